@@ -0,0 +1,254 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Per frame temporaries from the heap vs the frame arena: time per frame and heap allocations per frame
+//(counted by replacing global operator new), single threaded and from jobs spread over the workers.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit ArenaBench.cpp ../DirectXInit/FrameArena.cpp ../DirectXInit/JobSystem.cpp
+//		../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp -o ArenaBench
+//
+//	ArenaBench [frames] [temporariesPerFrame]
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+static atomic<uint64_t> heapAllocations(0);
+
+void* operator new(size_t size)
+{
+	heapAllocations.fetch_add(1, memory_order_relaxed);
+	void *mem = malloc(size > 0 ? size : 1);
+	if (!mem)
+		throw bad_alloc();
+	return mem;
+}
+
+void operator delete(void *mem) noexcept
+{
+	free(mem);
+}
+
+void operator delete(void *mem, size_t) noexcept
+{
+	free(mem);
+}
+
+
+//Something like gathering visible objects: a list that grows to a few hundred entries, summed up after
+template <class Vector>
+static uint64_t Gather(Vector &list, uint32_t seed, uint32_t count)
+{
+	list.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+		list.push_back((seed + i * 2654435761u) >> 8);
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < list.size(); ++i)
+		sum += list[i];
+	return sum;
+}
+
+struct Result
+{
+	double   usPerFrame;
+	double   heapPerFrame;
+	uint64_t checksum;
+};
+
+template <class Frame>
+static Result Measure(int frames, Frame frame)
+{
+	//Warm up (arena blocks come in on first use)
+	for (int f = 0; f < 8; ++f)
+		frame(f);
+
+	Result r = { 0.0, 0.0, 0 };
+	uint64_t heap0 = heapAllocations.load();
+	auto t0 = chrono::steady_clock::now();
+
+	for (int f = 0; f < frames; ++f)
+		r.checksum += frame(f);
+
+	auto t1 = chrono::steady_clock::now();
+	r.usPerFrame = chrono::duration<double, micro>(t1 - t0).count() / frames;
+	r.heapPerFrame = (double)(heapAllocations.load() - heap0) / frames;
+	return r;
+}
+
+static void Print(const char *name, const Result &r)
+{
+	printf("  %-28s %10.1f us %12.1f heap allocations/frame   (%llu)\n", name, r.usPerFrame, r.heapPerFrame, (unsigned long long)r.checksum);
+}
+
+//Threads keep one slot per arena however many arenas they go through, and give it back when they exit
+static bool VerifyThreadSlots()
+{
+	const int arenaCount = FRAMEARENA_TLS_ENTRIES + 2;
+	FrameArena arenas[arenaCount];
+	for (int a = 0; a < arenaCount; ++a)
+		arenas[a].Init(2, 4096, 2);
+
+	for (int round = 0; round < 3; ++round)
+	{
+		for (int a = 0; a < arenaCount; ++a)
+			arenas[a].Allocate(16);
+	}
+
+	for (int a = 0; a < arenaCount; ++a)
+	{
+		arenas[a].BeginFrame();
+		if (arenas[a].Stats().threads != 1)
+		{
+			printf("FAILED: arena %d has %u threads after the thread local entries went around\n", a, arenas[a].Stats().threads);
+			return false;
+		}
+	}
+
+	for (int t = 0; t < 100; ++t)
+	{
+		thread worker([&arenas]()
+		{
+			for (int a = 0; a < arenaCount; ++a)
+				arenas[a].Allocate(16);
+		});
+		worker.join();
+
+		arenas[0].BeginFrame();
+		if (arenas[0].Stats().threads != 1)
+		{
+			printf("FAILED: %u threads after %d short lived threads, their slots weren't given back\n", arenas[0].Stats().threads, t + 1);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (!VerifyThreadSlots())
+		return 1;
+
+	int frames = (argc > 1) ? atoi(argv[1]) : 500;
+	uint32_t temporaries = (argc > 2) ? (uint32_t)atoi(argv[2]) : 2000;
+
+	JobSystem jobs;
+	jobs.Start();
+
+	//Big enough that one thread can take the whole frame, overflows go straight to malloc and would be missed
+	//by the count below, so they're printed separately
+	size_t bytesPerThread = FRAMEARENA_DEFAULT_THREAD_BYTES;
+	while (bytesPerThread < temporaries * 256 * sizeof(uint32_t) + 64 * 1024)
+		bytesPerThread *= 2;
+
+	FrameArena arena;
+	arena.Init(FRAMEARENA_DEFAULT_FRAMES, bytesPerThread, jobs.WorkerCount() + JOB_MAX_EXTERNAL_THREADS + 1);
+
+	printf("%u temporaries of ~256 entries per frame, %d workers\n", temporaries, jobs.WorkerCount());
+
+	Result heapSerial = Measure(frames, [&](int f)
+	{
+		uint64_t sum = 0;
+		for (uint32_t t = 0; t < temporaries; ++t)
+		{
+			vector<uint32_t> list;
+			sum += Gather(list, f + t, 256);
+		}
+		return sum;
+	});
+
+	Result arenaSerial = Measure(frames, [&](int f)
+	{
+		arena.BeginFrame();
+
+		uint64_t sum = 0;
+		for (uint32_t t = 0; t < temporaries; ++t)
+		{
+			FrameVector<uint32_t> list((FrameAllocator<uint32_t>(&arena)));
+			sum += Gather(list, f + t, 256);
+		}
+		return sum;
+	});
+
+	//Same thing from jobs, each worker allocates from its own block
+	vector<uint64_t> sums(temporaries);
+	uint64_t *out = &sums[0];
+
+	Result heapJobs = Measure(frames, [&](int f)
+	{
+		jobs.ParallelFor(temporaries, 64, [out, f](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t t = begin; t < end; ++t)
+			{
+				vector<uint32_t> list;
+				out[t] = Gather(list, f + t, 256);
+			}
+		});
+
+		uint64_t sum = 0;
+		for (uint32_t t = 0; t < temporaries; ++t)
+			sum += out[t];
+		return sum;
+	});
+
+	FrameArena *frameArena = &arena;
+	Result arenaJobs = Measure(frames, [&](int f)
+	{
+		arena.BeginFrame();
+
+		jobs.ParallelFor(temporaries, 64, [out, f, frameArena](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t t = begin; t < end; ++t)
+			{
+				FrameVector<uint32_t> list((FrameAllocator<uint32_t>(frameArena)));
+				out[t] = Gather(list, f + t, 256);
+			}
+		});
+
+		uint64_t sum = 0;
+		for (uint32_t t = 0; t < temporaries; ++t)
+			sum += out[t];
+		return sum;
+	});
+
+	Print("heap, serial", heapSerial);
+	Print("arena, serial", arenaSerial);
+	Print("heap, jobs", heapJobs);
+	Print("arena, jobs", arenaJobs);
+
+	const FrameArenaStats &stats = arena.Stats();
+	printf("\narena: %.1f MB per thread, last frame %.1f KB in %llu allocations, high water %.1f KB (one thread %.1f KB)\n",
+		bytesPerThread / 1048576.0, stats.lastFrameBytes / 1024.0, (unsigned long long)stats.lastFrameAllocations,
+		stats.highWaterBytes / 1024.0, stats.threadHighWaterBytes / 1024.0);
+	printf("       %llu overflows over %llu frames, %.1f MB reserved by %u threads\n",
+		(unsigned long long)stats.overflowAllocations, (unsigned long long)stats.frames, stats.reservedBytes / 1048576.0, stats.threads);
+
+	jobs.Stop();
+
+	bool bSame = heapSerial.checksum == arenaSerial.checksum && heapJobs.checksum == arenaJobs.checksum && heapSerial.checksum == heapJobs.checksum;
+	return bSame ? 0 : 1;
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Small repeat-and-summarize harness for the benchmarks. Header only, include it from one bench.
+//
+//Every case is a function that does `ops` operations. The harness doubles ops until one repetition takes
+//at least -minms (so timer resolution stops mattering), runs -warmup repetitions it throws away, then
+//-reps timed ones. Reported per op: median, MAD (median absolute deviation from the median, the spread
+//that a couple of outliers can't drag around), min and max.
+//
+//Options every bench using it understands:
+//	-reps N			timed repetitions (default 15)
+//	-warmup N		repetitions thrown away first (default 3)
+//	-minms X		minimum time per repetition (default 20)
+//	-filter text	only cases whose name contains text
+//	-json path		write the results, one case per line so text diffs of two runs line up
+//	-baseline path	compare against a -json file from an earlier run
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//Store a result somewhere the optimizer has to assume is read
+static volatile uint64_t benchSink = 0;
+
+template <class T>
+inline void BenchKeep(T value)
+{
+	benchSink = benchSink + (uint64_t)value;
+}
+
+
+struct BenchResult
+{
+	std::string name;
+	uint64_t ops;			//Per repetition
+	int		 reps;
+	double	 medianNs;		//Per op
+	double	 madNs;
+	double	 minNs;
+	double	 maxNs;
+};
+
+
+class BenchSuite
+{
+public:
+	BenchSuite(const char *suiteName, int argc, char **argv)
+		: suite(suiteName), reps(15), warmup(3), minRepMs(20.0), filter(NULL), jsonPath(NULL), baselinePath(NULL)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			bool bHasValue = i + 1 < argc;
+			if (strcmp(argv[i], "-reps") == 0 && bHasValue)
+				reps = atoi(argv[++i]);
+			else if (strcmp(argv[i], "-warmup") == 0 && bHasValue)
+				warmup = atoi(argv[++i]);
+			else if (strcmp(argv[i], "-minms") == 0 && bHasValue)
+				minRepMs = atof(argv[++i]);
+			else if (strcmp(argv[i], "-filter") == 0 && bHasValue)
+				filter = argv[++i];
+			else if (strcmp(argv[i], "-json") == 0 && bHasValue)
+				jsonPath = argv[++i];
+			else if (strcmp(argv[i], "-baseline") == 0 && bHasValue)
+				baselinePath = argv[++i];
+		}
+
+		if (reps < 1)
+			reps = 1;
+		if (warmup < 0)
+			warmup = 0;
+
+		printf("%s: %d reps, %d warmup, >= %.1f ms per rep\n\n", suite.c_str(), reps, warmup, minRepMs);
+		printf("  %-40s %12s %10s %7s %10s %10s %12s\n", "(ns per op)", "ops/rep", "median", "mad %", "min", "max", baselinePath ? "vs baseline" : "");
+	}
+
+	inline bool Wants(const char *name) const { return !filter || strstr(name, filter) != NULL; }
+
+	//fn(ops) does ops operations. opsHint is where the doubling starts, for things too slow to start at 1k.
+	template <class TFn>
+	void Run(const char *name, TFn fn, uint64_t opsHint = 1024)
+	{
+		if (!Wants(name))
+			return;
+
+		uint64_t ops = opsHint > 0 ? opsHint : 1;
+		while (TimeNs(fn, ops) < minRepMs * 1e6 && ops < (1ull << 40))
+			ops *= 2;
+
+		for (int i = 0; i < warmup; ++i)
+			TimeNs(fn, ops);
+
+		std::vector<double> perOp(reps);
+		for (int i = 0; i < reps; ++i)
+			perOp[i] = TimeNs(fn, ops) / (double)ops;
+
+		BenchResult result;
+		result.name = name;
+		result.ops = ops;
+		result.reps = reps;
+		Summarize(perOp, result);
+		results.push_back(result);
+
+		printf("  %-40s %12llu %10.2f %7.2f %10.2f %10.2f %12s\n", name, (unsigned long long)ops, result.medianNs,
+			result.medianNs > 0.0 ? 100.0 * result.madNs / result.medianNs : 0.0, result.minNs, result.maxNs, Versus(result).c_str());
+		fflush(stdout);
+	}
+
+	//Writes the json and returns the exit code
+	int Finish()
+	{
+		printf("\n");
+
+		if (!jsonPath)
+			return 0;
+
+		FILE *file = fopen(jsonPath, "w");
+		if (!file)
+		{
+			printf("couldn't write %s\n", jsonPath);
+			return 1;
+		}
+
+		fprintf(file, "{\"suite\":\"%s\",\"reps\":%d,\"warmup\":%d,\"minRepMs\":%.3f,\"results\":[\n", suite.c_str(), reps, warmup, minRepMs);
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const BenchResult &r = results[i];
+
+			//Case names are ours, no quotes or backslashes to escape
+			fprintf(file, "{\"name\":\"%s\",\"ops\":%llu,\"reps\":%d,\"medianNs\":%.4f,\"madNs\":%.4f,\"minNs\":%.4f,\"maxNs\":%.4f}%s\n",
+				r.name.c_str(), (unsigned long long)r.ops, r.reps, r.medianNs, r.madNs, r.minNs, r.maxNs, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "]}\n");
+
+		return fclose(file) == 0 ? 0 : 1;
+	}
+
+private:
+	BenchSuite(const BenchSuite&);
+	BenchSuite& operator=(const BenchSuite&);
+
+	template <class TFn>
+	static double TimeNs(TFn &fn, uint64_t ops)
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn(ops);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count();
+	}
+
+	static double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		size_t n = values.size();
+		return (n & 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+	}
+
+	static void Summarize(const std::vector<double> &perOp, BenchResult &out)
+	{
+		out.medianNs = Median(perOp);
+		out.minNs = *std::min_element(perOp.begin(), perOp.end());
+		out.maxNs = *std::max_element(perOp.begin(), perOp.end());
+
+		std::vector<double> deviations(perOp.size());
+		for (size_t i = 0; i < perOp.size(); ++i)
+			deviations[i] = fabs(perOp[i] - out.medianNs);
+		out.madNs = Median(deviations);
+	}
+
+	//The same case in the baseline file, false if it has none. Lines look like what Finish writes.
+	bool FindBaseline(const std::string &name, double &medianNs, double &madNs)
+	{
+		if (!baselinePath)
+			return false;
+
+		if (baselineLines.empty())
+		{
+			FILE *file = fopen(baselinePath, "r");
+			if (!file)
+			{
+				printf("couldn't read %s\n", baselinePath);
+				baselinePath = NULL;
+				return false;
+			}
+
+			char line[1024];
+			while (fgets(line, sizeof(line), file))
+				baselineLines.push_back(line);
+			fclose(file);
+		}
+
+		std::string key = "{\"name\":\"" + name + "\",";
+		for (size_t i = 0; i < baselineLines.size(); ++i)
+		{
+			if (baselineLines[i].compare(0, key.size(), key) != 0)
+				continue;
+
+			const char *median = strstr(baselineLines[i].c_str(), "\"medianNs\":");
+			const char *mad = strstr(baselineLines[i].c_str(), "\"madNs\":");
+			if (!median || !mad)
+				return false;
+
+			medianNs = atof(median + 11);
+			madNs = atof(mad + 8);
+			return true;
+		}
+
+		return false;
+	}
+
+	//Change against the baseline. Starred when the medians are further apart than three MADs of the noisier
+	//run, i.e. probably not noise.
+	std::string Versus(const BenchResult &result)
+	{
+		double oldMedian = 0.0, oldMad = 0.0;
+		if (!FindBaseline(result.name, oldMedian, oldMad) || oldMedian <= 0.0)
+			return "";
+
+		double change = 100.0 * (result.medianNs - oldMedian) / oldMedian;
+		bool bSignificant = fabs(result.medianNs - oldMedian) > 3.0 * (oldMad > result.madNs ? oldMad : result.madNs);
+
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%+.1f%%%s", change, bSignificant ? " *" : "");
+		return buffer;
+	}
+
+	std::string suite;
+	int		reps;
+	int		warmup;
+	double	minRepMs;
+	const char *filter;
+	const char *jsonPath;
+	const char *baselinePath;
+
+	std::vector<BenchResult> results;
+	std::vector<std::string> baselineLines;
+};
@@ -0,0 +1,461 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//SceneBvh over 10k/100k boxes scattered through a city sized block (the same scene as CullBench): full
+//Build, Update with 1%/10% of the objects moved, and frustum, pick ray and proximity queries against doing
+//the same by testing every object from an array of structs. Checks the queries against brute force first,
+//on a fresh build and again after a few frames of moving, adding and removing objects, and returns 1 if
+//they don't agree.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit BvhBench.cpp ../DirectXInit/SceneBvh.cpp ../DirectXInit/FrustumCull.cpp
+//		../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp
+//		../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp -o BvhBench
+//
+//	BvhBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static const float WORLD_SIZE = 2000.0f;
+static const uint32_t QUERY_COUNT = 256;
+
+
+static uint32_t randState = 12345;
+static uint32_t RandUint()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return randState >> 8;
+}
+
+static float RandFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)RandUint() / 16777216.0f;
+}
+
+
+//What an app without the tree would keep: bounds next to everything else about the object
+struct SceneObject
+{
+	Float3	 min;
+	Float3	 max;
+	uint32_t mesh;
+	Float4x4 world;
+	BvhObjectId id;
+	bool	 bLive;
+};
+
+struct BvhScene
+{
+	vector<SceneObject> objects;
+	SceneBvh bvh;
+	Frustum frustum;
+
+	//Pick rays from the camera, and spots to look around
+	vector<Float3> rayOrigins, rayDirections, sphereCenters;
+
+	BvhScene(uint32_t count)
+	{
+		objects.resize(count);
+		bvh.Reserve(count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			SceneObject &object = objects[i];
+			Float3 center = { RandFloat(-WORLD_SIZE, WORLD_SIZE), RandFloat(0.0f, 100.0f), RandFloat(-WORLD_SIZE, WORLD_SIZE) };
+			Float3 extents = { RandFloat(0.5f, 10.0f), RandFloat(0.5f, 20.0f), RandFloat(0.5f, 10.0f) };
+			SetBox(object, center, extents);
+			object.mesh = i;
+			StoreFloat4x4(object.world, Mat4Translation(center.x, center.y, center.z));
+			object.id = bvh.Add(object.min, object.max);
+			object.bLive = true;
+		}
+		bvh.Build();
+
+		Float3 eye = { 0.0f, 30.0f, -200.0f };
+		Mat4 view = Mat4LookAtLH(LoadFloat3(eye, 1.0f), Vec4Set(300.0f, 0.0f, 800.0f, 1.0f), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f));
+		frustum = FrustumFromCamera(view, 0.25f * MATH_PI, 16.0f / 9.0f, 1.0f, 1500.0f);
+
+		//Rays spread over the view, the way mouse clicks would be
+		Mat4 cameraToWorld = Mat4InverseAffine(view);
+		for (uint32_t q = 0; q < QUERY_COUNT; ++q)
+		{
+			Float3 direction;
+			StoreFloat3(direction, TransformVector(Vec4Set(RandFloat(-0.7f, 0.7f), RandFloat(-0.4f, 0.4f), 1.0f, 0.0f), cameraToWorld));
+			rayOrigins.push_back(eye);
+			rayDirections.push_back(direction);
+
+			Float3 center = { RandFloat(-WORLD_SIZE, WORLD_SIZE), RandFloat(0.0f, 100.0f), RandFloat(-WORLD_SIZE, WORLD_SIZE) };
+			sphereCenters.push_back(center);
+		}
+	}
+
+	static void SetBox(SceneObject &object, const Float3 &center, const Float3 &extents)
+	{
+		object.min.x = center.x - extents.x;
+		object.min.y = center.y - extents.y;
+		object.min.z = center.z - extents.z;
+		object.max.x = center.x + extents.x;
+		object.max.y = center.y + extents.y;
+		object.max.z = center.z + extents.z;
+	}
+
+	//Nudge every stride'th object starting at first by (dx, dz)
+	void Move(uint32_t first, uint32_t stride, float dx, float dz)
+	{
+		for (uint32_t i = first; i < (uint32_t)objects.size(); i += stride)
+		{
+			SceneObject &object = objects[i];
+			if (!object.bLive)
+				continue;
+
+			object.min.x += dx;
+			object.max.x += dx;
+			object.min.z += dz;
+			object.max.z += dz;
+			bvh.SetBounds(object.id, object.min, object.max);
+		}
+	}
+
+	uint32_t FrustumReference(vector<BvhObjectId> &out) const
+	{
+		out.clear();
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			const SceneObject &object = objects[i];
+			Float3 center = { (object.min.x + object.max.x) * 0.5f, (object.min.y + object.max.y) * 0.5f, (object.min.z + object.max.z) * 0.5f };
+			Float3 extents = { (object.max.x - object.min.x) * 0.5f, (object.max.y - object.min.y) * 0.5f, (object.max.z - object.min.z) * 0.5f };
+			if (object.bLive && FrustumTestBox(frustum, center, extents))
+				out.push_back(object.id);
+		}
+		return (uint32_t)out.size();
+	}
+
+	uint32_t SphereReference(const Float3 &center, float radius, vector<BvhObjectId> &out) const
+	{
+		out.clear();
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			const SceneObject &object = objects[i];
+			float dx = fmaxf(fmaxf(object.min.x - center.x, center.x - object.max.x), 0.0f);
+			float dy = fmaxf(fmaxf(object.min.y - center.y, center.y - object.max.y), 0.0f);
+			float dz = fmaxf(fmaxf(object.min.z - center.z, center.z - object.max.z), 0.0f);
+			if (object.bLive && dx * dx + dy * dy + dz * dz <= radius * radius)
+				out.push_back(object.id);
+		}
+		return (uint32_t)out.size();
+	}
+
+	uint32_t BoxReference(const Float3 &min, const Float3 &max, vector<BvhObjectId> &out) const
+	{
+		out.clear();
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			const SceneObject &object = objects[i];
+			if (object.bLive && object.min.x <= max.x && object.max.x >= min.x && object.min.y <= max.y && object.max.y >= min.y &&
+				object.min.z <= max.z && object.max.z >= min.z)
+				out.push_back(object.id);
+		}
+		return (uint32_t)out.size();
+	}
+
+	//Distance to the nearest box hit, maxDistance if none
+	float RayReference(const Float3 &origin, const Float3 &direction, float maxDistance) const
+	{
+		float invX = 1.0f / direction.x, invY = 1.0f / direction.y, invZ = 1.0f / direction.z;
+		float best = maxDistance;
+		for (size_t i = 0; i < objects.size(); ++i)
+		{
+			const SceneObject &object = objects[i];
+			float x1 = (object.min.x - origin.x) * invX, x2 = (object.max.x - origin.x) * invX;
+			float y1 = (object.min.y - origin.y) * invY, y2 = (object.max.y - origin.y) * invY;
+			float z1 = (object.min.z - origin.z) * invZ, z2 = (object.max.z - origin.z) * invZ;
+			float enter = fmaxf(fmaxf(fminf(x1, x2), fminf(y1, y2)), fmaxf(fminf(z1, z2), 0.0f));
+			float leave = fminf(fminf(fmaxf(x1, x2), fmaxf(y1, y2)), fmaxf(z1, z2));
+			if (object.bLive && enter <= leave && enter < best)
+				best = enter;
+		}
+		return best;
+	}
+
+	//How close the object is to being on the other side of some plane, for telling rounding apart from bugs
+	float FrustumMargin(BvhObjectId id) const
+	{
+		Float3 min, max;
+		bvh.GetBounds(id, min, max);
+		float margin = 1e30f;
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+		{
+			const Float4 &plane = frustum.planes[p];
+			float nearDistance = (plane.x >= 0.0f ? max.x : min.x) * plane.x + (plane.y >= 0.0f ? max.y : min.y) * plane.y +
+				(plane.z >= 0.0f ? max.z : min.z) * plane.z + plane.w;
+			margin = fminf(margin, fabsf(nearDistance));
+		}
+		return margin;
+	}
+};
+
+
+static uint32_t CountDifferences(vector<BvhObjectId> &a, vector<BvhObjectId> &b, const BvhScene *frustumScene)
+{
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+
+	vector<BvhObjectId> different;
+	set_symmetric_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(different));
+
+	uint32_t bad = 0;
+	for (size_t i = 0; i < different.size(); ++i)
+		if (!frustumScene || frustumScene->FrustumMargin(different[i]) > 1e-3f)
+			++bad;
+	return bad;
+}
+
+static bool VerifyQueries(BvhScene &scene, const char *when)
+{
+	vector<BvhObjectId> reference, result;
+	uint32_t frustumBad, sphereBad = 0, boxBad = 0, rayBad = 0;
+
+	scene.FrustumReference(reference);
+	scene.bvh.QueryFrustum(scene.frustum, result);
+	uint32_t visible = (uint32_t)result.size();
+	frustumBad = CountDifferences(reference, result, &scene);
+
+	for (uint32_t q = 0; q < QUERY_COUNT; ++q)
+	{
+		const Float3 &center = scene.sphereCenters[q];
+		scene.SphereReference(center, 60.0f, reference);
+		result.clear();
+		scene.bvh.QuerySphere(center, 60.0f, result);
+		sphereBad += CountDifferences(reference, result, NULL);
+
+		Float3 min = { center.x - 50.0f, center.y - 10.0f, center.z - 80.0f };
+		Float3 max = { center.x + 50.0f, center.y + 10.0f, center.z + 80.0f };
+		scene.BoxReference(min, max, reference);
+		result.clear();
+		scene.bvh.QueryBox(min, max, result);
+		boxBad += CountDifferences(reference, result, NULL);
+
+		float expected = scene.RayReference(scene.rayOrigins[q], scene.rayDirections[q], 1e6f);
+		BvhRayHit hit;
+		bool bHit = scene.bvh.Raycast(scene.rayOrigins[q], scene.rayDirections[q], 1e6f, hit);
+		if (bHit != (expected < 1e6f) || fabsf(hit.distance - expected) > 1e-4f * fmaxf(expected, 1.0f))
+			++rayBad;
+	}
+
+	bool bOk = frustumBad == 0 && sphereBad == 0 && boxBad == 0 && rayBad == 0;
+	printf("%u %s: depth %u, %u nodes, %u visible, wrong: %u frustum %u sphere %u box %u ray%s\n",
+		scene.bvh.Count(), when, scene.bvh.Depth(), scene.bvh.NodeCount(), visible, frustumBad, sphereBad, boxBad, rayBad,
+		bOk ? "" : "  FAILED");
+	return bOk;
+}
+
+//Fresh build, then frames of objects drifting away (enough to set off rebuilds), some removed and added
+static bool VerifyScene(uint32_t count)
+{
+	BvhScene scene(count);
+	bool bOk = VerifyQueries(scene, "built");
+
+	uint32_t refit = 0, rebuilt = 0;
+	for (uint32_t frame = 0; frame < 30; ++frame)
+	{
+		scene.Move(frame % 10, 10, RandFloat(-40.0f, 40.0f), RandFloat(-40.0f, 40.0f));
+
+		for (uint32_t n = 0; n < count / 200; ++n)
+		{
+			SceneObject &object = scene.objects[RandUint() % count];
+			if (object.bLive)
+			{
+				scene.bvh.Remove(object.id);
+				object.bLive = false;
+			}
+		}
+
+		for (uint32_t n = 0; n < count / 400; ++n)
+		{
+			SceneObject object;
+			Float3 center = { RandFloat(-WORLD_SIZE, WORLD_SIZE), RandFloat(0.0f, 100.0f), RandFloat(-WORLD_SIZE, WORLD_SIZE) };
+			Float3 extents = { RandFloat(0.5f, 10.0f), RandFloat(0.5f, 20.0f), RandFloat(0.5f, 10.0f) };
+			BvhScene::SetBox(object, center, extents);
+			object.mesh = 0;
+			object.id = scene.bvh.Add(object.min, object.max);
+			object.bLive = true;
+			scene.objects.push_back(object);
+		}
+
+		scene.bvh.Update();
+		refit += scene.bvh.LastRefitNodes();
+		rebuilt += scene.bvh.LastRebuildObjects();
+	}
+
+	printf("%u after 30 updates: %u nodes refit, %u objects rebuilt\n", count, refit, rebuilt);
+	return VerifyQueries(scene, "updated") && bOk;
+}
+
+
+static void BuildCases(BenchSuite &suite, uint32_t count, const char *countName)
+{
+	char name[128];
+	snprintf(name, sizeof(name), "bvh/%s build", countName);
+	if (!suite.Wants(name))
+		return;
+
+	BvhScene scene(count);
+
+	//One op is one whole build
+	suite.Run(name, [&scene](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.bvh.Build();
+		BenchKeep(scene.bvh.NodeCount());
+	}, 1);
+}
+
+static void RefitCases(BenchSuite &suite, uint32_t count, const char *countName)
+{
+	static const uint32_t strides[2] = { 100, 10 };
+	static const char *strideNames[2] = { "1%", "10%" };
+
+	for (int s = 0; s < 2; ++s)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "bvh/%s update %s moved", countName, strideNames[s]);
+		if (!suite.Wants(name))
+			continue;
+
+		BvhScene scene(count);
+		uint32_t stride = strides[s];
+
+		//One op is one frame: move the objects (back and forth, so the tree stays in one shape) and Update
+		uint64_t frame = 0;
+		suite.Run(name, [&scene, &frame, stride](uint64_t ops)
+		{
+			for (uint64_t n = 0; n < ops; ++n, ++frame)
+			{
+				float dx = (frame & 1) ? -3.0f : 3.0f;
+				scene.Move((uint32_t)(frame / 2 % stride), stride, dx, dx);
+				scene.bvh.Update();
+			}
+			BenchKeep(scene.bvh.LastRefitNodes());
+		}, 1);
+	}
+}
+
+static void QueryCases(BenchSuite &suite, uint32_t count, const char *countName)
+{
+	char names[6][128];
+	bool bAny = false;
+	static const char *kinds[3] = { "frustum", "ray", "sphere" };
+	for (int k = 0; k < 3; ++k)
+	{
+		snprintf(names[k * 2], sizeof(names[k * 2]), "bvh/%s %s brute force", countName, kinds[k]);
+		snprintf(names[k * 2 + 1], sizeof(names[k * 2 + 1]), "bvh/%s %s", countName, kinds[k]);
+		bAny = bAny || suite.Wants(names[k * 2]) || suite.Wants(names[k * 2 + 1]);
+	}
+
+	if (!bAny)
+		return;
+
+	BvhScene scene(count);
+	vector<BvhObjectId> found;
+	found.reserve(count);
+
+	//One op is the whole view
+	suite.Run(names[0], [&scene, &found](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.FrustumReference(found);
+		BenchKeep(found.size());
+	}, 1);
+
+	suite.Run(names[1], [&scene, &found](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+		{
+			found.clear();
+			scene.bvh.QueryFrustum(scene.frustum, found);
+		}
+		BenchKeep(found.size());
+	}, 1);
+
+	//One op is one ray
+	suite.Run(names[2], [&scene](uint64_t ops)
+	{
+		float total = 0.0f;
+		for (uint64_t n = 0; n < ops; ++n)
+			total += scene.RayReference(scene.rayOrigins[n % QUERY_COUNT], scene.rayDirections[n % QUERY_COUNT], 1e6f);
+		BenchKeep(total);
+	}, 16);
+
+	suite.Run(names[3], [&scene](uint64_t ops)
+	{
+		float total = 0.0f;
+		BvhRayHit hit;
+		for (uint64_t n = 0; n < ops; ++n)
+		{
+			scene.bvh.Raycast(scene.rayOrigins[n % QUERY_COUNT], scene.rayDirections[n % QUERY_COUNT], 1e6f, hit);
+			total += hit.distance;
+		}
+		BenchKeep(total);
+	}, 1024);
+
+	//One op is everything within 60 of one spot
+	suite.Run(names[4], [&scene, &found](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.SphereReference(scene.sphereCenters[n % QUERY_COUNT], 60.0f, found);
+		BenchKeep(found.size());
+	}, 16);
+
+	suite.Run(names[5], [&scene, &found](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+		{
+			found.clear();
+			scene.bvh.QuerySphere(scene.sphereCenters[n % QUERY_COUNT], 60.0f, found);
+		}
+		BenchKeep(found.size());
+	}, 1024);
+}
+
+int main(int argc, char **argv)
+{
+	bool bOk = VerifyScene(10007);
+	bOk = VerifyScene(100003) && bOk;
+	printf("\n");
+	if (!bOk)
+		printf("the tree doesn't match brute force, timings follow anyway\n\n");
+
+	BenchSuite suite("BvhBench", argc, argv);
+
+	BuildCases(suite, 10000, "10k");
+	BuildCases(suite, 100000, "100k");
+	RefitCases(suite, 10000, "10k");
+	RefitCases(suite, 100000, "100k");
+	QueryCases(suite, 10000, "10k");
+	QueryCases(suite, 100000, "100k");
+
+	int result = suite.Finish();
+	return bOk ? result : 1;
+}
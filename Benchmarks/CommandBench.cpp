@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Render command list: record/sort/replay cost per frame, radix sort vs std::stable_sort, and how many
+//state binds reach the backend in submission order vs key order. Replays into the recording context,
+//so no device needed.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -I../DirectXInit CommandBench.cpp ../DirectXInit/RenderCommands.cpp ../DirectXInit/RenderContext.cpp -o CommandBench
+//
+//	CommandBench [draws] [frames]
+
+#include "RenderCommands.h"
+#include "RenderContext.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+struct SceneDraw
+{
+	uint32_t state;
+	uint32_t material;
+	uint32_t geometry;
+	float	 depth;
+	bool	 transparent;
+};
+
+//Roughly a scene's worth of variety: few pipeline states, more materials, lots of meshes
+static void MakeScene(vector<SceneDraw> &draws, uint32_t count)
+{
+	srand(1234);
+	draws.resize(count);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		SceneDraw &d = draws[i];
+		d.state = 1 + rand() % 16;
+		d.material = 1 + rand() % 256;
+		d.geometry = 1 + rand() % 1024;
+		d.depth = (float)rand() / (float)RAND_MAX;
+		d.transparent = (rand() % 10) == 0;
+	}
+}
+
+static void Record(RenderCommandList &list, const vector<SceneDraw> &draws, bool bUseKeys)
+{
+	static const float clearColor[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	float constants[16] = { 0 };
+
+	list.Reset();
+	list.ClearColor(MakePassStartKey(0), clearColor);
+	list.ClearDepthStencil(MakePassStartKey(0), 1.0f, 0);
+
+	for (size_t i = 0; i < draws.size(); ++i)
+	{
+		const SceneDraw &d = draws[i];
+		constants[0] = d.depth;
+
+		//Without keys everything ties and replays in submission order
+		uint64_t key = 0;
+		if (bUseKeys)
+			key = d.transparent ? MakeTransparentKey(2, d.depth, d.state, d.material) : MakeOpaqueKey(1, d.state, d.material, d.depth);
+
+		list.DrawIndexed(key, d.state, d.material, d.geometry, 36, 0, 0, constants, sizeof(constants));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t drawCount = (argc > 1) ? (uint32_t)atoi(argv[1]) : 20000;
+	int frames = (argc > 2) ? atoi(argv[2]) : 200;
+
+	vector<SceneDraw> draws;
+	MakeScene(draws, drawCount);
+
+	RenderCommandList list(drawCount + 16, (drawCount + 16) * 64);
+	RecordingRenderContext context;
+	context.SetKeepCalls(false);
+
+	//Binds that reach the backend
+	Record(list, draws, false);
+	list.Submit(context);
+	RenderCommandStats unsorted = list.LastStats();
+
+	Record(list, draws, true);
+	list.Submit(context);
+	RenderCommandStats sorted = list.LastStats();
+
+	bool bOrdered = true;
+	for (uint32_t i = 1; i < list.CommandCount(); ++i)
+		bOrdered = bOrdered && (list.SortedKey(i - 1) <= list.SortedKey(i));
+
+	printf("%u draws\n", drawCount);
+	printf("  %-22s %10s %10s %10s\n", "", "states", "materials", "geometry");
+	printf("  %-22s %10u %10u %10u\n", "submission order", unsorted.stateChanges, unsorted.materialChanges, unsorted.geometryChanges);
+	printf("  %-22s %10u %10u %10u   (%u radix passes%s)\n\n", "key order", sorted.stateChanges, sorted.materialChanges, sorted.geometryChanges,
+		sorted.sortPasses, bOrdered ? "" : ", NOT SORTED!");
+
+	//Per frame costs
+	double recordUs = 0.0, sortUs = 0.0, submitUs = 0.0, stdSortUs = 0.0;
+	vector<pair<uint64_t, uint32_t> > stdKeys;
+	stdKeys.reserve(drawCount + 2);
+
+	for (int f = 0; f < frames; ++f)
+	{
+		auto t0 = chrono::steady_clock::now();
+		Record(list, draws, true);
+		auto t1 = chrono::steady_clock::now();
+		list.Sort();
+		auto t2 = chrono::steady_clock::now();
+		list.Submit(context);
+		auto t3 = chrono::steady_clock::now();
+
+		recordUs += chrono::duration<double, micro>(t1 - t0).count();
+		sortUs += chrono::duration<double, micro>(t2 - t1).count();
+		submitUs += chrono::duration<double, micro>(t3 - t2).count();
+
+		//Same key/index pairs through the standard library, in recorded order
+		stdKeys.clear();
+		for (uint32_t i = 0; i < list.CommandCount(); ++i)
+			stdKeys.push_back(make_pair(list.SortedKey(i), list.SortedCommandIndex(i)));
+		sort(stdKeys.begin(), stdKeys.end(), [](const pair<uint64_t, uint32_t> &a, const pair<uint64_t, uint32_t> &b) { return a.second < b.second; });
+
+		auto s0 = chrono::steady_clock::now();
+		stable_sort(stdKeys.begin(), stdKeys.end(), [](const pair<uint64_t, uint32_t> &a, const pair<uint64_t, uint32_t> &b) { return a.first < b.first; });
+		auto s1 = chrono::steady_clock::now();
+		stdSortUs += chrono::duration<double, micro>(s1 - s0).count();
+	}
+
+	printf("Per frame (us)\n");
+	printf("  %-22s %10.1f\n", "record", recordUs / frames);
+	printf("  %-22s %10.1f\n", "radix sort", sortUs / frames);
+	printf("  %-22s %10.1f\n", "std::stable_sort", stdSortUs / frames);
+	printf("  %-22s %10.1f\n", "replay", submitUs / frames);
+
+	return bOrdered ? 0 : 1;
+}
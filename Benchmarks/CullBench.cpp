@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//FrustumCuller::Cull over 100k/1M spheres and boxes scattered through a city sized block, seen by a camera
+//in the middle (about a tenth end up visible), serial and on the job system, against testing the same
+//bounds one object at a time from an array of structs. Checks both agree first and returns 1 if they don't.
+//The CMake build also makes CullBenchScalar (DXAPP_MATH_SCALAR) and, where the compiler has it,
+//CullBenchAVX2, so the backends can be run side by side.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit CullBench.cpp ../DirectXInit/FrustumCull.cpp
+//		../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp
+//		../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp -o CullBench
+//		(add -DDXAPP_MATH_SCALAR or -mavx2 -mfma for the other backends)
+//
+//	CullBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "FrustumCull.h"
+#include "JobSystem.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static const float WORLD_SIZE = 2000.0f;
+
+
+static uint32_t randState = 12345;
+static uint32_t RandUint()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return randState >> 8;
+}
+
+static float RandFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)RandUint() / 16777216.0f;
+}
+
+
+//What an app without the culler would keep: bounds next to everything else about the object
+struct SceneObject
+{
+	Float3	 center;
+	Float3	 extents;
+	float	 radius;
+	uint32_t mesh;
+	Float4x4 world;
+};
+
+struct CullScene
+{
+	vector<SceneObject> objects;
+	FrustumCuller culler;
+	Frustum frustum;
+	bool bBoxes;
+
+	CullScene(uint32_t count, bool boxes)
+		: bBoxes(boxes)
+	{
+		objects.resize(count);
+		culler.Reserve(count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			SceneObject &object = objects[i];
+			object.center.x = RandFloat(-WORLD_SIZE, WORLD_SIZE);
+			object.center.y = RandFloat(0.0f, 100.0f);
+			object.center.z = RandFloat(-WORLD_SIZE, WORLD_SIZE);
+			object.extents.x = RandFloat(0.5f, 10.0f);
+			object.extents.y = RandFloat(0.5f, 20.0f);
+			object.extents.z = RandFloat(0.5f, 10.0f);
+			object.mesh = i;
+			StoreFloat4x4(object.world, Mat4Translation(object.center.x, object.center.y, object.center.z));
+
+			if (bBoxes)
+			{
+				object.radius = Length3(LoadFloat3(object.extents));
+				culler.AddBox(object.center, object.extents);
+			}
+			else
+			{
+				object.radius = object.extents.x;
+				object.extents.x = object.extents.y = object.extents.z = object.radius;
+				culler.AddSphere(object.center, object.radius);
+			}
+		}
+
+		Mat4 view = Mat4LookAtLH(Vec4Set(0.0f, 30.0f, -200.0f, 1.0f), Vec4Set(300.0f, 0.0f, 800.0f, 1.0f), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f));
+		frustum = FrustumFromCamera(view, 0.25f * MATH_PI, 16.0f / 9.0f, 1.0f, 1500.0f);
+	}
+
+	uint32_t CullReference(vector<uint32_t> &visible) const
+	{
+		visible.clear();
+		for (uint32_t i = 0; i < (uint32_t)objects.size(); ++i)
+		{
+			const SceneObject &object = objects[i];
+			if (FrustumTestSphere(frustum, object.center, object.radius) && (!bBoxes || FrustumTestBox(frustum, object.center, object.extents)))
+				visible.push_back(i);
+		}
+		return (uint32_t)visible.size();
+	}
+
+	//How close the object is to being on the other side of some plane, for telling rounding apart from bugs
+	float Margin(uint32_t i) const
+	{
+		const SceneObject &object = objects[i];
+		float margin = 1e30f;
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+		{
+			const Float4 &plane = frustum.planes[p];
+			float distance = object.center.x * plane.x + object.center.y * plane.y + object.center.z * plane.z + plane.w;
+			float sphere = fabsf(distance + object.radius);
+			float box = fabsf(distance + object.extents.x * fabsf(plane.x) + object.extents.y * fabsf(plane.y) + object.extents.z * fabsf(plane.z));
+			margin = fminf(margin, bBoxes ? fminf(sphere, box) : sphere);
+		}
+		return margin;
+	}
+};
+
+
+//Anything in one list and not the other has to be right on a plane
+static bool VerifyScene(JobSystem &jobs, uint32_t count, bool bBoxes)
+{
+	CullScene scene(count, bBoxes);
+
+	vector<uint32_t> reference;
+	scene.CullReference(reference);
+
+	bool bOk = true;
+	for (int withJobs = 0; withJobs < 2; ++withJobs)
+	{
+		scene.culler.Cull(scene.frustum, withJobs ? &jobs : NULL);
+		const uint32_t *visible = scene.culler.Visible();
+		uint32_t visibleCount = scene.culler.VisibleCount();
+
+		uint32_t mismatches = 0, bad = 0, a = 0, b = 0;
+		bool bOrdered = true;
+		while (a < reference.size() || b < visibleCount)
+		{
+			if (b > 0 && b < visibleCount && visible[b] <= visible[b - 1])
+				bOrdered = false;
+
+			uint32_t index;
+			if (b == visibleCount || (a < reference.size() && reference[a] < visible[b]))
+				index = reference[a++];
+			else if (a == reference.size() || visible[b] < reference[a])
+				index = visible[b++];
+			else
+			{
+				++a;
+				++b;
+				continue;
+			}
+
+			++mismatches;
+			if (scene.Margin(index) > 1e-3f)
+				++bad;
+		}
+
+		printf("%u %s%s: %u visible, reference %u, %u on a plane, %u wrong%s\n", count, bBoxes ? "boxes" : "spheres",
+			withJobs ? " jobs" : "", visibleCount, (uint32_t)reference.size(), mismatches - bad, bad,
+			bad || !bOrdered ? "  FAILED" : "");
+		bOk = bOk && bad == 0 && bOrdered;
+	}
+
+	return bOk;
+}
+
+
+static void CullCases(BenchSuite &suite, JobSystem &jobs, uint32_t count, const char *countName, bool bBoxes)
+{
+	static const char *variants[3] = { " reference", "", " jobs" };
+
+	char names[3][128];
+	bool bAny = false;
+	for (int v = 0; v < 3; ++v)
+	{
+		snprintf(names[v], sizeof(names[v]), "cull/%s %s%s", countName, bBoxes ? "boxes" : "spheres", variants[v]);
+		bAny = bAny || suite.Wants(names[v]);
+	}
+
+	if (!bAny)
+		return;
+
+	CullScene scene(count, bBoxes);
+	vector<uint32_t> visible;
+	visible.reserve(count);
+
+	//One op is one whole cull
+	suite.Run(names[0], [&scene, &visible](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.CullReference(visible);
+		BenchKeep(visible.size());
+	}, 1);
+
+	for (int withJobs = 0; withJobs < 2; ++withJobs)
+	{
+		JobSystem *jobsPtr = withJobs ? &jobs : NULL;
+		suite.Run(names[1 + withJobs], [&scene, jobsPtr](uint64_t ops)
+		{
+			for (uint64_t n = 0; n < ops; ++n)
+				scene.culler.Cull(scene.frustum, jobsPtr);
+			BenchKeep(scene.culler.VisibleCount());
+		}, 1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	JobSystem jobs;
+	jobs.Start();
+
+	bool bOk = VerifyScene(jobs, 100003, false);
+	bOk = VerifyScene(jobs, 100003, true) && bOk;
+	printf("\n");
+	if (!bOk)
+		printf("the culler doesn't match the reference, timings follow anyway\n\n");
+
+	BenchSuite suite("CullBench", argc, argv);
+
+	CullCases(suite, jobs, 100000, "100k", false);
+	CullCases(suite, jobs, 100000, "100k", true);
+	CullCases(suite, jobs, 1000000, "1M", false);
+	CullCases(suite, jobs, 1000000, "1M", true);
+
+	int result = suite.Finish();
+	jobs.Stop();
+	return bOk ? result : 1;
+}
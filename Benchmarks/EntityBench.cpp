@@ -0,0 +1,435 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//One frame of updates over 10k/100k entities of four kinds (movers, movers with health, spinners, static
+//props), as heap allocated objects behind a virtual Update in a shuffled list, the way a ProcSceneUpdate
+//would hand roll it, against EntityStore chunk iteration, serial and on the job system. Then structural
+//changes through command buffers: spawning and despawning, adding and removing a component. Checks the
+//store ends up with the same positions as the objects first and returns 1 if not.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit EntityBench.cpp ../DirectXInit/EntityStore.cpp
+//		../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp
+//		../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp -o EntityBench
+//
+//	EntityBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "VecMath.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+static const float FRAME_DT = 1.0f / 60.0f;
+
+
+struct Position { float x, y, z; };
+struct Velocity { float x, y, z; };
+struct Health	{ float value, regen; };
+struct Spin		{ float angle, rate; };
+struct Spawned	{ uint32_t frame; };
+
+
+static uint32_t randState = 12345;
+static uint32_t RandUint()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return randState >> 8;
+}
+
+static float RandFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)RandUint() / 16777216.0f;
+}
+
+
+//The hand rolled version
+class GameObject
+{
+public:
+	GameObject() : entity(ENTITY_NONE) { position.x = position.y = position.z = 0.0f; }
+	virtual ~GameObject() { }
+	virtual void Update(float dt) = 0;
+
+	Position position;
+	Entity	 entity;		//Its twin in the store, for checking
+};
+
+class Mover : public GameObject
+{
+public:
+	virtual void Update(float dt)
+	{
+		position.x += velocity.x * dt;
+		position.y += velocity.y * dt;
+		position.z += velocity.z * dt;
+	}
+
+	Velocity velocity;
+};
+
+class HealthMover : public Mover
+{
+public:
+	virtual void Update(float dt)
+	{
+		Mover::Update(dt);
+		health.value = fminf(health.value + health.regen * dt, 100.0f);
+	}
+
+	Health health;
+};
+
+class Spinner : public GameObject
+{
+public:
+	virtual void Update(float dt)
+	{
+		spin.angle += spin.rate * dt;
+		if (spin.angle > MATH_PI)
+			spin.angle -= 2.0f * MATH_PI;
+	}
+
+	Spin spin;
+};
+
+class Prop : public GameObject
+{
+public:
+	virtual void Update(float dt) { }
+};
+
+
+//Same updates on a chunk
+static void MoveChunk(EntityChunk &chunk, float dt)
+{
+	Position *position = chunk.Components<Position>();
+	const Velocity *velocity = chunk.Components<Velocity>();
+	uint32_t count = chunk.Count();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		position[i].x += velocity[i].x * dt;
+		position[i].y += velocity[i].y * dt;
+		position[i].z += velocity[i].z * dt;
+	}
+}
+
+static void HealChunk(EntityChunk &chunk, float dt)
+{
+	Health *health = chunk.Components<Health>();
+	uint32_t count = chunk.Count();
+	for (uint32_t i = 0; i < count; ++i)
+		health[i].value = fminf(health[i].value + health[i].regen * dt, 100.0f);
+}
+
+static void SpinChunk(EntityChunk &chunk, float dt)
+{
+	Spin *spin = chunk.Components<Spin>();
+	uint32_t count = chunk.Count();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		spin[i].angle += spin[i].rate * dt;
+		if (spin[i].angle > MATH_PI)
+			spin[i].angle -= 2.0f * MATH_PI;
+	}
+}
+
+
+//Both versions of the same world
+struct World
+{
+	EntityStore store;
+	vector<GameObject*> objects;
+
+	explicit World(uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			GameObject *object;
+			Position position = { RandFloat(-100.0f, 100.0f), RandFloat(-100.0f, 100.0f), RandFloat(-100.0f, 100.0f) };
+			Velocity velocity = { RandFloat(-5.0f, 5.0f), RandFloat(-5.0f, 5.0f), RandFloat(-5.0f, 5.0f) };
+
+			switch (i % 4)
+			{
+			case 0:
+			{
+				Mover *mover = new Mover();
+				mover->velocity = velocity;
+				object = mover;
+				object->entity = store.Create<Position, Velocity>();
+				store.Set(object->entity, velocity);
+				break;
+			}
+			case 1:
+			{
+				HealthMover *mover = new HealthMover();
+				Health health = { RandFloat(0.0f, 100.0f), RandFloat(0.0f, 10.0f) };
+				mover->velocity = velocity;
+				mover->health = health;
+				object = mover;
+				object->entity = store.Create<Position, Velocity, Health>();
+				store.Set(object->entity, velocity);
+				store.Set(object->entity, health);
+				break;
+			}
+			case 2:
+			{
+				Spinner *spinner = new Spinner();
+				Spin spin = { 0.0f, RandFloat(-3.0f, 3.0f) };
+				spinner->spin = spin;
+				object = spinner;
+				object->entity = store.Create<Position, Spin>();
+				store.Set(object->entity, spin);
+				break;
+			}
+			default:
+				object = new Prop();
+				object->entity = store.Create<Position>();
+				break;
+			}
+
+			object->position = position;
+			store.Set(object->entity, position);
+			objects.push_back(object);
+		}
+
+		//Objects come and go over a game, so their list ends up in no particular order
+		for (uint32_t i = count - 1; i > 0; --i)
+			swap(objects[i], objects[RandUint() % (i + 1)]);
+	}
+
+	~World()
+	{
+		for (size_t i = 0; i < objects.size(); ++i)
+			delete objects[i];
+	}
+
+	void UpdateObjects(float dt)
+	{
+		for (size_t i = 0; i < objects.size(); ++i)
+			objects[i]->Update(dt);
+	}
+
+	void UpdateStore(float dt)
+	{
+		store.ForEachChunk(QueryAll<Position, Velocity>(), [dt](EntityChunk &chunk) { MoveChunk(chunk, dt); });
+		store.ForEachChunk(QueryAll<Health>(), [dt](EntityChunk &chunk) { HealChunk(chunk, dt); });
+		store.ForEachChunk(QueryAll<Spin>(), [dt](EntityChunk &chunk) { SpinChunk(chunk, dt); });
+	}
+
+	void UpdateStore(JobSystem &jobs, float dt)
+	{
+		store.ParallelForEachChunk(jobs, QueryAll<Position, Velocity>(), [dt](EntityChunk &chunk, EntityCommandBuffer&) { MoveChunk(chunk, dt); });
+		store.ParallelForEachChunk(jobs, QueryAll<Health>(), [dt](EntityChunk &chunk, EntityCommandBuffer&) { HealChunk(chunk, dt); });
+		store.ParallelForEachChunk(jobs, QueryAll<Spin>(), [dt](EntityChunk &chunk, EntityCommandBuffer&) { SpinChunk(chunk, dt); });
+	}
+};
+
+
+//A few frames both ways, serial and jobs, with some entities moved between archetypes and back in between
+static bool Verify(JobSystem &jobs)
+{
+	World world(10000);
+
+	for (int frame = 0; frame < 10; ++frame)
+	{
+		world.UpdateObjects(FRAME_DT);
+		if (frame & 1)
+			world.UpdateStore(jobs, FRAME_DT);
+		else
+			world.UpdateStore(FRAME_DT);
+
+		//Tag every 5th entity and untag it again through the buffers, which reshuffles chunks but must not
+		//change any values
+		world.store.ParallelForEachChunk(jobs, QueryAll<Position>(), [](EntityChunk &chunk, EntityCommandBuffer &commands)
+		{
+			const Entity *entities = chunk.Entities();
+			for (uint32_t i = 0; i < chunk.Count(); ++i)
+				if (entities[i].index % 5 == 0)
+					commands.Add<Spawned>(entities[i], Spawned());
+		});
+
+		EntityCommandBuffer commands;
+		world.store.ForEachChunk(QueryAll<Spawned>(), [&commands](EntityChunk &chunk)
+		{
+			for (uint32_t i = 0; i < chunk.Count(); ++i)
+				commands.Remove<Spawned>(chunk.Entities()[i]);
+		});
+		commands.Playback(world.store);
+	}
+
+	float maxError = 0.0f;
+	uint32_t missing = 0;
+	for (size_t i = 0; i < world.objects.size(); ++i)
+	{
+		const GameObject &object = *world.objects[i];
+		const Position *position = world.store.Get<Position>(object.entity);
+		if (!position)
+		{
+			++missing;
+			continue;
+		}
+
+		maxError = fmaxf(maxError, fabsf(position->x - object.position.x));
+		maxError = fmaxf(maxError, fabsf(position->y - object.position.y));
+		maxError = fmaxf(maxError, fabsf(position->z - object.position.z));
+	}
+
+	bool bOk = missing == 0 && maxError < 1e-4f && world.store.EntityCount() == world.objects.size();
+	printf("%u entities in %u archetypes, %u chunks, max position error %.3g, %u missing%s\n\n", world.store.EntityCount(),
+		world.store.ArchetypeCount(), world.store.ChunkCount(), maxError, missing, bOk ? "" : "  FAILED");
+	return bOk;
+}
+
+
+static void UpdateCases(BenchSuite &suite, JobSystem &jobs, uint32_t count, const char *countName)
+{
+	char objectsName[128], storeName[128], jobsName[128];
+	snprintf(objectsName, sizeof(objectsName), "update/%s virtual objects", countName);
+	snprintf(storeName, sizeof(storeName), "update/%s chunks", countName);
+	snprintf(jobsName, sizeof(jobsName), "update/%s chunks jobs", countName);
+
+	if (!suite.Wants(objectsName) && !suite.Wants(storeName) && !suite.Wants(jobsName))
+		return;
+
+	World world(count);
+
+	//One op is one frame
+	suite.Run(objectsName, [&world](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			world.UpdateObjects(FRAME_DT);
+		BenchKeep(world.objects[0]->position.x);
+	}, 1);
+
+	suite.Run(storeName, [&world](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			world.UpdateStore(FRAME_DT);
+		BenchKeep(world.store.EntityCount());
+	}, 1);
+
+	suite.Run(jobsName, [&world, &jobs](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			world.UpdateStore(jobs, FRAME_DT);
+		BenchKeep(world.store.EntityCount());
+	}, 1);
+}
+
+//One op is a batch spawned and played back, then found by query and despawned
+static void SpawnCase(BenchSuite &suite, uint32_t batch, const char *name)
+{
+	if (!suite.Wants(name))
+		return;
+
+	World world(10000);
+	EntityCommandBuffer commands;
+
+	suite.Run(name, [&world, &commands, batch](uint64_t ops)
+	{
+		Position position = { 1.0f, 2.0f, 3.0f };
+		Velocity velocity = { 0.0f, 1.0f, 0.0f };
+		Spawned spawned = { 0 };
+
+		for (uint64_t n = 0; n < ops; ++n)
+		{
+			for (uint32_t i = 0; i < batch; ++i)
+			{
+				Entity entity = commands.Create(ComponentMaskOf<Position, Velocity, Spawned>());
+				commands.Set(entity, position);
+				commands.Set(entity, velocity);
+				commands.Set(entity, spawned);
+			}
+			commands.Playback(world.store);
+
+			world.store.ForEachChunk(QueryAll<Spawned>(), [&commands](EntityChunk &chunk)
+			{
+				const Entity *entities = chunk.Entities();
+				for (uint32_t i = 0; i < chunk.Count(); ++i)
+					commands.Destroy(entities[i]);
+			});
+			commands.Playback(world.store);
+		}
+		BenchKeep(world.store.EntityCount());
+	}, 1);
+}
+
+//One op is every mover given a component and then having it taken away, recorded while iterating
+static void AddRemoveCase(BenchSuite &suite, const char *name)
+{
+	if (!suite.Wants(name))
+		return;
+
+	World world(10000);
+	EntityCommandBuffer commands;
+
+	suite.Run(name, [&world, &commands](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+		{
+			world.store.ForEachChunk(QueryAll<Velocity>(), [&commands](EntityChunk &chunk)
+			{
+				const Entity *entities = chunk.Entities();
+				for (uint32_t i = 0; i < chunk.Count(); ++i)
+				{
+					Spawned spawned = { i };
+					commands.Add(entities[i], spawned);
+				}
+			});
+			commands.Playback(world.store);
+
+			world.store.ForEachChunk(QueryAll<Spawned>(), [&commands](EntityChunk &chunk)
+			{
+				const Entity *entities = chunk.Entities();
+				for (uint32_t i = 0; i < chunk.Count(); ++i)
+					commands.Remove<Spawned>(entities[i]);
+			});
+			commands.Playback(world.store);
+		}
+		BenchKeep(world.store.ChunkCount());
+	}, 1);
+}
+
+int main(int argc, char **argv)
+{
+	JobSystem jobs;
+	jobs.Start();
+
+	bool bOk = Verify(jobs);
+	if (!bOk)
+		printf("the store doesn't match the objects, timings follow anyway\n\n");
+
+	BenchSuite suite("EntityBench", argc, argv);
+
+	UpdateCases(suite, jobs, 10000, "10k");
+	UpdateCases(suite, jobs, 100000, "100k");
+
+	SpawnCase(suite, 100, "commands/spawn+despawn 100");
+	SpawnCase(suite, 1000, "commands/spawn+despawn 1000");
+	AddRemoveCase(suite, "commands/add+remove 5k movers");
+
+	int result = suite.Finish();
+	jobs.Stop();
+	return bOk ? result : 1;
+}
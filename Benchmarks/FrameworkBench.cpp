@@ -0,0 +1,390 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//The framework's hot paths under one harness (BenchHarness.h): ScopeLock acquire/release, GameTimer,
+//FrameStats, the input queue, the resize path and the main loop skeleton against the null device. Keep a
+//-json from before a change and pass it as -baseline after to see what moved. Checks first that a full
+//input queue still delivers every button down/up in order, returning 1 if not.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit FrameworkBench.cpp ../DirectXInit/DxAppBase.cpp ../DirectXInit/InitManager.cpp
+//		../DirectXInit/NullRenderDevice.cpp ../DirectXInit/RenderCommands.cpp ../DirectXInit/RenderContext.cpp ../DirectXInit/RenderStateCache.cpp
+//		../DirectXInit/RenderTargetPool.cpp ../DirectXInit/JobSystem.cpp ../DirectXInit/GameTimer.cpp ../DirectXInit/FrameStats.cpp
+//		../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp ../DirectXInit/FrameArena.cpp ../DirectXInit/StartupGraph.cpp
+//		../DirectXInit/StartupReport.cpp ../DirectXInit/InputQueue.cpp
+//		../DirectXInit/FramePacer.cpp ../DirectXInit/Profiler.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/SceneTransforms.cpp
+//		../DirectXInit/EntityStore.cpp ../DirectXInit/FrustumCull.cpp ../DirectXInit/OcclusionCull.cpp -o FrameworkBench
+//
+//	FrameworkBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "DxAppBase.h"
+#include "InitManager.h"
+#include "FrameStats.h"
+#include "GameTimer.h"
+#include "InputQueue.h"
+#include "JobSystem.h"
+#include "LockStats.h"
+#include "Locks.h"
+#include "ScopeLock.h"
+#include "StartupGraph.h"
+
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+//Something for the critical section to protect so it can't be optimized away
+static volatile uint64_t sharedCounter = 0;
+
+
+//What every frame costs the framework: no scene, just the clear and present
+class SkeletonApp : public DxAppBase
+{
+public:
+	SkeletonApp() : DxAppBase(NULL), mResizes(0)
+	{
+		SetHeadless(true);
+	}
+
+	void ProcSceneUpdate(float) { }
+
+	void ProcSceneDraw(float)
+	{
+		static const float clearColor[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+		if (!_dxMgr.LockMgr())
+			return;
+
+		if (_dxMgr.GetCurrentState() == STATE_MGR_VIEWPORT_CREATED)
+		{
+			_renderCommands.Reset();
+			_renderCommands.ClearColor(MakePassStartKey(0), clearColor);
+			_renderCommands.ClearDepthStencil(MakePassStartKey(0), 1.0f, 0);
+			_renderCommands.Submit(_dxMgr.Context());
+			_dxMgr.Present(0);
+		}
+
+		_dxMgr.UnlockMgr();
+	}
+
+	//A resize request and the frame boundary that applies it, between two sizes so every one is real
+	void ResizeOnce()
+	{
+		bool bLarge = (++mResizes & 1) != 0;
+		SimulateResize(bLarge ? 1920 : 1280, bLarge ? 1080 : 720);
+		ApplyPendingResize();
+	}
+
+private:
+	uint64_t mResizes;
+};
+
+
+template <class TLock>
+static void LockCase(BenchSuite &suite, const char *name, TLock &lock)
+{
+	suite.Run(name, [&lock](uint64_t ops)
+	{
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			ScopeLock<TLock> scope(lock);
+			sharedCounter = sharedCounter + 1;
+		}
+	});
+}
+
+static void LockCases(BenchSuite &suite)
+{
+	NullLock null;
+	SpinParkMutex spin;
+	TrackedSpinMutex tracked("bench tracked");
+	SharedSpinMutex rw;
+	ClaimableMutex claimable;
+
+	LockCase(suite, "lock/ScopeLock<NullLock>", null);
+	LockCase(suite, "lock/ScopeLock<SpinParkMutex>", spin);
+	LockCase(suite, "lock/ScopeLock<TrackedSpinMutex>", tracked);
+
+	//Same with LockStats recording, what -lockstats (or a debug build) costs
+	bool bWasEnabled = LockStatsEnabled();
+	LockStatsSetEnabled(true);
+	LockCase(suite, "lock/ScopeLock<TrackedSpinMutex> recording", tracked);
+	LockStatsSetEnabled(bWasEnabled);
+	LockCase(suite, "lock/ScopeLock<SharedSpinMutex>", rw);
+
+	suite.Run("lock/SharedScopeLock<SharedSpinMutex>", [&rw](uint64_t ops)
+	{
+		uint64_t sink = 0;
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			SharedScopeLock<SharedSpinMutex> scope(rw);
+			sink += sharedCounter;
+		}
+		BenchKeep(sink);
+	});
+
+	//The render thread's case: it holds the claim, so its own ScopeLocks pass straight through
+	LockCase(suite, "lock/ScopeLock<ClaimableMutex> unclaimed", claimable);
+	if (suite.Wants("lock/ScopeLock<ClaimableMutex> claimed") && claimable.Claim(0))
+	{
+		LockCase(suite, "lock/ScopeLock<ClaimableMutex> claimed", claimable);
+		claimable.ReleaseClaim();
+	}
+}
+
+static void TimerCases(BenchSuite &suite)
+{
+	GameTimer timer;
+	timer.Reset();
+
+	suite.Run("timer/Tick", [&timer](uint64_t ops)
+	{
+		for (uint64_t i = 0; i < ops; ++i)
+			timer.Tick();
+	});
+
+	suite.Run("timer/TotalTime", [&timer](uint64_t ops)
+	{
+		float sum = 0.0f;
+		for (uint64_t i = 0; i < ops; ++i)
+			sum += timer.TotalTime();
+		BenchKeep(sum > 0.0f);
+	});
+
+	suite.Run("timer/DeltaTime", [&timer](uint64_t ops)
+	{
+		float sum = 0.0f;
+		for (uint64_t i = 0; i < ops; ++i)
+			sum += timer.DeltaTime();
+		BenchKeep(sum > 0.0f);
+	});
+
+	suite.Run("timer/QueryCounter", [](uint64_t ops)
+	{
+		int64_t last = 0;
+		for (uint64_t i = 0; i < ops; ++i)
+			GameTimer::QueryCounter(last);
+		BenchKeep(last);
+	});
+}
+
+static void FrameStatsCases(BenchSuite &suite)
+{
+	FrameStats stats;
+	double now = 0.0;
+
+	//60 fps with a little jitter and a hitch now and then
+	suite.Run("framestats/AddFrame", [&stats, &now](uint64_t ops)
+	{
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			double frameTime = (i % 240) == 0 ? 0.05 : 0.0166 + (double)(i & 7) * 0.0001;
+			now += frameTime;
+			stats.AddFrame(now, frameTime);
+		}
+	});
+
+	//The ring is full by now, so these walk a full window
+	static const FrameStatsWindow windows[2] = { FRAMESTATS_WINDOW_1S, FRAMESTATS_WINDOW_60S };
+	static const char *names[2] = { "framestats/Query 1s", "framestats/Query 60s" };
+
+	for (int w = 0; w < 2; ++w)
+	{
+		FrameStatsWindow window = windows[w];
+		suite.Run(names[w], [&stats, window](uint64_t ops)
+		{
+			FrameStatsSummary summary;
+			for (uint64_t i = 0; i < ops; ++i)
+				stats.Query(window, summary);
+			BenchKeep(summary.frameCount);
+		}, 16);
+	}
+}
+
+//Way more clicks than the ring holds with nobody draining, then a trailing button up: every down/up has to
+//come out, in order, and the last thing out has to be that up
+static bool VerifyInputOverflow()
+{
+	InputQueue queue;
+	const uint32_t clicks = INPUTQUEUE_CAPACITY;
+
+	for (uint32_t i = 0; i < clicks; ++i)
+	{
+		queue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 0, (int)(i & 1023), 100);
+		queue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_LEFT, 1, (int)(i & 1023), 100);
+		queue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 1, (int)(i & 1023), 101);
+		queue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_LEFT, 0, (int)(i & 1023), 101);
+	}
+	//A drag coming in from outside the window, the buttons change without a down
+	queue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 0, 5, 5);
+	queue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 4, 6, 6);
+	queue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_RIGHT, 2, 0, 0);
+	queue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_RIGHT, 0, 0, 0);
+
+	vector<InputEvent> batch(INPUTQUEUE_CAPACITY);
+	uint32_t downs = 0, ups = 0, count;
+	bool bInOrder = true, bHeld = false, bDragKept = false;
+	InputEvent last = { 0 };
+	while ((count = queue.Drain(&batch[0], (uint32_t)batch.size())) != 0)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (batch[i].type == INPUT_MOUSE_MOVE && batch[i].buttons == 0 && batch[i].y == 5)
+				bDragKept = true;
+
+			if (batch[i].type == INPUT_MOUSE_DOWN)
+			{
+				bInOrder = bInOrder && !bHeld;
+				bHeld = true;
+				++downs;
+			}
+			else if (batch[i].type == INPUT_MOUSE_UP)
+			{
+				bInOrder = bInOrder && bHeld;
+				bHeld = false;
+				++ups;
+			}
+		}
+		last = batch[count - 1];
+	}
+
+	bool bOk = downs == clicks + 1 && ups == clicks + 1 && bInOrder && bDragKept && last.type == INPUT_MOUSE_UP && last.button == INPUT_BUTTON_RIGHT;
+	printf("input queue past capacity: %u downs, %u ups of %u, %s, %s, last event %s, %s\n\n", downs, ups, clicks + 1,
+		bInOrder ? "in order" : "out of order", bDragKept ? "buttons kept" : "buttons merged",
+		last.type == INPUT_MOUSE_UP ? "an up" : "not an up", bOk ? "ok" : "FAILED");
+	return bOk;
+}
+
+//A cycle has to fail Run with everything outside it still run. Then main thread and job steps taking turns,
+//so the main thread keeps submitting just as the last step job finishes: none of those runs may fail.
+static bool VerifyStartupGraph()
+{
+	JobSystem jobs;
+	jobs.Start(1);
+
+	auto ok = []() { return true; };
+
+	StartupGraph graph;
+	int a = graph.AddStep("a", ok);
+	int b = graph.AddStep("b", ok, false, { a });
+	graph.AddDependency(a, b);
+	int c = graph.AddStep("c", ok);
+	int d = graph.AddStep("d", ok, true, { c });
+	bool bCycleRun = graph.Run(jobs);
+	const vector<StartupStepTiming> &timings = graph.Timings();
+	bool bCycleOk = !bCycleRun && !timings[a].bRan && !timings[b].bRan && timings[c].bRan && timings[d].bRan;
+
+	const int runs = 500;
+	int failed = 0;
+	for (int r = 0; r < runs; ++r)
+	{
+		graph.Reset();
+		int last = STARTUP_INVALID_STEP;
+		for (int s = 0; s < 8; ++s)
+		{
+			if (last == STARTUP_INVALID_STEP)
+				last = graph.AddStep("step", ok, (s & 1) != 0);
+			else
+				last = graph.AddStep("step", ok, (s & 1) != 0, { last });
+		}
+		if (!graph.Run(jobs))
+			++failed;
+	}
+
+	jobs.Stop();
+
+	bool bOk = bCycleOk && failed == 0;
+	printf("startup graph: cycle %s, %d of %d alternating runs failed, %s\n\n", bCycleOk ? "caught" : "NOT caught", failed, runs, bOk ? "ok" : "FAILED");
+	return bOk;
+}
+
+static void InputCases(BenchSuite &suite)
+{
+	InputQueue queue;
+	vector<InputEvent> batch(INPUTQUEUE_CAPACITY);
+
+	//A frame's worth of window thread input: a drag (coalesced into one move) and a click, then the drain
+	suite.Run("input/push frame + drain", [&queue, &batch](uint64_t ops)
+	{
+		uint64_t drained = 0;
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			for (int m = 0; m < 8; ++m)
+				queue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 0, m, 100);
+			queue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_LEFT, 1, 8, 100);
+			queue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_LEFT, 0, 8, 100);
+			queue.Flush();
+			drained += queue.Drain(&batch[0], (uint32_t)batch.size());
+		}
+		BenchKeep(drained);
+	});
+}
+
+static bool AppCases(BenchSuite &suite)
+{
+	if (!suite.Wants("resize/") && !suite.Wants("loop/"))
+		return true;
+
+	SkeletonApp app;
+	if (!app.InitApp())
+	{
+		printf("InitApp failed\n");
+		return false;
+	}
+
+	suite.Run("resize/request and apply", [&app](uint64_t ops)
+	{
+		for (uint64_t i = 0; i < ops; ++i)
+			app.ResizeOnce();
+	}, 16);
+
+	bool bOk = true;
+	static const char *names[2] = { "loop/serial frame", "loop/threaded frame" };
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		app.SetThreadedLoop(mode == 1);
+		suite.Run(names[mode], [&app, &bOk](uint64_t ops)
+		{
+			app.SetFrameLimit(ops);
+			app.Run();
+			bOk = bOk && app.FramesDrawn() == ops;
+		}, 64);
+	}
+
+	if (!bOk)
+		printf("a loop run didn't draw the frames it was asked for\n");
+
+	return bOk;
+}
+
+int main(int argc, char **argv)
+{
+	if (!VerifyInputOverflow() || !VerifyStartupGraph())
+		return 1;
+
+	BenchSuite suite("FrameworkBench", argc, argv);
+
+	LockCases(suite);
+	TimerCases(suite);
+	FrameStatsCases(suite);
+	InputCases(suite);
+	bool bOk = AppCases(suite);
+
+	int result = suite.Finish();
+	return bOk ? result : 1;
+}
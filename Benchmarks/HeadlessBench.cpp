@@ -0,0 +1,258 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Whole app loop on the null device: DxAppBase::Run for a few thousand frames, serial and threaded, with
+//a job system update, a command list per frame and a resize every so often. Prints frame times and what
+//the device saw (calls, buffer memory, binds issued vs filtered), so init/resize/loop regressions show up without a GPU or window.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit HeadlessBench.cpp ../DirectXInit/DxAppBase.cpp ../DirectXInit/InitManager.cpp
+//		../DirectXInit/NullRenderDevice.cpp ../DirectXInit/RenderCommands.cpp ../DirectXInit/RenderContext.cpp ../DirectXInit/RenderStateCache.cpp
+//		../DirectXInit/RenderTargetPool.cpp ../DirectXInit/JobSystem.cpp ../DirectXInit/GameTimer.cpp ../DirectXInit/FrameStats.cpp
+//		../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp ../DirectXInit/FrameArena.cpp ../DirectXInit/StartupGraph.cpp
+//		../DirectXInit/StartupReport.cpp ../DirectXInit/InputQueue.cpp
+//		../DirectXInit/FramePacer.cpp ../DirectXInit/Profiler.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/SceneTransforms.cpp
+//		../DirectXInit/EntityStore.cpp ../DirectXInit/FrustumCull.cpp ../DirectXInit/OcclusionCull.cpp -o HeadlessBench
+//
+//	HeadlessBench [frames] [draws] [resizeEvery] [fpsLimit]
+
+#include "DxAppBase.h"
+#include "NullRenderDevice.h"
+
+#include <chrono>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+class HeadlessApp : public DxAppBase
+{
+public:
+	HeadlessApp(uint32_t drawCount, uint32_t resizeEvery)
+		: DxAppBase(NULL), mPhases(16384, 0.0f), mDrawCount(drawCount), mResizeEvery(resizeEvery), mUpdates(0), mInputEvents(0)
+	{
+		SetHeadless(true);
+	}
+
+	NullRenderDevice& Device() { return static_cast<NullRenderDevice&>(_dxMgr.Device()); }
+	uint64_t InputEventsHandled() const { return mInputEvents; }
+
+	void ProcSceneUpdate(float _dt)
+	{
+		float *phases = &mPhases[0];
+		Jobs().ParallelFor((uint32_t)mPhases.size(), 1024, [phases, _dt](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; ++i)
+				phases[i] = fmodf(phases[i] + _dt * (1.0f + (i & 7)), 6.2831853f);
+		});
+
+		//Flip between two sizes, like someone dragging the window around: a burst of in between sizes that
+		//should end up as one resize to the last
+		if (mResizeEvery > 0 && (++mUpdates % mResizeEvery) == 0)
+		{
+			bool bLarge = ((mUpdates / mResizeEvery) & 1) != 0;
+			for (int step = 1; step <= 8; ++step)
+			{
+				int width = bLarge ? 1280 + (640 * step) / 8 : 1920 - (640 * step) / 8;
+				int height = bLarge ? 720 + (360 * step) / 8 : 1080 - (360 * step) / 8;
+				SimulateResize(width, height);
+			}
+		}
+
+		//A mouse being dragged: a few moves per frame that should reach the next update as one, and a click
+		//now and then. Pushed from here, the thread that drains, so one producer and one consumer still holds.
+		InputQueue &input = InputEvents();
+		int x = (int)(mUpdates % 1000);
+		for (int i = 0; i < 4; ++i)
+			input.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, 0, x + i, 300);
+		if ((mUpdates % 16) == 0)
+		{
+			input.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_LEFT, 1, x, 300);
+			input.Push(INPUT_MOUSE_UP, INPUT_BUTTON_LEFT, 0, x, 300);
+		}
+		input.Flush();
+	}
+
+	void ProcInput(const InputEvent *, uint32_t count)
+	{
+		mInputEvents += count;
+	}
+
+	void ProcSceneDraw(float)
+	{
+		static const float clearColor[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+		if (!_dxMgr.LockMgr())
+			return;
+
+		if (_dxMgr.GetCurrentState() == STATE_MGR_VIEWPORT_CREATED)
+		{
+			_renderCommands.Reset();
+			_renderCommands.ClearColor(MakePassStartKey(0), clearColor);
+			_renderCommands.ClearDepthStencil(MakePassStartKey(0), 1.0f, 0);
+
+			//Per material constants, repeated for every draw of the material
+			for (uint32_t i = 0; i < mDrawCount; ++i)
+			{
+				float tint[4] = { (i & 63) / 64.0f, 0.5f, 0.5f, 1.0f };
+				_renderCommands.DrawIndexed(MakeOpaqueKey(1, i & 7, i & 63, (i & 1023) / 1024.0f), 1 + (i & 7), 1 + (i & 63), 1 + i, 36, 0, 0,
+					tint, sizeof(tint));
+			}
+
+			_renderCommands.Submit(_dxMgr.Context());
+			_dxMgr.Present(0);
+		}
+
+		_dxMgr.UnlockMgr();
+	}
+
+private:
+	vector<float> mPhases;
+	uint32_t mDrawCount;
+	uint32_t mResizeEvery;
+	uint64_t mUpdates;
+	uint64_t mInputEvents;
+};
+
+//Counters that keep counting across runs, as deltas for one run
+struct RunCounters
+{
+	uint64_t resizesRequested;
+	uint64_t resizesPerformed;
+	uint64_t inputPushed;
+	uint64_t inputCoalesced;
+	uint64_t inputOverflowed;
+	uint64_t inputHandled;
+};
+
+static RunCounters ReadCounters(HeadlessApp &app)
+{
+	RunCounters c = { app.ResizesRequested(), app.ResizesPerformed(), app.InputEvents().Pushed(), app.InputEvents().Coalesced(),
+		app.InputEvents().Overflowed(), app.InputEventsHandled() };
+	return c;
+}
+
+static void Report(const char *name, HeadlessApp &app, double seconds, const RunCounters &before)
+{
+	RunCounters after = ReadCounters(app);
+	const NullDeviceStats &dev = app.Device().Stats();
+	RecordingRenderContext &rec = app.Device().Recorder();
+
+	printf("%s: %llu frames in %.3f s, %.0f fps\n", name, (unsigned long long)app.FramesDrawn(), seconds, app.FramesDrawn() / seconds);
+
+	FrameStatsSummary summary;
+	if (app.GetFrameStats().Query(FRAMESTATS_WINDOW_60S, summary))
+		printf("  frame ms (last %u)   avg %.4f  p50 %.4f  p99 %.4f  max %.4f  hitches %u\n",
+			summary.frameCount, summary.avgMs, summary.p50Ms, summary.p99Ms, summary.maxMs, summary.hitchCount);
+
+	const FramePacer &pacer = app.Pacing();
+	if (pacer.IsCapped())
+		printf("  pacing (%.1f ms)      error avg %.4f  jitter %.4f  max %.4f ms  late %llu  resyncs %llu  slept %.0f%%  slack %.3f ms\n",
+			pacer.FrameBudget() * 1000.0, pacer.MeanAbsErrorMs(), pacer.ErrorStdDevMs(), pacer.Stats().maxAbsErrorMs,
+			(unsigned long long)pacer.Stats().lateFrames, (unsigned long long)pacer.Stats().resyncs,
+			100.0 * pacer.Stats().sleptMs / (pacer.Stats().sleptMs + pacer.Stats().spunMs + 1e-9), pacer.SleepSlack() * 1000.0);
+
+	printf("  resizes              requested %llu  performed %llu\n", (unsigned long long)(after.resizesRequested - before.resizesRequested),
+		(unsigned long long)(after.resizesPerformed - before.resizesPerformed));
+	printf("  input events         pushed %llu  coalesced %llu  overflowed %llu  handled %llu\n", (unsigned long long)(after.inputPushed - before.inputPushed),
+		(unsigned long long)(after.inputCoalesced - before.inputCoalesced), (unsigned long long)(after.inputOverflowed - before.inputOverflowed),
+		(unsigned long long)(after.inputHandled - before.inputHandled));
+	if (app.GetInputLatencyStats().Query(FRAMESTATS_WINDOW_60S, summary))
+		printf("  input to present ms  avg %.4f  p50 %.4f  p99 %.4f  max %.4f\n", summary.avgMs, summary.p50Ms, summary.p99Ms, summary.maxMs);
+	printf("  device calls         present %llu  resize %llu  failed %llu\n",
+		(unsigned long long)dev.calls[NULLDEV_PRESENT], (unsigned long long)dev.calls[NULLDEV_RESIZE_SWAP_CHAIN], (unsigned long long)dev.failedCalls);
+	printf("  buffer memory        live %.1f MB  peak %.1f MB  allocated %.1f MB in %llu buffers\n",
+		dev.bytesLive / 1048576.0, dev.bytesPeak / 1048576.0, dev.bytesAllocated / 1048576.0, (unsigned long long)dev.allocations);
+
+	const RenderTargetPoolStats &pool = app.Device().TargetPool().Stats();
+	printf("  depth pool           held %.1f MB  in use %.1f MB  used %.1f MB  reused %llu/%llu  shrinks %llu\n",
+		pool.bytesHeld / 1048576.0, pool.bytesInUse / 1048576.0, pool.bytesUsed / 1048576.0,
+		(unsigned long long)pool.reuses, (unsigned long long)pool.acquires, (unsigned long long)pool.shrinks);
+	printf("  context              draws %llu  state binds %llu  constant bytes %llu\n",
+		(unsigned long long)rec.CountOf(RENDER_CALL_DRAW_INDEXED), (unsigned long long)rec.CountOf(RENDER_CALL_SET_PIPELINE_STATE),
+		(unsigned long long)rec.ConstantBytes());
+
+	const RenderStateCache &cache = app.Device().StateCache();
+	printf("  binds per frame      issued %llu  filtered %llu (last frame)\n",
+		(unsigned long long)StateFilterIssued(cache.LastFrame()), (unsigned long long)StateFilterFiltered(cache.LastFrame()));
+	for (int c = 0; c < STATECALL_COUNT; ++c)
+	{
+		const StateFilterStats &total = cache.Total();
+		if (total.issued[c] + total.filtered[c] > 0)
+			printf("    %-20s issued %10llu  filtered %10llu\n", StateCallName((StateCall)c),
+				(unsigned long long)total.issued[c], (unsigned long long)total.filtered[c]);
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t frames = (argc > 1) ? (uint64_t)atoll(argv[1]) : 5000;
+	uint32_t draws = (argc > 2) ? (uint32_t)atoi(argv[2]) : 2000;
+	uint32_t resizeEvery = (argc > 3) ? (uint32_t)atoi(argv[3]) : 500;
+	double fpsLimit = (argc > 4) ? atof(argv[4]) : 0.0;
+
+	HeadlessApp app(draws, resizeEvery);
+
+	auto i0 = chrono::steady_clock::now();
+	if (!app.InitApp())
+	{
+		printf("InitApp failed\n");
+		return 1;
+	}
+	auto i1 = chrono::steady_clock::now();
+
+	printf("init %.1f us, %llu device calls\n\n", chrono::duration<double, micro>(i1 - i0).count(),
+		(unsigned long long)(app.Device().Stats().calls[NULLDEV_CREATE_DEVICE] + app.Device().Stats().calls[NULLDEV_CREATE_SWAP_CHAIN] +
+		app.Device().Stats().calls[NULLDEV_CREATE_BACK_BUFFER_VIEW] + app.Device().Stats().calls[NULLDEV_CREATE_DEPTH_STENCIL] +
+		app.Device().Stats().calls[NULLDEV_BIND_VIEWS] + app.Device().Stats().calls[NULLDEV_SET_VIEWPORT] + app.Device().Stats().calls[NULLDEV_CHECK_MULTISAMPLE]));
+
+	app.SetFrameLimit(frames);
+	app.SetFrameRateLimit(fpsLimit);
+
+	const char *names[2] = { "serial", "threaded" };
+	bool bFailed = false;
+
+	//For the lock report after each run, release builds don't record by default
+	LockStatsSetEnabled(true);
+
+	for (int mode = 0; mode < 2; ++mode)
+	{
+		app.Device().ResetStats();
+		app.SetThreadedLoop(mode == 1);
+
+		RunCounters before = ReadCounters(app);
+		LockStatsResetAll();
+
+		auto t0 = chrono::steady_clock::now();
+		app.Run();
+		auto t1 = chrono::steady_clock::now();
+
+		Report(names[mode], app, chrono::duration<double>(t1 - t0).count(), before);
+
+		//Who waited on which lock during this run
+		string locks;
+		LockStatsFormatReport(locks);
+		printf("%s\n", locks.c_str());
+
+		bFailed = bFailed || app.Device().Stats().failedCalls > 0 || app.FramesDrawn() != frames;
+	}
+
+	return bFailed ? 1 : 0;
+}
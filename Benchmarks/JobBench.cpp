@@ -0,0 +1,265 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Thread scaling of the job system on a synthetic scene update (1..N threads, the calling thread counts
+//as one), plus the cost of a dependent chain of small jobs. Checks first that a thread can have more than
+//JOB_POOL_SIZE jobs in flight (flat and chained) without any getting lost, returning 1 if not.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit JobBench.cpp ../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp
+//		../DirectXInit/Profiler.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp -o JobBench
+//
+//	JobBench [entities] [frames] [maxThreads]
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+struct Entity
+{
+	float pos[3];
+	float vel[3];
+	float angle;
+	float spin;
+};
+
+//Some integration plus a bit of trig so each entity costs roughly what a light game object update would
+static void UpdateEntities(Entity *entities, uint32_t begin, uint32_t end, float dt)
+{
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		Entity &e = entities[i];
+
+		e.angle += e.spin * dt;
+		float s = sinf(e.angle);
+		float c = cosf(e.angle);
+
+		e.vel[0] += (c * 0.5f - e.pos[0] * 0.01f) * dt;
+		e.vel[1] += (-9.8f * 0.01f) * dt;
+		e.vel[2] += (s * 0.5f - e.pos[2] * 0.01f) * dt;
+
+		for (int k = 0; k < 3; ++k)
+			e.pos[k] += e.vel[k] * dt;
+
+		if (e.pos[1] < 0.0f)
+		{
+			e.pos[1] = -e.pos[1];
+			e.vel[1] = -e.vel[1] * 0.8f;
+		}
+	}
+}
+
+static void ResetEntities(vector<Entity> &entities)
+{
+	for (size_t i = 0; i < entities.size(); ++i)
+	{
+		Entity &e = entities[i];
+		e.pos[0] = (float)(i % 1000);
+		e.pos[1] = (float)(i % 37);
+		e.pos[2] = (float)(i / 1000);
+		e.vel[0] = e.vel[1] = e.vel[2] = 0.0f;
+		e.angle = (float)i * 0.001f;
+		e.spin = 1.0f + (float)(i & 15) * 0.1f;
+	}
+}
+
+static double Checksum(const vector<Entity> &entities)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < entities.size(); ++i)
+		sum += entities[i].pos[0] + entities[i].pos[1] + entities[i].pos[2];
+	return sum;
+}
+
+//Average ms per frame with threadCount threads in total
+static double UpdateMs(vector<Entity> &entities, int frames, int threadCount, uint32_t grain)
+{
+	JobSystem jobs;
+	jobs.Start(threadCount - 1);
+
+	Entity *data = &entities[0];
+	uint32_t count = (uint32_t)entities.size();
+
+	auto start = chrono::steady_clock::now();
+
+	for (int f = 0; f < frames; ++f)
+	{
+		jobs.ParallelFor(count, grain, [data](uint32_t begin, uint32_t end)
+		{
+			UpdateEntities(data, begin, end, 1.0f / 60.0f);
+		});
+	}
+
+	auto end = chrono::steady_clock::now();
+	jobs.Stop();
+
+	return chrono::duration<double, milli>(end - start).count() / frames;
+}
+
+static void ChainLink(void *data, uint32_t, uint32_t)
+{
+	static_cast<atomic<uint32_t>*>(data)->fetch_add(1, memory_order_relaxed);
+}
+
+//ns per link of a chain where every job only starts once the previous one finished, all links queued up front
+static double ChainNs(int threadCount, int links)
+{
+	JobSystem jobs;
+	jobs.Start(threadCount - 1);
+
+	atomic<uint32_t> done(0);
+	vector<JobCounter> counters(links);
+
+	auto start = chrono::steady_clock::now();
+
+	jobs.Submit(&ChainLink, &done, 0, 1, 0, &counters[0]);
+	for (int i = 1; i < links; ++i)
+		jobs.RunAfter(counters[i - 1], &ChainLink, &done, 0, 1, 0, &counters[i]);
+
+	jobs.Wait(counters[links - 1]);
+
+	auto end = chrono::steady_clock::now();
+	jobs.Stop();
+
+	if (done.load() != (uint32_t)links)
+		printf("  chain ran %u of %d links!\n", done.load(), links);
+
+	return chrono::duration<double, nano>(end - start).count() / links;
+}
+
+//Three pools' worth of jobs from one thread before anything gets waited on: single jobs on one counter, then
+//a chain (every link parked on the previous one's counter, so the pool fills with jobs that can't run yet)
+static bool VerifyPoolOverflow()
+{
+	const uint32_t jobCount = JOB_POOL_SIZE * 3;
+
+	JobSystem jobs;
+	jobs.Start(1);
+
+	atomic<uint32_t> done(0);
+	JobCounter counter;
+	for (uint32_t i = 0; i < jobCount; ++i)
+		jobs.Submit(&ChainLink, &done, 0, 1, 0, &counter);
+	jobs.Wait(counter);
+	uint32_t flat = done.exchange(0);
+
+	vector<JobCounter> counters(jobCount);
+	jobs.Submit(&ChainLink, &done, 0, 1, 0, &counters[0]);
+	for (uint32_t i = 1; i < jobCount; ++i)
+		jobs.RunAfter(counters[i - 1], &ChainLink, &done, 0, 1, 0, &counters[i]);
+	jobs.Wait(counters[jobCount - 1]);
+	uint32_t chained = done.load();
+
+	jobs.Stop();
+
+	bool bOk = flat == jobCount && chained == jobCount;
+	printf("%u jobs in flight on one thread: %u flat and %u chained ran, %s\n\n", jobCount, flat, chained, bOk ? "ok" : "FAILED");
+	return bOk;
+}
+
+//The owner adding a job to a counter just as its last job finishes, which StartupGraph does every run. Wait
+//has to cover the new job too, and the counter has to come back open for the next round.
+static bool VerifyResubmit()
+{
+	const uint32_t rounds = 20000;
+
+	JobSystem jobs;
+	jobs.Start(2);
+
+	atomic<uint32_t> done(0);
+	JobCounter counter;
+	uint32_t expected = 0;
+	for (uint32_t i = 0; i < rounds; ++i)
+	{
+		jobs.Submit(&ChainLink, &done, 0, 1, 0, &counter);
+		for (uint32_t spin = 0; spin < (i & 63); ++spin)
+			LockCpuRelax();
+		jobs.Submit(&ChainLink, &done, 0, 1, 0, &counter);
+		expected += 2;
+
+		jobs.Wait(counter);
+		if (done.load() != expected)
+			break;
+	}
+
+	jobs.Stop();
+
+	bool bOk = done.load() == expected;
+	printf("%u rounds of submitting onto a finishing counter: %u of %u jobs done at the waits, %s\n", rounds, done.load(), expected, bOk ? "ok" : "FAILED");
+	return bOk;
+}
+
+int main(int argc, char **argv)
+{
+	if (!VerifyPoolOverflow() || !VerifyResubmit())
+		return 1;
+
+	int entityCount = (argc > 1) ? atoi(argv[1]) : 1000000;
+	int frames = (argc > 2) ? atoi(argv[2]) : 60;
+	int maxThreads = (argc > 3) ? atoi(argv[3]) : (int)thread::hardware_concurrency();
+	if (maxThreads < 1)
+		maxThreads = 1;
+
+	vector<Entity> entities(entityCount);
+
+	//Serial baseline, no job system at all
+	ResetEntities(entities);
+	auto start = chrono::steady_clock::now();
+	for (int f = 0; f < frames; ++f)
+		UpdateEntities(&entities[0], 0, (uint32_t)entities.size(), 1.0f / 60.0f);
+	auto end = chrono::steady_clock::now();
+	double serialMs = chrono::duration<double, milli>(end - start).count() / frames;
+	double serialSum = Checksum(entities);
+
+	printf("%d entities, %d frames, %u hardware threads\n", entityCount, frames, thread::hardware_concurrency());
+	printf("  %-10s %10.3f ms/frame\n\n", "serial", serialMs);
+
+	const uint32_t grains[] = { 256, 4096 };
+
+	for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); ++g)
+	{
+		printf("ParallelFor, grain %u\n", grains[g]);
+		printf("  %-10s %10s %10s %10s\n", "threads", "ms/frame", "speedup", "eff");
+
+		double oneThreadMs = 0.0;
+		for (int t = 1; t <= maxThreads; ++t)
+		{
+			ResetEntities(entities);
+			double ms = UpdateMs(entities, frames, t, grains[g]);
+			if (t == 1)
+				oneThreadMs = ms;
+
+			double speedup = oneThreadMs / ms;
+			printf("  %-10d %10.3f %10.2f %9.0f%%%s\n", t, ms, speedup, 100.0 * speedup / t,
+				(Checksum(entities) != serialSum) ? "  (checksum mismatch!)" : "");
+		}
+		printf("\n");
+	}
+
+	printf("Dependent chain, 2000 links (ns/link)\n");
+	for (int t = 1; t <= maxThreads; t = (t < 2) ? t + 1 : t * 2)
+		printf("  %-10d %10.1f\n", t, ChainNs(t, 2000));
+
+	return 0;
+}
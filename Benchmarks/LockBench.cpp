@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Per-acquire cost of the ScopeLock policies vs the old kernel mutex path. Checks first that a writer timing
+//out on SharedSpinMutex doesn't leave new readers locked out, returning 1 if it does.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit LockBench.cpp ../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp
+//		../DirectXInit/LockStats.cpp ../DirectXInit/Profiler.cpp ../DirectXInit/GameTimer.cpp -o LockBench
+//
+//KernelMutex is a SysV semaphore on linux (every op is a syscall), CreateMutex/WaitForSingleObject on windows.
+//TrackedSpinMutex is SpinParkMutex plus its LockStats, the difference is what the telemetry costs per acquire
+//("rec" recording, "off" the default release build where LockStatsSetEnabled hasn't turned it on).
+
+#include "Locks.h"
+#include "ScopeLock.h"
+#include "LockStats.h"
+#include <string>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+//Something for the critical section to protect so it can't be optimized away
+static volatile uint64_t sharedCounter = 0;
+
+template <class TLock>
+static double UncontendedNs(TLock &lock, int iterations)
+{
+	auto start = chrono::steady_clock::now();
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		ScopeLock<TLock> scope(lock);
+		sharedCounter = sharedCounter + 1;
+	}
+
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count() / iterations;
+}
+
+template <class TLock>
+static double ContendedNs(TLock &lock, int threadCount, int iterationsPerThread)
+{
+	vector<thread> threads;
+	auto start = chrono::steady_clock::now();
+
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.push_back(thread([&lock, iterationsPerThread]()
+		{
+			for (int i = 0; i < iterationsPerThread; ++i)
+			{
+				ScopeLock<TLock> scope(lock);
+				sharedCounter = sharedCounter + 1;
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count() / ((double)iterationsPerThread * threadCount);
+}
+
+static double SharedReadNs(SharedSpinMutex &lock, int threadCount, int iterationsPerThread)
+{
+	vector<thread> threads;
+	auto start = chrono::steady_clock::now();
+
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.push_back(thread([&lock, iterationsPerThread]()
+		{
+			uint64_t sink = 0;
+			for (int i = 0; i < iterationsPerThread; ++i)
+			{
+				SharedScopeLock<SharedSpinMutex> scope(lock);
+				sink += sharedCounter;
+			}
+			if (sink == 1)
+				printf(" ");
+		}));
+	}
+
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	auto end = chrono::steady_clock::now();
+	return chrono::duration<double, nano>(end - start).count() / ((double)iterationsPerThread * threadCount);
+}
+
+//A writer gives up (TryLockFor) while a reader holds the lock, then the reader lets go: new readers have
+//to get in, without any other writer coming along to clear the pending flag
+static bool VerifySharedWriterTimeout()
+{
+	SharedSpinMutex lock;
+	lock.LockShared();
+
+	bool bWriterGot = true;
+	thread writer([&lock, &bWriterGot]() { bWriterGot = lock.TryLockFor(20); });
+	writer.join();
+	lock.UnlockShared();
+
+	bool bTryShared = lock.TryLockShared();
+	if (bTryShared)
+		lock.UnlockShared();
+
+	//And the blocking path, on a thread so a hang shows up as a failure instead of a stuck bench
+	atomic<bool> bReaderGot(false);
+	thread reader([&lock, &bReaderGot]()
+	{
+		lock.LockShared();
+		bReaderGot = true;
+		lock.UnlockShared();
+	});
+
+	auto deadline = chrono::steady_clock::now() + chrono::seconds(2);
+	while (!bReaderGot && chrono::steady_clock::now() < deadline)
+		this_thread::sleep_for(chrono::milliseconds(1));
+
+	bool bOk = !bWriterGot && bTryShared && bReaderGot;
+	printf("SharedSpinMutex writer timeout: writer %s, TryLockShared %s, LockShared %s, %s\n\n", bWriterGot ? "got it" : "timed out",
+		bTryShared ? "ok" : "failed", bReaderGot ? "ok" : "stuck", bOk ? "ok" : "FAILED");
+
+	//A stuck reader can't be joined, leave it to the process exit
+	if (bReaderGot)
+		reader.join();
+	else
+		reader.detach();
+	return bOk;
+}
+
+int main(int argc, char **argv)
+{
+	if (!VerifySharedWriterTimeout())
+		return 1;
+
+	int iterations = (argc > 1) ? atoi(argv[1]) : 2000000;
+	int kernelIterations = iterations / 10;
+	int threadCount = (int)thread::hardware_concurrency();
+	if (threadCount < 2)
+		threadCount = 2;
+	if (threadCount > 8)
+		threadCount = 8;
+
+	SpinParkMutex spin;
+	TrackedSpinMutex tracked("bench tracked");
+	SharedSpinMutex rw;
+	NullLock null;
+	KernelMutex kernel;
+
+	printf("Uncontended acquire+release (ns/op)\n");
+	printf("  %-16s %8.2f\n", "NullLock", UncontendedNs(null, iterations));
+	printf("  %-16s %8.2f\n", "SpinParkMutex", UncontendedNs(spin, iterations));
+	LockStatsSetEnabled(false);
+	printf("  %-16s %8.2f\n", "Tracked (off)", UncontendedNs(tracked, iterations));
+	LockStatsSetEnabled(true);
+	printf("  %-16s %8.2f\n", "Tracked (rec)", UncontendedNs(tracked, iterations));
+	printf("  %-16s %8.2f\n", "SharedSpinMutex", UncontendedNs(rw, iterations));
+
+	if (kernel.IsValid())
+		printf("  %-16s %8.2f\n", "KernelMutex", UncontendedNs(kernel, kernelIterations));
+	else
+		printf("  %-16s %8s\n", "KernelMutex", "n/a");
+
+	printf("\nContended, %d threads (ns/op, wall time / total ops)\n", threadCount);
+	printf("  %-16s %8.2f\n", "SpinParkMutex", ContendedNs(spin, threadCount, iterations / threadCount));
+	printf("  %-16s %8.2f\n", "Tracked (rec)", ContendedNs(tracked, threadCount, iterations / threadCount));
+	printf("  %-16s %8.2f\n", "SharedSpinMutex", ContendedNs(rw, threadCount, iterations / threadCount));
+
+	if (kernel.IsValid())
+		printf("  %-16s %8.2f\n", "KernelMutex", ContendedNs(kernel, threadCount, kernelIterations / threadCount));
+
+	printf("  %-16s %8.2f\n", "SharedSpin (rd)", SharedReadNs(rw, threadCount, iterations / threadCount));
+
+	std::string report;
+	LockStatsFormatReport(report);
+	printf("\n%s", report.c_str());
+
+	return 0;
+}
@@ -0,0 +1,336 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//VecMath/MathBatch against plain float reference code: point transforms one at a time (scalar, Vec4) and
+//in SoA batches, matrix multiply, quaternion rotation and normalize. Checks the answers agree first and
+//returns 1 if they don't. The CMake build also makes MathBenchScalar (DXAPP_MATH_SCALAR) and, where the
+//compiler has it, MathBenchAVX2, so the backends can be run side by side.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -I../DirectXInit MathBench.cpp -o MathBench
+//		(add -DDXAPP_MATH_SCALAR or -mavx2 -mfma for the other backends)
+//
+//	MathBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "MathBatch.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t POINT_COUNT = 4096;
+static const float TOLERANCE = 1e-4f;
+
+
+//Small LCG so every run (and every backend) sees the same data
+static uint32_t randState = 12345;
+static float RandFloat(float lo, float hi)
+{
+	randState = randState * 1664525u + 1013904223u;
+	return lo + (hi - lo) * (float)(randState >> 8) / 16777216.0f;
+}
+
+
+//Reference code, written the obvious way with no VecMath in it
+
+static void RefMultiply(const Float4x4 &a, const Float4x4 &b, Float4x4 &out)
+{
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			out.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+}
+
+static void RefTransformPoint(const Float4x4 &m, const Float3 &p, Float3 &out)
+{
+	out.x = p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0];
+	out.y = p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1];
+	out.z = p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2];
+}
+
+
+struct PointSet
+{
+	vector<Float3> aos;
+	vector<float> x, y, z;
+	vector<Float3> outAoS;
+	vector<float> outX, outY, outZ;
+
+	explicit PointSet(uint32_t count) : aos(count), x(count), y(count), z(count),
+		outAoS(count), outX(count), outY(count), outZ(count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			aos[i].x = x[i] = RandFloat(-100.0f, 100.0f);
+			aos[i].y = y[i] = RandFloat(-100.0f, 100.0f);
+			aos[i].z = z[i] = RandFloat(-100.0f, 100.0f);
+		}
+	}
+};
+
+static Mat4 TestMatrix()
+{
+	Quat rotation = QuatFromAxisAngle(Normalize3(Vec4Set(1.0f, 2.0f, 3.0f, 0.0f)), 0.7f);
+	return Mat4Compose(Vec4Set(1.5f, 0.5f, 2.0f, 0.0f), rotation, Vec4Set(10.0f, -4.0f, 3.0f, 0.0f));
+}
+
+static float MaxDiff(const Float4x4 &a, const Float4x4 &b)
+{
+	float maxDiff = 0.0f;
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			maxDiff = fmaxf(maxDiff, fabsf(a.m[r][c] - b.m[r][c]));
+	return maxDiff;
+}
+
+static float MaxDiff(const Mat4 &a, const Mat4 &b)
+{
+	Float4x4 fa, fb;
+	StoreFloat4x4(fa, a);
+	StoreFloat4x4(fb, b);
+	return MaxDiff(fa, fb);
+}
+
+static float MaxDiff(Vec4 a, Vec4 b)
+{
+	Float4 fa, fb;
+	StoreFloat4(fa, a);
+	StoreFloat4(fb, b);
+	return fmaxf(fmaxf(fabsf(fa.x - fb.x), fabsf(fa.y - fb.y)), fmaxf(fabsf(fa.z - fb.z), fabsf(fa.w - fb.w)));
+}
+
+static bool Check(const char *what, float error, float tolerance = TOLERANCE)
+{
+	bool bOk = error <= tolerance;
+	printf("  %-40s max error %.3g%s\n", what, error, bOk ? "" : "  FAILED");
+	return bOk;
+}
+
+
+//Every path has to agree with the reference before the timings mean anything
+static bool Verify()
+{
+	printf("%s backend, checking against the reference\n", MATH_BACKEND_NAME);
+
+	bool bOk = true;
+	Mat4 m = TestMatrix();
+	Float4x4 fm;
+	StoreFloat4x4(fm, m);
+
+	//Odd count so the SoA tails get checked too
+	PointSet points(POINT_COUNT + 5);
+	uint32_t count = (uint32_t)points.aos.size();
+
+	vector<Float3> ref(count);
+	for (uint32_t i = 0; i < count; ++i)
+		RefTransformPoint(fm, points.aos[i], ref[i]);
+
+	TransformPointsAoS(m, &points.aos[0], &points.outAoS[0], count);
+	TransformPointsSoA(m, &points.x[0], &points.y[0], &points.z[0], &points.outX[0], &points.outY[0], &points.outZ[0], count);
+
+	//Relative, the points go out to a few hundred
+	float aosError = 0.0f, soaError = 0.0f;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float scale = 1.0f / fmaxf(1.0f, fabsf(ref[i].x) + fabsf(ref[i].y) + fabsf(ref[i].z));
+		aosError = fmaxf(aosError, scale * (fabsf(points.outAoS[i].x - ref[i].x) + fabsf(points.outAoS[i].y - ref[i].y) + fabsf(points.outAoS[i].z - ref[i].z)));
+		soaError = fmaxf(soaError, scale * (fabsf(points.outX[i] - ref[i].x) + fabsf(points.outY[i] - ref[i].y) + fabsf(points.outZ[i] - ref[i].z)));
+	}
+	bOk &= Check("TransformPointsAoS", aosError);
+	bOk &= Check("TransformPointsSoA", soaError);
+
+	//Vectors and normalize against their own Vec4 versions
+	TransformVectorsSoA(m, &points.x[0], &points.y[0], &points.z[0], &points.outX[0], &points.outY[0], &points.outZ[0], count);
+	Normalize3SoA(&points.outX[0], &points.outY[0], &points.outZ[0], count);
+	float vecError = 0.0f;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Vec4 expected = Normalize3(TransformVector(LoadFloat3(points.aos[i]), m));
+		vecError = fmaxf(vecError, MaxDiff(expected, Vec4Set(points.outX[i], points.outY[i], points.outZ[i], 0.0f)));
+	}
+	bOk &= Check("TransformVectorsSoA + Normalize3SoA", vecError);
+
+	Float4x4 refProduct;
+	Mat4 other = Mat4LookAtLH(Vec4Set(3.0f, 4.0f, -5.0f, 1.0f), Vec4Zero(), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f));
+	Float4x4 fo;
+	StoreFloat4x4(fo, other);
+	RefMultiply(fm, fo, refProduct);
+	Float4x4 product;
+	StoreFloat4x4(product, m * other);
+	bOk &= Check("Mat4Multiply", MaxDiff(product, refProduct), 1e-3f);
+
+	bOk &= Check("Mat4Inverse * m", MaxDiff(Mat4Inverse(m) * m, Mat4Identity()));
+	bOk &= Check("Mat4InverseAffine", MaxDiff(Mat4InverseAffine(m), Mat4Inverse(m)));
+	bOk &= Check("Mat4Transpose twice", MaxDiff(Mat4Transpose(Mat4Transpose(m)), m), 0.0f);
+
+	float angle = 1.1f;
+	Quat qy = QuatFromAxisAngle(Vec4Set(0.0f, 1.0f, 0.0f, 0.0f), angle);
+	bOk &= Check("Mat4FromQuat vs Mat4RotationY", MaxDiff(Mat4FromQuat(qy), Mat4RotationY(angle)));
+
+	Quat q = QuatFromAxisAngle(Normalize3(Vec4Set(-2.0f, 1.0f, 0.5f, 0.0f)), 2.3f);
+	Vec4 v = Vec4Set(3.0f, -1.0f, 2.0f, 0.0f);
+	bOk &= Check("QuatRotate vs Mat4FromQuat", MaxDiff(QuatRotate(q, v), TransformVector(v, Mat4FromQuat(q))));
+
+	//a then b, same as the matrices
+	Quat q2 = QuatMultiply(qy, q);
+	bOk &= Check("QuatMultiply vs Mat4Multiply", MaxDiff(Mat4FromQuat(q2), Mat4FromQuat(qy) * Mat4FromQuat(q)));
+
+	bOk &= Check("QuatSlerp endpoints", fmaxf(MaxDiff(QuatSlerp(qy, q, 0.0f).q, qy.q), MaxDiff(QuatSlerp(qy, q, 1.0f).q, q.q)));
+
+	printf("\n");
+	return bOk;
+}
+
+
+static void TransformCases(BenchSuite &suite)
+{
+	PointSet *points = new PointSet(POINT_COUNT);
+	Mat4 m = TestMatrix();
+	Float4x4 fm;
+	StoreFloat4x4(fm, m);
+
+	//ops are batches of POINT_COUNT points
+	suite.Run("transform/4096 points reference", [points, &fm](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			for (uint32_t i = 0; i < POINT_COUNT; ++i)
+				RefTransformPoint(fm, points->aos[i], points->outAoS[i]);
+		BenchKeep(points->outAoS[0].x);
+	}, 4);
+
+	suite.Run("transform/4096 points Vec4", [points, &m](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			TransformPointsAoS(m, &points->aos[0], &points->outAoS[0], POINT_COUNT);
+		BenchKeep(points->outAoS[0].x);
+	}, 4);
+
+	suite.Run("transform/4096 points SoA scalar", [points, &m](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			TransformPointsScalar(m, &points->x[0], &points->y[0], &points->z[0], &points->outX[0], &points->outY[0], &points->outZ[0], POINT_COUNT);
+		BenchKeep(points->outX[0]);
+	}, 4);
+
+	suite.Run("transform/4096 points SoA", [points, &m](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			TransformPointsSoA(m, &points->x[0], &points->y[0], &points->z[0], &points->outX[0], &points->outY[0], &points->outZ[0], POINT_COUNT);
+		BenchKeep(points->outX[0]);
+	}, 4);
+
+	//In place, so every pass after the first is already unit length. Same work either way.
+	suite.Run("normalize/4096 SoA scalar", [points](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			Normalize3Scalar(&points->x[0], &points->y[0], &points->z[0], POINT_COUNT);
+		BenchKeep(points->x[0]);
+	}, 4);
+
+	suite.Run("normalize/4096 SoA", [points](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			Normalize3SoA(&points->x[0], &points->y[0], &points->z[0], POINT_COUNT);
+		BenchKeep(points->x[0]);
+	}, 4);
+
+	delete points;
+}
+
+static void MatrixCases(BenchSuite &suite)
+{
+	Mat4 a = TestMatrix();
+	Mat4 b = Mat4PerspectiveFovLH(0.25f * MATH_PI, 16.0f / 9.0f, 0.1f, 1000.0f);
+	Float4x4 fa, fb;
+	StoreFloat4x4(fa, a);
+	StoreFloat4x4(fb, b);
+
+	//Chained so each multiply depends on the last, the way a transform hierarchy does
+	suite.Run("matrix/multiply reference", [&fa, &fb](uint64_t ops)
+	{
+		Float4x4 acc = fa, next;
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			RefMultiply(acc, fb, next);
+			RefMultiply(next, fa, acc);
+		}
+		BenchKeep(acc.m[0][0]);
+	});
+
+	suite.Run("matrix/Mat4Multiply", [&a, &b](uint64_t ops)
+	{
+		Mat4 acc = a;
+		for (uint64_t i = 0; i < ops; ++i)
+			acc = (acc * b) * a;
+		BenchKeep(Vec4GetX(acc.r[0]));
+	});
+
+	suite.Run("matrix/Mat4Inverse", [&a](uint64_t ops)
+	{
+		Mat4 acc = a;
+		for (uint64_t i = 0; i < ops; ++i)
+			acc = Mat4Inverse(acc);
+		BenchKeep(Vec4GetX(acc.r[0]));
+	});
+
+	suite.Run("matrix/Mat4InverseAffine", [&a](uint64_t ops)
+	{
+		Mat4 acc = a;
+		for (uint64_t i = 0; i < ops; ++i)
+			acc = Mat4InverseAffine(acc);
+		BenchKeep(Vec4GetX(acc.r[0]));
+	});
+
+	Quat q = QuatFromAxisAngle(Normalize3(Vec4Set(1.0f, 1.0f, 0.0f, 0.0f)), 0.01f);
+	suite.Run("quat/QuatRotate", [q](uint64_t ops)
+	{
+		Vec4 v = Vec4Set(1.0f, 2.0f, 3.0f, 0.0f);
+		for (uint64_t i = 0; i < ops; ++i)
+			v = QuatRotate(q, v);
+		BenchKeep(Vec4GetX(v));
+	});
+
+	suite.Run("quat/Mat4FromQuat", [q](uint64_t ops)
+	{
+		Quat acc = q;
+		float sum = 0.0f;
+		for (uint64_t i = 0; i < ops; ++i)
+		{
+			Mat4 m = Mat4FromQuat(acc);
+			sum += Vec4GetX(m.r[0]);
+			acc = QuatMultiply(acc, q);
+		}
+		BenchKeep(sum);
+	});
+}
+
+int main(int argc, char **argv)
+{
+	bool bOk = Verify();
+	if (!bOk)
+		printf("backend disagrees with the reference, timings follow anyway\n\n");
+
+	BenchSuite suite("MathBench", argc, argv);
+
+	TransformCases(suite);
+	MatrixCases(suite);
+
+	int result = suite.Finish();
+	return bOk ? result : 1;
+}
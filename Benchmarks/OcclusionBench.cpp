@@ -0,0 +1,386 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//OcclusionCuller in a city: a grid of buildings as occluders, 100k props (boxes) scattered between and
+//inside them, a camera down at street level in a 1280x720 window. Times rasterizing the buildings serial
+//and on the job system, and a frame's culling with and without the occlusion test after the frustum
+//culler. The buildings are added nearest first, like a game handing over occluders it already sorted.
+//Checks first, returning 1 if either is off:
+//	- the rasterized depth against ray casting the building boxes through every buffer pixel center, as view
+//	  distance within 1% (a few pixels along edges may differ, more than 1 in 500 fails)
+//	- what the tests call hidden against looking at every pixel under each box in the ray cast depth
+//	  (more than 1 in 1000 wrongly hidden fails, wrongly visible only costs a draw and is just reported)
+//The CMake build also makes OcclusionBenchAVX2 where the compiler has it, for the 8 wide backend.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit OcclusionBench.cpp ../DirectXInit/OcclusionCull.cpp
+//		../DirectXInit/FrustumCull.cpp ../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/LockStats.cpp
+//		../DirectXInit/GameTimer.cpp ../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp -o OcclusionBench
+//		(add -mavx2 -mfma for the AVX2 backend)
+//
+//	OcclusionBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "OcclusionCull.h"
+#include "FrustumCull.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t CLIENT_WIDTH = 1280;
+static const uint32_t CLIENT_HEIGHT = 720;
+
+static const int   CITY_BLOCKS = 24;			//Each way
+static const float BLOCK_PITCH = 60.0f;		//Building centers apart, streets are what's left over
+static const float CITY_HALF = CITY_BLOCKS * BLOCK_PITCH * 0.5f;
+
+static const uint32_t PROP_COUNT = 100000;
+
+static const float NEAR_PLANE = 1.0f;
+static const float FAR_PLANE = 3000.0f;
+
+//Standing in a street near one edge, looking into town a little off the street's line
+static const float EYE_X = -CITY_HALF + 2.0f * BLOCK_PITCH;
+static const float EYE_Z = -CITY_HALF + 5.0f;
+
+
+static uint32_t randState = 12345;
+static uint32_t RandUint()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return randState >> 8;
+}
+
+static float RandFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)RandUint() / 16777216.0f;
+}
+
+
+//A unit cube, 12 triangles
+static const Float3 cubeVertices[8] =
+{
+	{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f },
+	{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f },
+};
+
+static const uint32_t cubeIndices[36] =
+{
+	0, 2, 1, 1, 2, 3,		//-z
+	4, 5, 6, 5, 7, 6,		//+z
+	0, 1, 4, 1, 5, 4,		//-y
+	2, 6, 3, 3, 6, 7,		//+y
+	0, 4, 2, 2, 4, 6,		//-x
+	1, 3, 5, 3, 7, 5,		//+x
+};
+
+
+struct Building
+{
+	Float3 center;
+	Float3 extents;
+	Float4x4 world;
+	float eyeDistance;		//Squared, on the ground
+
+	bool operator<(const Building &other) const { return eyeDistance < other.eyeDistance; };
+};
+
+//View distance from D3D's z/w, to compare depths at about the same relative precision near and far
+static float LinearDepth(float z)
+{
+	return NEAR_PLANE * FAR_PLANE / (FAR_PLANE - z * (FAR_PLANE - NEAR_PLANE));
+}
+
+struct CityScene
+{
+	vector<Building> buildings;
+	FrustumCuller props;
+	Mat4 viewProjection;
+	Frustum frustum;
+
+	OcclusionCuller occlusion;
+	vector<uint32_t> visible;
+
+	CityScene()
+	{
+		for (int bz = 0; bz < CITY_BLOCKS; ++bz)
+		{
+			for (int bx = 0; bx < CITY_BLOCKS; ++bx)
+			{
+				Building building;
+				building.extents.x = RandFloat(18.0f, 25.0f);
+				building.extents.y = RandFloat(10.0f, 40.0f);
+				building.extents.z = RandFloat(18.0f, 25.0f);
+				building.center.x = -CITY_HALF + ((float)bx + 0.5f) * BLOCK_PITCH;
+				building.center.y = building.extents.y;
+				building.center.z = -CITY_HALF + ((float)bz + 0.5f) * BLOCK_PITCH;
+				StoreFloat4x4(building.world, Mat4Scaling(building.extents.x, building.extents.y, building.extents.z) *
+					Mat4Translation(building.center.x, building.center.y, building.center.z));
+				float dx = building.center.x - EYE_X, dz = building.center.z - EYE_Z;
+				building.eyeDistance = dx * dx + dz * dz;
+				buildings.push_back(building);
+			}
+		}
+
+		//Occluders go in front to back, the way a game would get them out of its own culling
+		sort(buildings.begin(), buildings.end());
+
+		//Props anywhere, on the street or stuck inside a building, up to about a story off the ground
+		props.Reserve(PROP_COUNT);
+		for (uint32_t i = 0; i < PROP_COUNT; ++i)
+		{
+			Float3 extents = { RandFloat(0.3f, 2.0f), RandFloat(0.3f, 2.0f), RandFloat(0.3f, 2.0f) };
+			Float3 center = { RandFloat(-CITY_HALF, CITY_HALF), extents.y + RandFloat(0.0f, 4.0f), RandFloat(-CITY_HALF, CITY_HALF) };
+			props.AddBox(center, extents);
+		}
+
+		Mat4 view = Mat4LookAtLH(Vec4Set(EYE_X, 2.0f, EYE_Z, 1.0f),
+			Vec4Set(-CITY_HALF + 6.0f * BLOCK_PITCH, 1.0f, CITY_HALF, 1.0f), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f));
+		float aspect = (float)CLIENT_WIDTH / (float)CLIENT_HEIGHT;
+		viewProjection = view * Mat4PerspectiveFovLH(0.33f * MATH_PI, aspect, NEAR_PLANE, FAR_PLANE);
+		frustum = FrustumFromMatrix(viewProjection);
+
+		occlusion.Resize(CLIENT_WIDTH, CLIENT_HEIGHT);
+		visible.resize(PROP_COUNT);
+	}
+
+	void Rasterize(JobSystem *jobs)
+	{
+		occlusion.Begin(viewProjection);
+		for (size_t i = 0; i < buildings.size(); ++i)
+			occlusion.AddOccluder(cubeVertices, 8, cubeIndices, 36, LoadFloat4x4(buildings[i].world));
+		occlusion.Rasterize(jobs);
+	}
+
+	//What's left to draw after the frustum and (with bOcclusion) the occlusion test
+	uint32_t Cull(bool bOcclusion)
+	{
+		uint32_t count = props.Cull(frustum);
+		if (!bOcclusion)
+			return count;
+
+		return occlusion.TestList(props, props.Visible(), count, &visible[0]);
+	}
+
+	//Nearest building hit through each buffer pixel center, as z/w, 1 for nothing
+	void ReferenceDepth(vector<float> &out) const
+	{
+		uint32_t width = occlusion.Width(), height = occlusion.Height();
+		Mat4 clipToWorld = Mat4Inverse(viewProjection);
+		out.assign((size_t)width * height, 1.0f);
+
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				float ndcX = ((float)x + 0.5f) / (float)width * 2.0f - 1.0f;
+				float ndcY = 1.0f - ((float)y + 0.5f) / (float)height * 2.0f;
+
+				Float4 nearPoint, farPoint;
+				StoreFloat4(nearPoint, TransformPoint(Vec4Set(ndcX, ndcY, 0.0f, 1.0f), clipToWorld));
+				StoreFloat4(farPoint, TransformPoint(Vec4Set(ndcX, ndcY, 1.0f, 1.0f), clipToWorld));
+				double ox = nearPoint.x / nearPoint.w, oy = nearPoint.y / nearPoint.w, oz = nearPoint.z / nearPoint.w;
+				double dx = farPoint.x / farPoint.w - ox, dy = farPoint.y / farPoint.w - oy, dz = farPoint.z / farPoint.w - oz;
+
+				double best = 2.0;
+				for (size_t b = 0; b < buildings.size(); ++b)
+				{
+					const Building &building = buildings[b];
+					double lo[3] = { building.center.x - building.extents.x, building.center.y - building.extents.y, building.center.z - building.extents.z };
+					double hi[3] = { building.center.x + building.extents.x, building.center.y + building.extents.y, building.center.z + building.extents.z };
+					double o[3] = { ox, oy, oz }, d[3] = { dx, dy, dz };
+
+					double enter = 0.0, leave = 1.0;
+					for (int a = 0; a < 3 && enter <= leave; ++a)
+					{
+						if (fabs(d[a]) < 1e-12)
+						{
+							if (o[a] < lo[a] || o[a] > hi[a])
+								leave = -1.0;
+							continue;
+						}
+
+						double t1 = (lo[a] - o[a]) / d[a], t2 = (hi[a] - o[a]) / d[a];
+						enter = fmax(enter, fmin(t1, t2));
+						leave = fmin(leave, fmax(t1, t2));
+					}
+
+					if (enter <= leave && enter < best)
+						best = enter;
+				}
+
+				if (best <= 1.0)
+				{
+					Float4 clip;
+					StoreFloat4(clip, TransformPoint(Vec4Set((float)(ox + dx * best), (float)(oy + dy * best), (float)(oz + dz * best), 1.0f), viewProjection));
+					out[(size_t)y * width + x] = clip.z / clip.w;
+				}
+			}
+		}
+	}
+
+	//Any pixel under the box's screen rectangle with depth at or behind its nearest corner
+	bool ReferenceTest(const vector<float> &depth, const Float3 &center, const Float3 &extents) const
+	{
+		uint32_t width = occlusion.Width(), height = occlusion.Height();
+		float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f, minZ = 1e30f;
+		for (int c = 0; c < 8; ++c)
+		{
+			Float4 clip;
+			StoreFloat4(clip, TransformPoint(Vec4Set(center.x + cubeVertices[c].x * extents.x, center.y + cubeVertices[c].y * extents.y,
+				center.z + cubeVertices[c].z * extents.z, 1.0f), viewProjection));
+			if (clip.z < 0.0f)
+				return true;
+
+			float sx = (clip.x / clip.w + 1.0f) * 0.5f * (float)width, sy = (1.0f - clip.y / clip.w) * 0.5f * (float)height;
+			minX = fminf(minX, sx);
+			maxX = fmaxf(maxX, sx);
+			minY = fminf(minY, sy);
+			maxY = fmaxf(maxY, sy);
+			minZ = fminf(minZ, clip.z / clip.w);
+		}
+
+		for (int y = (int)fmaxf(minY, 0.0f); y <= (int)fminf(maxY, (float)(height - 1)); ++y)
+			for (int x = (int)fmaxf(minX, 0.0f); x <= (int)fminf(maxX, (float)(width - 1)); ++x)
+				if (depth[(size_t)y * width + x] >= minZ)
+					return true;
+
+		return false;
+	}
+};
+
+
+static bool Verify(CityScene &scene, JobSystem &jobs)
+{
+	bool bOk = true;
+	vector<float> reference;
+	scene.ReferenceDepth(reference);
+
+	uint32_t width = scene.occlusion.Width(), height = scene.occlusion.Height();
+	for (int withJobs = 0; withJobs < 2; ++withJobs)
+	{
+		scene.Rasterize(withJobs ? &jobs : NULL);
+
+		uint32_t covered = 0, coverage = 0, depthOff = 0;
+		float worst = 0.0f;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				float ours = scene.occlusion.Depth(x, y), theirs = reference[(size_t)y * width + x];
+				covered += theirs < 1.0f;
+				if ((ours < 1.0f) != (theirs < 1.0f))
+					++coverage;
+				else if (theirs < 1.0f)
+				{
+					float relative = fabsf(LinearDepth(ours) - LinearDepth(theirs)) / LinearDepth(theirs);
+					if (relative > 0.01f)
+						++depthOff;
+					else
+						worst = fmaxf(worst, relative);
+				}
+			}
+		}
+
+		bool bPass = (coverage + depthOff) * 500 <= width * height;
+		printf("%ux%u depth%s: %u triangles, %u of %u pixels covered, %u coverage and %u depth off (worst within %.2g%%), %s\n", width, height,
+			withJobs ? " jobs" : "", scene.occlusion.TriangleCount(), covered, width * height, coverage, depthOff, worst * 100.0f, bPass ? "ok" : "FAILED");
+		bOk = bOk && bPass;
+	}
+
+	uint32_t inFrustum = scene.props.Cull(scene.frustum);
+	const uint32_t *indices = scene.props.Visible();
+	const float *cx = scene.props.BoundsData(CULL_CENTER_X), *cy = scene.props.BoundsData(CULL_CENTER_Y), *cz = scene.props.BoundsData(CULL_CENTER_Z);
+	const float *ex = scene.props.BoundsData(CULL_EXTENT_X), *ey = scene.props.BoundsData(CULL_EXTENT_Y), *ez = scene.props.BoundsData(CULL_EXTENT_Z);
+
+	uint32_t hidden = 0, wrongHidden = 0, wrongVisible = 0;
+	for (uint32_t i = 0; i < inFrustum; ++i)
+	{
+		uint32_t index = indices[i];
+		Float3 center = { cx[index], cy[index], cz[index] };
+		Float3 extents = { ex[index], ey[index], ez[index] };
+		bool bVisible = scene.occlusion.TestBox(center, extents);
+		bool bReference = scene.ReferenceTest(reference, center, extents);
+		hidden += !bVisible;
+		wrongHidden += bReference && !bVisible;
+		wrongVisible += !bReference && bVisible;
+	}
+
+	bool bPass = wrongHidden * 1000 <= inFrustum;
+	printf("%u props in the frustum, %u hidden, %u wrongly hidden, %u wrongly visible, %s\n", inFrustum, hidden, wrongHidden, wrongVisible,
+		bPass ? "ok" : "FAILED");
+	return bOk && bPass;
+}
+
+
+int main(int argc, char **argv)
+{
+	JobSystem jobs;
+	jobs.Start();
+
+	CityScene scene;
+
+	bool bOk = Verify(scene, jobs);
+	printf("\n");
+	if (!bOk)
+		printf("the occlusion buffer doesn't match the reference, timings follow anyway\n\n");
+
+	BenchSuite suite("OcclusionBench", argc, argv);
+
+	//One op is the whole buffer: Begin, every building, Rasterize
+	char name[128];
+	snprintf(name, sizeof(name), "occlusion/rasterize %u buildings", (uint32_t)scene.buildings.size());
+	suite.Run(name, [&scene](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.Rasterize(NULL);
+		BenchKeep(scene.occlusion.TriangleCount());
+	}, 1);
+
+	snprintf(name, sizeof(name), "occlusion/rasterize %u buildings jobs", (uint32_t)scene.buildings.size());
+	suite.Run(name, [&scene, &jobs](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			scene.Rasterize(&jobs);
+		BenchKeep(scene.occlusion.TriangleCount());
+	}, 1);
+
+	//One op is culling all the props for a frame, the buffer already rasterized
+	scene.Rasterize(&jobs);
+	suite.Run("occlusion/100k props frustum", [&scene](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			BenchKeep(scene.Cull(false));
+	}, 1);
+
+	suite.Run("occlusion/100k props frustum + occlusion", [&scene](uint64_t ops)
+	{
+		for (uint64_t n = 0; n < ops; ++n)
+			BenchKeep(scene.Cull(true));
+	}, 1);
+
+	printf("\n%u props left after the frustum, %u after occlusion\n", scene.Cull(false), scene.Cull(true));
+
+	int result = suite.Finish();
+	jobs.Stop();
+	return bOk ? result : 1;
+}
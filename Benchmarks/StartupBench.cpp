@@ -0,0 +1,267 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//Launch time, construction to first frame, on the null device. Cold runs start this exe again with -child
+//(new process, nothing loaded or warmed up), warm runs construct a fresh app in this process each time.
+//Prints min/median/p90/max of the total and of each startup stage, so an init regression shows up as a
+//stage moving rather than just a bigger number.
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit StartupBench.cpp ../DirectXInit/DxAppBase.cpp ../DirectXInit/InitManager.cpp
+//		../DirectXInit/NullRenderDevice.cpp ../DirectXInit/RenderCommands.cpp ../DirectXInit/RenderContext.cpp ../DirectXInit/RenderStateCache.cpp
+//		../DirectXInit/RenderTargetPool.cpp ../DirectXInit/JobSystem.cpp ../DirectXInit/GameTimer.cpp ../DirectXInit/FrameStats.cpp
+//		../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp ../DirectXInit/FrameArena.cpp ../DirectXInit/StartupGraph.cpp
+//		../DirectXInit/StartupReport.cpp ../DirectXInit/InputQueue.cpp
+//		../DirectXInit/FramePacer.cpp ../DirectXInit/Profiler.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/SceneTransforms.cpp
+//		../DirectXInit/EntityStore.cpp ../DirectXInit/FrustumCull.cpp ../DirectXInit/OcclusionCull.cpp -o StartupBench
+//
+//	StartupBench [coldRuns] [warmRuns] [-json path]
+
+#include "DxAppBase.h"
+#include "InitManager.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+
+class StartupApp : public DxAppBase
+{
+public:
+	StartupApp() : DxAppBase(NULL)
+	{
+		SetHeadless(true);
+		SetFrameLimit(1);
+	}
+
+	void ProcSceneUpdate(float _dt) { }
+	//Just the clear and present, what a first frame costs is the framework's part of it
+	void ProcSceneDraw(float)
+	{
+		static const float clearColor[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+		if (!_dxMgr.LockMgr())
+			return;
+
+		if (_dxMgr.GetCurrentState() == STATE_MGR_VIEWPORT_CREATED)
+		{
+			_dxMgr.Context().ClearColor(clearColor);
+			_dxMgr.Present(0);
+		}
+
+		_dxMgr.UnlockMgr();
+	}
+};
+
+//One launch: the total and every stage's duration by "category/name"
+struct StartupSample
+{
+	double firstFrameMs;
+	map<string, double> stageMs;
+};
+
+static bool LaunchOnce(StartupSample &sample)
+{
+	StartupApp app;
+	if (!app.InitApp())
+		return false;
+	app.Run();
+
+	const StartupReport &report = app.StartupTimes();
+	if (!report.IsFinished())
+		return false;
+
+	sample.firstFrameMs = report.FirstFrameMs();
+	sample.stageMs.clear();
+	for (size_t i = 0; i < report.Stages().size(); ++i)
+	{
+		const StartupStage &stage = report.Stages()[i];
+		sample.stageMs[stage.category + "/" + stage.name] += stage.endMs - stage.startMs;
+	}
+	return true;
+}
+
+//Child side of a cold run: one launch, printed as lines the parent reads back
+static int RunChild()
+{
+	StartupSample sample;
+	if (!LaunchOnce(sample))
+		return 1;
+
+	printf("first\t%.6f\n", sample.firstFrameMs);
+	for (map<string, double>::const_iterator it = sample.stageMs.begin(); it != sample.stageMs.end(); ++it)
+		printf("stage\t%.6f\t%s\n", it->second, it->first.c_str());
+	return 0;
+}
+
+static bool LaunchCold(const char *exe, StartupSample &sample)
+{
+	string command = string("\"") + exe + "\" -child";
+	FILE *pipe = popen(command.c_str(), "r");
+	if (!pipe)
+		return false;
+
+	sample.firstFrameMs = -1.0;
+	sample.stageMs.clear();
+
+	char line[512];
+	while (fgets(line, sizeof(line), pipe))
+	{
+		line[strcspn(line, "\r\n")] = 0;
+
+		double ms = 0.0;
+		char name[512];
+		if (sscanf(line, "first\t%lf", &ms) == 1)
+			sample.firstFrameMs = ms;
+		else if (sscanf(line, "stage\t%lf\t%511[^\n]", &ms, name) == 2)
+			sample.stageMs[name] = ms;
+	}
+
+	return pclose(pipe) == 0 && sample.firstFrameMs >= 0.0;
+}
+
+
+struct Distribution
+{
+	double minMs, medianMs, p90Ms, maxMs;
+};
+
+static Distribution Summarize(vector<double> values)
+{
+	Distribution d = { 0.0, 0.0, 0.0, 0.0 };
+	if (values.empty())
+		return d;
+
+	sort(values.begin(), values.end());
+	d.minMs = values.front();
+	d.medianMs = values[values.size() / 2];
+	d.p90Ms = values[(values.size() * 9) / 10 < values.size() ? (values.size() * 9) / 10 : values.size() - 1];
+	d.maxMs = values.back();
+	return d;
+}
+
+struct RunSet
+{
+	const char *name;
+	vector<StartupSample> samples;
+	int failures;
+};
+
+static void Report(const RunSet &runs, string &json)
+{
+	vector<double> totals;
+	map<string, vector<double> > stages;
+	for (size_t i = 0; i < runs.samples.size(); ++i)
+	{
+		totals.push_back(runs.samples[i].firstFrameMs);
+		for (map<string, double>::const_iterator it = runs.samples[i].stageMs.begin(); it != runs.samples[i].stageMs.end(); ++it)
+			stages[it->first].push_back(it->second);
+	}
+
+	Distribution total = Summarize(totals);
+	printf("%s: %u runs%s\n", runs.name, (unsigned)runs.samples.size(), runs.failures ? " (some failed to launch)" : "");
+	printf("  %-40s %9s %9s %9s %9s\n", "(ms)", "min", "median", "p90", "max");
+	printf("  %-40s %9.3f %9.3f %9.3f %9.3f\n", "first frame", total.minMs, total.medianMs, total.p90Ms, total.maxMs);
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer), "\"%s\":{\"runs\":%u,\"failures\":%d,\"firstFrame\":{\"min\":%.6f,\"median\":%.6f,\"p90\":%.6f,\"max\":%.6f},\"stages\":{",
+		runs.name, (unsigned)runs.samples.size(), runs.failures, total.minMs, total.medianMs, total.p90Ms, total.maxMs);
+	json += buffer;
+
+	bool bFirst = true;
+	for (map<string, vector<double> >::const_iterator it = stages.begin(); it != stages.end(); ++it)
+	{
+		Distribution d = Summarize(it->second);
+		printf("  %-40s %9.3f %9.3f %9.3f %9.3f\n", it->first.c_str(), d.minMs, d.medianMs, d.p90Ms, d.maxMs);
+
+		//Stage names are ours, no quotes or backslashes to escape
+		snprintf(buffer, sizeof(buffer), "%s\"%s\":{\"min\":%.6f,\"median\":%.6f,\"p90\":%.6f,\"max\":%.6f}",
+			bFirst ? "" : ",", it->first.c_str(), d.minMs, d.medianMs, d.p90Ms, d.maxMs);
+		json += buffer;
+		bFirst = false;
+	}
+
+	json += "}}";
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && strcmp(argv[1], "-child") == 0)
+		return RunChild();
+
+	int coldRuns = 20, warmRuns = 50;
+	const char *jsonPath = NULL;
+
+	int positional = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (positional++ == 0)
+			coldRuns = atoi(argv[i]);
+		else
+			warmRuns = atoi(argv[i]);
+	}
+
+	RunSet cold = { "cold", vector<StartupSample>(), 0 };
+	for (int i = 0; i < coldRuns; ++i)
+	{
+		StartupSample sample;
+		if (LaunchCold(argv[0], sample))
+			cold.samples.push_back(sample);
+		else
+			++cold.failures;
+	}
+
+	RunSet warm = { "warm", vector<StartupSample>(), 0 };
+	for (int i = 0; i < warmRuns; ++i)
+	{
+		StartupSample sample;
+		if (LaunchOnce(sample))
+			warm.samples.push_back(sample);
+		else
+			++warm.failures;
+	}
+
+	string json = "{";
+	Report(cold, json);
+	json += ",";
+	Report(warm, json);
+	json += "}\n";
+
+	if (jsonPath)
+	{
+		FILE *file = fopen(jsonPath, "w");
+		if (file)
+		{
+			fputs(json.c_str(), file);
+			fclose(file);
+		}
+	}
+
+	return (cold.failures == 0 && warm.failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//N reader threads hammer GameTimer::TotalTime()/Snapshot() while the "main loop" ticks.
+//Reports reader throughput and how long Tick() takes under that load, next to a locked timer that
+//behaves like the old one (every Tick/TotalTime takes the same mutex).
+//
+//Linux:
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit TimerBench.cpp ../DirectXInit/GameTimer.cpp ../DirectXInit/Locks.cpp ../DirectXInit/ScopeLock.cpp
+//		../DirectXInit/Profiler.cpp -o TimerBench
+
+#include "GameTimer.h"
+#include "Locks.h"
+#include "ScopeLock.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+
+//Same shape as the old timer, one lock around everything
+class LockedTimer
+{
+public:
+	LockedTimer() : mBase(0), mCurr(0), mPrev(0), mDelta(0.0) { }
+
+	void Reset()
+	{
+		ScopeLock<SpinParkMutex> lock(timerLock);
+		int64_t now;
+		GameTimer::QueryCounter(now);
+		mBase = mCurr = mPrev = now;
+	}
+
+	void Tick()
+	{
+		ScopeLock<SpinParkMutex> lock(timerLock);
+		int64_t now;
+		GameTimer::QueryCounter(now);
+		mCurr = now;
+		mDelta = (mCurr - mPrev) * 1e-9;
+		mPrev = mCurr;
+	}
+
+	float TotalTime() const
+	{
+		ScopeLock<SpinParkMutex> lock(timerLock);
+		return (float)((mCurr - mBase) * 1e-9);
+	}
+
+private:
+	int64_t mBase, mCurr, mPrev;
+	double mDelta;
+	mutable SpinParkMutex timerLock;
+};
+
+
+struct RunResult
+{
+	double readsPerSecPerThread;
+	double tickAvgNs;
+	double tickMaxNs;
+};
+
+template <class TTimer, class TRead>
+static RunResult RunContention(TTimer &timer, TRead readFn, int readerCount, int tickCount)
+{
+	atomic<bool> stop(false);
+	atomic<uint64_t> totalReads(0);
+	vector<thread> readers;
+
+	timer.Reset();
+
+	for (int r = 0; r < readerCount; ++r)
+	{
+		readers.push_back(thread([&]()
+		{
+			uint64_t reads = 0;
+			float sink = 0.0f;
+			while (!stop.load(memory_order_relaxed))
+			{
+				sink += readFn(timer);
+				++reads;
+			}
+			totalReads += reads;
+			if (sink < 0.0f)
+				printf(" ");
+		}));
+	}
+
+	//Let the readers get going before we start timing ticks
+	this_thread::sleep_for(chrono::milliseconds(20));
+
+	double tickTotal = 0.0, tickMax = 0.0;
+	auto start = chrono::steady_clock::now();
+
+	for (int i = 0; i < tickCount; ++i)
+	{
+		auto t0 = chrono::steady_clock::now();
+		timer.Tick();
+		auto t1 = chrono::steady_clock::now();
+
+		double ns = chrono::duration<double, nano>(t1 - t0).count();
+		tickTotal += ns;
+		tickMax = max(tickMax, ns);
+
+		//Pretend to do a bit of frame work between ticks
+		for (volatile int spin = 0; spin < 2000; ++spin)
+			;
+	}
+
+	auto end = chrono::steady_clock::now();
+	stop = true;
+
+	for (size_t r = 0; r < readers.size(); ++r)
+		readers[r].join();
+
+	double seconds = chrono::duration<double>(end - start).count();
+
+	RunResult res;
+	res.readsPerSecPerThread = (readerCount > 0) ? (double)totalReads.load() / seconds / readerCount : 0.0;
+	res.tickAvgNs = tickTotal / tickCount;
+	res.tickMaxNs = tickMax;
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	int tickCount = (argc > 1) ? atoi(argv[1]) : 200000;
+	int maxReaders = (int)thread::hardware_concurrency() - 1;
+	if (maxReaders < 1)
+		maxReaders = 1;
+
+	printf("%-22s %8s %16s %12s %12s\n", "timer", "readers", "reads/s/thread", "tick avg ns", "tick max ns");
+
+	for (int readers = 1; readers <= maxReaders; readers *= 2)
+	{
+		GameTimer seqTimer;
+		RunResult a = RunContention(seqTimer, [](const GameTimer &t) { return t.TotalTime(); }, readers, tickCount);
+		printf("%-22s %8d %16.0f %12.1f %12.1f\n", "GameTimer TotalTime", readers, a.readsPerSecPerThread, a.tickAvgNs, a.tickMaxNs);
+
+		GameTimer snapTimer;
+		RunResult b = RunContention(snapTimer, [](const GameTimer &t) { return (float)t.Snapshot().totalTime; }, readers, tickCount);
+		printf("%-22s %8d %16.0f %12.1f %12.1f\n", "GameTimer Snapshot", readers, b.readsPerSecPerThread, b.tickAvgNs, b.tickMaxNs);
+
+		LockedTimer lockedTimer;
+		RunResult c = RunContention(lockedTimer, [](const LockedTimer &t) { return t.TotalTime(); }, readers, tickCount);
+		printf("%-22s %8d %16.0f %12.1f %12.1f\n", "locked (old design)", readers, c.readsPerSecPerThread, c.tickAvgNs, c.tickMaxNs);
+	}
+
+	return 0;
+}
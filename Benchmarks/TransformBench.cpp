@@ -0,0 +1,274 @@
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//SceneTransforms::Update at 10k/100k/1M nodes with 1%/10%/100% of the locals set each frame, serial and on
+//the job system, against recomputing every world matrix one node at a time with Mat4 (what an app keeping
+//its own object list would do). The scene is a forest of trees 4 wide and 6 deep. Checks the world matrices
+//against that reference first and returns 1 if they don't match.
+//
+//Linux: cmake -S . -B build && cmake --build build (from this directory), or
+//	g++ -std=c++14 -O2 -pthread -I../DirectXInit TransformBench.cpp ../DirectXInit/SceneTransforms.cpp
+//		../DirectXInit/JobSystem.cpp ../DirectXInit/Locks.cpp ../DirectXInit/LockStats.cpp ../DirectXInit/GameTimer.cpp
+//		../DirectXInit/ScopeLock.cpp ../DirectXInit/Profiler.cpp -o TransformBench
+//
+//	TransformBench [-reps N] [-warmup N] [-minms X] [-filter text] [-json path] [-baseline path]
+
+#include "BenchHarness.h"
+
+#include "JobSystem.h"
+#include "SceneTransforms.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t TREE_WIDTH = 4;
+static const uint32_t TREE_DEPTH = 6;		//Levels, so 1365 nodes a tree
+
+
+static uint32_t randState = 12345;
+static uint32_t RandUint()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return randState >> 8;
+}
+
+static float RandFloat(float lo, float hi)
+{
+	return lo + (hi - lo) * (float)RandUint() / 16777216.0f;
+}
+
+static Float4 RandRotation()
+{
+	Vec4 axis = Normalize3(Vec4Set(RandFloat(-1.0f, 1.0f), RandFloat(-1.0f, 1.0f), RandFloat(-1.0f, 1.0f) + 2.0f, 0.0f));
+	Float4 rotation;
+	StoreFloat4(rotation, QuatFromAxisAngle(axis, RandFloat(-MATH_PI, MATH_PI)).q);
+	return rotation;
+}
+
+
+//The scene, plus the same thing as a plain array of nodes for the reference. Nodes are added depth first, so
+//the array is parent first too and the store has real reordering to do.
+struct Scene
+{
+	struct Node
+	{
+		TransformId id;
+		uint32_t	parent;		//Into nodes, or TRANSFORM_NONE
+		Float3		position;
+		Float4		rotation;
+		Float3		scale;
+	};
+
+	SceneTransforms transforms;
+	vector<Node> nodes;
+	vector<Mat4> reference;
+
+	explicit Scene(uint32_t count)
+	{
+		transforms.Reserve(count);
+		nodes.reserve(count);
+
+		while (nodes.size() < count)
+			AddTree(TRANSFORM_NONE, 0, count);
+
+		transforms.Update();
+	}
+
+	void AddTree(uint32_t parentNode, uint32_t depth, uint32_t count)
+	{
+		if (nodes.size() >= count)
+			return;
+
+		Node node;
+		node.parent = parentNode;
+		node.position.x = RandFloat(-10.0f, 10.0f);
+		node.position.y = RandFloat(-10.0f, 10.0f);
+		node.position.z = RandFloat(-10.0f, 10.0f);
+		node.rotation = RandRotation();
+		node.scale.x = node.scale.y = node.scale.z = RandFloat(0.8f, 1.2f);
+		node.id = transforms.Add(parentNode == TRANSFORM_NONE ? TRANSFORM_NONE : nodes[parentNode].id, node.position, node.rotation, node.scale);
+
+		uint32_t self = (uint32_t)nodes.size();
+		nodes.push_back(node);
+
+		if (depth + 1 < TREE_DEPTH)
+			for (uint32_t c = 0; c < TREE_WIDTH; ++c)
+				AddTree(self, depth + 1, count);
+	}
+
+	//Every world matrix from scratch, one node at a time
+	void UpdateReference()
+	{
+		reference.resize(nodes.size());
+		for (size_t i = 0; i < nodes.size(); ++i)
+		{
+			const Node &node = nodes[i];
+			Quat rotation = MakeQuat(LoadFloat4(node.rotation));
+			Mat4 localMatrix = Mat4Compose(LoadFloat3(node.scale), rotation, LoadFloat3(node.position));
+			reference[i] = node.parent == TRANSFORM_NONE ? localMatrix : localMatrix * reference[node.parent];
+		}
+	}
+
+	void Set(uint32_t i, const Float3 &position, const Float4 &rotation)
+	{
+		nodes[i].position = position;
+		nodes[i].rotation = rotation;
+		transforms.SetLocal(nodes[i].id, position, rotation, nodes[i].scale);
+	}
+};
+
+
+static float MaxWorldError(Scene &scene)
+{
+	scene.UpdateReference();
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < scene.nodes.size(); ++i)
+	{
+		Float4x4 a, b;
+		StoreFloat4x4(a, scene.transforms.World(scene.nodes[i].id));
+		StoreFloat4x4(b, scene.reference[i]);
+
+		//Relative to the translation, which grows with depth
+		float scale = 1.0f / fmaxf(1.0f, fabsf(b.m[3][0]) + fabsf(b.m[3][1]) + fabsf(b.m[3][2]));
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				maxError = fmaxf(maxError, fabsf(a.m[r][c] - b.m[r][c]) * (r == 3 ? scale : 1.0f));
+	}
+
+	return maxError;
+}
+
+//The store against the reference after the initial build, and after a couple of partial updates
+static bool Verify(JobSystem &jobs)
+{
+	Scene scene(10000);
+	float error = MaxWorldError(scene);
+
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		for (uint32_t n = 0; n < 200; ++n)
+		{
+			Float3 position = { RandFloat(-10.0f, 10.0f), RandFloat(-10.0f, 10.0f), RandFloat(-10.0f, 10.0f) };
+			scene.Set(RandUint() % (uint32_t)scene.nodes.size(), position, RandRotation());
+		}
+		scene.transforms.Update(pass == 1 ? &jobs : NULL);
+		error = fmaxf(error, MaxWorldError(scene));
+	}
+
+	bool bOk = error < 1e-4f;
+	printf("%u nodes in %u levels, max error against the reference %.3g%s\n\n", scene.transforms.Count(),
+		scene.transforms.LevelCount(), error, bOk ? "" : "  FAILED");
+	return bOk;
+}
+
+
+static void UpdateCases(BenchSuite &suite, JobSystem &jobs, uint32_t count, const char *countName)
+{
+	static const uint32_t percents[3] = { 1, 10, 100 };
+	static const char *variants[3] = { " reference", "", " jobs" };
+
+	char names[3][3][128];
+	bool bAny = false;
+	for (int p = 0; p < 3; ++p)
+	{
+		for (int v = 0; v < 3; ++v)
+		{
+			snprintf(names[p][v], sizeof(names[p][v]), "transforms/%s %u%% dirty%s", countName, percents[p], variants[v]);
+			bAny = bAny || suite.Wants(names[p][v]);
+		}
+	}
+
+	if (!bAny)
+		return;
+
+	Scene scene(count);
+
+	//Same dirty sets every run: a shuffled prefix, so no node twice, then back in order since an app would
+	//walk its objects in order setting the ones that moved
+	vector<uint32_t> shuffled(count);
+	for (uint32_t i = 0; i < count; ++i)
+		shuffled[i] = i;
+	for (uint32_t i = count - 1; i > 0; --i)
+		swap(shuffled[i], shuffled[RandUint() % (i + 1)]);
+
+	Float3 position = { 1.0f, 2.0f, 3.0f };
+	Float4 rotation = RandRotation();
+
+	for (int p = 0; p < 3; ++p)
+	{
+		uint32_t dirtyCount = (uint32_t)(((uint64_t)count * percents[p]) / 100);
+		vector<uint32_t> dirtySet(shuffled.begin(), shuffled.begin() + dirtyCount);
+		sort(dirtySet.begin(), dirtySet.end());
+
+		//The same locals set, then everything recomputed
+		suite.Run(names[p][0], [&scene, &dirtySet, dirtyCount, position, rotation](uint64_t ops)
+		{
+			for (uint64_t n = 0; n < ops; ++n)
+			{
+				for (uint32_t i = 0; i < dirtyCount; ++i)
+				{
+					scene.nodes[dirtySet[i]].position = position;
+					scene.nodes[dirtySet[i]].rotation = rotation;
+				}
+				scene.UpdateReference();
+			}
+			BenchKeep(Vec4GetX(scene.reference[0].r[0]) > 0.0f);
+		}, 1);
+
+		//One op is one frame: set the locals, then Update
+		for (int withJobs = 0; withJobs < 2; ++withJobs)
+		{
+			JobSystem *jobsPtr = withJobs ? &jobs : NULL;
+			suite.Run(names[p][1 + withJobs], [&scene, &dirtySet, dirtyCount, jobsPtr, position, rotation](uint64_t ops)
+			{
+				for (uint64_t n = 0; n < ops; ++n)
+				{
+					for (uint32_t i = 0; i < dirtyCount; ++i)
+					{
+						const Scene::Node &node = scene.nodes[dirtySet[i]];
+						scene.transforms.SetLocal(node.id, position, rotation, node.scale);
+					}
+					scene.transforms.Update(jobsPtr);
+				}
+				BenchKeep(scene.transforms.LastUpdateCount());
+			}, 1);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	JobSystem jobs;
+	jobs.Start();
+
+	bool bOk = Verify(jobs);
+	if (!bOk)
+		printf("world matrices don't match the reference, timings follow anyway\n\n");
+
+	BenchSuite suite("TransformBench", argc, argv);
+
+	UpdateCases(suite, jobs, 10000, "10k");
+	UpdateCases(suite, jobs, 100000, "100k");
+	UpdateCases(suite, jobs, 1000000, "1M");
+
+	int result = suite.Finish();
+	jobs.Stop();
+	return bOk ? result : 1;
+}
@@ -0,0 +1,262 @@
+#include "stdafx.h"
+
+#include "D3D11RenderContext.h"
+#include "D3D11RenderDevice.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+static inline void AddRefIf(IUnknown *com)
+{
+	if (com)
+		com->AddRef();
+}
+
+static inline void ReleaseIf(IUnknown *com)
+{
+	if (com)
+		com->Release();
+}
+
+
+D3D11RenderContext::D3D11RenderContext(D3D11RenderDevice &device) : dxDevice(device)
+{
+	for (uint32_t i = 0; i < RENDER_MAX_CONSTANT_SLOTS; ++i)
+	{
+		constantBuffers[i] = NULL;
+		constantBufferSizes[i] = 0;
+	}
+}
+
+D3D11RenderContext::~D3D11RenderContext()
+{
+	Clear();
+}
+
+void D3D11RenderContext::Clear()
+{
+	for (size_t i = 0; i < pipelineStates.size(); ++i)
+	{
+		ReleaseIf(pipelineStates[i].blend);
+		ReleaseIf(pipelineStates[i].depthStencil);
+		ReleaseIf(pipelineStates[i].raster);
+	}
+	pipelineStates.clear();
+
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		ReleaseIf(materials[i].vs);
+		ReleaseIf(materials[i].ps);
+		ReleaseIf(materials[i].layout);
+		ReleaseIf(materials[i].srv);
+		ReleaseIf(materials[i].sampler);
+	}
+	materials.clear();
+
+	for (size_t i = 0; i < geometries.size(); ++i)
+	{
+		ReleaseIf(geometries[i].vertexBuffer);
+		ReleaseIf(geometries[i].indexBuffer);
+	}
+	geometries.clear();
+
+	for (uint32_t i = 0; i < RENDER_MAX_CONSTANT_SLOTS; ++i)
+	{
+		ReleaseIf(constantBuffers[i]);
+		constantBuffers[i] = NULL;
+		constantBufferSizes[i] = 0;
+	}
+
+	//Released objects could come back at the same address
+	dxDevice.StateCache().InvalidateAll();
+}
+
+uint32_t D3D11RenderContext::AddPipelineState(ID3D11BlendState *blend, ID3D11DepthStencilState *depthStencil, ID3D11RasterizerState *raster, UINT stencilRef)
+{
+	PipelineState state = { blend, depthStencil, raster, stencilRef };
+	AddRefIf(blend);
+	AddRefIf(depthStencil);
+	AddRefIf(raster);
+
+	pipelineStates.push_back(state);
+	return (uint32_t)pipelineStates.size();
+}
+
+uint32_t D3D11RenderContext::AddMaterial(ID3D11VertexShader *vs, ID3D11PixelShader *ps, ID3D11InputLayout *layout,
+	ID3D11ShaderResourceView *srv, ID3D11SamplerState *sampler)
+{
+	Material material = { vs, ps, layout, srv, sampler };
+	AddRefIf(vs);
+	AddRefIf(ps);
+	AddRefIf(layout);
+	AddRefIf(srv);
+	AddRefIf(sampler);
+
+	materials.push_back(material);
+	return (uint32_t)materials.size();
+}
+
+uint32_t D3D11RenderContext::AddGeometry(ID3D11Buffer *vertexBuffer, UINT stride, ID3D11Buffer *indexBuffer,
+	DXGI_FORMAT indexFormat, D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	Geometry geometry = { vertexBuffer, stride, indexBuffer, indexFormat, topology };
+	AddRefIf(vertexBuffer);
+	AddRefIf(indexBuffer);
+
+	geometries.push_back(geometry);
+	return (uint32_t)geometries.size();
+}
+
+void D3D11RenderContext::ClearColor(const float rgba[4])
+{
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	if (context && dxDevice.RenderTargetView())
+		context->ClearRenderTargetView(dxDevice.RenderTargetView(), rgba);
+}
+
+void D3D11RenderContext::ClearDepthStencil(float depth, uint8_t stencil)
+{
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	if (context && dxDevice.DepthStencilView())
+		context->ClearDepthStencilView(dxDevice.DepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depth, stencil);
+}
+
+//Every bind below asks the device's state cache first and is skipped if it would change nothing
+
+void D3D11RenderContext::SetPipelineState(uint32_t stateId)
+{
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	RenderStateCache &cache = dxDevice.StateCache();
+
+	PipelineState none = { NULL, NULL, NULL, 0 };
+	const PipelineState &state = (stateId == 0 || stateId > pipelineStates.size()) ? none : pipelineStates[stateId - 1];
+
+	if (cache.Set(STATECALL_BLEND_STATE, 0, state.blend))
+		context->OMSetBlendState(state.blend, NULL, 0xFFFFFFFF);
+
+	void *depthStencil[2] = { state.depthStencil, (void*)(uintptr_t)state.stencilRef };
+	if (cache.SetBytes(STATECALL_DEPTH_STENCIL_STATE, 0, depthStencil, sizeof(depthStencil)))
+		context->OMSetDepthStencilState(state.depthStencil, state.stencilRef);
+
+	if (cache.Set(STATECALL_RASTERIZER_STATE, 0, state.raster))
+		context->RSSetState(state.raster);
+}
+
+void D3D11RenderContext::SetMaterial(uint32_t materialId)
+{
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	RenderStateCache &cache = dxDevice.StateCache();
+
+	Material none = { NULL, NULL, NULL, NULL, NULL };
+	const Material &material = (materialId == 0 || materialId > materials.size()) ? none : materials[materialId - 1];
+
+	//Materials often share shaders/layouts and differ only in textures, so each part is checked on its own
+	if (cache.Set(STATECALL_INPUT_LAYOUT, 0, material.layout))
+		context->IASetInputLayout(material.layout);
+	if (cache.Set(STATECALL_VERTEX_SHADER, 0, material.vs))
+		context->VSSetShader(material.vs, NULL, 0);
+	if (cache.Set(STATECALL_PIXEL_SHADER, 0, material.ps))
+		context->PSSetShader(material.ps, NULL, 0);
+	if (cache.Set(STATECALL_SHADER_RESOURCES, 0, material.srv))
+		context->PSSetShaderResources(0, 1, &material.srv);
+	if (cache.Set(STATECALL_SAMPLERS, 0, material.sampler))
+		context->PSSetSamplers(0, 1, &material.sampler);
+}
+
+void D3D11RenderContext::SetGeometry(uint32_t geometryId)
+{
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	RenderStateCache &cache = dxDevice.StateCache();
+
+	Geometry none = { NULL, 0, NULL, DXGI_FORMAT_R16_UINT, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST };
+	const Geometry &geometry = (geometryId == 0 || geometryId > geometries.size()) ? none : geometries[geometryId - 1];
+
+	UINT offset = 0;
+	void *vertexBuffer[2] = { geometry.vertexBuffer, (void*)(uintptr_t)geometry.stride };
+	if (cache.SetBytes(STATECALL_VERTEX_BUFFERS, 0, vertexBuffer, sizeof(vertexBuffer)))
+		context->IASetVertexBuffers(0, 1, &geometry.vertexBuffer, &geometry.stride, &offset);
+
+	void *indexBuffer[2] = { geometry.indexBuffer, (void*)(uintptr_t)geometry.indexFormat };
+	if (cache.SetBytes(STATECALL_INDEX_BUFFER, 0, indexBuffer, sizeof(indexBuffer)))
+		context->IASetIndexBuffer(geometry.indexBuffer, geometry.indexFormat, 0);
+
+	if (cache.SetId(STATECALL_TOPOLOGY, 0, (uint64_t)geometry.topology))
+		context->IASetPrimitiveTopology(geometry.topology);
+}
+
+void D3D11RenderContext::SetConstants(uint32_t slot, const void *data, uint32_t size)
+{
+	if (slot >= RENDER_MAX_CONSTANT_SLOTS || size == 0)
+		return;
+
+	ID3D11Device *device = dxDevice.Device();
+	ID3D11DeviceContext *context = dxDevice.DeviceContext();
+	RenderStateCache &cache = dxDevice.StateCache();
+
+	if (size > constantBufferSizes[slot])
+	{
+		ReleaseIf(constantBuffers[slot]);
+		constantBuffers[slot] = NULL;
+		constantBufferSizes[slot] = 0;
+
+		//New buffer, whatever was uploaded before is gone
+		cache.Invalidate(STATECALL_CONSTANT_DATA, slot);
+
+		D3D11_BUFFER_DESC desc;
+		ZeroMemory(&desc, sizeof(desc));
+		desc.ByteWidth = (size + 255) & ~255u;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		if (FAILED(device->CreateBuffer(&desc, NULL, &constantBuffers[slot])))
+			return;
+
+		constantBufferSizes[slot] = desc.ByteWidth;
+	}
+
+	//Same bytes as the last upload to this slot, the buffer already holds them
+	if (cache.SetBytes(STATECALL_CONSTANT_DATA, slot, data, size))
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(context->Map(constantBuffers[slot], 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			cache.Invalidate(STATECALL_CONSTANT_DATA, slot);
+			return;
+		}
+
+		memcpy(mapped.pData, data, size);
+		context->Unmap(constantBuffers[slot], 0);
+	}
+
+	if (cache.Set(STATECALL_CONSTANT_BUFFERS, slot, constantBuffers[slot]))
+	{
+		context->VSSetConstantBuffers(slot, 1, &constantBuffers[slot]);
+		context->PSSetConstantBuffers(slot, 1, &constantBuffers[slot]);
+	}
+}
+
+void D3D11RenderContext::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+	dxDevice.DeviceContext()->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	dxDevice.DeviceContext()->DrawIndexed(indexCount, startIndex, baseVertex);
+}
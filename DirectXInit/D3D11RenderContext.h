@@ -0,0 +1,102 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "RenderContext.h"
+#include <d3d11.h>
+#include <vector>
+
+class D3D11RenderDevice;
+
+
+//IRenderContext on top of D3D11RenderDevice's immediate context, owned by the device. The app registers
+//its D3D objects here once and gets ids back to put in commands; we hold a reference to each until Clear
+//or destruction.
+//
+//Binds go through the device's RenderStateCache and are dropped when nothing would change, which only works
+//if the cache knows what is bound: after binding anything on the device context directly, Invalidate it.
+//
+//Like everything else touching the context, replay with the manager locked (LockMgr) or from the thread
+//that claimed it.
+
+class D3D11RenderContext : public IRenderContext
+{
+public:
+	D3D11RenderContext(D3D11RenderDevice &device);
+	virtual ~D3D11RenderContext();
+
+	//Any of these can be NULL for the D3D default
+	uint32_t AddPipelineState(ID3D11BlendState *blend, ID3D11DepthStencilState *depthStencil, ID3D11RasterizerState *raster, UINT stencilRef = 0);
+	uint32_t AddMaterial(ID3D11VertexShader *vs, ID3D11PixelShader *ps, ID3D11InputLayout *layout,
+		ID3D11ShaderResourceView *srv = NULL, ID3D11SamplerState *sampler = NULL);
+	uint32_t AddGeometry(ID3D11Buffer *vertexBuffer, UINT stride, ID3D11Buffer *indexBuffer = NULL,
+		DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT, D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	//Drop every registration and the constant buffers
+	void Clear();
+
+	virtual void ClearColor(const float rgba[4]);
+	virtual void ClearDepthStencil(float depth, uint8_t stencil);
+	virtual void SetPipelineState(uint32_t stateId);
+	virtual void SetMaterial(uint32_t materialId);
+	virtual void SetGeometry(uint32_t geometryId);
+	virtual void SetConstants(uint32_t slot, const void *data, uint32_t size);
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex);
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+
+private:
+
+	struct PipelineState
+	{
+		ID3D11BlendState		*blend;
+		ID3D11DepthStencilState *depthStencil;
+		ID3D11RasterizerState	*raster;
+		UINT					 stencilRef;
+	};
+
+	struct Material
+	{
+		ID3D11VertexShader		 *vs;
+		ID3D11PixelShader		 *ps;
+		ID3D11InputLayout		 *layout;
+		ID3D11ShaderResourceView *srv;
+		ID3D11SamplerState		 *sampler;
+	};
+
+	struct Geometry
+	{
+		ID3D11Buffer			*vertexBuffer;
+		UINT					 stride;
+		ID3D11Buffer			*indexBuffer;
+		DXGI_FORMAT				 indexFormat;
+		D3D11_PRIMITIVE_TOPOLOGY topology;
+	};
+
+	D3D11RenderContext(const D3D11RenderContext&);
+	D3D11RenderContext& operator=(const D3D11RenderContext&);
+
+	D3D11RenderDevice &dxDevice;
+
+	//Index id - 1, id 0 is the default
+	std::vector<PipelineState> pipelineStates;
+	std::vector<Material> materials;
+	std::vector<Geometry> geometries;
+
+	//Dynamic constant buffer per slot, grown (in 256 byte steps) when a bigger upload comes along
+	ID3D11Buffer *constantBuffers[RENDER_MAX_CONSTANT_SLOTS];
+	UINT constantBufferSizes[RENDER_MAX_CONSTANT_SLOTS];
+};
@@ -0,0 +1,380 @@
+#include "stdafx.h"
+
+#include "D3D11RenderDevice.h"
+#include <assert.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Release and NULL the pointer, so the Create* calls can tell what is still alive
+template <class T>
+static inline bool COMRelease(T *&targetCOM)
+{
+	if (!targetCOM)
+		return false;
+
+	targetCOM->Release();
+	targetCOM = NULL;
+	return true;
+}
+
+
+D3D11RenderDevice::D3D11RenderDevice() :
+	curDevice(NULL), curDeviceContext(NULL), curSwapChain(NULL), bbRenderTargetView(NULL),
+	mDepthStencilBuffer(NULL), mDepthStencilView(NULL), swapChainBufferCount(1), targetPool(*this), renderContext(*this)
+{
+	ZeroMemory(&depthTargetDesc, sizeof(depthTargetDesc));
+}
+
+D3D11RenderDevice::~D3D11RenderDevice()
+{
+	Release();
+}
+
+HRESULT D3D11RenderDevice::CreateDevice()
+{
+	if (curDevice)
+		return -1;
+
+	D3D_FEATURE_LEVEL checkForDX11[1];
+	checkForDX11[0] = D3D_FEATURE_LEVEL_11_0;
+	D3D_FEATURE_LEVEL highestFeatureLevel;
+
+	HRESULT retRes = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL,
+
+		//Specify debug flag if in debug mode...
+#ifdef _DEBUG
+		D3D11_CREATE_DEVICE_DEBUG
+#else
+		NULL
+#endif
+		, checkForDX11,
+		1,
+		D3D11_SDK_VERSION,
+		&curDevice,
+		&highestFeatureLevel,
+		&curDeviceContext
+		);
+
+	if (FAILED(retRes))
+		return retRes;
+
+	//Make sure the device supports D3D 11
+	if (highestFeatureLevel < D3D_FEATURE_LEVEL_11_0)
+	{
+		Release();
+		return -1;
+	}
+
+	return retRes;
+}
+
+HRESULT D3D11RenderDevice::CheckMultisampleQuality(UINT sampleCount, UINT &quality)
+{
+	quality = 0;
+	return curDevice->CheckMultisampleQualityLevels(DXGI_FORMAT_R8G8B8A8_UNORM, sampleCount, &quality);
+}
+
+//Create an instance of the swap chain
+HRESULT D3D11RenderDevice::CreateSwapChain(const RenderSwapChainDesc &desc)
+{
+	if (!curDevice || curSwapChain)
+		return -1;
+
+	DXGI_SWAP_CHAIN_DESC swapChainDesc;
+	ZeroMemory(&swapChainDesc, sizeof(DXGI_SWAP_CHAIN_DESC));
+
+	swapChainDesc.BufferDesc.Width = desc.width;
+	swapChainDesc.BufferDesc.Height = desc.height;
+	swapChainDesc.BufferDesc.RefreshRate.Numerator = desc.refreshNumerator;
+	swapChainDesc.BufferDesc.RefreshRate.Denominator = desc.refreshDenominator;
+
+	swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;	//Monitor doesn't output the alpha but we can use it for extra effects later
+	swapChainDesc.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;	//Leave it up to the adapter
+	swapChainDesc.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;	//Leave it up to the adapter
+
+	swapChainDesc.SampleDesc.Count = desc.sampleCount;
+	swapChainDesc.SampleDesc.Quality = desc.sampleQuality;
+
+	//We will be rendering to the back buffer...
+	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	swapChainDesc.BufferCount = desc.bufferCount;
+	swapChainDesc.OutputWindow = desc.outputWindow;
+	swapChainDesc.Windowed = desc.windowed;
+
+	//Let the adapter choose the most efficient presentation method
+	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	swapChainDesc.Flags = 0;
+
+	//We need to get the instance of the IDXGIFactory used to create the device...
+	//Time for COM queries...
+
+	IDXGIDevice *dxgiDevice = NULL;
+
+	if (FAILED(curDevice->QueryInterface(__uuidof(IDXGIDevice), (void**)&dxgiDevice)))
+		return -1;
+
+	//Get the adapter
+	IDXGIAdapter *dxgiAdapter = NULL;
+
+	if (FAILED(dxgiDevice->GetParent(__uuidof(IDXGIAdapter), (void**)&dxgiAdapter)))
+	{
+		//Release what we have so far
+		COMRelease(dxgiDevice);
+		return -1;
+	}
+
+	//Finally get the factory interface
+	IDXGIFactory *dxgiFactory = NULL;
+
+	if (FAILED(dxgiAdapter->GetParent(__uuidof(IDXGIFactory), (void**)&dxgiFactory)))
+	{
+		//Free the other interfaces we have succesfully aqquired
+		COMRelease(dxgiDevice);
+		COMRelease(dxgiAdapter);
+		return -1;
+	}
+
+	//Now create the swap chain
+	HRESULT retRes = dxgiFactory->CreateSwapChain(curDevice, &swapChainDesc, &curSwapChain);
+
+	COMRelease(dxgiDevice);
+	COMRelease(dxgiAdapter);
+	COMRelease(dxgiFactory);
+
+	if (FAILED(retRes))
+	{
+		curSwapChain = NULL;
+		return -1;
+	}
+
+	swapChainBufferCount = desc.bufferCount;
+	return 0;
+}
+
+//Create a render target view for the back buffer of the swap chain
+HRESULT D3D11RenderDevice::CreateBackBufferView()
+{
+	if (!curSwapChain || bbRenderTargetView)
+		return -1;
+
+	//Handle to back buffer
+	ID3D11Texture2D *backBuffer = NULL;
+
+	//Get a pointer to the swap chain back buffer, index 0 is the one we render to
+	if (FAILED(curSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer)))
+		return -1;
+
+	//Create a render target view to the back buffer. We can leave this NULL since we specified the type of the resource earlier.
+	HRESULT retRes = curDevice->CreateRenderTargetView(backBuffer, NULL, &bbRenderTargetView);
+
+	//Release the handle to the back buffer in either case
+	COMRelease(backBuffer);
+
+	if (FAILED(retRes))
+	{
+		bbRenderTargetView = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+//Texture for the pool, at the (bucketed) size it asks for
+HRESULT D3D11RenderDevice::CreateTarget(const RenderTargetDesc &desc, void *&resource)
+{
+	resource = NULL;
+
+	if (!curDevice)
+		return -1;
+
+	D3D11_TEXTURE2D_DESC textureDesc;
+	ZeroMemory(&textureDesc, sizeof(D3D11_TEXTURE2D_DESC));
+
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+
+	//Mip levels and array size are 1 for render targets and depth/stencil buffers
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = (DXGI_FORMAT)desc.format;
+
+	textureDesc.SampleDesc.Count = desc.sampleCount;
+	textureDesc.SampleDesc.Quality = desc.sampleQuality;
+
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = (desc.usage == RENDERTARGET_DEPTH_STENCIL) ? D3D11_BIND_DEPTH_STENCIL : (D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+	textureDesc.CPUAccessFlags = 0;
+	textureDesc.MiscFlags = 0;
+
+	ID3D11Texture2D *texture = NULL;
+	if (FAILED(curDevice->CreateTexture2D(&textureDesc, NULL, &texture)))
+		return -1;
+
+	resource = texture;
+	return 0;
+}
+
+void D3D11RenderDevice::ReleaseTarget(const RenderTargetDesc&, void *resource)
+{
+	ID3D11Texture2D *texture = static_cast<ID3D11Texture2D*>(resource);
+	COMRelease(texture);
+}
+
+//Get a depth/stencil texture from the pool (the one from before the resize if it is still big enough) and a
+//view which we can bind to
+HRESULT D3D11RenderDevice::CreateDepthStencil(const RenderDepthStencilDesc &desc)
+{
+	if (!curDevice || mDepthStencilBuffer)
+		return -1;
+
+	//24 bits normalized to [0,1] for depth and 8 bits for -128, 127, for stencil.
+	depthTargetDesc.usage = RENDERTARGET_DEPTH_STENCIL;
+	depthTargetDesc.format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthTargetDesc.bytesPerSample = 4;
+	depthTargetDesc.sampleCount = desc.sampleCount;
+	depthTargetDesc.sampleQuality = desc.sampleQuality;
+	depthTargetDesc.width = desc.width;
+	depthTargetDesc.height = desc.height;
+
+	void *texture = NULL;
+	if (FAILED(targetPool.Acquire(depthTargetDesc, texture)))
+		return -1;
+
+	mDepthStencilBuffer = static_cast<ID3D11Texture2D*>(texture);
+	return CreateDepthStencilView();
+}
+
+HRESULT D3D11RenderDevice::CreateDepthStencilView()
+{
+	//takes pointer to the resource we want to create a view for, returns pointer to view in mDepthStencilView
+	if (FAILED(curDevice->CreateDepthStencilView(mDepthStencilBuffer, NULL, &mDepthStencilView)))
+	{
+		mDepthStencilView = NULL;
+		targetPool.Release(mDepthStencilBuffer);
+		mDepthStencilBuffer = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+//Has been bigger than the window for long enough, swap for one the right size (the old one is freed on release)
+void D3D11RenderDevice::ShrinkDepthStencil()
+{
+	if (!mDepthStencilBuffer || !targetPool.ShouldShrink(mDepthStencilBuffer))
+		return;
+
+	bool bBound = (bbRenderTargetView != NULL);
+
+	COMRelease(mDepthStencilView);
+	targetPool.Release(mDepthStencilBuffer);
+	mDepthStencilBuffer = NULL;
+
+	void *texture = NULL;
+	if (FAILED(targetPool.Acquire(depthTargetDesc, texture)))
+		return;
+
+	mDepthStencilBuffer = static_cast<ID3D11Texture2D*>(texture);
+	if (FAILED(CreateDepthStencilView()))
+		return;
+
+	//The new view replaces the old one, which the context still holds until then
+	if (bBound)
+		BindViews();
+}
+
+//Bind the views to the output merger state
+void D3D11RenderDevice::BindViews()
+{
+	void *views[2] = { bbRenderTargetView, mDepthStencilView };
+	if (stateCache.SetBytes(STATECALL_RENDER_TARGETS, 0, views, sizeof(views)))
+		curDeviceContext->OMSetRenderTargets(1, &bbRenderTargetView, mDepthStencilView);
+}
+
+void D3D11RenderDevice::SetViewport(const RenderViewport &viewport)
+{
+	D3D11_VIEWPORT vp;
+	vp.TopLeftX = viewport.topLeftX;
+	vp.TopLeftY = viewport.topLeftY;
+	vp.Width = viewport.width;
+	vp.Height = viewport.height;
+	vp.MinDepth = viewport.minDepth;
+	vp.MaxDepth = viewport.maxDepth;
+
+	if (stateCache.SetBytes(STATECALL_VIEWPORT, 0, &vp, sizeof(vp)))
+		curDeviceContext->RSSetViewports(1, &vp);
+}
+
+void D3D11RenderDevice::ReleaseViews()
+{
+	//Unbind first, the context would otherwise keep its own references to the old views
+	void *views[2] = { NULL, NULL };
+	if (curDeviceContext && stateCache.SetBytes(STATECALL_RENDER_TARGETS, 0, views, sizeof(views)))
+		curDeviceContext->OMSetRenderTargets(0, NULL, NULL);
+
+	COMRelease(bbRenderTargetView);
+	COMRelease(mDepthStencilView);
+
+	//Kept for the next CreateDepthStencil, a resize that stays inside its size bucket gets it back
+	targetPool.Release(mDepthStencilBuffer);
+	mDepthStencilBuffer = NULL;
+}
+
+HRESULT D3D11RenderDevice::ResizeSwapChain(UINT width, UINT height)
+{
+	assert(curSwapChain);
+
+	return curSwapChain->ResizeBuffers(swapChainBufferCount, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
+}
+
+HRESULT D3D11RenderDevice::Present(UINT syncInterval)
+{
+	stateCache.EndFrame();
+	HRESULT retRes = curSwapChain->Present(syncInterval, 0);
+
+	if (targetPool.EndFrame())
+		ShrinkDepthStencil();
+
+	return retRes;
+}
+
+void D3D11RenderDevice::Release()
+{
+	renderContext.Clear();
+
+	ReleaseViews();
+	targetPool.Clear();
+	COMRelease(curSwapChain);
+
+	if (curDeviceContext)
+	{
+		try
+		{
+			curDeviceContext->ClearState();
+		}
+		catch (...)
+		{
+
+		}
+	}
+
+	COMRelease(curDeviceContext);
+	COMRelease(curDevice);
+
+	stateCache.InvalidateAll();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "RenderDevice.h"
+#include "D3D11RenderContext.h"
+#include <d3d11.h>
+
+
+//The hardware device: D3D11 device/immediate context, DXGI swap chain, back buffer render target view and
+//the depth/stencil buffer. What used to live directly in DirectXManager, which still does the bookkeeping.
+
+class D3D11RenderDevice : public IRenderDevice, private IRenderTargetAllocator
+{
+public:
+	D3D11RenderDevice();
+	virtual ~D3D11RenderDevice();
+
+	virtual RenderDeviceType Type() const { return RENDER_DEVICE_D3D11; }
+	virtual bool NeedsWindow() const { return true; }
+
+	virtual HRESULT CreateDevice();
+	virtual HRESULT CheckMultisampleQuality(UINT sampleCount, UINT &quality);
+	virtual HRESULT CreateSwapChain(const RenderSwapChainDesc &desc);
+	virtual HRESULT CreateBackBufferView();
+	virtual HRESULT CreateDepthStencil(const RenderDepthStencilDesc &desc);
+	virtual void	BindViews();
+	virtual void	SetViewport(const RenderViewport &viewport);
+	virtual void	ReleaseViews();
+	virtual HRESULT ResizeSwapChain(UINT width, UINT height);
+	virtual HRESULT Present(UINT syncInterval);
+	virtual void	Release();
+
+	virtual IRenderContext& Context() { return renderContext; }
+	virtual RenderStateCache& StateCache() { return stateCache; }
+	virtual RenderTargetPool& TargetPool() { return targetPool; }
+
+	//Register D3D objects here to get the ids render commands use
+	inline D3D11RenderContext& RenderContext() { return renderContext; };
+
+	inline ID3D11Device *Device() const { return curDevice; };
+	inline ID3D11DeviceContext *DeviceContext() const { return curDeviceContext; };
+	inline IDXGISwapChain *SwapChain() const { return curSwapChain; };
+	inline ID3D11RenderTargetView *RenderTargetView() const { return bbRenderTargetView; };
+	inline ID3D11Texture2D *DepthStencilBuffer() const { return mDepthStencilBuffer; };
+	inline ID3D11DepthStencilView *DepthStencilView() const { return mDepthStencilView; };
+
+private:
+
+	D3D11RenderDevice(const D3D11RenderDevice&);
+	D3D11RenderDevice& operator=(const D3D11RenderDevice&);
+
+	//Textures for the target pool
+	virtual HRESULT CreateTarget(const RenderTargetDesc &desc, void *&resource);
+	virtual void	ReleaseTarget(const RenderTargetDesc &desc, void *resource);
+
+	HRESULT CreateDepthStencilView();
+	void	ShrinkDepthStencil();
+
+	ID3D11Device *curDevice;
+	ID3D11DeviceContext *curDeviceContext;
+	IDXGISwapChain *curSwapChain;
+
+	//Handle to render target view for swap chain back buffer
+	ID3D11RenderTargetView *bbRenderTargetView;
+
+	//depth/stencil texture (owned by targetPool) and the view to bind to output pipeline
+	ID3D11Texture2D *mDepthStencilBuffer;
+	ID3D11DepthStencilView *mDepthStencilView;
+	RenderTargetDesc depthTargetDesc;
+
+	UINT swapChainBufferCount;
+
+	//Everything bound on curDeviceContext goes through this, renderContext included
+	RenderStateCache stateCache;
+
+	RenderTargetPool targetPool;
+
+	//Registered states/materials/geometry are released before the device
+	D3D11RenderContext renderContext;
+};
@@ -24,18 +24,29 @@ Parts inspired by/adapted from Frank D. Lunas' excellent book "Intro to 3D Game
 
 
 #include "DxAppBase.h"
-#include <Windows.h>
 #include "InitManager.h"
-#include <sstream>
+#include "NullRenderDevice.h"
 #include "ScopeLock.h"
-#include <windowsx.h>
+#include "Profiler.h"
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windowsx.h>
+#endif
 
 using namespace std;
 
 //global instance, more or less singleton model (or half of it anyways)....
 DxAppBase *globalDxApp = NULL;
 
+//Caption FrameStatUpdate puts together once a second
+#define DXAPP_CAPTION_FORMAT _T("%s    FPS: %.1f    Frame Time: %.2f (ms)    p99: %.2f    max: %.2f    hitches: %u")
+
+#ifdef _WIN32
+
 //Alternative window proc
 
 LRESULT CALLBACK AppWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -47,25 +58,44 @@ LRESULT CALLBACK AppWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	return globalDxApp->WndMsgProc(hwnd, msg, wParam, lParam);
 }
 
+#endif
+
 
 DxAppBase::DxAppBase(HINSTANCE wndInstance)
 	:
-	handleAppInstance(NULL), strMainWindowCaption(_T("DX11 Application")), bEnforce4xMSAA(true),
-	handleMainWindow(NULL), bAppPaused(false), bAppMinimized(false), bAppMaximized(false),
-	bIsResizing(false), mClientWidth(1080), mClientHeight(1920), bFullScreen(false)
+	handleAppInstance(NULL), handleMainWindow(NULL), bAppPaused(false), bAppMinimized(false), bAppMaximized(false),
+	bIsResizing(false), bEnforce4xMSAA(true), bFullScreen(false), resizeLock("BASE_LOCK"),
+	startupWindowStep(STARTUP_INVALID_STEP), startupDeviceStep(STARTUP_INVALID_STEP), startupReadyStep(STARTUP_INVALID_STEP),
+	inputBatch(INPUTQUEUE_CAPACITY), mPendingInputCounter(0), mLastLatencyFrame(0), mInitEndMs(-1.0), mRunStartMs(-1.0), bStartupConsole(false),
+	mNextCaptionUpdate(1.0), captionLock("BASE_CAPTION"), mClientWidth(1080), mClientHeight(1920),
+	bFixedTimestep(false), mFixedStep(1.0 / 60.0), mMaxCatchUpSteps(5), mStepAccumulator(0.0), mDroppedSimTime(0.0), mLastStepCount(0),
+	mRenderSnapshot(NULL), mSimFrame(0), bThreadedLoop(false), bLoopThreadsRunning(false), bQuitLoopThreads(false),
+	pendingResize(0), mResizesRequested(0), mResizesPerformed(0), loopSignal(0),
+	bHeadless(false), mFrameLimit(0), mFramesDrawn(0), bQuitRequested(false), strMainWindowCaption(_T("DX11 Application"))
 {
+	//Startup times are from here
+	_startupReport.Begin();
+
+	captionBuffer[0] = 0;
 
 	globalDxApp = this;
 
+	_jobSystem.Start();
 
-	resizeLock = CreateMutex(NULL, false, _T("BASE_LOCK"));
+	//Room for every thread that can be running jobs, the workers and the registered ones
+	_frameArena.Init(FRAMEARENA_DEFAULT_FRAMES, FRAMEARENA_DEFAULT_THREAD_BYTES, _jobSystem.WorkerCount() + JOB_MAX_EXTERNAL_THREADS + 1);
 
-	assert(resizeLock > 0);
+	_startupReport.AddStage("app", "DxAppBase constructor", 0.0, _startupReport.NowMs(), _jobSystem.CurrentThreadSlot());
 
 }
 
 DxAppBase::~DxAppBase()
 {
+	//Normally already stopped at the end of Run
+	StopLoopThreads();
+
+	_jobSystem.Stop();
+
 	//_dxMgr destructor gets called after we go out of scope here
 }
 
@@ -87,61 +117,730 @@ float DxAppBase::CurAspectRatio() const
 		return static_cast<float>(_dxMgr.GetClientWidth()) / _dxMgr.GetClientHeight();
 }
 
+//Where the picture goes in the client area: the viewport, or the whole window before there is one
+bool DxAppBase::CameraRect(float &left, float &top, float &width, float &height) const
+{
+	const RenderViewport &viewport = _dxMgr.GetCurrentViewPort();
+
+	if (_dxMgr.GetCurrentState() == STATE_MGR_VIEWPORT_CREATED && viewport.width > 0.0f && viewport.height > 0.0f)
+	{
+		left = viewport.topLeftX;
+		top = viewport.topLeftY;
+		width = viewport.width;
+		height = viewport.height;
+		return true;
+	}
+
+	if (_dxMgr.GetClientHeight() > 0 && CurAspectRatio() > 0.0f)
+	{
+		left = top = 0.0f;
+		width = static_cast<float>(_dxMgr.GetClientWidth());
+		height = static_cast<float>(_dxMgr.GetClientHeight());
+		return true;
+	}
+
+	return false;
+}
+
+Frustum DxAppBase::CameraFrustum(const Mat4 &view, float fovY, float zNear, float zFar) const
+{
+	float left, top, width, height;
+	float aspect = CameraRect(left, top, width, height) ? width / height : 1.0f;
+
+	return FrustumFromCamera(view, fovY, aspect, zNear, zFar);
+}
+
+bool DxAppBase::CameraPickRay(const Mat4 &view, float fovY, int x, int y, Float3 &origin, Float3 &direction) const
+{
+	float left, top, width, height;
+	if (!CameraRect(left, top, width, height))
+		return false;
+
+	//Through the middle of the pixel, to -1..1 both ways with y up, then out to z = 1 in view space
+	float ndcX = (static_cast<float>(x) + 0.5f - left) / width * 2.0f - 1.0f;
+	float ndcY = 1.0f - (static_cast<float>(y) + 0.5f - top) / height * 2.0f;
+	float tanHalfFov = tanf(fovY * 0.5f);
+
+	Mat4 cameraToWorld = Mat4InverseAffine(view);
+	StoreFloat3(origin, TransformPoint(Vec4Set(0.0f, 0.0f, 0.0f, 1.0f), cameraToWorld));
+	StoreFloat3(direction, TransformVector(Vec4Set(ndcX * tanHalfFov * width / height, ndcY * tanHalfFov, 1.0f, 0.0f), cameraToWorld));
+	return true;
+}
+
 int DxAppBase::Run()
 {
 
-	MSG curMsg = { NULL };
+	int exitCode = 0;
+
+	PROFILE_THREAD_NAME("Main");
+
+	//First Run after InitApp, whatever the app did since the base init is part of startup
+	if (!_startupReport.IsFinished() && mRunStartMs < 0.0)
+	{
+		mRunStartMs = _startupReport.NowMs();
+		if (mInitEndMs >= 0.0)
+			_startupReport.AddStage("app", "rest of InitApp, until Run", mInitEndMs, mRunStartMs, _jobSystem.CurrentThreadSlot());
+	}
 
 	//Reset timer...
 	_gameTimer.Reset();
+	_frameStats.Reset();
+	mNextCaptionUpdate = 1.0;
+	mStepAccumulator = 0.0;
+	mSimFrame = 0;
+	mFramesDrawn = 0;
+	bQuitRequested = false;
+	_inputLatency.Reset();
+	_framePacer.Reset();
+	_framePacer.ResetStats();
+	_simPacer.Reset();
+	mPendingInputCounter = 0;
+	mLastLatencyFrame = 0;
+
+	//Created here rather than in the constructor since CreateRenderSnapshot is virtual
+	for (int i = 0; i < 3; ++i)
+		_renderSnapshots.Buffer(i).reset(CreateRenderSnapshot());
+
+	if (bThreadedLoop)
+		return RunThreaded();
+
+#ifdef _WIN32
+	MSG curMsg = { NULL };
+#endif
 
-	while (curMsg.message != WM_QUIT)
+	while (!bQuitRequested)
 	{
 
-		if (PeekMessage(&curMsg, NULL, 0, 0, PM_REMOVE))
+#ifdef _WIN32
+		//Everything that came in since the last frame, then the frame. One message per loop would let a fast
+		//mouse spread its messages over several frames.
+		if (!bHeadless)
 		{
-			TranslateMessage(&curMsg);
-			DispatchMessage(&curMsg);
+			PROFILE_ZONE("Message pump");
+
+			bool bGotQuit = false;
+			while (PeekMessage(&curMsg, NULL, 0, 0, PM_REMOVE))
+			{
+				if (curMsg.message == WM_QUIT)
+				{
+					exitCode = (int)curMsg.wParam;
+					bGotQuit = true;
+					break;
+				}
+
+				TranslateMessage(&curMsg);
+				DispatchMessage(&curMsg);
+			}
+
+			if (bGotQuit)
+				break;
 		}
-		else if (_gameTimer.GetIsValid())
+#endif
+
+		//Pump ran dry, the last move can go
+		_inputQueue.Flush();
+
+		if (!_gameTimer.GetIsValid())
 		{
+			//Something went terribly wrong, game timer is not valid, bail
+			//TODO: Add SetLastError of some sort
+			break;
+		}
 
-			//Increment timer and get new delta
-			_gameTimer.Tick();
+		//Increment timer and get new delta
+		_gameTimer.Tick();
+
+		if (!bAppPaused)
+		{
+			PROFILE_ZONE("Frame");
+
+			//Whatever the messages above asked for, once
+			ApplyPendingResize();
+
+			_frameArena.BeginFrame();
+			DrainInput();
+
+			//Double time from the snapshot, the float TotalTime is only good to ~8ms after a day up
+			TimerSnapshot timer = _gameTimer.Snapshot();
+			FrameStatUpdate(timer.totalTime, timer.deltaTime);
+			float alpha = StepSimulation(timer.deltaTime);
+			_sceneTransforms.Update(&_jobSystem);
+
+			//Same hand off as the threaded loop, just without anyone in between
+			PublishSnapshot(alpha);
+			_renderSnapshots.Acquire();
+			mRenderSnapshot = _renderSnapshots.ReadBuffer().get();
 
-			if (!bAppPaused)
 			{
-				FrameStatUpdate();
-				ProcSceneUpdate(_gameTimer.DeltaTime());
-				ProcSceneDraw();
+				PROFILE_ZONE("ProcSceneDraw");
+				ProcSceneDraw(alpha);
 			}
+			FrameDrawn();
+
+			_framePacer.Wait();
+		}
+		else
+		{
+			//Nothing to do until something unpauses us. That comes in as a message, so windowed this thread
+			//has to be back in the pump for it.
+#ifdef _WIN32
+			if (!bHeadless)
+				WaitMessage();
 			else
-			{
-				Sleep(100);
-			}
+#endif
+				WaitWhilePaused();
+
+			_framePacer.Reset();
+		}
+
+	}
+
+	mRenderSnapshot = NULL;
+	return exitCode;
+
+}
+
+bool DxAppBase::FrameDrawn()
+{
+	++mFramesDrawn;
+
+	if (!_startupReport.IsFinished())
+		FinishStartupReport();
+
+	//Frame range captures start and end here, the trace is written once one ends
+	if (PROFILE_FRAME_BOUNDARY() && !profileTracePath.empty())
+		ProfilerWriteChromeTrace(profileTracePath.c_str());
+
+	//First present of a snapshot that had input behind it
+	if (mRenderSnapshot && mRenderSnapshot->inputCounter != 0 && mRenderSnapshot->simFrame != mLastLatencyFrame)
+	{
+		int64_t counter = 0;
+		GameTimer::QueryCounter(counter);
+
+		double secondsPerCount = _gameTimer.SecondsPerCount();
+		_inputLatency.AddFrame(counter * secondsPerCount, (counter - mRenderSnapshot->inputCounter) * secondsPerCount);
+		mLastLatencyFrame = mRenderSnapshot->simFrame;
+	}
+
+	//Exactly once, windowed that posts WM_CLOSE and frames keep coming until the window is gone
+	if (mFramesDrawn == mFrameLimit)
+	{
+		RequestQuit();
+		return true;
+	}
+
+	return false;
+}
+
+void DxAppBase::SetStartupReportOutput(bool bConsole, const char *textPath, const char *jsonPath)
+{
+	bStartupConsole = bConsole;
+	startupTextPath = textPath ? textPath : "";
+	startupJsonPath = jsonPath ? jsonPath : "";
+}
+
+void DxAppBase::RecordStartup(double initStartMs)
+{
+	double offsetMs = _startupReport.ToMs(_startupGraph.StartCounter());
+
+	const std::vector<StartupStepTiming> &steps = _startupGraph.Timings();
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		if (steps[i].bRan)
+			_startupReport.AddStage("graph", steps[i].name, offsetMs + steps[i].startMs, offsetMs + steps[i].endMs, steps[i].threadSlot, steps[i].bSucceeded);
+	}
+
+	for (int i = 0; i < MGR_STAGE_COUNT; ++i)
+	{
+		const MgrStageTiming &timing = _dxMgr.StageTiming((MgrInitStage)i);
+		if (timing.endCounter != 0)
+			_startupReport.AddStage("mgr", MgrStageName((MgrInitStage)i), _startupReport.ToMs(timing.startCounter), _startupReport.ToMs(timing.endCounter));
+	}
+
+	mInitEndMs = _startupReport.NowMs();
+	_startupReport.AddStage("app", "DxAppBase::InitApp", initStartMs, mInitEndMs, _jobSystem.CurrentThreadSlot(), _startupGraph.Succeeded());
+}
+
+//Right after the first frame was presented, on whichever thread draws
+void DxAppBase::FinishStartupReport()
+{
+	double nowMs = _startupReport.NowMs();
+
+	if (mRunStartMs >= 0.0)
+		_startupReport.AddStage("frame", "first frame", mRunStartMs, nowMs, _jobSystem.CurrentThreadSlot());
+
+	_startupReport.Finish(nowMs);
+
+	if (bStartupConsole)
+	{
+		std::string text;
+		_startupReport.FormatText(text);
+#ifdef _WIN32
+		OutputDebugStringA(text.c_str());
+#endif
+		fputs(text.c_str(), stdout);
+	}
+
+	if (!startupTextPath.empty())
+		_startupReport.WriteText(startupTextPath.c_str());
+	if (!startupJsonPath.empty())
+		_startupReport.WriteJson(startupJsonPath.c_str());
+}
+
+void DxAppBase::RequestQuit()
+{
+#ifdef _WIN32
+	if (!bHeadless)
+	{
+		PostMessage(handleMainWindow, WM_CLOSE, 0, 0);
+		return;
+	}
+#endif
+
+	bQuitRequested = true;
+	WakeLoopThreads();
+}
+
+void DxAppBase::SimulatePause(bool paused)
+{
+	if (paused)
+		_gameTimer.Stop();
+	else
+		_gameTimer.Start();
+
+	SetPaused(paused);
+}
+
+void DxAppBase::CaptureProfile(uint32_t frames, const char *tracePath)
+{
+	profileTracePath = tracePath ? tracePath : "";
+	ProfilerCaptureFrames(frames);
+}
+
+void DxAppBase::SetFrameRateLimit(double fps)
+{
+	_framePacer.SetTargetFps(fps);
+	_simPacer.SetTargetFps(fps);
+}
+
+void DxAppBase::SetPaused(bool paused)
+{
+	bAppPaused = paused;
+	if (!paused)
+		WakeLoopThreads();
+}
+
+void DxAppBase::WakeLoopThreads()
+{
+	loopSignal.fetch_add(1, std::memory_order_release);
+	LockUnparkAll(loopSignal);
+}
+
+void DxAppBase::WaitWhilePaused()
+{
+	for (;;)
+	{
+		//Read the signal before the flags, so a wake in between makes the park return straight away
+		uint32_t signal = loopSignal.load(std::memory_order_acquire);
+		if (!bAppPaused || bQuitLoopThreads || bQuitRequested)
+			return;
+
+		LockParkOnAddress(loopSignal, signal, LOCK_WAIT_INFINITE);
+	}
+}
+
+void DxAppBase::SimulateResize(int width, int height)
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	ScopeLock<TrackedSpinMutex> lock(resizeLock);
+
+	mClientWidth = width;
+	mClientHeight = height;
+	QueueResize(width, height);
+}
+
+void DxAppBase::DrainInput()
+{
+	PROFILE_FUNCTION();
+	uint32_t count = _inputQueue.Drain(&inputBatch[0], (uint32_t)inputBatch.size());
+	if (count == 0)
+		return;
+
+	//Events are in arrival order and a coalesced move keeps its first time, so the first is the oldest
+	if (mPendingInputCounter == 0)
+		mPendingInputCounter = inputBatch[0].counter;
+
+	ProcInput(&inputBatch[0], count);
+}
+
+void DxAppBase::ProcInput(const InputEvent *events, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const InputEvent &ev = events[i];
+		switch (ev.type)
+		{
+		case INPUT_MOUSE_DOWN:
+			HandleMouseDown(ev.buttons, ev.x, ev.y);
+			break;
+		case INPUT_MOUSE_UP:
+			HandleMouseUp(ev.buttons, ev.x, ev.y);
+			break;
+		case INPUT_MOUSE_MOVE:
+			HandleMouseMove(ev.buttons, ev.x, ev.y);
+			break;
+		}
+	}
+}
+
+void DxAppBase::PublishSnapshot(float alpha)
+{
+	int64_t counter = 0;
+	GameTimer::QueryCounter(counter);
+
+	RenderSnapshot &snap = *_renderSnapshots.WriteBuffer();
+	snap.simFrame = ++mSimFrame;
+	snap.timer = _gameTimer.Snapshot();
+	snap.alpha = alpha;
+	snap.publishTime = counter * _gameTimer.SecondsPerCount();
+	snap.inputCounter = mPendingInputCounter;
+	mPendingInputCounter = 0;
+
+	ProcSceneSnapshot(snap);
+
+	_renderSnapshots.Publish();
+}
+
+
+//Threaded loop: this thread pumps messages, SimThreadProc ticks the timer and runs updates, RenderThreadProc
+//owns the device context and draws the newest snapshot. Nothing here waits on anything else per frame.
+
+int DxAppBase::RunThreaded()
+{
+	int exitCode = 0;
+
+	bQuitLoopThreads = false;
+	bLoopThreadsRunning = true;
+
+	simThread = std::thread(&DxAppBase::SimThreadProc, this);
+	renderThread = std::thread(&DxAppBase::RenderThreadProc, this);
+
+	if (bHeadless)
+	{
+		//No messages either, just wait for the frame limit or a RequestQuit (which wakes us)
+		for (;;)
+		{
+			uint32_t signal = loopSignal.load(std::memory_order_acquire);
+			if (bQuitRequested)
+				break;
+
+			LockParkOnAddress(loopSignal, signal, LOCK_WAIT_INFINITE);
+		}
+	}
+#ifdef _WIN32
+	else
+	{
+		MSG curMsg = { NULL };
+
+		//Nothing else to do on this thread, so block on messages instead of peeking
+		BOOL getResult;
+		while ((getResult = GetMessage(&curMsg, NULL, 0, 0)) != 0)
+		{
+			if (getResult == -1)
+				break;
+
+			TranslateMessage(&curMsg);
+			DispatchMessage(&curMsg);
+
+			//Nothing else queued, let the held back move go to the sim thread
+			MSG nextMsg;
+			if (!PeekMessage(&nextMsg, NULL, 0, 0, PM_NOREMOVE))
+				_inputQueue.Flush();
+		}
+
+		exitCode = (int)curMsg.wParam;
+	}
+#endif
+
+	StopLoopThreads();
+
+#ifdef _WIN32
+	//What WM_CLOSE left for us, now nothing presents to it
+	if (!bHeadless && IsWindow(handleMainWindow))
+		DestroyWindow(handleMainWindow);
+#endif
+
+	return exitCode;
+}
+
+void DxAppBase::StopLoopThreads()
+{
+	if (!bLoopThreadsRunning)
+		return;
+
+	bQuitLoopThreads = true;
+	WakeLoopThreads();
+
+	if (simThread.joinable())
+		simThread.join();
+
+	if (renderThread.joinable())
+		renderThread.join();
+
+	bLoopThreadsRunning = false;
+}
+
+void DxAppBase::SimThreadProc()
+{
+	//So ProcSceneUpdate can fan out and help with its own jobs
+	_jobSystem.RegisterCurrentThread();
+	PROFILE_THREAD_NAME("Simulation");
+
+	while (!bQuitLoopThreads)
+	{
+		if (!_gameTimer.GetIsValid())
+		{
+			//Same as the serial loop bailing out, but the window thread has to do the quitting
+			RequestQuit();
+			break;
+		}
+
+		if (bAppPaused)
+		{
+			WaitWhilePaused();
+			_simPacer.Reset();
+			continue;
+		}
+
+		PROFILE_ZONE("Sim frame");
 
+		_gameTimer.Tick();
 
+		_frameArena.BeginFrame();
+		DrainInput();
+		float alpha = StepSimulation(_gameTimer.DeltaTime());
+		_sceneTransforms.Update(&_jobSystem);
+
+		//With a fixed step there is nothing new to publish until a step ran, and nothing to do until the
+		//next one is due. The render thread extrapolates alpha on its own in between.
+		if (bFixedTimestep)
+		{
+			if (mLastStepCount > 0)
+				PublishSnapshot(alpha);
+
+			double untilNextStep = mFixedStep - mStepAccumulator;
+			if (untilNextStep > 0.002)
+				std::this_thread::sleep_for(std::chrono::microseconds((int64_t)((untilNextStep - 0.001) * 1e6)));
 		}
 		else
 		{
-			//Something went terribly wrong, game timer is not valid, bail
-			//TODO: Add SetLastError of some sort
-			return (int)curMsg.wParam;
+			PublishSnapshot(alpha);
+
+			//Capped, nothing new is needed before the next frame anyway
+			if (_simPacer.IsCapped())
+				_simPacer.Wait();
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	_jobSystem.UnregisterCurrentThread();
+}
+
+void DxAppBase::RenderThreadProc()
+{
+	//From here on the device context belongs to this thread, LockMgr/UnlockMgr in ProcSceneDraw are free
+	if (!_dxMgr.ClaimContext())
+	{
+		RequestQuit();
+		return;
+	}
+
+	_jobSystem.RegisterCurrentThread();
+	PROFILE_THREAD_NAME("Render");
+
+	double secondsPerCount = _gameTimer.SecondsPerCount();
+	int64_t lastCounter = 0;
+	double renderTime = 0.0;
+	bool bHaveSnapshot = false;
+
+	while (!bQuitLoopThreads)
+	{
+		if (bAppPaused)
+		{
+			//Don't count the pause as a frame when we come back
+			lastCounter = 0;
+			WaitWhilePaused();
+			_framePacer.Reset();
+			continue;
+		}
+
+		PROFILE_ZONE("Render frame");
+
+		//Resizes are only ever done here, at a frame boundary
+		ApplyPendingResize();
+
+		if (_renderSnapshots.Acquire())
+			bHaveSnapshot = true;
+
+		if (!bHaveSnapshot)
+		{
+			//Simulation hasn't published its first frame yet
+			std::this_thread::yield();
+			continue;
 		}
 
+		const RenderSnapshot *snap = _renderSnapshots.ReadBuffer().get();
+
+		int64_t counter = 0;
+		GameTimer::QueryCounter(counter);
+
+		if (lastCounter != 0)
+		{
+			double frameTime = (counter - lastCounter) * secondsPerCount;
+			renderTime += frameTime;
+			FrameStatUpdate(renderTime, frameTime);
+		}
+		lastCounter = counter;
+
+		float alpha = snap->alpha;
+		if (bFixedTimestep)
+		{
+			//Carry the alpha forward by however long ago the snapshot was published
+			double since = counter * secondsPerCount - snap->publishTime;
+			alpha = (float)(snap->alpha + since / mFixedStep);
+			if (alpha > 1.0f)
+				alpha = 1.0f;
+			else if (alpha < 0.0f)
+				alpha = 0.0f;
+		}
+
+		mRenderSnapshot = snap;
+		{
+			PROFILE_ZONE("ProcSceneDraw");
+			ProcSceneDraw(alpha);
+		}
+
+		//Don't draw past the limit while the window thread gets around to stopping us
+		if (FrameDrawn())
+			break;
+
+		_framePacer.Wait();
 	}
 
-	return (int)curMsg.wParam;
+	mRenderSnapshot = NULL;
+	_jobSystem.UnregisterCurrentThread();
+	_dxMgr.ReleaseContext();
+}
+
+void DxAppBase::QueueResize(int width, int height)
+{
+	++mResizesRequested;
 
+	//Latest wins, if the frame boundary hasn't come around for the previous one it never will
+	pendingResize.store(((uint64_t)(uint32_t)width << 32) | (uint32_t)height);
+}
+
+void DxAppBase::ApplyPendingResize()
+{
+	uint64_t size = pendingResize.exchange(0);
+	if (size == 0)
+		return;
+
+	UINT width = (UINT)(size >> 32);
+	UINT height = (UINT)(size & 0xFFFFFFFF);
+
+	//Back where we started (restored from minimized, dragged back, the WM_SIZE CreateSwapChain sends), the
+	//buffers are already right. Only once the mgr is up though, before that this is just its size to create with.
+	if (_dxMgr.GetCurrentState() == STATE_MGR_VIEWPORT_CREATED && width == _dxMgr.GetClientWidth() && height == _dxMgr.GetClientHeight())
+		return;
+
+	PROFILE_ZONE("ApplyPendingResize");
+
+	//Whoever calls this draws, so nobody else is using the views
+	_dxMgr.SetClientDimensions(height, width);
+	if (OnResizeHandler())
+		++mResizesPerformed;
+
+	_occlusion.Resize(_dxMgr.GetClientWidth(), _dxMgr.GetClientHeight());
+}
+
+void DxAppBase::SetFixedTimestep(bool enable, double stepHz, int maxCatchUpSteps)
+{
+	bFixedTimestep = enable;
+
+	if (stepHz > 0.0)
+		mFixedStep = 1.0 / stepHz;
+
+	mMaxCatchUpSteps = maxCatchUpSteps > 0 ? maxCatchUpSteps : 1;
+	mStepAccumulator = 0.0;
+}
+
+float DxAppBase::StepSimulation(double frameDelta)
+{
+	PROFILE_FUNCTION();
+	if (!bFixedTimestep)
+	{
+		mLastStepCount = 1;
+		ProcSceneUpdate((float)frameDelta);
+		return 1.0f;
+	}
+
+	//A frame longer than the whole catch up budget (breakpoint, drag, hitch) can't be caught up anyway
+	double maxDelta = mFixedStep * mMaxCatchUpSteps;
+	if (frameDelta > maxDelta)
+	{
+		mDroppedSimTime += frameDelta - maxDelta;
+		frameDelta = maxDelta;
+	}
+
+	mStepAccumulator += frameDelta;
+
+	int steps = 0;
+	while (mStepAccumulator >= mFixedStep && steps < mMaxCatchUpSteps)
+	{
+		ProcSceneUpdate((float)mFixedStep);
+		mStepAccumulator -= mFixedStep;
+		++steps;
+	}
+
+	//Spiral of death guard, if updates alone take longer than a step we would never catch up.
+	//Drop whole steps we didn't get to and keep the fraction for interpolation.
+	if (mStepAccumulator >= mFixedStep)
+	{
+		double keep = fmod(mStepAccumulator, mFixedStep);
+		mDroppedSimTime += mStepAccumulator - keep;
+		mStepAccumulator = keep;
+	}
+
+	mLastStepCount = steps;
+	return (float)(mStepAccumulator / mFixedStep);
 }
 
 //Initialization code goes here, then overrides can do other stuff
 bool DxAppBase::InitApp()
 {
-	if (!ProcWndInit())
+	//Keep SimulateResize from changing the client size under us (WM_SIZE only queues, it doesn't care)
+	ScopeLock<TrackedSpinMutex> lock(resizeLock, 100);
+	if (!lock.IsLocked())
 		return FALSE;
-	
-	if (!D3DInit())
+
+	//If state isn't free, we need to close it first
+	if (_dxMgr.GetCurrentState() != STATE_MGR_FREE)
+		return FALSE;
+
+	double initStartMs = _startupReport.NowMs();
+
+	_startupGraph.Reset();
+	AddStartupSteps(_startupGraph);
+	ProcStartupSteps(_startupGraph);
+
+	bool bOk = _startupGraph.Run(_jobSystem);
+	RecordStartup(initStartMs);
+
+	if (!bOk)
 		return FALSE;
 
 	//subclass would call if (!DxAppBase::InitApp()) then do their stuff on success.
@@ -149,9 +848,56 @@ bool DxAppBase::InitApp()
 	return TRUE;
 }
 
+//The device doesn't need the window, so it gets created on a worker while this thread registers the class and
+//creates the window. Everything from the swap chain on needs both and stays on this thread: DXGI sends the
+//window messages while creating the swap chain, which would never get answered with this thread waiting on it.
+//The manager still checks every step against its CurState ladder, the dependencies here follow it.
+void DxAppBase::AddStartupSteps(StartupGraph &graph)
+{
+	startupWindowStep = STARTUP_INVALID_STEP;
+	if (!bHeadless)
+		startupWindowStep = graph.AddStep("window", [this]() { return ProcWndInit(); }, true);
+
+	startupDeviceStep = graph.AddStep("device", [this]()
+	{
+		//Everything in memory, no window needed
+		if (bHeadless && _dxMgr.DeviceType() != RENDER_DEVICE_NULL && !_dxMgr.SetDevice(new NullRenderDevice()))
+			return false;
+
+		return SUCCEEDED(_dxMgr.CreateDeviceAndContext()) && SUCCEEDED(_dxMgr.Check4xMSAASupport());
+	});
+
+	int swapChain = graph.AddStep("swap chain", [this]()
+	{
+		if (FAILED(_dxMgr.DescribeSwapChain(bEnforce4xMSAA, bFullScreen, mClientWidth, mClientHeight, handleMainWindow)))
+			return false;
+
+		return SUCCEEDED(_dxMgr.CreateSwapChain());
+	}, true, { startupDeviceStep });
+
+	if (startupWindowStep != STARTUP_INVALID_STEP)
+		graph.AddDependency(swapChain, startupWindowStep);
+
+	int backBuffer = graph.AddStep("back buffer view", [this]() { return SUCCEEDED(_dxMgr.CreateRenderTargetView()); }, true, { swapChain });
+	int depth = graph.AddStep("depth/stencil", [this]() { return SUCCEEDED(_dxMgr.CreateDepthStencilBufferAndView()); }, true, { backBuffer });
+
+	startupReadyStep = graph.AddStep("bind views, viewport", [this]()
+	{
+		if (FAILED(_dxMgr.BindBackBufferAndDepthBufferViewsToOutput()) || FAILED(_dxMgr.SetDefaultViewport()))
+			return false;
+
+		_occlusion.Resize(_dxMgr.GetClientWidth(), _dxMgr.GetClientHeight());
+		return true;
+	}, true, { depth });
+}
+
 //Create the window
 bool DxAppBase::ProcWndInit()
 {
+#ifndef _WIN32
+	//Nothing to create one with, headless only
+	return false;
+#else
 	WNDCLASS wc;
 	wc.style = CS_HREDRAW | CS_VREDRAW;
 	wc.lpfnWndProc = AppWndProc;
@@ -194,93 +940,80 @@ bool DxAppBase::ProcWndInit()
 	UpdateWindow(handleMainWindow);
 
 	return true;
+#endif
 }
 
-bool DxAppBase::D3DInit()
+//Window resize handler - have this call something in dxmgr so i dont have to mess around with
+//poking at private data members and locking
+bool DxAppBase::OnResizeHandler()
 {
-	//We need to ignore any resize messages while in this function
-	if (WaitForSingleObject(resizeLock, 100))
-		return false;
 
-	//If state isn't free, we need to close it first
-	if (_dxMgr.GetCurrentState() != STATE_MGR_FREE)
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
+	//Only called from ApplyPendingResize, at a frame boundary on the thread that draws, with the new size
+	//already set on the mgr.
 
-	if (FAILED(_dxMgr.CreateDeviceAndContext()))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
+	//The mgr will either be free, or completely initialized.
+	return _dxMgr.ResizeHandler();
 
-	if (FAILED(_dxMgr.Check4xMSAASupport()))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
+}
 
-	if (FAILED(_dxMgr.DescribeSwapChain(bEnforce4xMSAA, bFullScreen, mClientWidth, mClientHeight, handleMainWindow)))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
 
-	if (FAILED(_dxMgr.CreateSwapChain()))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
 
-	if (FAILED(_dxMgr.CreateRenderTargetView()))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
 
-	if (FAILED(_dxMgr.CreateDepthStencilBufferAndView()))
-	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
+#ifdef _WIN32
 
-	if (FAILED(_dxMgr.BindBackBufferAndDepthBufferViewsToOutput()))
-	{
-		ReleaseMutex(resizeLock);
+//Pause/minimize/maximize bookkeeping for WM_SIZE. Returns true if the swap chain and depth buffer need resizing.
+bool DxAppBase::UpdateSizeFlags(WPARAM sizeType)
+{
+	//Nothing to resize until D3DInit has created the device
+	if (_dxMgr.GetCurrentState() < STATE_MGR_INIT)
 		return false;
-	}
 
-	if (FAILED(_dxMgr.SetDefaultViewport()))
+	if (sizeType == SIZE_MINIMIZED)
 	{
-		ReleaseMutex(resizeLock);
-		return false;
-	}
 
-	if (!ReleaseMutex(resizeLock))
-		return false;
-	else
+		SetPaused(true);
+		bAppMinimized = true;
+		bAppMaximized = false;
+	}
+	else if (sizeType == SIZE_MAXIMIZED)
+	{
+		SetPaused(false);
+		bAppMinimized = false;
+		bAppMaximized = true;
 		return true;
-}
-
-
-
-//Window resize handler - have this call something in dxmgr so i dont have to mess around with
-//poking at private data members and locking
-bool DxAppBase::OnResizeHandler()
-{
-
-	//We could potentially get resize messages from the message pump before we have finished intializing everything.
-	//However, we will make access to this interface BEFORE the intialization is done, single threaded only.
+	}
+	else if (sizeType == SIZE_RESTORED)
+	{
 
-	//Therefore it will either be free, or completely initialized.
-	return _dxMgr.ResizeHandler();
+		if (bAppMinimized)
+		{
+			//restore from minimized
+			SetPaused(false);
+			bAppMinimized = false;
+			return true;
+		}
+		else if (bAppMaximized)
+		{
+			SetPaused(false);
+			bAppMaximized = false;
+			return true;
+		}
+		else if (bIsResizing)
+		{
+			//Still dragging size bar around, WM_EXITSIZEMOVE does the resize.
+			return false;
+		}
+		else
+		{
+			return true;
+		}
+	}
 
+	return false;
 }
 
 
 
-
 //Windows message pump dispatcher/handler, mostly from Frank Luna's code with a few modifications
 LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
@@ -293,12 +1026,12 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	{
 		if (LOWORD(wParam) == WA_INACTIVE)
 		{
-			bAppPaused = true;
+			SetPaused(true);
 			_gameTimer.Stop();
 		}
 		else
 		{
-			bAppPaused = false;
+			SetPaused(false);
 			_gameTimer.Start();
 		}
 		return 0;
@@ -308,77 +1041,14 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	//Size of window changed
 	case WM_SIZE:
 	{
-		DWORD waitResult = 0;
-		if ( (waitResult = WaitForSingleObject(resizeLock, 50)) == WAIT_TIMEOUT)
-		{
-			//We are already handling a resize or starting the app up right now, perhaps later launch a new thread which waits
-			//until the current task is done then processes the new size.
-			return -WAIT_TIMEOUT;
-		}
-		else if (waitResult != 0)
-		{
-			return (LONG_PTR)-waitResult;
-		}
-
+		//Only bookkeeping here, the buffers get resized at the next frame boundary (by the render thread in the
+		//threaded loop). No lock to wait on, this can come from inside D3DInit (CreateSwapChain sends WM_SIZE), and
+		//a burst of them (maximize, live resize) just keeps overwriting the pending size, nothing gets dropped.
 		mClientWidth = LOWORD(lParam);
 		mClientHeight = HIWORD(lParam);
 
-		//At this point we will either have our dxmgr in the FREE state, or it will be completely initalized.
-		_dxMgr.LockMgr();
-
-		//Update our dxMgr's height and width
-		_dxMgr.SetClientDimensions(mClientHeight, mClientWidth);
-
-		if (_dxMgr.CurrentDevice())
-		{
-
-			if (wParam == SIZE_MINIMIZED)
-			{
-
-				bAppPaused = true;
-				bAppMinimized = true;
-				bAppMaximized = false;
-			}
-			else if (wParam == SIZE_MAXIMIZED)
-			{
-				bAppPaused = false;
-				bAppMinimized = false;
-				bAppMaximized = true;
-				_dxMgr.UnlockMgr();
-				_dxMgr.ResizeHandler();
-			}
-			else if (wParam == SIZE_RESTORED)
-			{
-
-				if (bAppMinimized)
-				{
-					//restore from minimized
-					bAppPaused = false;
-					bAppMinimized = false;
-					_dxMgr.UnlockMgr();
-					_dxMgr.ResizeHandler();
-				}
-				else if (bAppMaximized)
-				{
-					bAppPaused = false;
-					bAppMaximized = false;
-					_dxMgr.UnlockMgr();
-					_dxMgr.ResizeHandler();
-				}
-				else if (bIsResizing)
-				{
-					//Still dragging size bar around...
-
-
-
-				}
-				else
-				{
-					_dxMgr.UnlockMgr();
-					_dxMgr.ResizeHandler();
-				}
-			}
-		}
+		if (UpdateSizeFlags(wParam))
+			QueueResize(mClientWidth, mClientHeight);
 
 		return 0;
 
@@ -387,7 +1057,7 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	//WM_ENTERSIZEMOVE - user grabs resize bar
 	case WM_ENTERSIZEMOVE:
 	{
-		bAppPaused = true;
+		SetPaused(true);
 		bIsResizing = true;
 		_gameTimer.Stop();
 		return 0;
@@ -396,15 +1066,38 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 	//WM_EXITSIZEMOVE - user releases resize bar
 	case WM_EXITSIZEMOVE:
 	{
-		bAppPaused = false;
+		SetPaused(false);
 		bIsResizing = false;
 		_gameTimer.Start();
-		_dxMgr.UnlockMgr();
-		_dxMgr.ResizeHandler();
+
+		QueueResize(mClientWidth, mClientHeight);
 		return 0;
 
 	}
 
+	case WM_CLOSE:
+	{
+		//Threaded, the window has to outlive the render thread presenting to it, but joining it from in here
+		//can deadlock (Present or a mgr retry waiting on this thread to pump). So just tell the loop threads
+		//to stop and leave the message loop, RunThreaded joins them and then destroys the window.
+		if (bLoopThreadsRunning)
+		{
+			bQuitLoopThreads = true;
+			WakeLoopThreads();
+			PostQuitMessage(0);
+			return 0;
+		}
+		break;
+	}
+
+	//Render thread has a new caption for us
+	case WM_DXAPP_CAPTION:
+	{
+		ScopeLock<TrackedSpinMutex> lock(captionLock);
+		SetWindowText(hwnd, captionBuffer);
+		return 0;
+	}
+
 	case WM_DESTROY:
 	{
 		PostQuitMessage(0);
@@ -425,19 +1118,29 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 		return 0;
 	}
 
+	//Mouse input is only queued here, the simulation gets it at the top of its next frame (ProcInput)
 	case WM_LBUTTONDOWN:
+		_inputQueue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_LEFT, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		return 0;
 	case WM_MBUTTONDOWN:
+		_inputQueue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_MIDDLE, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		return 0;
 	case WM_RBUTTONDOWN:
-		HandleMouseDown(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		_inputQueue.Push(INPUT_MOUSE_DOWN, INPUT_BUTTON_RIGHT, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 
 	case WM_LBUTTONUP:
+		_inputQueue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_LEFT, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		return 0;
 	case WM_MBUTTONUP:
+		_inputQueue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_MIDDLE, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		return 0;
 	case WM_RBUTTONUP:
-		HandleMouseUp(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		_inputQueue.Push(INPUT_MOUSE_UP, INPUT_BUTTON_RIGHT, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
+
 	case WM_MOUSEMOVE:
-		HandleMouseMove(wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+		_inputQueue.Push(INPUT_MOUSE_MOVE, INPUT_BUTTON_NONE, (uint32_t)wParam, GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
 		return 0;
 
 	}
@@ -446,36 +1149,46 @@ LRESULT DxAppBase::WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
 }
 
+#endif
 
 
-//Direct from Frank Luna's code w/ some additions to account for unicode/ansi
 
-void DxAppBase::FrameStatUpdate()
-{
-	// Code computes the average frames per second, and also the 
-	// average time it takes to render one frame.  These stats 
-	// are appended to the window caption bar.
+//Started from Frank Luna's code. Stats now live in _frameStats, the caption just reads them once a second
+//and is formatted into a fixed buffer so there are no allocations per frame.
 
-	static int frameCnt = 0;
-	static float timeElapsed = 0.0f;
+void DxAppBase::FrameStatUpdate(double totalTime, double frameTime)
+{
+	PROFILE_FUNCTION();
+	_frameStats.AddFrame(totalTime, frameTime);
 
-	frameCnt++;
+	if (totalTime < mNextCaptionUpdate)
+		return;
 
-	// Compute averages over one second period.
-	if ((_gameTimer.TotalTime() - timeElapsed) >= 1.0f)
+	FrameStatsSummary summary;
+	if (_frameStats.Query(FRAMESTATS_WINDOW_1S, summary))
 	{
-		float fps = (float)frameCnt; // fps = frameCnt / 1
-		float mspf = 1000.0f / fps;
+		ScopeLock<TrackedSpinMutex> lock(captionLock);
 
-		std::wostringstream outs;
-		outs.precision(6);
-		outs << strMainWindowCaption << _T("    ")
-			<< _T("FPS: ") << fps << _T("    ")
-			<< _T("Frame Time: ") << mspf << _T(" (ms)");
-		SetWindowText(handleMainWindow, outs.str().c_str());
+#ifdef _WIN32
+		_sntprintf_s(captionBuffer, _countof(captionBuffer), _TRUNCATE, DXAPP_CAPTION_FORMAT,
+			strMainWindowCaption.c_str(), summary.avgFps, summary.avgMs, summary.p99Ms, summary.maxMs, summary.hitchCount);
 
-		// Reset for next average.
-		frameCnt = 0;
-		timeElapsed += 1.0f;
+		//SetWindowText from another thread would block on the window thread, which may be waiting to join us
+		if (!bHeadless)
+		{
+			if (bLoopThreadsRunning)
+				PostMessage(handleMainWindow, WM_DXAPP_CAPTION, 0, 0);
+			else
+				SetWindowText(handleMainWindow, captionBuffer);
+		}
+#else
+		snprintf(captionBuffer, sizeof(captionBuffer), DXAPP_CAPTION_FORMAT,
+			strMainWindowCaption.c_str(), summary.avgFps, summary.avgMs, summary.p99Ms, summary.maxMs, summary.hitchCount);
+#endif
 	}
-}
\ No newline at end of file
+
+	//Skip ahead rather than catching up if we were stalled for more than a second
+	mNextCaptionUpdate += 1.0;
+	if (mNextCaptionUpdate <= totalTime)
+		mNextCaptionUpdate = totalTime + 1.0;
+}
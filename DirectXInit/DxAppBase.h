@@ -21,9 +21,52 @@ Parts inspired by/adapted from Frank D. Lunas' excellent book "Intro to 3D Game
 */
 
 #include "InitManager.h"
-#include <tchar.h>
+#include "GameTimer.h"
+#include "FrameStats.h"
+#include "Locks.h"
+#include "LockStats.h"
+#include "TripleBuffer.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "StartupGraph.h"
+#include "StartupReport.h"
+#include "InputQueue.h"
+#include "FramePacer.h"
+#include "RenderCommands.h"
+#include "SceneTransforms.h"
+#include "EntityStore.h"
+#include "FrustumCull.h"
+#include "OcclusionCull.h"
+#include "SceneBvh.h"
+#include "Platform.h"
 #include <string>
-#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+
+#ifdef _WIN32
+//Posted to the window by the render thread when it has a new caption for us (threaded loop only)
+const UINT WM_DXAPP_CAPTION = WM_APP + 1;
+#endif
+
+
+//What the simulation hands to rendering each frame. Derive from this for app state the draw needs
+//(transforms, camera, ...), create it in CreateRenderSnapshot and fill it in ProcSceneSnapshot.
+//In the threaded loop three of these rotate through a TripleBuffer, so ProcSceneDraw must only read
+//CurrentRenderSnapshot() and never simulation state directly.
+
+struct RenderSnapshot
+{
+	RenderSnapshot() : simFrame(0), alpha(1.0f), publishTime(0.0), inputCounter(0) { timer.totalTime = 0.0; timer.deltaTime = 0.0; timer.paused = false; }
+	virtual ~RenderSnapshot() { }
+
+	uint64_t	  simFrame;		//Number of the simulation frame that produced it
+	TimerSnapshot timer;		//Timer right after that frame's update
+	float		  alpha;		//Fixed step interpolation alpha at the time it was published
+	double		  publishTime;	//Raw counter time in seconds when it was published
+	int64_t		  inputCounter;	//Earliest input handled by the simulation frames behind it (GameTimer counter), 0 if none
+};
 
 
 //provides abstract base class with window and d3d init stuff taken care of.
@@ -39,15 +82,136 @@ public:
 	HWND	  ProcWnd()		 const;
 	float	  CurAspectRatio() const;
 
+	//Culling frustum for a camera with this view matrix, shaped like the current viewport (the window's
+	//aspect ratio before there is one, square headless)
+	Frustum	  CameraFrustum(const Mat4 &view, float fovY, float zNear, float zFar) const;
+
+	//World space ray through client pixel (x, y) (HandleMouseDown's coordinates) for the same camera, to
+	//Raycast a SceneBvh with. direction isn't normalized, it reaches view space z = 1. False with no window.
+	bool	  CameraPickRay(const Mat4 &view, float fovY, int x, int y, Float3 &origin, Float3 &direction) const;
+
+	//Frame time stats (percentiles, histogram, hitches), read from the thread running frames
+	inline const FrameStats& GetFrameStats() const { return _frameStats; };
+
+	//Worker pool for fanning out update work (ParallelFor etc). Started with the app, one worker per core
+	//besides the main thread. The main thread and, in the threaded loop, the sim/render threads are registered.
+	inline JobSystem& Jobs() { return _jobSystem; };
+
+	//Transient memory for the frame, from the update and the jobs it sends out (FrameAllocator/FrameVector
+	//for containers). Starts a new frame at the top of every frame, or every simulation frame in the threaded
+	//loop, where the render thread should not allocate from it. Call Init on it before Run to resize.
+	inline FrameArena& FrameMemory() { return _frameArena; };
+
+	//Mouse input on its way from the window to the simulation, drained once per frame into ProcInput. Fed by
+	//WndMsgProc; headless, Push from one thread and Flush after (the serial loop flushes every frame).
+	inline InputQueue& InputEvents() { return _inputQueue; };
+
+	//The scene's transform hierarchy. Set locals from ProcSceneUpdate, world matrices are brought up to date
+	//after the frame's updates (all of them, in fixed step mode) and before ProcSceneSnapshot. Simulation thread only.
+	inline SceneTransforms& Transforms() { return _sceneTransforms; };
+
+	//Game object storage for ProcSceneUpdate, see EntityStore. ParallelForEachChunk with Jobs() to spread an
+	//update over the workers. Simulation thread only, the base never touches it.
+	inline EntityStore& Entities() { return _entities; };
+
+	//Software occlusion culling for the draw side: Begin with the frame's camera, AddOccluder, Rasterize (over
+	//Jobs()), then TestList what the frustum culler left before recording draws. Kept sized from the client
+	//area by the base, on the thread that draws.
+	inline OcclusionCuller& Occlusion() { return _occlusion; };
+
+	//Input to photon: earliest input behind each new snapshot until that snapshot was first presented, as
+	//"frames" in seconds. Same thread rules as GetFrameStats.
+	inline const FrameStats& GetInputLatencyStats() const { return _inputLatency; };
+
 	int		  Run();
 
+	//No window and a NullRenderDevice (set before InitApp). Run then just runs frames, there are no messages
+	//to pump, until the frame limit or RequestQuit. For benchmarks/regression runs, and the only way to run
+	//off Windows.
+	inline void SetHeadless(bool enable) { bHeadless = enable; };
+	inline bool IsHeadless() const { return bHeadless; };
+
+	//Run returns after this many frames were drawn, 0 (default) for no limit
+	inline void SetFrameLimit(uint64_t frames) { mFrameLimit = frames; };
+	inline uint64_t FramesDrawn() const { return mFramesDrawn; };
+
+	//End Run from any thread. Headless it stops after the current frame, otherwise the window gets closed.
+	void RequestQuit();
+
+	//Same as the window being resized to this client size (headless runs have no WM_SIZE)
+	void SimulateResize(int width, int height);
+
+	//Same as the window being deactivated/reactivated
+	void SimulatePause(bool paused);
+
+	//Profile the next frames (zones from Profiler.h, every thread) and write them as a Chrome trace when
+	//done, NULL to write nothing and ProfilerWriteChromeTrace yourself
+	void CaptureProfile(uint32_t frames, const char *tracePath = NULL);
+
+	//Cap the frame rate, 0 (default) for none. Whoever presents waits out the rest of each frame (mostly
+	//sleeping), in the threaded loop the simulation is held to the same rate. Set before Run.
+	void SetFrameRateLimit(double fps);
+
+	//The presenting thread's pacer, for its pacing error stats. Same thread rules as GetFrameStats.
+	inline const FramePacer& Pacing() const { return _framePacer; };
+
+	//Resizes asked for (WM_SIZE, WM_EXITSIZEMOVE, SimulateResize) vs swap chain resizes actually done. They are
+	//applied at the next frame boundary, latest size wins, so a storm of requests ends in one resize.
+	inline uint64_t ResizesRequested() const { return mResizesRequested; };
+	inline uint64_t ResizesPerformed() const { return mResizesPerformed; };
+
 
 	virtual bool InitApp();
 	virtual bool OnResizeHandler();
+
+	//What InitApp ran and how long each step took, valid once it returned
+	inline const StartupGraph& Startup() const { return _startupGraph; };
+
+	//Construction to first frame: the startup graph's steps, every DirectXManager init call, the rest of InitApp
+	//and the first frame. Complete once a frame was drawn (IsFinished), which is also when it is printed/written
+	//if asked to here. Paths are copied, NULL for none.
+	inline const StartupReport& StartupTimes() const { return _startupReport; };
+	void SetStartupReportOutput(bool bConsole, const char *textPath = NULL, const char *jsonPath = NULL);
+
+	//Add app steps to the startup graph (asset loading, shader warmup, ...), they run alongside the base init
+	//on the job system unless marked main thread. Depend on startupDeviceStep for anything that needs the
+	//device, startupReadyStep for the whole thing; AddDependency(startupReadyStep, yours) holds the first
+	//frame back until yours is done.
+	virtual void ProcStartupSteps(StartupGraph &graph) { }
+
+	//In variable step mode (default) ProcSceneUpdate is called once per frame with the frame delta and
+	//_alpha is always 1. In fixed step mode it is called zero or more times per frame with the fixed step,
+	//and _alpha in [0,1) is how far we are between the last two simulation states, for interpolating.
 	virtual void ProcSceneUpdate(float _dt) = 0;
-	virtual void ProcSceneDraw() = 0;
+	virtual void ProcSceneDraw(float _alpha) = 0;
+
+	//Snapshot hooks, see RenderSnapshot. ProcSceneSnapshot runs right after the frame's updates, on the simulation thread.
+	virtual RenderSnapshot* CreateRenderSnapshot() { return new RenderSnapshot(); }
+	virtual void ProcSceneSnapshot(RenderSnapshot &_out) { }
 
+	//Valid inside ProcSceneDraw, the snapshot being drawn
+	inline const RenderSnapshot* CurrentRenderSnapshot() const { return mRenderSnapshot; };
+
+	//Run simulation and rendering on their own threads (set before Run). The thread calling Run only pumps
+	//window messages, the render thread claims the device context for as long as it runs.
+	inline void SetThreadedLoop(bool enable) { bThreadedLoop = enable; };
+	inline bool IsThreadedLoop() const { return bThreadedLoop; };
+
+	//Run the simulation at a fixed rate. maxCatchUpSteps limits updates per frame, if we fall further behind
+	//than that the extra time is dropped (counted in DroppedSimTime) instead of spiraling.
+	void SetFixedTimestep(bool enable, double stepHz = 60.0, int maxCatchUpSteps = 5);
+	inline bool   IsFixedTimestep() const { return bFixedTimestep; };
+	inline double FixedStepSeconds() const { return mFixedStep; };
+	inline int    LastFrameStepCount() const { return mLastStepCount; };
+	inline double DroppedSimTime() const { return mDroppedSimTime; };
+
+#ifdef _WIN32
 	virtual LRESULT WndMsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+#endif
+
+	//The frame's input in arrival order, right before its updates, on the simulation thread. Default hands
+	//each event to the HandleMouse overrides below.
+	virtual void ProcInput(const InputEvent *events, uint32_t count);
 
 	//Overrides for mouse input
 	virtual void HandleMouseDown(WPARAM bState, int x, int y) { }
@@ -58,30 +222,155 @@ public:
 protected:
 
 	bool ProcWndInit();
-	bool D3DInit();
-	void FrameStatUpdate();
+
+	//Client area rectangle the camera draws into (viewport, else the whole window), false if neither exists
+	bool CameraRect(float &left, float &top, float &width, float &height) const;
+
+	//Window and device/swap chain/views steps, see InitApp
+	void AddStartupSteps(StartupGraph &graph);
+
+	//totalTime/frameTime in seconds, of whichever thread is presenting frames
+	void FrameStatUpdate(double totalTime, double frameTime);
+
+	//Runs ProcSceneUpdate for this frame's delta (once, or in fixed steps), returns the draw alpha
+	float StepSimulation(double frameDelta);
+
+	//Fill and publish the write side snapshot after a simulation frame
+	void PublishSnapshot(float alpha);
+
+	//Everything the window pushed since last time, into ProcInput
+	void DrainInput();
+
+	//Pausing: SetPaused wakes whoever waits in WaitWhilePaused when it unpauses. WaitWhilePaused blocks a
+	//loop thread until unpaused or quitting, WakeLoopThreads makes every waiter look again.
+	void SetPaused(bool paused);
+	void WaitWhilePaused();
+	void WakeLoopThreads();
+
+	//Threaded loop
+	int  RunThreaded();
+	void SimThreadProc();
+	void RenderThreadProc();
+	void StopLoopThreads();
+
+	//Resizes go through here in both loops, applied by whoever draws
+	void QueueResize(int width, int height);
+	void ApplyPendingResize();
+
+#ifdef _WIN32
+	//Updates paused/minimized/maximized for a WM_SIZE, returns true if the buffers need resizing
+	bool UpdateSizeFlags(WPARAM sizeType);
+#endif
+
+	//Frame limit bookkeeping after each draw, true when this was the last one
+	bool FrameDrawn();
+
+	//Adds InitApp's graph steps and mgr calls to the report, and finishes it after the first frame
+	void RecordStartup(double initStartMs);
+	void FinishStartupReport();
 
 protected:
 
 
 	HINSTANCE handleAppInstance;
 	HWND	  handleMainWindow;
-	bool	  bAppPaused;
+	std::atomic<bool> bAppPaused;
 	bool	  bAppMinimized;
 	bool	  bAppMaximized;
 	bool      bIsResizing;
 	bool      bEnforce4xMSAA;
 	bool	  bFullScreen;
 
-	HANDLE    resizeLock;
+	//"BASE_LOCK" in the lock report
+	TrackedSpinMutex resizeLock;
 
 
 	DirectXManager _dxMgr;
+
+	//Draw through this rather than the device context: record into it in ProcSceneDraw, then Submit into
+	//_dxMgr.Context() (on D3D11 register objects with CurrentD3D11Device()->RenderContext() to get the ids
+	//commands use)
+	RenderCommandList  _renderCommands;
+
 	GameTimer	   _gameTimer;
+	FrameStats	   _frameStats;
+	JobSystem	   _jobSystem;
+	FrameArena	   _frameArena;
+	SceneTransforms _sceneTransforms;
+	EntityStore	   _entities;
+	OcclusionCuller _occlusion;
+
+	//Init steps, kept for their timings. Ids of the base steps, for ProcStartupSteps to depend on
+	//(startupWindowStep is STARTUP_INVALID_STEP headless).
+	StartupGraph   _startupGraph;
+	int			   startupWindowStep;
+	int			   startupDeviceStep;
+	int			   startupReadyStep;
+
+	//Input from the window thread, the batch it is drained into, and the earliest input not yet published
+	//in a snapshot. _inputLatency and mLastLatencyFrame belong to whoever presents.
+	InputQueue	   _inputQueue;
+	std::vector<InputEvent> inputBatch;
+	int64_t		   mPendingInputCounter;
+	FrameStats	   _inputLatency;
+	uint64_t	   mLastLatencyFrame;
+
+	StartupReport  _startupReport;
+	double		   mInitEndMs;
+	double		   mRunStartMs;
+	bool		   bStartupConsole;
+	std::string	   startupTextPath;
+	std::string	   startupJsonPath;
+
+	std::string	   profileTracePath;
+
+	//Next time (timer total time) the caption gets refreshed, and the buffer it is formatted into.
+	//captionLock only matters in the threaded loop, where the render thread formats and the window thread sets it.
+	double	  mNextCaptionUpdate;
+	TCHAR	  captionBuffer[256];
+	TrackedSpinMutex captionLock;
 
 	int mClientWidth;
 	int mClientHeight;
 
+	//Fixed step simulation
+	bool	  bFixedTimestep;
+	double	  mFixedStep;
+	int		  mMaxCatchUpSteps;
+	double	  mStepAccumulator;
+	double	  mDroppedSimTime;
+	int		  mLastStepCount;
+
+	//Snapshots handed from simulation to rendering, and the one being drawn
+	TripleBuffer<std::unique_ptr<RenderSnapshot> > _renderSnapshots;
+	const RenderSnapshot *mRenderSnapshot;
+	uint64_t  mSimFrame;
+
+	//Threaded loop
+	bool	  bThreadedLoop;
+	std::atomic<bool> bLoopThreadsRunning;
+	std::atomic<bool> bQuitLoopThreads;
+	std::thread simThread;
+	std::thread renderThread;
+
+	//Latest size to resize to at the next frame boundary, 0 if none. (width << 32) | height
+	std::atomic<uint64_t> pendingResize;
+	std::atomic<uint64_t> mResizesRequested;
+	std::atomic<uint64_t> mResizesPerformed;
+
+	//Bumped whenever a blocked loop thread should look again (unpause, quit), they park on it
+	std::atomic<uint32_t> loopSignal;
+
+	//Frame rate cap: the presenting thread's pacer, and the sim thread's in the threaded loop
+	FramePacer _framePacer;
+	FramePacer _simPacer;
+
+	//Headless runs / frame limit
+	bool	  bHeadless;
+	uint64_t  mFrameLimit;
+	uint64_t  mFramesDrawn;
+	std::atomic<bool> bQuitRequested;
+
 #ifdef UNICODE
 	std::wstring strMainWindowCaption;
 #else
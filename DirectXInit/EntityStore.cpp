@@ -0,0 +1,519 @@
+#include "stdafx.h"
+
+#include "EntityStore.h"
+#include "Platform.h"
+#include "Profiler.h"
+#include <assert.h>
+#include <atomic>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Generation of the placeholder entities command buffers hand out, real ones never get it
+static const uint32_t ENTITY_PENDING_GENERATION = 0xFFFFFFFF;
+
+static ComponentInfo componentInfos[ENTITY_MAX_COMPONENTS];
+static std::atomic<uint32_t> componentTypeCount(0);
+
+
+ComponentType RegisterComponentType(uint32_t size, uint32_t align)
+{
+	ComponentType type = componentTypeCount.fetch_add(1);
+	assert(type < (ComponentType)ENTITY_MAX_COMPONENTS && "out of component types, raise ENTITY_MAX_COMPONENTS");
+
+	componentInfos[type].size = size;
+	componentInfos[type].align = align;
+	return type;
+}
+
+const ComponentInfo& GetComponentInfo(ComponentType type)
+{
+	return componentInfos[type];
+}
+
+
+static inline uint32_t AlignUp(uint32_t value, uint32_t align)
+{
+	return (value + align - 1) & ~(align - 1);
+}
+
+//Lay out the arrays for capacity entities, returns the bytes it takes
+static uint32_t LayoutChunk(Archetype &archetype, uint32_t capacity)
+{
+	uint32_t offset = ENTITY_CHUNK_ALIGN + AlignUp(capacity * (uint32_t)sizeof(Entity), ENTITY_CHUNK_ALIGN);
+	for (size_t i = 0; i < archetype.types.size(); ++i)
+	{
+		const ComponentInfo &info = GetComponentInfo(archetype.types[i]);
+		offset = AlignUp(offset, info.align > ENTITY_CHUNK_ALIGN ? info.align : ENTITY_CHUNK_ALIGN);
+		archetype.offsets[archetype.types[i]] = offset;
+		offset += capacity * info.size;
+	}
+
+	return offset;
+}
+
+
+EntityStore::EntityStore()
+	: entityCount(0), iterating(0)
+{
+}
+
+EntityStore::~EntityStore()
+{
+	Clear();
+
+	for (size_t i = 0; i < threadCommands.size(); ++i)
+		delete threadCommands[i];
+}
+
+void EntityStore::Clear()
+{
+	if (iterating)
+		return;
+
+	for (size_t a = 0; a < archetypes.size(); ++a)
+	{
+		for (size_t c = 0; c < archetypes[a]->chunks.size(); ++c)
+			AlignedFree(archetypes[a]->chunks[c]);
+		delete archetypes[a];
+	}
+
+	for (size_t i = 0; i < freeChunks.size(); ++i)
+		AlignedFree(freeChunks[i]);
+
+	archetypes.clear();
+	archetypeByMask.clear();
+	freeChunks.clear();
+	records.clear();
+	freeRecords.clear();
+	entityCount = 0;
+}
+
+uint32_t EntityStore::ChunkCount() const
+{
+	uint32_t count = 0;
+	for (size_t a = 0; a < archetypes.size(); ++a)
+		count += (uint32_t)archetypes[a]->chunks.size();
+	return count;
+}
+
+
+Archetype* EntityStore::GetArchetype(ComponentMask mask)
+{
+	std::unordered_map<ComponentMask, Archetype*>::iterator it = archetypeByMask.find(mask);
+	if (it != archetypeByMask.end())
+		return it->second;
+
+	Archetype *archetype = new Archetype();
+	archetype->mask = mask;
+	archetype->entityCount = 0;
+	memset(archetype->offsets, 0, sizeof(archetype->offsets));
+	for (ComponentType type = 0; type < (ComponentType)ENTITY_MAX_COMPONENTS; ++type)
+		if (mask & ComponentBit(type))
+			archetype->types.push_back(type);
+
+	//Bytes per entity ignoring padding is an upper bound, then back off until the padding fits too
+	uint32_t bytesPerEntity = (uint32_t)sizeof(Entity);
+	for (size_t i = 0; i < archetype->types.size(); ++i)
+		bytesPerEntity += GetComponentInfo(archetype->types[i]).size;
+
+	uint32_t capacity = (ENTITY_CHUNK_BYTES - ENTITY_CHUNK_ALIGN) / bytesPerEntity;
+	while (capacity > 0 && LayoutChunk(*archetype, capacity) > ENTITY_CHUNK_BYTES)
+		--capacity;
+
+	//One entity's components have to fit in a chunk
+	if (capacity == 0)
+	{
+		delete archetype;
+		return NULL;
+	}
+
+	archetype->capacity = capacity;
+	archetypes.push_back(archetype);
+	archetypeByMask[mask] = archetype;
+	return archetype;
+}
+
+EntityChunk* EntityStore::AllocChunk(Archetype &archetype)
+{
+	void *mem;
+	if (!freeChunks.empty())
+	{
+		mem = freeChunks.back();
+		freeChunks.pop_back();
+	}
+	else
+	{
+		mem = AlignedAlloc(ENTITY_CHUNK_BYTES, ENTITY_CHUNK_ALIGN);
+	}
+
+	EntityChunk *chunk = static_cast<EntityChunk*>(mem);
+	chunk->archetype = &archetype;
+	chunk->count = 0;
+	chunk->chunkIndex = (uint32_t)archetype.chunks.size();
+	archetype.chunks.push_back(chunk);
+	return chunk;
+}
+
+void EntityStore::FreeChunk(EntityChunk *chunk)
+{
+	freeChunks.push_back(chunk);
+}
+
+void EntityStore::AllocRow(Archetype &archetype, EntityChunk *&chunk, uint32_t &row)
+{
+	chunk = archetype.chunks.empty() ? NULL : archetype.chunks.back();
+	if (!chunk || chunk->count == archetype.capacity)
+		chunk = AllocChunk(archetype);
+
+	row = chunk->count++;
+	++archetype.entityCount;
+
+	uint8_t *base = reinterpret_cast<uint8_t*>(chunk);
+	for (size_t i = 0; i < archetype.types.size(); ++i)
+	{
+		uint32_t size = GetComponentInfo(archetype.types[i]).size;
+		memset(base + archetype.offsets[archetype.types[i]] + row * size, 0, size);
+	}
+}
+
+void EntityStore::RemoveRow(EntityChunk *chunk, uint32_t row)
+{
+	Archetype &archetype = *chunk->archetype;
+	EntityChunk *last = archetype.chunks.back();
+	uint32_t lastRow = last->count - 1;
+
+	if (last != chunk || lastRow != row)
+	{
+		uint8_t *to = reinterpret_cast<uint8_t*>(chunk);
+		const uint8_t *from = reinterpret_cast<const uint8_t*>(last);
+		for (size_t i = 0; i < archetype.types.size(); ++i)
+		{
+			uint32_t offset = archetype.offsets[archetype.types[i]];
+			uint32_t size = GetComponentInfo(archetype.types[i]).size;
+			memcpy(to + offset + row * size, from + offset + lastRow * size, size);
+		}
+
+		Entity moved = last->Entities()[lastRow];
+		chunk->MutableEntities()[row] = moved;
+		records[moved.index].chunk = chunk;
+		records[moved.index].row = row;
+	}
+
+	--last->count;
+	--archetype.entityCount;
+	if (last->count == 0)
+	{
+		archetype.chunks.pop_back();
+		FreeChunk(last);
+	}
+}
+
+void EntityStore::MoveEntity(uint32_t index, Archetype &to)
+{
+	EntityRecord &record = records[index];
+	EntityChunk *fromChunk = record.chunk;
+	uint32_t fromRow = record.row;
+	const Archetype &from = *fromChunk->archetype;
+
+	EntityChunk *toChunk;
+	uint32_t toRow;
+	AllocRow(to, toChunk, toRow);
+
+	uint8_t *toBase = reinterpret_cast<uint8_t*>(toChunk);
+	const uint8_t *fromBase = reinterpret_cast<const uint8_t*>(fromChunk);
+	for (size_t i = 0; i < to.types.size(); ++i)
+	{
+		ComponentType type = to.types[i];
+		if (!(from.mask & ComponentBit(type)))
+			continue;
+
+		uint32_t size = GetComponentInfo(type).size;
+		memcpy(toBase + to.offsets[type] + toRow * size, fromBase + from.offsets[type] + fromRow * size, size);
+	}
+
+	toChunk->MutableEntities()[toRow] = fromChunk->Entities()[fromRow];
+
+	//Fills the old row from elsewhere in the old archetype, never touches this record
+	RemoveRow(fromChunk, fromRow);
+
+	record.chunk = toChunk;
+	record.row = toRow;
+}
+
+
+const EntityStore::EntityRecord* EntityStore::Find(Entity entity) const
+{
+	if (entity.index >= records.size())
+		return NULL;
+
+	const EntityRecord &record = records[entity.index];
+	if (record.generation != entity.generation || !record.chunk)
+		return NULL;
+
+	return &record;
+}
+
+Entity EntityStore::Create(ComponentMask mask)
+{
+	if (iterating)
+		return ENTITY_NONE;
+
+	Archetype *archetype = GetArchetype(mask);
+	if (!archetype)
+		return ENTITY_NONE;
+
+	uint32_t index;
+	if (!freeRecords.empty())
+	{
+		index = freeRecords.back();
+		freeRecords.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)records.size();
+		EntityRecord record = { NULL, 0, 1 };
+		records.push_back(record);
+	}
+
+	EntityRecord &record = records[index];
+	AllocRow(*archetype, record.chunk, record.row);
+
+	Entity entity = { index, record.generation };
+	record.chunk->MutableEntities()[record.row] = entity;
+	++entityCount;
+	return entity;
+}
+
+bool EntityStore::Destroy(Entity entity)
+{
+	if (iterating || !Find(entity))
+		return false;
+
+	EntityRecord &record = records[entity.index];
+	RemoveRow(record.chunk, record.row);
+
+	record.chunk = NULL;
+	if (++record.generation == ENTITY_PENDING_GENERATION)
+		record.generation = 1;
+	freeRecords.push_back(entity.index);
+	--entityCount;
+	return true;
+}
+
+bool EntityStore::IsAlive(Entity entity) const
+{
+	return Find(entity) != NULL;
+}
+
+bool EntityStore::Has(Entity entity, ComponentType type) const
+{
+	const EntityRecord *record = Find(entity);
+	return record && record->chunk->Has(type);
+}
+
+void* EntityStore::Get(Entity entity, ComponentType type) const
+{
+	const EntityRecord *record = Find(entity);
+	if (!record)
+		return NULL;
+
+	uint8_t *components = static_cast<uint8_t*>(record->chunk->Components(type));
+	return components ? components + record->row * GetComponentInfo(type).size : NULL;
+}
+
+bool EntityStore::Set(Entity entity, ComponentType type, const void *value)
+{
+	void *component = Get(entity, type);
+	if (!component)
+		return false;
+
+	if (value)
+		memcpy(component, value, GetComponentInfo(type).size);
+	else
+		memset(component, 0, GetComponentInfo(type).size);
+	return true;
+}
+
+bool EntityStore::Add(Entity entity, ComponentType type, const void *value)
+{
+	const EntityRecord *record = Find(entity);
+	if (!record)
+		return false;
+
+	if (record->chunk->Has(type))
+		return Set(entity, type, value);
+
+	if (iterating)
+		return false;
+
+	Archetype *archetype = GetArchetype(record->chunk->archetype->mask | ComponentBit(type));
+	if (!archetype)
+		return false;
+
+	MoveEntity(entity.index, *archetype);
+	return value ? Set(entity, type, value) : true;
+}
+
+bool EntityStore::Remove(Entity entity, ComponentType type)
+{
+	const EntityRecord *record = Find(entity);
+	if (iterating || !record || !record->chunk->Has(type))
+		return false;
+
+	Archetype *archetype = GetArchetype(record->chunk->archetype->mask & ~ComponentBit(type));
+	if (!archetype)
+		return false;
+
+	MoveEntity(entity.index, *archetype);
+	return true;
+}
+
+
+void EntityStore::GatherChunks(const EntityQuery &query, std::vector<EntityChunk*> &out)
+{
+	out.clear();
+	for (size_t a = 0; a < archetypes.size(); ++a)
+	{
+		Archetype *archetype = archetypes[a];
+		if (Matches(*archetype, query))
+			out.insert(out.end(), archetype->chunks.begin(), archetype->chunks.end());
+	}
+}
+
+void EntityStore::PrepareThreadCommands(JobSystem &jobs)
+{
+	size_t needed = (size_t)jobs.ThreadSlotCount() + 1;
+	while (threadCommands.size() < needed)
+		threadCommands.push_back(new EntityCommandBuffer());
+}
+
+int EntityStore::ThreadCommandIndex(JobSystem &jobs) const
+{
+	//The one thread without a slot that can get here is the caller, when the jobs run inline
+	int slot = jobs.CurrentThreadSlot();
+	return slot >= 0 ? slot : jobs.ThreadSlotCount();
+}
+
+void EntityStore::PlaybackThreadCommands()
+{
+	PROFILE_ZONE("EntityStore playback");
+
+	for (size_t i = 0; i < threadCommands.size(); ++i)
+		if (!threadCommands[i]->IsEmpty())
+			threadCommands[i]->Playback(*this);
+}
+
+
+EntityCommandBuffer::EntityCommandBuffer()
+	: commandCount(0), pendingCount(0)
+{
+}
+
+void EntityCommandBuffer::Record(uint32_t op, Entity entity, ComponentType type, ComponentMask mask, const void *value, uint32_t valueBytes)
+{
+	size_t at = stream.size();
+	size_t words = (sizeof(Command) + valueBytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	stream.resize(at + words);
+
+	Command *command = reinterpret_cast<Command*>(&stream[at]);
+	command->op = op;
+	command->type = type;
+	command->entity = entity;
+	command->mask = mask;
+	command->valueBytes = valueBytes;
+	command->pad = 0;
+
+	if (valueBytes)
+		memcpy(command + 1, value, valueBytes);
+
+	++commandCount;
+}
+
+Entity EntityCommandBuffer::Create(ComponentMask mask)
+{
+	Entity entity = { pendingCount++, ENTITY_PENDING_GENERATION };
+	Record(OP_CREATE, entity, 0, mask, NULL, 0);
+	return entity;
+}
+
+void EntityCommandBuffer::Destroy(Entity entity)
+{
+	Record(OP_DESTROY, entity, 0, 0, NULL, 0);
+}
+
+void EntityCommandBuffer::Add(Entity entity, ComponentType type, const void *value)
+{
+	Record(OP_ADD, entity, type, 0, value, value ? GetComponentInfo(type).size : 0);
+}
+
+void EntityCommandBuffer::Remove(Entity entity, ComponentType type)
+{
+	Record(OP_REMOVE, entity, type, 0, NULL, 0);
+}
+
+void EntityCommandBuffer::Set(Entity entity, ComponentType type, const void *value)
+{
+	Record(OP_SET, entity, type, 0, value, value ? GetComponentInfo(type).size : 0);
+}
+
+void EntityCommandBuffer::Playback(EntityStore &store)
+{
+	created.assign(pendingCount, ENTITY_NONE);
+
+	size_t at = 0;
+	while (at < stream.size())
+	{
+		const Command *command = reinterpret_cast<const Command*>(&stream[at]);
+		at += (sizeof(Command) + command->valueBytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		Entity entity = command->entity;
+		if (entity.generation == ENTITY_PENDING_GENERATION)
+			entity = created[entity.index];
+
+		const void *value = command->valueBytes ? command + 1 : NULL;
+		switch (command->op)
+		{
+		case OP_CREATE:
+			created[command->entity.index] = store.Create(command->mask);
+			break;
+		case OP_DESTROY:
+			store.Destroy(entity);
+			break;
+		case OP_ADD:
+			store.Add(entity, command->type, value);
+			break;
+		case OP_REMOVE:
+			store.Remove(entity, command->type);
+			break;
+		case OP_SET:
+			store.Set(entity, command->type, value);
+			break;
+		}
+	}
+
+	Clear();
+}
+
+void EntityCommandBuffer::Clear()
+{
+	stream.clear();
+	commandCount = 0;
+	pendingCount = 0;
+}
@@ -0,0 +1,360 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "JobSystem.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+
+const uint32_t ENTITY_CHUNK_BYTES = 16 * 1024;
+const uint32_t ENTITY_CHUNK_ALIGN = 64;		//Every array in a chunk starts on a cache line
+const int	   ENTITY_MAX_COMPONENTS = 64;		//Component types, one bit each in a ComponentMask
+
+//Chunks per job in ParallelForEachChunk
+const uint32_t ENTITY_PARALLEL_GRAIN = 4;
+
+typedef uint32_t ComponentType;
+typedef uint64_t ComponentMask;
+
+inline ComponentMask ComponentBit(ComponentType type) { return (ComponentMask)1 << type; }
+
+
+//Index into the store's records plus the generation it was given out with, so a handle to a destroyed
+//entity doesn't find whatever reused its slot
+struct Entity
+{
+	uint32_t index;
+	uint32_t generation;
+};
+
+inline bool operator==(const Entity &a, const Entity &b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(const Entity &a, const Entity &b) { return !(a == b); }
+
+const Entity ENTITY_NONE = { 0xFFFFFFFF, 0 };
+
+
+//Component types are registered process wide the first time ComponentTypeOf<T> sees them. They are moved
+//around with memcpy and start out zeroed, so they have to be plain data.
+
+struct ComponentInfo
+{
+	uint32_t size;
+	uint32_t align;
+};
+
+ComponentType RegisterComponentType(uint32_t size, uint32_t align);
+const ComponentInfo& GetComponentInfo(ComponentType type);
+
+template <class T>
+inline ComponentType ComponentTypeOf()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components are moved with memcpy");
+	static const ComponentType type = RegisterComponentType((uint32_t)sizeof(T), (uint32_t)alignof(T));
+	return type;
+}
+
+template <class... T>
+struct ComponentMaskBuilder;
+
+template <>
+struct ComponentMaskBuilder<>
+{
+	static inline ComponentMask Get() { return 0; }
+};
+
+template <class T, class... TRest>
+struct ComponentMaskBuilder<T, TRest...>
+{
+	static inline ComponentMask Get() { return ComponentBit(ComponentTypeOf<T>()) | ComponentMaskBuilder<TRest...>::Get(); }
+};
+
+template <class... T>
+inline ComponentMask ComponentMaskOf() { return ComponentMaskBuilder<T...>::Get(); }
+
+
+//Archetypes that have everything in all and nothing in none
+struct EntityQuery
+{
+	ComponentMask all;
+	ComponentMask none;
+};
+
+template <class... T>
+inline EntityQuery QueryAll(ComponentMask none = 0)
+{
+	EntityQuery query = { ComponentMaskOf<T...>(), none };
+	return query;
+}
+
+
+struct Archetype;
+
+//One 16 KB block of entities that all have the same components. This header sits at the start of it, then
+//the Entity array, then one array per component (structure of arrays), each on its own cache line.
+class EntityChunk
+{
+public:
+	inline uint32_t Count() const { return count; };
+	inline const Entity* Entities() const { return reinterpret_cast<const Entity*>(reinterpret_cast<const uint8_t*>(this) + ENTITY_CHUNK_ALIGN); };
+
+	inline bool Has(ComponentType type) const;
+	inline void* Components(ComponentType type) const;
+
+	//NULL if this chunk's archetype doesn't have T
+	template <class T>
+	inline T* Components() const { return static_cast<T*>(Components(ComponentTypeOf<T>())); }
+
+private:
+	friend class EntityStore;
+
+	inline Entity* MutableEntities() { return reinterpret_cast<Entity*>(reinterpret_cast<uint8_t*>(this) + ENTITY_CHUNK_ALIGN); };
+
+	Archetype *archetype;
+	uint32_t   count;
+	uint32_t   chunkIndex;		//In archetype->chunks
+};
+
+struct Archetype
+{
+	ComponentMask mask;
+	uint32_t	  capacity;		//Entities per chunk
+	uint32_t	  entityCount;
+	uint32_t	  offsets[ENTITY_MAX_COMPONENTS];	//Chunk byte offset of each component's array, only for the ones in mask
+	std::vector<ComponentType> types;
+
+	//All full but the last, removing fills the hole from the last one
+	std::vector<EntityChunk*> chunks;
+};
+
+inline bool EntityChunk::Has(ComponentType type) const
+{
+	return (archetype->mask & ComponentBit(type)) != 0;
+}
+
+inline void* EntityChunk::Components(ComponentType type) const
+{
+	if (!Has(type))
+		return NULL;
+	return const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(this)) + archetype->offsets[type];
+}
+
+
+class EntityStore;
+
+//Structural changes (create, destroy, add/remove component) recorded to be made later, for when they can't be
+//made right away: while the store is being iterated, or from jobs. Played back in the order recorded.
+//
+//Create hands back a placeholder entity that only means something to later commands in the same buffer,
+//Playback swaps in the real one. Not thread safe, one buffer per thread.
+
+class EntityCommandBuffer
+{
+public:
+	EntityCommandBuffer();
+
+	Entity Create(ComponentMask mask);
+	void Destroy(Entity entity);
+
+	//value NULL for zeroed. Add on an entity that already has the component just sets it.
+	void Add(Entity entity, ComponentType type, const void *value);
+	void Remove(Entity entity, ComponentType type);
+	void Set(Entity entity, ComponentType type, const void *value);
+
+	template <class T> inline void Add(Entity entity, const T &value) { Add(entity, ComponentTypeOf<T>(), &value); }
+	template <class T> inline void Remove(Entity entity) { Remove(entity, ComponentTypeOf<T>()); }
+	template <class T> inline void Set(Entity entity, const T &value) { Set(entity, ComponentTypeOf<T>(), &value); }
+
+	inline bool IsEmpty() const { return stream.empty(); };
+	inline uint32_t CommandCount() const { return commandCount; };
+
+	//Make the changes and empty the buffer. Commands on entities that are gone by then are skipped.
+	void Playback(EntityStore &store);
+	void Clear();
+
+private:
+
+	enum Op
+	{
+		OP_CREATE = 0,
+		OP_DESTROY,
+		OP_ADD,
+		OP_REMOVE,
+		OP_SET,
+	};
+
+	struct Command
+	{
+		uint32_t	  op;
+		ComponentType type;
+		Entity		  entity;
+		ComponentMask mask;			//OP_CREATE
+		uint32_t	  valueBytes;	//Value right after, padded to 8
+		uint32_t	  pad;
+	};
+
+	EntityCommandBuffer(const EntityCommandBuffer&);
+	EntityCommandBuffer& operator=(const EntityCommandBuffer&);
+
+	void Record(uint32_t op, Entity entity, ComponentType type, ComponentMask mask, const void *value, uint32_t valueBytes);
+
+	std::vector<uint64_t> stream;		//uint64_t so commands stay 8 aligned
+	uint32_t commandCount;
+	uint32_t pendingCount;
+	std::vector<Entity> created;		//Placeholder index -> real entity, during Playback
+};
+
+
+//Entities grouped by archetype (the exact set of components they have) into chunks, so a query walks
+//arrays of just the components it wants, front to back, instead of jumping from object to object.
+//
+//Every entity is a record (chunk, row, generation). Destroying one, or moving it to another archetype,
+//moves the last entity of the archetype's last chunk into its row, so chunks stay packed and a chunk's
+//entities are always [0, Count()).
+//
+//Structural changes move entities between chunks, so none can be made while iterating: during ForEachChunk
+//they fail (ENTITY_NONE / false), record them in an EntityCommandBuffer instead. ParallelForEachChunk
+//hands each job its thread's buffer and plays them all back afterwards. Reading and writing component
+//values is fine any time. Otherwise not thread safe, use it from the simulation thread.
+
+class EntityStore
+{
+public:
+	EntityStore();
+	~EntityStore();
+
+	//Every component zeroed
+	Entity Create(ComponentMask mask);
+	bool   Destroy(Entity entity);
+	void   Clear();
+
+	bool IsAlive(Entity entity) const;
+	bool Has(Entity entity, ComponentType type) const;
+
+	//NULL if the entity is gone or doesn't have it. Valid until the next structural change.
+	void* Get(Entity entity, ComponentType type) const;
+
+	//value NULL for zeroed. Add on an entity that already has the component just sets it.
+	bool Add(Entity entity, ComponentType type, const void *value);
+	bool Remove(Entity entity, ComponentType type);
+	bool Set(Entity entity, ComponentType type, const void *value);
+
+	template <class... T> inline Entity Create() { return Create(ComponentMaskOf<T...>()); }
+	template <class T> inline T*   Get(Entity entity) const { return static_cast<T*>(Get(entity, ComponentTypeOf<T>())); }
+	template <class T> inline bool Has(Entity entity) const { return Has(entity, ComponentTypeOf<T>()); }
+	template <class T> inline bool Add(Entity entity, const T &value) { return Add(entity, ComponentTypeOf<T>(), &value); }
+	template <class T> inline bool Remove(Entity entity) { return Remove(entity, ComponentTypeOf<T>()); }
+	template <class T> inline bool Set(Entity entity, const T &value) { return Set(entity, ComponentTypeOf<T>(), &value); }
+
+	inline uint32_t EntityCount() const { return entityCount; };
+	inline uint32_t ArchetypeCount() const { return (uint32_t)archetypes.size(); };
+	uint32_t ChunkCount() const;
+
+	//fn(EntityChunk &chunk) for every chunk of every archetype the query matches
+	template <class TFunc>
+	void ForEachChunk(const EntityQuery &query, const TFunc &fn)
+	{
+		++iterating;
+		for (size_t a = 0; a < archetypes.size(); ++a)
+		{
+			Archetype *archetype = archetypes[a];
+			if (!Matches(*archetype, query))
+				continue;
+
+			for (size_t c = 0; c < archetype->chunks.size(); ++c)
+				fn(*archetype->chunks[c]);
+		}
+		--iterating;
+	}
+
+	//Same, with the chunks spread over jobs, blocks until done. fn(EntityChunk &chunk, EntityCommandBuffer &commands)
+	//gets the buffer of the thread it runs on; they are played back in thread order once every chunk is done.
+	template <class TFunc>
+	void ParallelForEachChunk(JobSystem &jobs, const EntityQuery &query, const TFunc &fn, uint32_t grain = ENTITY_PARALLEL_GRAIN)
+	{
+		GatherChunks(query, parallelChunks);
+		PrepareThreadCommands(jobs);
+
+		++iterating;
+		jobs.ParallelFor((uint32_t)parallelChunks.size(), grain, [this, &jobs, &fn](uint32_t begin, uint32_t end)
+		{
+			EntityCommandBuffer &commands = *threadCommands[ThreadCommandIndex(jobs)];
+			for (uint32_t c = begin; c < end; ++c)
+				fn(*parallelChunks[c], commands);
+		});
+		--iterating;
+
+		PlaybackThreadCommands();
+	}
+
+private:
+
+	struct EntityRecord
+	{
+		EntityChunk *chunk;
+		uint32_t	 row;
+		uint32_t	 generation;
+	};
+
+	EntityStore(const EntityStore&);
+	EntityStore& operator=(const EntityStore&);
+
+	static inline bool Matches(const Archetype &archetype, const EntityQuery &query)
+	{
+		return (archetype.mask & query.all) == query.all && (archetype.mask & query.none) == 0;
+	}
+
+	const EntityRecord* Find(Entity entity) const;
+
+	Archetype* GetArchetype(ComponentMask mask);
+	EntityChunk* AllocChunk(Archetype &archetype);
+	void FreeChunk(EntityChunk *chunk);
+
+	//A free row at the end of the archetype's last chunk (a new chunk if that is full), zeroed
+	void AllocRow(Archetype &archetype, EntityChunk *&chunk, uint32_t &row);
+
+	//Fill the row from the archetype's last entity and shrink by one
+	void RemoveRow(EntityChunk *chunk, uint32_t row);
+
+	//Entity to another archetype, keeping the components both have
+	void MoveEntity(uint32_t index, Archetype &to);
+
+	void GatherChunks(const EntityQuery &query, std::vector<EntityChunk*> &out);
+
+	//One buffer per job thread slot, plus one for threads without
+	void PrepareThreadCommands(JobSystem &jobs);
+	int  ThreadCommandIndex(JobSystem &jobs) const;
+	void PlaybackThreadCommands();
+
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeRecords;
+	uint32_t entityCount;
+
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<ComponentMask, Archetype*> archetypeByMask;
+
+	//Empty chunks kept for reuse
+	std::vector<EntityChunk*> freeChunks;
+
+	int iterating;
+
+	std::vector<EntityChunk*> parallelChunks;
+	std::vector<EntityCommandBuffer*> threadCommands;
+};
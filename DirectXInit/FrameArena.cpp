@@ -0,0 +1,295 @@
+#include "stdafx.h"
+
+#include "FrameArena.h"
+#include "Platform.h"
+#include "ScopeLock.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+struct ArenaThreadEntry
+{
+	uint64_t arenaId;
+	uint32_t slot;
+};
+
+static std::atomic<uint64_t> nextArenaId(1);
+static std::atomic<uint64_t> nextThreadId(1);
+
+static thread_local ArenaThreadEntry tlsArenaSlots[FRAMEARENA_TLS_ENTRIES];
+static thread_local int tlsArenaReplace = 0;
+
+//Live arenas, so a thread going away can hand its slots back. Never freed, threads can outlive statics.
+static SpinParkMutex registryLock;
+
+static std::vector<FrameArena*>& ArenaRegistry()
+{
+	static std::vector<FrameArena*> *arenas = new std::vector<FrameArena*>();
+	return *arenas;
+}
+
+//Built the first time a thread takes a slot, gives them all back when it exits
+struct ArenaThread
+{
+	uint64_t id;
+
+	ArenaThread() : id(nextThreadId.fetch_add(1, std::memory_order_relaxed)) { }
+	~ArenaThread()
+	{
+		memset(tlsArenaSlots, 0, sizeof(tlsArenaSlots));
+		FrameArena::ReleaseSlots(id);
+	}
+};
+
+static thread_local ArenaThread tlsArenaThread;
+
+
+FrameArena::FrameArena() : framesInFlight(0), bytesPerThread(0), maxThreads(0), currentFrame(0), threadCount(0), arenaId(0)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	{
+		ScopeLock<SpinParkMutex> lock(registryLock);
+		ArenaRegistry().push_back(this);
+	}
+
+	Init();
+}
+
+FrameArena::~FrameArena()
+{
+	Shutdown();
+
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	std::vector<FrameArena*> &arenas = ArenaRegistry();
+	for (size_t i = 0; i < arenas.size(); ++i)
+	{
+		if (arenas[i] == this)
+		{
+			arenas.erase(arenas.begin() + i);
+			break;
+		}
+	}
+}
+
+void FrameArena::Init(uint32_t frames, size_t threadBytes, uint32_t threads)
+{
+	Shutdown();
+
+	framesInFlight = frames > 0 ? frames : 1;
+	bytesPerThread = threadBytes;
+	maxThreads = threads;
+
+	SubArena empty;
+	empty.base = NULL;
+	empty.offset = 0;
+	empty.allocations = 0;
+	empty.overflowBytes = 0;
+	subArenas.assign(framesInFlight * (maxThreads + 1), empty);
+
+	currentFrame.store(0);
+
+	//Under the registry lock, a thread exiting right now may be looking at the owners
+	{
+		std::vector<std::atomic<uint64_t> > owners(maxThreads);
+		for (uint32_t i = 0; i < maxThreads; ++i)
+			owners[i].store(0, std::memory_order_relaxed);
+
+		ScopeLock<SpinParkMutex> lock(registryLock);
+		slotOwners.swap(owners);
+		threadCount.store(0);
+		arenaId = nextArenaId.fetch_add(1);
+	}
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+void FrameArena::Shutdown()
+{
+	for (size_t i = 0; i < subArenas.size(); ++i)
+	{
+		Rewind(subArenas[i]);
+		AlignedFree(subArenas[i].base);
+		subArenas[i].base = NULL;
+	}
+
+	subArenas.clear();
+
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	slotOwners.clear();
+	threadCount.store(0);
+}
+
+uint32_t FrameArena::ThreadSlot()
+{
+	for (int i = 0; i < FRAMEARENA_TLS_ENTRIES; ++i)
+	{
+		if (tlsArenaSlots[i].arenaId == arenaId)
+			return tlsArenaSlots[i].slot;
+	}
+
+	//First allocation from this thread, or it was pushed out by other arenas and finds the slot it had
+	uint32_t slot = ClaimSlot(tlsArenaThread.id);
+
+	ArenaThreadEntry &entry = tlsArenaSlots[tlsArenaReplace];
+	tlsArenaReplace = (tlsArenaReplace + 1) % FRAMEARENA_TLS_ENTRIES;
+
+	entry.arenaId = arenaId;
+	entry.slot = slot;
+	return slot;
+}
+
+uint32_t FrameArena::ClaimSlot(uint64_t thread)
+{
+	for (uint32_t i = 0; i < maxThreads; ++i)
+	{
+		if (slotOwners[i].load(std::memory_order_relaxed) == thread)
+			return i;
+	}
+
+	//Acquire pairs with the release in ReleaseSlots, the last owner's writes to the sub arenas are done
+	for (uint32_t i = 0; i < maxThreads; ++i)
+	{
+		uint64_t expected = 0;
+		if (slotOwners[i].compare_exchange_strong(expected, thread, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			threadCount.fetch_add(1, std::memory_order_relaxed);
+			return i;
+		}
+	}
+
+	return maxThreads;
+}
+
+void FrameArena::ReleaseSlots(uint64_t thread)
+{
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	std::vector<FrameArena*> &arenas = ArenaRegistry();
+
+	for (size_t a = 0; a < arenas.size(); ++a)
+	{
+		FrameArena &arena = *arenas[a];
+		for (size_t i = 0; i < arena.slotOwners.size(); ++i)
+		{
+			if (arena.slotOwners[i].load(std::memory_order_relaxed) == thread)
+			{
+				arena.slotOwners[i].store(0, std::memory_order_release);
+				arena.threadCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+	}
+}
+
+void* FrameArena::Allocate(size_t size, size_t align)
+{
+	uint32_t slot = ThreadSlot();
+	SubArena &sub = subArenas[currentFrame.load(std::memory_order_acquire) * (maxThreads + 1) + slot];
+
+	if (slot < maxThreads)
+		return AllocateFrom(sub, size, align);
+
+	ScopeLock<SpinParkMutex> lock(sharedLock);
+	return AllocateFrom(sub, size, align);
+}
+
+void* FrameArena::AllocateFrom(SubArena &sub, size_t size, size_t align)
+{
+	++sub.allocations;
+
+	//Blocks come in the first time a thread needs one in this frame slot, then stay
+	if (!sub.base && bytesPerThread > 0)
+		sub.base = (uint8_t*)AlignedAlloc(bytesPerThread, 64);
+
+	if (sub.base)
+	{
+		uintptr_t start = (uintptr_t)sub.base;
+		uintptr_t p = (start + sub.offset + align - 1) & ~(uintptr_t)(align - 1);
+
+		if (p + size <= start + bytesPerThread)
+		{
+			sub.offset = (size_t)(p + size - start);
+			return (void*)p;
+		}
+	}
+
+	//Doesn't fit, heap it and let it go with the frame
+	void *mem = AlignedAlloc(size > 0 ? size : 1, align);
+	if (mem)
+	{
+		sub.overflow.push_back(mem);
+		sub.overflowBytes += size;
+	}
+
+	return mem;
+}
+
+void FrameArena::Rewind(SubArena &sub)
+{
+	for (size_t i = 0; i < sub.overflow.size(); ++i)
+		AlignedFree(sub.overflow[i]);
+
+	//clear keeps the capacity, so overflowing every frame at least doesn't grow this every frame
+	sub.overflow.clear();
+	sub.overflowBytes = 0;
+	sub.offset = 0;
+	sub.allocations = 0;
+}
+
+void FrameArena::BeginFrame()
+{
+	uint32_t rowSize = maxThreads + 1;
+	uint32_t row = currentFrame.load(std::memory_order_relaxed);
+
+	//Stats for the frame that just ended
+	size_t frameBytes = 0;
+	uint64_t frameAllocations = 0;
+
+	for (uint32_t t = 0; t < rowSize; ++t)
+	{
+		const SubArena &sub = subArenas[row * rowSize + t];
+		size_t used = sub.offset + sub.overflowBytes;
+
+		frameBytes += used;
+		frameAllocations += sub.allocations;
+		stats.overflowAllocations += sub.overflow.size();
+		stats.overflowBytes += sub.overflowBytes;
+
+		if (used > stats.threadHighWaterBytes)
+			stats.threadHighWaterBytes = used;
+	}
+
+	++stats.frames;
+	stats.lastFrameBytes = frameBytes;
+	stats.lastFrameAllocations = frameAllocations;
+	if (frameBytes > stats.highWaterBytes)
+		stats.highWaterBytes = frameBytes;
+
+	//The next row was last used framesInFlight frames ago, nothing in it is alive anymore
+	uint32_t next = (row + 1) % framesInFlight;
+	for (uint32_t t = 0; t < rowSize; ++t)
+		Rewind(subArenas[next * rowSize + t]);
+
+	size_t blocks = 0;
+	for (size_t i = 0; i < subArenas.size(); ++i)
+		blocks += subArenas[i].base ? 1 : 0;
+
+	stats.reservedBytes = blocks * bytesPerThread;
+	stats.threads = threadCount.load(std::memory_order_relaxed);
+
+	currentFrame.store(next, std::memory_order_release);
+}
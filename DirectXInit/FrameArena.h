@@ -0,0 +1,160 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "Locks.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+const uint32_t FRAMEARENA_DEFAULT_FRAMES = 3;
+const size_t   FRAMEARENA_DEFAULT_THREAD_BYTES = 1024 * 1024;
+const uint32_t FRAMEARENA_DEFAULT_MAX_THREADS = 32;
+
+//Arenas a thread can be using at the same time before it has to look its slot up again
+const int	   FRAMEARENA_TLS_ENTRIES = 4;
+
+
+struct FrameArenaStats
+{
+	uint64_t frames;
+	size_t	 lastFrameBytes;			//All threads, the frame before the current one
+	uint64_t lastFrameAllocations;
+	size_t	 highWaterBytes;			//Most any frame used, all threads
+	size_t	 threadHighWaterBytes;		//Most one thread used in one frame, compare against bytesPerThread
+	uint64_t overflowAllocations;		//Went to the heap instead (block full), total
+	size_t	 overflowBytes;
+	size_t	 reservedBytes;				//Blocks allocated so far
+	uint32_t threads;					//Threads holding a slot (allocated and haven't exited)
+};
+
+
+//Transient memory by the frame. Every thread that allocates gets its own bump block per frame in flight, so
+//allocating is a thread local lookup and an add, no locks or atomics. BeginFrame moves everyone on to the
+//next frame's blocks and rewinds them, which makes anything allocated valid for framesInFlight frames
+//(long enough for a frame's data to be read by the next one or two, not longer).
+//
+//Blocks are allocated the first time a thread needs one and kept, so once every thread has been through
+//each frame once a frame does no heap allocation at all. A request that doesn't fit in what is left goes to
+//the heap (freed with the frame) and counts as an overflow; raise bytesPerThread if that shows up.
+//
+//A thread keeps its slot until it exits, then the slot goes back for the next thread to take, so worker
+//pools being restarted don't use up maxThreads.
+//
+//Nothing is destructed, only put things in here that don't need it. BeginFrame must not overlap any
+//allocation (top of the frame, before jobs go out).
+
+class FrameArena
+{
+public:
+	FrameArena();
+	~FrameArena();
+
+	//(Re)initialize, only while nobody is allocating. Frees everything from before.
+	void Init(uint32_t framesInFlight = FRAMEARENA_DEFAULT_FRAMES, size_t bytesPerThread = FRAMEARENA_DEFAULT_THREAD_BYTES,
+		uint32_t maxThreads = FRAMEARENA_DEFAULT_MAX_THREADS);
+	void Shutdown();
+
+	void BeginFrame();
+
+	//From the calling thread's block for the current frame, never NULL. align must be a power of two.
+	void* Allocate(size_t size, size_t align = 16);
+
+	//Uninitialized, no constructors run
+	template <class T>
+	inline T* AllocateArray(size_t count) { return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T))); }
+
+	inline uint32_t FramesInFlight() const { return framesInFlight; };
+	inline size_t	BytesPerThread() const { return bytesPerThread; };
+
+	//Updated by BeginFrame, read from the thread calling it
+	inline const FrameArenaStats& Stats() const { return stats; };
+
+private:
+
+	struct SubArena
+	{
+		uint8_t *base;
+		size_t	 offset;
+		uint64_t allocations;
+		size_t	 overflowBytes;
+		std::vector<void*> overflow;	//Heap blocks handed out this frame
+	};
+
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	friend struct ArenaThread;
+
+	//Thread slot, maxThreads for the shared sub arena
+	uint32_t ThreadSlot();
+	uint32_t ClaimSlot(uint64_t thread);
+	static void ReleaseSlots(uint64_t thread);		//From a thread exiting, in every live arena
+	void* AllocateFrom(SubArena &sub, size_t size, size_t align);
+	void  Rewind(SubArena &sub);
+
+	uint32_t framesInFlight;
+	size_t	 bytesPerThread;
+	uint32_t maxThreads;
+
+	//framesInFlight rows of maxThreads + 1, row currentFrame is being allocated from. The last one in each
+	//row is shared, under sharedLock, by threads that came after maxThreads others.
+	std::vector<SubArena> subArenas;
+	std::atomic<uint32_t> currentFrame;
+	SpinParkMutex sharedLock;
+
+	//Which thread has each slot, 0 for free. arenaId changes with every Init so stale thread local entries miss.
+	std::vector<std::atomic<uint64_t> > slotOwners;
+	std::atomic<uint32_t> threadCount;
+	uint64_t arenaId;
+
+	FrameArenaStats stats;
+};
+
+
+//std allocator on top of a FrameArena, deallocate does nothing. Containers using it only live for the
+//frame(s) the arena keeps their memory; reserve up front, growing leaves the old blocks behind until the
+//arena gets back around.
+//
+//	FrameVector<uint32_t> visible(FrameAllocator<uint32_t>(&FrameMemory()));
+//	visible.reserve(objectCount);
+
+template <class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator(FrameArena *frameArena) : arena(frameArena) { }
+	template <class U> FrameAllocator(const FrameAllocator<U> &other) : arena(other.Arena()) { }
+
+	inline T* allocate(size_t count) { return arena->AllocateArray<T>(count); }
+	inline void deallocate(T*, size_t) { }
+
+	inline FrameArena* Arena() const { return arena; }
+
+	template <class U> inline bool operator==(const FrameAllocator<U> &other) const { return arena == other.Arena(); }
+	template <class U> inline bool operator!=(const FrameAllocator<U> &other) const { return arena != other.Arena(); }
+
+private:
+	FrameArena *arena;
+};
+
+template <class T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+
+#include "FramePacer.h"
+#include "GameTimer.h"
+#include "Locks.h"
+#include "Profiler.h"
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <mmsystem.h>
+//timeBeginPeriod/timeEndPeriod
+#pragma comment(lib, "winmm.lib")
+#endif
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+static inline double ClampSlack(double slack)
+{
+	if (slack < FRAMEPACER_MIN_SLACK)
+		return FRAMEPACER_MIN_SLACK;
+	if (slack > FRAMEPACER_MAX_SLACK)
+		return FRAMEPACER_MAX_SLACK;
+	return slack;
+}
+
+FramePacer::FramePacer()
+	: secondsPerCount(0.0), budget(0.0), sleepSlack(0.001), bCalibrated(false), bTimerRaised(false), nextDeadline(0), lastFrameEnd(0)
+{
+	int64_t frequency = 0;
+	GameTimer::QueryFrequency(frequency);
+	secondsPerCount = frequency > 0 ? 1.0 / (double)frequency : 0.0;
+
+	ResetStats();
+}
+
+FramePacer::~FramePacer()
+{
+	RaiseTimerResolution(false);
+}
+
+void FramePacer::SetTargetFps(double fps)
+{
+	SetFrameBudget(fps > 0.0 ? 1.0 / fps : 0.0);
+}
+
+void FramePacer::SetFrameBudget(double seconds)
+{
+	budget = seconds > 0.0 ? seconds : 0.0;
+
+	//Without 1 ms timer resolution a windows sleep can come back up to ~15.6 ms late
+	RaiseTimerResolution(budget > 0.0);
+
+	if (budget > 0.0 && !bCalibrated)
+		Calibrate();
+
+	Reset();
+}
+
+void FramePacer::RaiseTimerResolution(bool raise)
+{
+	if (raise == bTimerRaised)
+		return;
+
+#ifdef _WIN32
+	if (raise)
+		timeBeginPeriod(1);
+	else
+		timeEndPeriod(1);
+#endif
+
+	bTimerRaised = raise;
+}
+
+void FramePacer::Calibrate()
+{
+	if (secondsPerCount <= 0.0)
+		return;
+
+	//Worst of a handful of 1 ms sleeps
+	double worstLate = 0.0;
+	for (int i = 0; i < 8; ++i)
+	{
+		int64_t before = 0, after = 0;
+		GameTimer::QueryCounter(before);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		GameTimer::QueryCounter(after);
+
+		double late = (after - before) * secondsPerCount - 0.001;
+		if (late > worstLate)
+			worstLate = late;
+	}
+
+	sleepSlack = ClampSlack(worstLate * 1.25);
+	bCalibrated = true;
+}
+
+void FramePacer::Reset()
+{
+	nextDeadline = 0;
+	lastFrameEnd = 0;
+}
+
+void FramePacer::ResetStats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+double FramePacer::Wait()
+{
+	if (budget <= 0.0 || secondsPerCount <= 0.0)
+		return 0.0;
+
+	PROFILE_ZONE("FramePacer::Wait");
+
+	int64_t budgetCounts = (int64_t)(budget / secondsPerCount);
+
+	int64_t start = 0;
+	GameTimer::QueryCounter(start);
+
+	//First frame of the schedule, nothing to wait for
+	if (nextDeadline == 0)
+	{
+		nextDeadline = start + budgetCounts;
+		lastFrameEnd = start;
+		return 0.0;
+	}
+
+	if (start >= nextDeadline)
+	{
+		++stats.lateFrames;
+		if (start - nextDeadline > budgetCounts)
+		{
+			++stats.resyncs;
+			nextDeadline = start;
+		}
+	}
+
+	//Coarse part: let the OS have the core until a slack's worth before the deadline
+	double remaining = (nextDeadline - start) * secondsPerCount;
+	if (remaining > sleepSlack)
+	{
+		double request = remaining - sleepSlack;
+		std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(request * 1e6)));
+
+		int64_t woke = 0;
+		GameTimer::QueryCounter(woke);
+		double slept = (woke - start) * secondsPerCount;
+		stats.sleptMs += slept * 1000.0;
+
+		//Follow how late sleeps come back: jump up right away, drift back down slowly
+		double late = slept - request;
+		if (late > sleepSlack)
+			sleepSlack = ClampSlack(late * 1.25);
+		else
+			sleepSlack = ClampSlack(sleepSlack - (sleepSlack - late) * 0.01);
+	}
+
+	//Fine part: spin out the rest
+	int64_t spinStart = 0, now = 0;
+	GameTimer::QueryCounter(spinStart);
+	now = spinStart;
+	while (now < nextDeadline)
+	{
+		LockCpuRelax();
+		GameTimer::QueryCounter(now);
+	}
+	stats.spunMs += (now - spinStart) * secondsPerCount * 1000.0;
+
+	//How far this frame's interval was off the budget
+	double errorMs = ((now - lastFrameEnd) * secondsPerCount - budget) * 1000.0;
+	++stats.frames;
+	stats.lastErrorMs = errorMs;
+	stats.errorSumMs += errorMs;
+	stats.absErrorSumMs += fabs(errorMs);
+	stats.errorSqSumMs += errorMs * errorMs;
+	if (fabs(errorMs) > stats.maxAbsErrorMs)
+		stats.maxAbsErrorMs = fabs(errorMs);
+
+	lastFrameEnd = now;
+	nextDeadline += budgetCounts;
+
+	return (now - start) * secondsPerCount;
+}
+
+double FramePacer::MeanAbsErrorMs() const
+{
+	return stats.frames ? stats.absErrorSumMs / stats.frames : 0.0;
+}
+
+double FramePacer::ErrorStdDevMs() const
+{
+	if (stats.frames == 0)
+		return 0.0;
+
+	double mean = stats.errorSumMs / stats.frames;
+	double variance = stats.errorSqSumMs / stats.frames - mean * mean;
+	return variance > 0.0 ? sqrt(variance) : 0.0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+
+
+//Sleep slack bounds. The slack is how much earlier than the deadline we wake up from the OS sleep to spin
+//the rest, it follows how late sleeps actually come back.
+const double FRAMEPACER_MIN_SLACK = 0.00025;
+const double FRAMEPACER_MAX_SLACK = 0.004;
+
+struct FramePacingStats
+{
+	uint64_t frames;			//Intervals measured (frame to frame, while capped)
+	uint64_t lateFrames;		//Got to the wait already past the deadline
+	uint64_t resyncs;			//More than a whole frame behind, the schedule restarted from now
+	double	 lastErrorMs;		//Last interval minus the budget
+	double	 errorSumMs;
+	double	 absErrorSumMs;
+	double	 errorSqSumMs;
+	double	 maxAbsErrorMs;
+	double	 sleptMs;			//Total time given back to the OS
+	double	 spunMs;			//Total time spent spinning for the last bit
+};
+
+
+//Frame rate limiter. Wait() once per frame, it returns at the frame's deadline: sleeps most of the way
+//and spins the last FRAMEPACER_MIN_SLACK..MAX_SLACK so the wake up lands on time despite the OS timer's
+//granularity. Deadlines are a fixed schedule (last deadline + budget), so one slow frame doesn't push every
+//later frame back, but falling more than a frame behind restarts the schedule instead of rushing to catch up.
+//
+//Uncapped (the default) Wait returns immediately and measures nothing. One thread per pacer.
+
+class FramePacer
+{
+public:
+	FramePacer();
+	~FramePacer();
+
+	//0 for no cap
+	void SetTargetFps(double fps);
+	void SetFrameBudget(double seconds);
+	inline double FrameBudget() const { return budget; };
+	inline bool IsCapped() const { return budget > 0.0; };
+
+	//Measure how late short sleeps come back to start the slack off right. Done when a cap is first set.
+	void Calibrate();
+	inline double SleepSlack() const { return sleepSlack; };
+
+	//Next frame's deadline is a budget from now (after a pause, or anything else that wasn't a frame)
+	void Reset();
+
+	//Blocks until this frame's deadline, returns the seconds waited
+	double Wait();
+
+	inline const FramePacingStats& Stats() const { return stats; };
+	void ResetStats();
+
+	double MeanAbsErrorMs() const;
+	double ErrorStdDevMs() const;
+
+private:
+
+	FramePacer(const FramePacer&);
+	FramePacer& operator=(const FramePacer&);
+
+	void RaiseTimerResolution(bool raise);
+
+	double	secondsPerCount;
+	double	budget;
+	double	sleepSlack;
+	bool	bCalibrated;
+	bool	bTimerRaised;
+
+	int64_t nextDeadline;		//0 until the first Wait after a Reset
+	int64_t lastFrameEnd;
+
+	FramePacingStats stats;
+};
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+#include "FrameStats.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+FrameStats::FrameStats()
+	: head(0), count(0), totalFrames(0), totalHitches(0), avgFrameMs(0.0), lastFrameMs(0.0),
+	hitchFactor(2.0), hitchMinMs(4.0)
+{
+	//The only allocations, everything after this reuses these
+	ring.resize(FRAMESTATS_CAPACITY);
+	scratch.resize(FRAMESTATS_CAPACITY);
+
+	Reset();
+}
+
+void FrameStats::Reset()
+{
+	head = 0;
+	count = 0;
+	totalFrames = 0;
+	totalHitches = 0;
+	avgFrameMs = 0.0;
+	lastFrameMs = 0.0;
+	memset(lifetimeHistogram, 0, sizeof(lifetimeHistogram));
+}
+
+double FrameStats::WindowSeconds(FrameStatsWindow window)
+{
+	switch (window)
+	{
+	case FRAMESTATS_WINDOW_1S:	return 1.0;
+	case FRAMESTATS_WINDOW_10S:	return 10.0;
+	case FRAMESTATS_WINDOW_60S:	return 60.0;
+	default:					return 0.0;
+	}
+}
+
+int FrameStats::BucketForMs(double ms)
+{
+	if (ms <= FRAMESTATS_HISTOGRAM_MIN_MS)
+		return 0;
+
+	int bucket = (int)(log2(ms / FRAMESTATS_HISTOGRAM_MIN_MS) * FRAMESTATS_BUCKETS_PER_OCTAVE);
+	return std::min(bucket, FRAMESTATS_HISTOGRAM_BUCKETS - 1);
+}
+
+double FrameStats::BucketLowerMs(int bucket)
+{
+	if (bucket <= 0)
+		return 0.0;
+
+	return FRAMESTATS_HISTOGRAM_MIN_MS * pow(2.0, (double)bucket / FRAMESTATS_BUCKETS_PER_OCTAVE);
+}
+
+void FrameStats::AddFrame(double timestamp, double frameTime)
+{
+	double ms = frameTime * 1000.0;
+	if (ms < 0.0)
+		ms = 0.0;
+
+	//Compare against the average before this frame is folded in, otherwise a long hitch hides itself
+	bool bHitch = (totalFrames > 0) && (ms >= hitchMinMs) && (ms > avgFrameMs * hitchFactor);
+
+	//~0.5 s time constant at 60 fps
+	if (totalFrames == 0)
+		avgFrameMs = ms;
+	else
+		avgFrameMs += (ms - avgFrameMs) * (1.0 / 32.0);
+
+	Sample &s = ring[head];
+	s.timestamp = timestamp;
+	s.frameMs = (float)ms;
+	s.bucket = (uint8_t)BucketForMs(ms);
+	s.hitch = bHitch ? 1 : 0;
+
+	head = (head + 1) & (FRAMESTATS_CAPACITY - 1);
+	if (count < FRAMESTATS_CAPACITY)
+		++count;
+
+	++lifetimeHistogram[s.bucket];
+	++totalFrames;
+	if (bHitch)
+		++totalHitches;
+
+	lastFrameMs = ms;
+}
+
+//Nearest rank index for percentile p of n samples
+static uint32_t PercentileRank(uint32_t n, double p)
+{
+	uint32_t rank = (uint32_t)ceil(p * n);
+	if (rank > 0)
+		--rank;
+	if (rank >= n)
+		rank = n - 1;
+	return rank;
+}
+
+bool FrameStats::Query(FrameStatsWindow window, FrameStatsSummary &out) const
+{
+	memset(&out, 0, sizeof(out));
+
+	if (count == 0)
+		return false;
+
+	uint32_t newest = (head - 1) & (FRAMESTATS_CAPACITY - 1);
+	double cutoff = ring[newest].timestamp - WindowSeconds(window);
+
+	double sumMs = 0.0;
+	double oldestTimestamp = ring[newest].timestamp;
+	uint32_t n = 0;
+
+	out.minMs = 1e30;
+
+	//Walk backwards from the newest frame until we leave the window
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const Sample &s = ring[(newest - i) & (FRAMESTATS_CAPACITY - 1)];
+		if (s.timestamp <= cutoff)
+			break;
+
+		scratch[n++] = s.frameMs;
+		sumMs += s.frameMs;
+		oldestTimestamp = s.timestamp - s.frameMs * 0.001;
+
+		out.minMs = std::min(out.minMs, (double)s.frameMs);
+		out.maxMs = std::max(out.maxMs, (double)s.frameMs);
+		out.hitchCount += s.hitch;
+		++out.histogram[s.bucket];
+	}
+
+	if (n == 0)
+	{
+		out.minMs = 0.0;
+		return false;
+	}
+
+	out.frameCount = n;
+	out.windowSeconds = ring[newest].timestamp - oldestTimestamp;
+	out.avgMs = sumMs / n;
+	out.avgFps = (out.windowSeconds > 0.0) ? n / out.windowSeconds : 0.0;
+
+	//Each nth_element leaves everything below the pivot <= it, so go high to low and shrink the range
+	float *data = &scratch[0];
+	uint32_t r99 = PercentileRank(n, 0.99);
+	uint32_t r95 = PercentileRank(n, 0.95);
+	uint32_t r50 = PercentileRank(n, 0.50);
+
+	std::nth_element(data, data + r99, data + n);
+	std::nth_element(data, data + r95, data + r99 + 1);
+	std::nth_element(data, data + r50, data + r95 + 1);
+
+	out.p99Ms = data[r99];
+	out.p95Ms = data[r95];
+	out.p50Ms = data[r50];
+
+	return true;
+}
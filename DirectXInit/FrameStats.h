@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <vector>
+
+
+//Ring capacity in frames, needs to hold the longest window at the highest frame rate we care about
+//(60s at ~270 fps). Power of two.
+const uint32_t FRAMESTATS_CAPACITY = 16384;
+
+//Log scale histogram, 4 buckets per octave starting at 0.25 ms, top bucket is everything >= ~1 s
+const int   FRAMESTATS_HISTOGRAM_BUCKETS = 48;
+const int   FRAMESTATS_BUCKETS_PER_OCTAVE = 4;
+const float FRAMESTATS_HISTOGRAM_MIN_MS = 0.25f;
+
+enum FrameStatsWindow
+{
+	FRAMESTATS_WINDOW_1S = 0,
+	FRAMESTATS_WINDOW_10S,
+	FRAMESTATS_WINDOW_60S,
+	FRAMESTATS_WINDOW_COUNT,
+};
+
+
+struct FrameStatsSummary
+{
+	uint32_t frameCount;
+	double   windowSeconds;		//Time actually covered by the frames in the window
+	double   avgFps;
+	double   avgMs;
+	double   minMs;
+	double   p50Ms;
+	double   p95Ms;
+	double   p99Ms;
+	double   maxMs;
+	uint32_t hitchCount;
+	uint32_t histogram[FRAMESTATS_HISTOGRAM_BUCKETS];
+};
+
+
+//Frame time statistics. AddFrame is O(1) and never allocates, everything lives in a ring that is
+//allocated once in the constructor. Query computes percentiles/histograms for a rolling window
+//using a scratch buffer that is also preallocated.
+//Not thread safe, AddFrame and Query should come from the same thread (the one running frames).
+
+class FrameStats
+{
+public:
+	FrameStats();
+
+	void Reset();
+
+	//timestamp is the timer's total time at the end of the frame, frameTime its delta. Both seconds.
+	void AddFrame(double timestamp, double frameTime);
+
+	//False if there are no frames in the window yet
+	bool Query(FrameStatsWindow window, FrameStatsSummary &out) const;
+
+	//A frame is a hitch when it takes longer than hitchFactor times the recent average, and at least hitchMinMs
+	inline void SetHitchThreshold(double factor, double minMs) { hitchFactor = factor; hitchMinMs = minMs; };
+
+	inline uint64_t TotalFrames() const { return totalFrames; };
+	inline uint64_t TotalHitches() const { return totalHitches; };
+	inline double   LastFrameMs() const { return lastFrameMs; };
+	inline const uint64_t* LifetimeHistogram() const { return lifetimeHistogram; };
+
+	static double WindowSeconds(FrameStatsWindow window);
+	static int    BucketForMs(double ms);
+	static double BucketLowerMs(int bucket);
+
+private:
+
+	struct Sample
+	{
+		double  timestamp;
+		float   frameMs;
+		uint8_t bucket;
+		uint8_t hitch;
+	};
+
+	std::vector<Sample> ring;
+	uint32_t head;		//Next slot to write
+	uint32_t count;		//Valid samples, <= FRAMESTATS_CAPACITY
+
+	uint64_t totalFrames;
+	uint64_t totalHitches;
+	uint64_t lifetimeHistogram[FRAMESTATS_HISTOGRAM_BUCKETS];
+
+	//Exponential moving average of frame time, for hitch detection
+	double avgFrameMs;
+	double lastFrameMs;
+	double hitchFactor;
+	double hitchMinMs;
+
+	//Query scratch, sized to the ring up front
+	mutable std::vector<float> scratch;
+};
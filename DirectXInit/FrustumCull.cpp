@@ -0,0 +1,283 @@
+#include "stdafx.h"
+
+#include "FrustumCull.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <math.h>
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Every plane component in every lane, plus the normals' absolute values for the box test
+struct FrustumLanes
+{
+	SimdF8 nx[FRUSTUM_PLANE_COUNT], ny[FRUSTUM_PLANE_COUNT], nz[FRUSTUM_PLANE_COUNT], d[FRUSTUM_PLANE_COUNT];
+	SimdF8 ax[FRUSTUM_PLANE_COUNT], ay[FRUSTUM_PLANE_COUNT], az[FRUSTUM_PLANE_COUNT];
+};
+
+static void LoadFrustumLanes(FrustumLanes &out, const Frustum &frustum)
+{
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+	{
+		const Float4 &plane = frustum.planes[p];
+		out.nx[p] = F8Splat(plane.x);
+		out.ny[p] = F8Splat(plane.y);
+		out.nz[p] = F8Splat(plane.z);
+		out.d[p] = F8Splat(plane.w);
+		out.ax[p] = F8Splat(fabsf(plane.x));
+		out.ay[p] = F8Splat(fabsf(plane.y));
+		out.az[p] = F8Splat(fabsf(plane.z));
+	}
+}
+
+
+Frustum FrustumFromMatrix(const Mat4 &viewProjection)
+{
+	//Clip space is v * M, so each clip coordinate is v dotted with a column. Inside is -w <= x <= w,
+	//-w <= y <= w and 0 <= z <= w.
+	Float4x4 m;
+	StoreFloat4x4(m, viewProjection);
+
+	Vec4 column[4];
+	for (int c = 0; c < 4; ++c)
+		column[c] = Vec4Set(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+
+	Vec4 planes[FRUSTUM_PLANE_COUNT];
+	planes[FRUSTUM_LEFT] = column[3] + column[0];
+	planes[FRUSTUM_RIGHT] = column[3] - column[0];
+	planes[FRUSTUM_BOTTOM] = column[3] + column[1];
+	planes[FRUSTUM_TOP] = column[3] - column[1];
+	planes[FRUSTUM_NEAR] = column[2];
+	planes[FRUSTUM_FAR] = column[3] - column[2];
+
+	Frustum frustum;
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+	{
+		float length = Length3(planes[p]);
+		StoreFloat4(frustum.planes[p], length > 0.0f ? planes[p] * (1.0f / length) : planes[p]);
+	}
+
+	return frustum;
+}
+
+Frustum FrustumFromCamera(const Mat4 &view, float fovY, float aspect, float zNear, float zFar)
+{
+	return FrustumFromMatrix(view * Mat4PerspectiveFovLH(fovY, aspect, zNear, zFar));
+}
+
+//Same sums in the same order as the kernel below, so both agree on what's exactly on a plane (without FMA)
+bool FrustumTestSphere(const Frustum &frustum, const Float3 &center, float radius)
+{
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+	{
+		const Float4 &plane = frustum.planes[p];
+		if (center.x * plane.x + (center.y * plane.y + (center.z * plane.z + (plane.w + radius))) < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+bool FrustumTestBox(const Frustum &frustum, const Float3 &center, const Float3 &extents)
+{
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+	{
+		const Float4 &plane = frustum.planes[p];
+		float reach = extents.x * fabsf(plane.x) + (extents.y * fabsf(plane.y) + extents.z * fabsf(plane.z));
+		if (center.x * plane.x + (center.y * plane.y + (center.z * plane.z + (plane.w + reach))) < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+
+FrustumCuller::FrustumCuller()
+	: bHasBoxes(false), visibleCount(0)
+{
+}
+
+void FrustumCuller::Reserve(uint32_t count)
+{
+	for (int e = 0; e < CULL_BOUNDS_COUNT; ++e)
+		bounds[e].reserve(count);
+	visible.reserve(count);
+}
+
+void FrustumCuller::Clear()
+{
+	for (int e = 0; e < CULL_BOUNDS_COUNT; ++e)
+		bounds[e].clear();
+	visible.clear();
+	visibleCount = 0;
+	bHasBoxes = false;
+}
+
+uint32_t FrustumCuller::AddSphere(const Float3 &center, float radius)
+{
+	for (int e = 0; e < CULL_BOUNDS_COUNT; ++e)
+		bounds[e].push_back(0.0f);
+
+	uint32_t index = Count() - 1;
+	SetSphere(index, center, radius);
+	return index;
+}
+
+uint32_t FrustumCuller::AddBox(const Float3 &center, const Float3 &extents)
+{
+	for (int e = 0; e < CULL_BOUNDS_COUNT; ++e)
+		bounds[e].push_back(0.0f);
+
+	uint32_t index = Count() - 1;
+	SetBox(index, center, extents);
+	return index;
+}
+
+void FrustumCuller::SetSphere(uint32_t index, const Float3 &center, float radius)
+{
+	bounds[CULL_CENTER_X][index] = center.x;
+	bounds[CULL_CENTER_Y][index] = center.y;
+	bounds[CULL_CENTER_Z][index] = center.z;
+	bounds[CULL_RADIUS][index] = radius;
+	bounds[CULL_EXTENT_X][index] = radius;
+	bounds[CULL_EXTENT_Y][index] = radius;
+	bounds[CULL_EXTENT_Z][index] = radius;
+}
+
+void FrustumCuller::SetBox(uint32_t index, const Float3 &center, const Float3 &extents)
+{
+	bounds[CULL_CENTER_X][index] = center.x;
+	bounds[CULL_CENTER_Y][index] = center.y;
+	bounds[CULL_CENTER_Z][index] = center.z;
+	bounds[CULL_RADIUS][index] = sqrtf(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+	bounds[CULL_EXTENT_X][index] = extents.x;
+	bounds[CULL_EXTENT_Y][index] = extents.y;
+	bounds[CULL_EXTENT_Z][index] = extents.z;
+	bHasBoxes = true;
+}
+
+
+uint32_t FrustumCuller::CullRange(const Frustum &frustum, uint32_t begin, uint32_t end, uint32_t *out) const
+{
+	FrustumLanes planes;
+	LoadFrustumLanes(planes, frustum);
+
+	const float *cx = &bounds[CULL_CENTER_X][0];
+	const float *cy = &bounds[CULL_CENTER_Y][0];
+	const float *cz = &bounds[CULL_CENTER_Z][0];
+	const float *radius = &bounds[CULL_RADIUS][0];
+	const float *ex = &bounds[CULL_EXTENT_X][0];
+	const float *ey = &bounds[CULL_EXTENT_Y][0];
+	const float *ez = &bounds[CULL_EXTENT_Z][0];
+
+	SimdF8 zero = F8Zero();
+	uint32_t count = 0;
+
+	uint32_t i = begin;
+	for (; i + MATH_SOA_LANES <= end; i += MATH_SOA_LANES)
+	{
+		SimdF8 x = F8Load(cx + i), y = F8Load(cy + i), z = F8Load(cz + i), r = F8Load(radius + i);
+
+		SimdF8 outside = zero;
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+		{
+			SimdF8 distance = F8MulAdd(x, planes.nx[p], F8MulAdd(y, planes.ny[p], F8MulAdd(z, planes.nz[p], F8Add(planes.d[p], r))));
+			outside = F8Or(outside, F8CmpLt(distance, zero));
+		}
+
+		int mask = ~F8MoveMask(outside) & 0xFF;
+		if (!mask)
+			continue;
+
+		if (bHasBoxes)
+		{
+			SimdF8 sx = F8Load(ex + i), sy = F8Load(ey + i), sz = F8Load(ez + i);
+
+			outside = zero;
+			for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+			{
+				SimdF8 reach = F8MulAdd(sx, planes.ax[p], F8MulAdd(sy, planes.ay[p], F8Mul(sz, planes.az[p])));
+				SimdF8 distance = F8MulAdd(x, planes.nx[p], F8MulAdd(y, planes.ny[p], F8MulAdd(z, planes.nz[p], F8Add(planes.d[p], reach))));
+				outside = F8Or(outside, F8CmpLt(distance, zero));
+			}
+
+			mask &= ~F8MoveMask(outside);
+			if (!mask)
+				continue;
+		}
+
+		//Every lane written, only the visible ones move the end along. No branches to mispredict, and it
+		//never writes past the lanes looked at so far.
+		for (uint32_t lane = 0; lane < MATH_SOA_LANES; ++lane)
+		{
+			out[count] = i + lane;
+			count += (mask >> lane) & 1;
+		}
+	}
+
+	for (; i < end; ++i)
+	{
+		Float3 center = { cx[i], cy[i], cz[i] };
+		Float3 extents = { ex[i], ey[i], ez[i] };
+		if (FrustumTestSphere(frustum, center, radius[i]) && (!bHasBoxes || FrustumTestBox(frustum, center, extents)))
+			out[count++] = i;
+	}
+
+	return count;
+}
+
+uint32_t FrustumCuller::Cull(const Frustum &frustum, JobSystem *jobs)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t count = Count();
+	visible.resize(count);
+	visibleCount = 0;
+
+	if (count == 0)
+		return 0;
+
+	uint32_t pieces = (count + CULL_JOB_OBJECTS - 1) / CULL_JOB_OBJECTS;
+	if (!jobs || pieces == 1)
+	{
+		visibleCount = CullRange(frustum, 0, count, &visible[0]);
+		return visibleCount;
+	}
+
+	//Each piece writes its visible list at its own start, then they're packed down one after another
+	jobCounts.resize(pieces);
+	jobs->ParallelFor(pieces, 1, [this, &frustum, count](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t piece = begin; piece < end; ++piece)
+		{
+			uint32_t first = piece * CULL_JOB_OBJECTS;
+			uint32_t last = first + CULL_JOB_OBJECTS < count ? first + CULL_JOB_OBJECTS : count;
+			jobCounts[piece] = CullRange(frustum, first, last, &visible[first]);
+		}
+	});
+
+	visibleCount = jobCounts[0];
+	for (uint32_t piece = 1; piece < pieces; ++piece)
+	{
+		if (jobCounts[piece])
+			memmove(&visible[visibleCount], &visible[piece * CULL_JOB_OBJECTS], jobCounts[piece] * sizeof(uint32_t));
+		visibleCount += jobCounts[piece];
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "VecMath.h"
+#include <stdint.h>
+#include <vector>
+
+class JobSystem;
+
+
+//Culls bigger than this get split into jobs of this many objects (a multiple of 8)
+const uint32_t CULL_JOB_OBJECTS = 16384;
+
+enum FrustumPlane
+{
+	FRUSTUM_LEFT = 0, FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM, FRUSTUM_TOP,
+	FRUSTUM_NEAR, FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT,
+};
+
+//Planes as (normal, d) with unit normals pointing inwards, a point p is inside one when dot(normal, p) + d >= 0
+struct Frustum
+{
+	Float4 planes[FRUSTUM_PLANE_COUNT];
+};
+
+//From a view * projection (or just a projection, for a frustum in view space) with D3D's 0..1 depth
+Frustum FrustumFromMatrix(const Mat4 &viewProjection);
+
+//Mat4PerspectiveFovLH with these, after view
+Frustum FrustumFromCamera(const Mat4 &view, float fovY, float aspect, float zNear, float zFar);
+
+//One at a time. Conservative: false means surely outside, true means maybe visible (big objects near the
+//frustum's corners can pass without being in it).
+bool FrustumTestSphere(const Frustum &frustum, const Float3 &center, float radius);
+bool FrustumTestBox(const Frustum &frustum, const Float3 &center, const Float3 &extents);
+
+
+//Bounds, structure of arrays. A box's radius is its extents' length, a sphere's extents are its radius.
+enum CullBoundsElement
+{
+	CULL_CENTER_X = 0, CULL_CENTER_Y, CULL_CENTER_Z,
+	CULL_RADIUS,
+	CULL_EXTENT_X, CULL_EXTENT_Y, CULL_EXTENT_Z,
+	CULL_BOUNDS_COUNT,
+};
+
+
+//Frustum culling for lots of objects: bounding spheres or boxes (center and half extents, axis aligned in
+//world space) packed into arrays, tested 8 at a time. Each object gets the sphere test, and once any box
+//was added the box test too for every group of 8 the spheres didn't rule out completely. Cull leaves the
+//indices of the ones that passed, in order, in one packed list for the draw loop to walk.
+//
+//Indices are the order objects were added. Not thread safe, Cull spreads itself over the job system.
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Reserve(uint32_t count);
+	void Clear();
+
+	uint32_t AddSphere(const Float3 &center, float radius);
+	uint32_t AddBox(const Float3 &center, const Float3 &extents);
+
+	void SetSphere(uint32_t index, const Float3 &center, float radius);
+	void SetBox(uint32_t index, const Float3 &center, const Float3 &extents);
+
+	//Fill the visible list, returns its length. jobs may be NULL, otherwise big sets are spread over it.
+	uint32_t Cull(const Frustum &frustum, JobSystem *jobs = NULL);
+
+	inline uint32_t Count() const { return (uint32_t)bounds[CULL_CENTER_X].size(); };
+
+	//As of the last Cull
+	inline uint32_t VisibleCount() const { return visibleCount; };
+	inline const uint32_t* Visible() const { return visible.empty() ? NULL : &visible[0]; };
+
+	inline const float* BoundsData(CullBoundsElement element) const { return bounds[element].empty() ? NULL : &bounds[element][0]; };
+
+private:
+
+	FrustumCuller(const FrustumCuller&);
+	FrustumCuller& operator=(const FrustumCuller&);
+
+	//Objects [begin, end) into out, returns how many were visible. begin a multiple of 8.
+	uint32_t CullRange(const Frustum &frustum, uint32_t begin, uint32_t end, uint32_t *out) const;
+
+	std::vector<float> bounds[CULL_BOUNDS_COUNT];
+	bool bHasBoxes;
+
+	std::vector<uint32_t> visible;			//Count() long, the first visibleCount are the result
+	uint32_t visibleCount;
+	std::vector<uint32_t> jobCounts;		//Visible per CULL_JOB_OBJECTS piece, before packing
+};
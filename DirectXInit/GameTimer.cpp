@@ -0,0 +1,333 @@
+#include "stdafx.h"
+
+#include "GameTimer.h"
+#include "Locks.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <chrono>
+#endif
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+static inline uint64_t DoubleBits(double d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return bits;
+}
+
+static inline double BitsDouble(uint64_t bits)
+{
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+
+bool GameTimer::QueryCounter(int64_t &counter)
+{
+#ifdef _WIN32
+	LARGE_INTEGER li;
+	if (!QueryPerformanceCounter(&li))
+		return false;
+	counter = li.QuadPart;
+	return true;
+#else
+	counter = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return true;
+#endif
+}
+
+bool GameTimer::QueryFrequency(int64_t &ticksPerSec)
+{
+#ifdef _WIN32
+	LARGE_INTEGER li;
+	if (!QueryPerformanceFrequency(&li))
+		return false;
+	ticksPerSec = li.QuadPart;
+	return true;
+#else
+	ticksPerSec = 1000000000;
+	return true;
+#endif
+}
+
+
+//Borrowed from Frank D Luna's excellent DX11 book, added isValid flag and seqlock publishing
+
+GameTimer::GameTimer()
+	: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0),
+	mPausedTime(0), mStopTime(0), mPrevTime(0), mCurrTime(0), mStopped(false), isValid(false),
+	pubSeq(0), pubTotalTime(DoubleBits(0.0)), pubDeltaTime(DoubleBits(-1.0)), pubPaused(0)
+{
+
+	int64_t ticksPerSec;
+	if (!QueryFrequency(ticksPerSec) || ticksPerSec <= 0)
+	{
+		isValid = false;
+		return;
+	}
+	else
+	{
+		mSecondsPerCount = 1.0 / (double)ticksPerSec;
+	}
+
+	isValid = true;
+	return;
+}
+
+
+uint32_t GameTimer::BeginWrite()
+{
+	uint32_t seq = pubSeq.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		//Odd means another writer is in the middle of an update, they are only a few instructions long
+		if (!(seq & 1) && pubSeq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			break;
+
+		LockCpuRelax();
+		seq = pubSeq.load(std::memory_order_relaxed);
+	}
+
+	//Make sure the odd sequence is visible before any of the published values change
+	std::atomic_thread_fence(std::memory_order_release);
+	return seq;
+}
+
+void GameTimer::EndWrite(uint32_t seqAtBegin)
+{
+	pubSeq.store(seqAtBegin + 2, std::memory_order_release);
+}
+
+void GameTimer::Publish()
+{
+	double total;
+
+	//If stopped, do not count time passed since stopped.
+	//If we already had a pause, mStopTime - mBaseTime includes paused time, so we subtract paused time from mStopTime
+	if (mStopped)
+		total = ((mStopTime - mPausedTime) - mBaseTime) * mSecondsPerCount;
+	else
+		total = ((mCurrTime - mPausedTime) - mBaseTime) * mSecondsPerCount;
+
+	pubTotalTime.store(DoubleBits(total), std::memory_order_relaxed);
+	pubDeltaTime.store(DoubleBits(mDeltaTime), std::memory_order_relaxed);
+	pubPaused.store(mStopped ? 1 : 0, std::memory_order_relaxed);
+}
+
+
+void GameTimer::Tick()
+{
+
+	if (!GetIsValid())
+	{
+		return;
+	}
+
+	uint32_t seq = BeginWrite();
+
+	if (mStopped)
+	{
+		mDeltaTime = 0.0;
+		Publish();
+		EndWrite(seq);
+		return;
+	}
+
+	//Get the time this frame.
+	int64_t currTime;
+
+	if (!QueryCounter(currTime))
+	{
+		mDeltaTime = 0.0;
+		isValid = false;
+		Publish();
+		EndWrite(seq);
+		return;
+	}
+
+	mCurrTime = currTime;
+
+	//Diff between this frame and prev
+	mDeltaTime = (mCurrTime - mPrevTime)*mSecondsPerCount;
+
+	//For next frame
+	mPrevTime = mCurrTime;
+
+	//Force nonnegative.
+	if (mDeltaTime < 0.0)
+	{
+		mDeltaTime = 0.0;
+	}
+
+	Publish();
+	EndWrite(seq);
+}
+
+void GameTimer::Reset()
+{
+	if (!GetIsValid())
+	{
+		return;
+	}
+
+	int64_t currTime;
+
+	if (!QueryCounter(currTime))
+	{
+		isValid = false;
+		return;
+	}
+
+	uint32_t seq = BeginWrite();
+
+	mBaseTime = currTime;
+	mPrevTime = currTime;
+	mCurrTime = currTime;
+	mPausedTime = 0;
+	mStopTime = 0;
+	mStopped = false;
+	mDeltaTime = 0.0;
+
+	Publish();
+	EndWrite(seq);
+}
+
+void GameTimer::Stop()
+{
+
+	if (!GetIsValid())
+		return;
+
+	int64_t currTime;
+	if (!QueryCounter(currTime))
+	{
+		isValid = false;
+		return;
+	}
+
+	uint32_t seq = BeginWrite();
+
+	//If stopped, nothing to do
+	if (!mStopped)
+	{
+		mStopTime = currTime;
+		mStopped = true;
+		mDeltaTime = 0.0;
+		Publish();
+	}
+
+	EndWrite(seq);
+}
+
+void GameTimer::Start()
+{
+
+	if (!GetIsValid())
+	{
+		return;
+	}
+
+	int64_t startTime;
+
+	if (!QueryCounter(startTime))
+	{
+		isValid = false;
+		return;
+	}
+
+	uint32_t seq = BeginWrite();
+
+	//If resuming...
+	if (mStopped)
+	{
+
+		//accumulate paused time
+		mPausedTime += (startTime - mStopTime);
+
+		//current prev time not valid, as it was last updated before paused.
+		//Reset prev time to current time.
+
+		mPrevTime = startTime;
+		mCurrTime = startTime;
+
+		//no longer stopped
+		mStopTime = 0;
+		mStopped = false;
+
+		Publish();
+	}
+
+	EndWrite(seq);
+}
+
+
+TimerSnapshot GameTimer::Snapshot() const
+{
+	TimerSnapshot snap;
+
+	for (;;)
+	{
+		uint32_t seqBegin = pubSeq.load(std::memory_order_acquire);
+
+		//Writer in progress, it will be done in a few instructions
+		if (seqBegin & 1)
+		{
+			LockCpuRelax();
+			continue;
+		}
+
+		uint64_t total = pubTotalTime.load(std::memory_order_relaxed);
+		uint64_t delta = pubDeltaTime.load(std::memory_order_relaxed);
+		uint32_t paused = pubPaused.load(std::memory_order_relaxed);
+
+		//Keep the loads above from moving below the second sequence read
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (pubSeq.load(std::memory_order_relaxed) == seqBegin)
+		{
+			snap.totalTime = BitsDouble(total);
+			snap.deltaTime = BitsDouble(delta);
+			snap.paused = (paused != 0);
+			return snap;
+		}
+	}
+}
+
+//And finally TotalTime, returns time since Reset was called (not counting pause time)
+float GameTimer::TotalTime() const
+{
+	//Single value, no need for the sequence dance
+	return (float)BitsDouble(pubTotalTime.load(std::memory_order_acquire));
+}
+
+float GameTimer::DeltaTime() const
+{
+	return (float)BitsDouble(pubDeltaTime.load(std::memory_order_acquire));
+}
+
+bool GameTimer::IsPaused() const
+{
+	return pubPaused.load(std::memory_order_acquire) != 0;
+}
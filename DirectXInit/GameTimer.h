@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <atomic>
+#include <stdint.h>
+
+
+typedef unsigned int TimerHandle;
+
+
+//Consistent view of the timer, everything in here was published by the same Tick/Start/Stop/Reset
+
+struct TimerSnapshot
+{
+	double totalTime;	//In seconds, not counting paused time
+	double deltaTime;	//In seconds, 0 while paused
+	bool   paused;
+};
+
+
+//More or less Frank D. Lunas' "Intro to game programming with Dx11" game timer class, added isValid.
+//
+//State is published through a sequence lock: writers (Tick/Start/Stop/Reset) bump the sequence to odd,
+//update, and bump it back to even. Readers never take a lock, they copy the published values and retry
+//only if a write overlapped the copy. So any thread can call TotalTime/DeltaTime/Snapshot and the
+//thread calling Tick() in Run() never waits on a reader.
+//Writers are serialized against each other on the sequence (Start/Stop can come from the message thread).
+
+class GameTimer
+{
+
+public:
+	GameTimer();
+
+	float TotalTime() const;	//In seconds
+	float DeltaTime() const;	//In seconds
+	bool  IsPaused() const;
+
+	TimerSnapshot Snapshot() const;
+
+	void Reset();	// Call before message loop
+	void Start();	// Call when unpaused
+	void Stop();	// Call when paused
+	void Tick();	// Call every frame
+
+	inline bool GetIsValid() const { return isValid.load(std::memory_order_relaxed); };
+	inline double SecondsPerCount() const { return mSecondsPerCount; };
+
+	//Raw high resolution counter (QueryPerformanceCounter on windows, steady_clock elsewhere)
+	static bool QueryCounter(int64_t &counter);
+	static bool QueryFrequency(int64_t &ticksPerSec);
+
+private:
+
+	//Writer side of the seqlock, BeginWrite spins only if another writer is mid update
+	uint32_t BeginWrite();
+	void EndWrite(uint32_t seqAtBegin);
+
+	//Recompute and store the published values, call between BeginWrite/EndWrite
+	void Publish();
+
+	double mSecondsPerCount;
+
+	//Writer owned state, only touched between BeginWrite/EndWrite
+	double mDeltaTime;
+
+	int64_t mBaseTime;
+	int64_t mPausedTime;
+	int64_t mStopTime;
+	int64_t mPrevTime;
+	int64_t mCurrTime;
+
+	bool mStopped;
+	std::atomic<bool> isValid;
+
+	//Published state. Doubles are stored as their bit patterns so readers can load them atomically.
+	std::atomic<uint32_t> pubSeq;
+	std::atomic<uint64_t> pubTotalTime;
+	std::atomic<uint64_t> pubDeltaTime;
+	std::atomic<uint32_t> pubPaused;
+
+};
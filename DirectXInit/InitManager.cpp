@@ -1,16 +1,13 @@
-#pragma once
 #include "stdafx.h"
-#include "DirectXInit.h"
-#include <xnamath.h>
-#include <Windows.h>
-#include <d3d11.h>
 #include "InitManager.h"
-#include <tchar.h>
+#include "NullRenderDevice.h"
+#include "GameTimer.h"
 #include <string>
 #include <map>
 #include <algorithm>
+#include <assert.h>
 #include "ScopeLock.h"
-#include "d3dUtil.h"
+#include "Profiler.h"
 
 
 /*
@@ -34,94 +31,110 @@ Inspired, and in some cases copied, from Frank D. Luna's book "Intro to game pro
 
 
 
-
-inline bool COMRelease(IUnknown *targetCOM)
+const char* MgrStageName(MgrInitStage stage)
 {
+	static const char *names[MGR_STAGE_COUNT] =
+	{
+		"CreateDeviceAndContext", "Check4xMSAASupport", "DescribeSwapChain", "CreateSwapChain",
+		"CreateRenderTargetView", "CreateDepthStencilBufferAndView", "BindViewsToOutput", "SetDefaultViewport",
+	};
 
-	if (targetCOM <= 0)
-		return false;
-	else
-		targetCOM->Release();
-	targetCOM = NULL;
-	return true;
-
+	return (stage >= 0 && stage < MGR_STAGE_COUNT) ? names[stage] : "?";
 }
 
+//Stamps when an init call started and returned, whichever way it returned
+struct MgrStageStamp
+{
+	MgrStageStamp(MgrStageTiming &stageTiming) : timing(stageTiming)
+	{
+		timing.endCounter = 0;
+		GameTimer::QueryCounter(timing.startCounter);
+	}
+
+	~MgrStageStamp()
+	{
+		GameTimer::QueryCounter(timing.endCounter);
+	}
+
+	MgrStageTiming &timing;
+};
 
-//TODO: Make an inline function for if any calls fail, to automatically release any com interfaces we have aqquired depending on mgrState
 
 DirectXManager::DirectXManager() : 
-	curDevice(NULL), curDeviceContext(NULL), mutexHandle(NULL), mgrState(STATE_MGR_FREE), lastValidState(STATE_MGR_FREE), 
-	curSwapChain(NULL), bbRenderTargetView(NULL)
+	mgrState(STATE_MGR_FREE), lastValidState(STATE_MGR_FREE), use4XMSAA(false), wHeight(0), wWidth(0), wWindowed(1),
+	m4xMsaaQuality(0), wCurWnd(NULL), mgrLock("MGR_MUTEX"), isLocked(false)
 {
-	mutexHandle = CreateMutex(NULL, false, _T("MGR_MUTEX"));
-	if (mutexHandle <= 0)
-	{
-		mgrState = STATE_INIT_ERROR;
-	}
+	ZeroMemory(&curSwapChainDesc, sizeof(curSwapChainDesc));
+	ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
+	ZeroMemory(&curViewport, sizeof(curViewport));
+	ZeroMemory(stageTimings, sizeof(stageTimings));
+
+#ifdef _WIN32
+	d3dDevice = new D3D11RenderDevice();
+	renderDevice.reset(d3dDevice);
+#else
+	renderDevice.reset(new NullRenderDevice());
+#endif
+}
+
+bool DirectXManager::SetDevice(IRenderDevice *device)
+{
+	if (!device || GetCurrentState() != STATE_MGR_FREE)
+		return false;
+
+	ScopeLock<MgrMutex> lock(mgrLock);
+
+	renderDevice.reset(device);
+
+#ifdef _WIN32
+	d3dDevice = (device->Type() == RENDER_DEVICE_D3D11) ? static_cast<D3D11RenderDevice*>(device) : NULL;
+#endif
+
+	return true;
 }
 
 
 HRESULT DirectXManager::CreateDeviceAndContext()
 {
-	if (mutexHandle <= 0 || mgrState == STATE_INIT_ERROR)
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_CREATE_DEVICE]);
+
+	if (GetCurrentState() == STATE_INIT_ERROR)
 		return -1;
 
 	//Lock is released in destructor when going out of context
-	ScopeLock lock(mutexHandle);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	D3D_FEATURE_LEVEL checkForDX11[1];
-	checkForDX11[0] = D3D_FEATURE_LEVEL_11_0;
-	D3D_FEATURE_LEVEL highestFeatureLevel;
+	HRESULT retRes = renderDevice->CreateDevice();
 
-	HRESULT retRes = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL,
-
-		//Specify debug flag if in debug mode...
-#ifdef _DEBUG
-		D3D11_CREATE_DEVICE_DEBUG
-#else
-		NULL
-#endif
-		, checkForDX11,
-		1,
-		D3D11_SDK_VERSION,
-		&curDevice,
-		&highestFeatureLevel,
-		&curDeviceContext
-		);
-
-	//Make sure we didn't fail and that the device supports D3D 11
+	//Make sure we didn't fail (the device checks for D3D 11 support itself)
 	if (FAILED(retRes))
 	{
-		mgrState = STATE_INIT_ERROR;
-		return retRes;
-	}
-	else if (highestFeatureLevel < D3D_FEATURE_LEVEL_11_0)
-	{
-		lastValidState = mgrState = STATE_MGR_INIT;
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return retRes;
 	}
 
-	lastValidState = mgrState = STATE_MGR_INIT;
+	lastValidState = STATE_MGR_INIT;
+	SetState(STATE_MGR_INIT);
 	return retRes;
 
 }
 
 HRESULT DirectXManager::Check4xMSAASupport()
 {
-	if (mutexHandle <= 0 || mgrState != STATE_MGR_INIT)
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_CHECK_MSAA]);
+
+	if (GetCurrentState() != STATE_MGR_INIT)
 		return -1;
 
 	//Lock is released in destructor when going out of context
-	ScopeLock lock(mutexHandle);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
 	UINT retQuality = 0;
-	HRESULT retRes = curDevice->CheckMultisampleQualityLevels(DXGI_FORMAT_R8G8B8A8_UNORM, 4, &retQuality);
+	HRESULT retRes = renderDevice->CheckMultisampleQuality(4, retQuality);
 
 	if (FAILED(retRes))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return retRes;
 	}
 	
@@ -134,23 +147,26 @@ HRESULT DirectXManager::Check4xMSAASupport()
 
 HRESULT DirectXManager::DescribeSwapChain(bool switchMSAA, bool fullScreen, UINT width, UINT height, HWND nCurWnd)
 {
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_DESCRIBE_SWAP_CHAIN]);
+
 	//Add support for fullscreen later, will need to refactor a bit
-	if (mutexHandle <= 0 || mgrState != STATE_MGR_INIT)
+	if (GetCurrentState() != STATE_MGR_INIT)
 	{
 		return -1;
 	}
 
 	//Lock is released in destructor when going out of context
-	ScopeLock lock(mutexHandle);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	if (nCurWnd <= 0)
+	//Headless devices don't present anywhere
+	if (nCurWnd == NULL && renderDevice->NeedsWindow())
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
 	//Zero out the swap chain descriptor structure
-	ZeroMemory(&curSwapChainDesc, sizeof(DXGI_SWAP_CHAIN_DESC));
+	ZeroMemory(&curSwapChainDesc, sizeof(curSwapChainDesc));
 
 	//Set the flag for msaa, we don't just specify it in a param so we can return later whether
 	//enabled or not.
@@ -166,114 +182,59 @@ HRESULT DirectXManager::DescribeSwapChain(bool switchMSAA, bool fullScreen, UINT
 		wWindowed = 1;
 
 	//Fill out of the swap chain back buffer
-	curSwapChainDesc.BufferDesc.Width = width;
-	curSwapChainDesc.BufferDesc.Height = height;
+	curSwapChainDesc.width = width;
+	curSwapChainDesc.height = height;
 
 	//TODO: Add non-default refresh rate check
-	curSwapChainDesc.BufferDesc.RefreshRate.Numerator = 60;
-	curSwapChainDesc.BufferDesc.RefreshRate.Denominator = 1;
-
-	curSwapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;	//Monitor doesn't output the alpha but we can use it for extra effects later
-	curSwapChainDesc.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;	//Leave it up to the adapter
-	curSwapChainDesc.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;	//Leave it up to the adapter
+	curSwapChainDesc.refreshNumerator = 60;
+	curSwapChainDesc.refreshDenominator = 1;
 
 	if (use4XMSAA)
 	{
-		curSwapChainDesc.SampleDesc.Count = 4;
+		curSwapChainDesc.sampleCount = 4;
 
 		//We got quality from CheckMultisampleQualityLevels earlier..
-		curSwapChainDesc.SampleDesc.Quality = m4xMsaaQuality - 1;
+		curSwapChainDesc.sampleQuality = m4xMsaaQuality - 1;
 	}
 	//Else no MSAA
 	else
 	{
-		curSwapChainDesc.SampleDesc.Count = 1;
-		curSwapChainDesc.SampleDesc.Quality = 0;
+		curSwapChainDesc.sampleCount = 1;
+		curSwapChainDesc.sampleQuality = 0;
 	}
 
-	//We will be rendering to the back buffer...
-	curSwapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 	//Double buffering for now, make triple buffering an option later TODO
-	curSwapChainDesc.BufferCount = 1;
+	curSwapChainDesc.bufferCount = 1;
 	//Set output window to current window...
-	curSwapChainDesc.OutputWindow = wCurWnd;
-	curSwapChainDesc.Windowed = wWindowed > 0 ? true : false;
+	curSwapChainDesc.outputWindow = wCurWnd;
+	curSwapChainDesc.windowed = wWindowed > 0 ? true : false;
 
-	//Let the adapter choose the most efficient presentation method
-	curSwapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-	curSwapChainDesc.Flags = 0;
-
-	lastValidState = mgrState = STATE_MGR_SWAP_CHAIN_DESCR_CREATED;
+	lastValidState = STATE_MGR_SWAP_CHAIN_DESCR_CREATED;
+	SetState(STATE_MGR_SWAP_CHAIN_DESCR_CREATED);
 	return 0;
 }
 
 //Create an instance of the swap chain
 HRESULT DirectXManager::CreateSwapChain()
 {
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_CREATE_SWAP_CHAIN]);
 
-	if (mgrState != STATE_MGR_SWAP_CHAIN_DESCR_CREATED || mutexHandle <= 0)
-	{
-		mgrState = STATE_INIT_ERROR;
-		return -1;
-	}
-
-	//We need to get the instanc eof the IDXGIFactory used to create the device...
-	//Time for COM queries...
-
-	IDXGIDevice *dxgiDevice = NULL;
-
-	if (FAILED(curDevice->QueryInterface(__uuidof(IDXGIDevice),
-		(void**)&dxgiDevice)))
-	{
-		DWORD errorWord = GetLastError();
-		mgrState = STATE_INIT_ERROR;
-		return -1;
-	}
-
-	//Get the adapter
-	IDXGIAdapter *dxgiAdapter = NULL;
-
-	if (FAILED(dxgiDevice->GetParent(__uuidof(IDXGIAdapter),
-		(void**)&dxgiAdapter)))
+	if (GetCurrentState() != STATE_MGR_SWAP_CHAIN_DESCR_CREATED)
 	{
-		//Release what we have so far
-		COMRelease(dxgiDevice);
-
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	//Finally get the factory interface
-	IDXGIFactory *dxgiFactory = NULL;
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	if (FAILED(dxgiAdapter->GetParent(__uuidof(IDXGIFactory),
-		(void**)&dxgiFactory)))
+	if (FAILED(renderDevice->CreateSwapChain(curSwapChainDesc)))
 	{
-		//Free the other interfaces we have succesfully aqquired
-		COMRelease(dxgiDevice);
-		COMRelease(dxgiAdapter);
-
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	//Now create the swap chain
-	IDXGISwapChain *mSwapChain = NULL;
-	if (FAILED(dxgiFactory->CreateSwapChain(curDevice, &curSwapChainDesc, &mSwapChain)))
-	{
-		COMRelease(dxgiDevice);
-		COMRelease(dxgiAdapter);
-		COMRelease(dxgiFactory);
-		mgrState = STATE_INIT_ERROR;
-		return -1;
-	}
-
-	COMRelease(dxgiDevice);
-	COMRelease(dxgiAdapter);
-	COMRelease(dxgiFactory);
-
-	curSwapChain = mSwapChain;
-	lastValidState = mgrState = STATE_MGR_SWAP_CHAIN_CREATED;
+	lastValidState = STATE_MGR_SWAP_CHAIN_CREATED;
+	SetState(STATE_MGR_SWAP_CHAIN_CREATED);
 	
 	return 0;
 }
@@ -281,141 +242,128 @@ HRESULT DirectXManager::CreateSwapChain()
 //Create a render target view for the back buffer of the swap chain
 HRESULT DirectXManager::CreateRenderTargetView()
 {
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_RENDER_TARGET_VIEW]);
 
-	if (mgrState != STATE_MGR_SWAP_CHAIN_CREATED || mutexHandle <= 0)
+	if (GetCurrentState() != STATE_MGR_SWAP_CHAIN_CREATED)
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	ScopeLock lock(mutexHandle);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	//Handle to back buffer
-	ID3D11Texture2D *backBuffer;
-
-	//Get a pointer to the swap chain back buffer, for now just double buffering so index 0
-	if (FAILED(curSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&backBuffer)))
+	if (FAILED(renderDevice->CreateBackBufferView()))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	//Create a render target view to the back buffer. We can leave this NULL since we specified the type of the resource earlier.
-	if (FAILED(curDevice->CreateRenderTargetView(backBuffer, NULL, &bbRenderTargetView)))
-	{
-		//Release the handle to the back buffer in either case
-		COMRelease(backBuffer);
-		mgrState = STATE_INIT_ERROR;
-		return -1;
-	}
-	else
-		COMRelease(backBuffer);
-
-	lastValidState = mgrState = STATE_MGR_RENDER_TARGET_VIEW_CREATED;
+	lastValidState = STATE_MGR_RENDER_TARGET_VIEW_CREATED;
+	SetState(STATE_MGR_RENDER_TARGET_VIEW_CREATED);
 	return 0;
 }
 
-//Create the depth/stencil texture and a view which we can bind to
-
-HRESULT DirectXManager::CreateDepthStencilBufferAndView()
+//Depth/stencil buffer matches the back buffer: our stored size and the msaa settings
+void DirectXManager::FillDepthStencilDesc()
 {
-	if (mgrState != STATE_MGR_RENDER_TARGET_VIEW_CREATED || mutexHandle <= 0)
-	{
-		mgrState = STATE_INIT_ERROR;
-		return -1;
-	}
-
-
+	ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
 
-	//Zero out the depthStencilDesc struct
-	ZeroMemory(&depthStencilDesc, sizeof(D3D11_TEXTURE2D_DESC));
-
-	//Set the width and height based on our stored values
-	depthStencilDesc.Width = wWidth;
-	depthStencilDesc.Height = wHeight;
-
-	//Mip levels and array size are 1 for depth/stencil buffer
-	depthStencilDesc.MipLevels = 1;
-	depthStencilDesc.ArraySize = 1;
-
-	//24 bits normalized to [0,1] for depth and 8 bits for -128, 127, for stencil.
-	depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthStencilDesc.width = wWidth;
+	depthStencilDesc.height = wHeight;
 
 	if (use4XMSAA)
 	{
-		depthStencilDesc.SampleDesc.Count = 4;
-		depthStencilDesc.SampleDesc.Quality = m4xMsaaQuality - 1;
+		depthStencilDesc.sampleCount = 4;
+		depthStencilDesc.sampleQuality = m4xMsaaQuality - 1;
 	}
 	else
 	{
-		depthStencilDesc.SampleDesc.Count = 1;
-		depthStencilDesc.SampleDesc.Quality = 0;
+		depthStencilDesc.sampleCount = 1;
+		depthStencilDesc.sampleQuality = 0;
 	}
+}
 
-	depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-	depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	depthStencilDesc.CPUAccessFlags = 0;
-	depthStencilDesc.MiscFlags = 0;
+//Create the depth/stencil texture and a view which we can bind to
+
+HRESULT DirectXManager::CreateDepthStencilBufferAndView()
+{
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_DEPTH_STENCIL]);
 
-	//returns pointer to depth/stencil buffer in mDepthStencilBuffer on success
-	if (FAILED(curDevice->CreateTexture2D(&depthStencilDesc, NULL, &mDepthStencilBuffer)))
+	if (GetCurrentState() != STATE_MGR_RENDER_TARGET_VIEW_CREATED)
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	//takes pointer to the resource we want to create a view for, returns pointer to view in mDepthStencilView
-	if (FAILED(curDevice->CreateDepthStencilView(mDepthStencilBuffer, NULL, &mDepthStencilView)))
+	ScopeLock<MgrMutex> lock(mgrLock);
+
+	FillDepthStencilDesc();
+
+	if (FAILED(renderDevice->CreateDepthStencil(depthStencilDesc)))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	lastValidState = mgrState = STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED;
+	lastValidState = STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED;
+	SetState(STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED);
 	return 0;
 }
 
 //Bind the views to the output merger state
 HRESULT DirectXManager::BindBackBufferAndDepthBufferViewsToOutput()
 {
-	if (mgrState != STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED || mutexHandle <= 0)
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_BIND_VIEWS]);
+
+	if (GetCurrentState() != STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED)
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	curDeviceContext->OMSetRenderTargets(1, &bbRenderTargetView, mDepthStencilView);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	lastValidState = mgrState = STATE_MGR_VIEWS_BOUND_TO_OUTPUT;
+	renderDevice->BindViews();
+
+	lastValidState = STATE_MGR_VIEWS_BOUND_TO_OUTPUT;
+	SetState(STATE_MGR_VIEWS_BOUND_TO_OUTPUT);
 	return 0;
 }
 
 
+void DirectXManager::FillViewport(float x, float y)
+{
+	ZeroMemory(&curViewport, sizeof(curViewport));
+
+	curViewport.topLeftX = x;
+	curViewport.topLeftY = y;
+	curViewport.width = (float)wWidth;
+	curViewport.height = (float)wHeight;
+
+	//Keep the min/max depth at the default of [0,1]
+	curViewport.minDepth = 0.0f;
+	curViewport.maxDepth = 1.0f;
+}
+
 //Set the viewport to the back buffer
 //Leave these default 0 for now
 HRESULT DirectXManager::SetDefaultViewport(float altX, float altY)
 {
-	if (mgrState != STATE_MGR_VIEWS_BOUND_TO_OUTPUT || mutexHandle <= 0)
+	MgrStageStamp stamp(stageTimings[MGR_STAGE_VIEWPORT]);
+
+	if (GetCurrentState() != STATE_MGR_VIEWS_BOUND_TO_OUTPUT)
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return -1;
 	}
 
-	//Zero out the viewport struct...
-	ZeroMemory(&curViewport, sizeof(D3D11_VIEWPORT));
-
-	curViewport.TopLeftX = altX;
-	curViewport.TopLeftY = altY;
-	curViewport.Width = wWidth;
-	curViewport.Height = wHeight;
-
-	//Keep the min/max depth at the default of [0,1]
-	curViewport.MinDepth = 0.0f;
-	curViewport.MaxDepth = 1.0f;
+	ScopeLock<MgrMutex> lock(mgrLock);
 
-	curDeviceContext->RSSetViewports(1, &curViewport);
+	FillViewport(altX, altY);
+	renderDevice->SetViewport(curViewport);
 
-	lastValidState = mgrState = STATE_MGR_VIEWPORT_CREATED;
+	lastValidState = STATE_MGR_VIEWPORT_CREATED;
+	SetState(STATE_MGR_VIEWPORT_CREATED);
 
 	return 0;
 
@@ -425,399 +373,82 @@ HRESULT DirectXManager::SetDefaultViewport(float altX, float altY)
 //Minimum which needs to be done when a resize occurs.
 bool DirectXManager::ResizeHandler()
 {
+	PROFILE_FUNCTION();
 
-	if (mgrState != STATE_MGR_VIEWPORT_CREATED || mutexHandle <= 0)
+	if (GetCurrentState() != STATE_MGR_VIEWPORT_CREATED)
 	{
 		return false;
 	}
 
-	ScopeLock lock(mutexHandle);
-
-	assert(curDeviceContext);
-	assert(curDevice);
-	assert(curSwapChain);
+	ScopeLock<MgrMutex> lock(mgrLock);
 
 	//Any old views which have a reference to buffers we will destroy need to be released.
 	//Stencil/depth buffer needs to go too. We can resize the back buffer, but still need to make a new render target view and new depth/stencil view.
+	renderDevice->ReleaseViews();
 
-	//Release render target view
-	COMRelease(bbRenderTargetView);
-
-	//Release depth/stencil view
-	COMRelease(mDepthStencilView);
-
-	//Release depth stencil buffer
-	COMRelease(mDepthStencilBuffer);
+	//Note that even if we fail at some stage in here, the device still knows what it holds for Clean.
 
-	//Update swap chain buffer, make render target view again
-
-	//Note that even if we fail at some stage in here, we can still use lastValidState as our reference for what to do in the
-	//destructor. If a COM interface has already been released, COMRelease just returns.
-
-	//For now we are doing double buffering, just 1 buffer. Change to new width/height.
-	if (FAILED(curSwapChain->ResizeBuffers(1, wWidth, wHeight, DXGI_FORMAT_R8G8B8A8_UNORM, 0)))
+	//Change to new width/height, same buffer count.
+	if (FAILED(renderDevice->ResizeSwapChain(wWidth, wHeight)))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return false;
 	}
 
-	//Get a pointer to the swap chain's back buffer.
-	ID3D11Texture2D *backBuf;
-
-	if (FAILED(curSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)(&backBuf))))
-	{
-		mgrState = STATE_INIT_ERROR;
-		return false;
-	}
+	curSwapChainDesc.width = wWidth;
+	curSwapChainDesc.height = wHeight;
 
-	//Create the render target view, again we have already defined the swap chain back buffer
-	//properties through the swap chain descriptor struct, so we can pass in NULL for the second param.
-	if (FAILED(curDevice->CreateRenderTargetView(backBuf, NULL, &bbRenderTargetView)))
+	//Create the render target view again
+	if (FAILED(renderDevice->CreateBackBufferView()))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return false;
 	}
 
-	//Release the interface to the buffer, we don't need anymore...
-	COMRelease(backBuf);
-
 	//Now we have to create the depth/stencil buffer and view again
-	ZeroMemory(&depthStencilDesc, sizeof(D3D11_TEXTURE2D_DESC));
-
-	depthStencilDesc.Width = wWidth;
-	depthStencilDesc.Height = wHeight;
-	depthStencilDesc.ArraySize = 1;
-	depthStencilDesc.MipLevels = 1;
-	depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-
-	if (use4XMSAA)
-	{
-		depthStencilDesc.SampleDesc.Count = 4;
-		depthStencilDesc.SampleDesc.Quality = m4xMsaaQuality - 1;
-	}
-	else
-	{
-		depthStencilDesc.SampleDesc.Count = 1;
-		depthStencilDesc.SampleDesc.Quality = 0;
-	}
-
-	depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-	depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	depthStencilDesc.CPUAccessFlags = 0;
-	depthStencilDesc.MiscFlags = 0;
-
-	//create buffer
-	if (FAILED(curDevice->CreateTexture2D(&depthStencilDesc, NULL, &mDepthStencilBuffer)))
-	{
-		mgrState = STATE_INIT_ERROR;
-		return false;
-	}
+	FillDepthStencilDesc();
 
-	//create view to depth stencil buffer
-	if (FAILED(curDevice->CreateDepthStencilView(mDepthStencilBuffer, NULL, &mDepthStencilView)))
+	if (FAILED(renderDevice->CreateDepthStencil(depthStencilDesc)))
 	{
-		mgrState = STATE_INIT_ERROR;
+		SetState(STATE_INIT_ERROR);
 		return false;
 	}
 
 	//bind depth/stencil view and render target view to the pipeline
-	curDeviceContext->OMSetRenderTargets(1, &bbRenderTargetView, mDepthStencilView);
+	renderDevice->BindViews();
 
 	//Set viewport
-	curViewport.TopLeftX = 0;
-	curViewport.TopLeftY = 0;
-	curViewport.Width = (float)wWidth;
-	curViewport.Height = (float)wHeight;
-	curViewport.MinDepth = 0.0f;
-	curViewport.MaxDepth = 1.0f;
-
-	curDeviceContext->RSSetViewports(1, &curViewport);
+	FillViewport(0.0f, 0.0f);
+	renderDevice->SetViewport(curViewport);
 
 	return true;
 }
 
-
-//We need to put releases for com interfaces depending on state when destructor is hit...
-DirectXManager::~DirectXManager()
-{
-	//If mutex handle is not valid, we don't have anything to clean up.
-	if (mutexHandle > 0)
-	{
-		Clean();
-		CloseHandle(mutexHandle);
-	}
-}
-
-//Meh figure out a nicer way to do this, since there is a lot of code reptition. Maybe inline functions for each step.
-//Test each of these states too.
-void DirectXManager::Clean()
-{
-
-	//We don't need to check mutex handle or mgrState, since mutex handle was checked before this was called.
-
-	//lastValidState tracks what we need to clean, so if we encounter an error, we can clean the stuff up to that point.
-
-	ScopeLock lock(mutexHandle);
-
-	if (lastValidState >= STATE_MGR_DEPTH_STENCIL_BUFFER_CREATED)
-	{
-		COMRelease(bbRenderTargetView);
-		COMRelease(mDepthStencilView);
-		COMRelease(curSwapChain);
-		COMRelease(mDepthStencilBuffer);
-
-		if (curDeviceContext)
-		{
-			try
-			{
-				curDeviceContext->ClearState();
-			}
-			catch (...)
-			{
-
-			}
-		}
-
-		COMRelease(curDeviceContext);
-		COMRelease(curDevice);
-	}
-	else if (lastValidState >= STATE_MGR_RENDER_TARGET_VIEW_CREATED)
-	{
-		COMRelease(bbRenderTargetView);
-		COMRelease(curSwapChain);
-		if (curDeviceContext)
-		{
-			try
-			{
-				curDeviceContext->ClearState();
-			}
-			catch (...)
-			{
-
-			}
-		}
-		COMRelease(curDeviceContext);
-		COMRelease(curDevice);
-	}
-	else if (lastValidState >= STATE_MGR_SWAP_CHAIN_CREATED)
-	{
-		COMRelease(curSwapChain);
-		if (curDeviceContext)
-		{
-			try
-			{
-				curDeviceContext->ClearState();
-			}
-			catch (...)
-			{
-
-			}
-		}
-		COMRelease(curDeviceContext);
-		COMRelease(curDevice);
-	}
-	else if (lastValidState >= STATE_MGR_INIT)
-	{
-		if (curDeviceContext)
-		{
-			try
-			{
-				curDeviceContext->ClearState();
-			}
-			catch (...)
-			{
-
-			}
-		}
-		COMRelease(curDeviceContext);
-		COMRelease(curDevice);
-	}
-
-}
-
-//Borrowed from Frank D Luna's excellent DX11 book, added mutex and isValid flag
-
-GameTimer::GameTimer()
-	: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0),
-	mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false), isValid(false)
-{
-
-	__int64 ticksPerSec;
-	if (!QueryPerformanceFrequency((LARGE_INTEGER*)&ticksPerSec))
-	{
-		isValid = false;
-		return;
-	}
-	else
-	{
-		mSecondsPerCount = 1.0 / (double)ticksPerSec;
-	}
-
-	//Try to create the mutex...
-	timerMutex = CreateMutex(NULL, false, _T("TIMER_MUTEX"));
-
-	if (timerMutex <= 0)
-	{
-		isValid = false;
-		return;
-	}
-
-	isValid = true;
-	return;
-}
-
-
-void GameTimer::Tick()
-{
-
-	if (!isValid)
-	{
-		return;
-	}
-
-	ScopeLock lock(timerMutex);
-
-	if (mStopped)
-	{
-		mDeltaTime = 0.0;
-		return;
-	}
-
-	//Get the time this frame.
-	__int64 currTime;
-
-	if (!QueryPerformanceCounter((LARGE_INTEGER*)&currTime))
-	{
-		mDeltaTime = 0.0;
-		isValid = false;
-		return;
-	}
-
-	mCurrTime = currTime;
-
-	//Diff between this frame and prev
-	mDeltaTime = (mCurrTime - mPrevTime)*mSecondsPerCount;
-
-	//For next frame
-	mPrevTime = mCurrTime;
-
-	//Force nonnegative.
-	if (mDeltaTime < 0.0)
-	{
-		mDeltaTime = 0.0;
-	}
-
-}
-
-void GameTimer::Reset()
+HRESULT DirectXManager::Present(UINT syncInterval)
 {
-	if (!isValid)
-	{
-		return;
-	}
-
-	ScopeLock lock(timerMutex);
-
-	__int64 currTime;
-
-	if (!QueryPerformanceCounter((LARGE_INTEGER*)&currTime))
-	{
-		isValid = false;
-		return;
-	}
+	PROFILE_FUNCTION();
+	if (GetCurrentState() != STATE_MGR_VIEWPORT_CREATED)
+		return -1;
 
-	mBaseTime = currTime;
-	mPrevTime = currTime;
-	mStopTime = 0;
-	mStopped = false;
+	return renderDevice->Present(syncInterval);
 }
 
-void GameTimer::Stop()
-{
-
-	if (!isValid)
-		return;
-
-	ScopeLock lock(timerMutex);
-
-	//If stopped, return
-	if (!mStopped)
-	{
-		__int64 currTime;
-		if (!QueryPerformanceCounter((LARGE_INTEGER*)&currTime))
-		{
-			isValid = false;
-			return;
-		}
-
-		mStopTime = currTime;
-		mStopped = true;
-
-	}
-
-}
 
-void GameTimer::Start()
+//We need to put releases for com interfaces depending on state when destructor is hit...
+DirectXManager::~DirectXManager()
 {
-
-	if (!isValid)
-	{
-		return;
-	}
-
-	ScopeLock lock(timerMutex);
-
-	__int64 startTime;
-
-	if (!QueryPerformanceCounter((LARGE_INTEGER*)&startTime))
-	{
-		isValid = false;
-		return;
-	}
-
-	//If resuming...
-	if (mStopped)
-	{
-
-		//accumulate paused time
-		mPausedTime += (startTime - mStopTime);
-
-		//current prev time not valid, as it was last updated before paused.
-		//Reset prev time to current time.
-
-		mPrevTime = startTime;
-
-		//no longer stopped
-		mStopTime = 0;
-		mStopped = false;
-
-	}
-
+	Clean();
 }
 
-
-//And finally TotalTime, returns time since Reset was called (not counting pause time)
-float GameTimer::TotalTime() const
+void DirectXManager::Clean()
 {
 
-	//we care about logical constness rather than bitwise constness..
-	ScopeLock lock(static_cast<HANDLE>(timerMutex));
+	//We don't need to check mgrState here.
 
-	//If stopped, do not count time passed since stopped.
-	//If we already had a pause, mStopTime - mBaseTime includes paused time, so we subtract paused time from mStopTime
+	//The device knows what it managed to create, so wherever init stopped (or failed) one Release cleans it up.
 
-	if (mStopped)
-	{
-		return (float)(((mStopTime - mPausedTime) - mBaseTime) * mSecondsPerCount);
-	}
-	else
-	{
-		return (float)(((mCurrTime - mPausedTime) - mBaseTime) * mSecondsPerCount);
-	}
-}
+	ScopeLock<MgrMutex> lock(mgrLock);
 
+	renderDevice->Release();
 
-float GameTimer::DeltaTime() const
-{
-	return (float)mDeltaTime;
 }
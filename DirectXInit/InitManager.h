@@ -18,9 +18,18 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
 
-#include <Windows.h>
-#include <d3d11.h>
+#include "Platform.h"
+#include "RenderDevice.h"
+#include "Locks.h"
+#include "LockStats.h"
+#include <atomic>
 #include <map>
+#include <memory>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include "D3D11RenderDevice.h"
+#endif
 
 using namespace std;
 
@@ -37,17 +46,51 @@ enum CurState
 	STATE_MGR_VIEWPORT_CREATED,
 };
 
+//The init calls, in ladder order, for timing them
+enum MgrInitStage
+{
+	MGR_STAGE_CREATE_DEVICE = 0,
+	MGR_STAGE_CHECK_MSAA,
+	MGR_STAGE_DESCRIBE_SWAP_CHAIN,
+	MGR_STAGE_CREATE_SWAP_CHAIN,
+	MGR_STAGE_RENDER_TARGET_VIEW,
+	MGR_STAGE_DEPTH_STENCIL,
+	MGR_STAGE_BIND_VIEWS,
+	MGR_STAGE_VIEWPORT,
+
+	MGR_STAGE_COUNT
+};
+
+//GameTimer::QueryCounter values, endCounter is 0 if the stage never finished
+struct MgrStageTiming
+{
+	int64_t startCounter;
+	int64_t endCounter;
+};
+
+const char* MgrStageName(MgrInitStage stage);
 
-inline bool COMRelease(IUnknown *targetCOM);
+//The manager's lock, tracked as "MGR_MUTEX" (LockStatsFormatReport). With the threaded loop the render thread's
+//claim is one long hold.
+typedef BasicClaimableMutex< TrackedLock<SpinParkMutex> > MgrMutex;
 
 
 //Provides access to D3D device and devicecontext, initialization methods
+//
+//The actual device calls go through an IRenderDevice: D3D11RenderDevice by default on Windows,
+//NullRenderDevice everywhere else or when SetDevice is handed one (headless runs).
 
 class DirectXManager
 {
 public:
 	DirectXManager();
 	virtual ~DirectXManager();
+
+	//Takes ownership. Only before CreateDeviceAndContext (state FREE), returns false otherwise.
+	bool SetDevice(IRenderDevice *device);
+	inline IRenderDevice& Device() { return *renderDevice; };
+	inline RenderDeviceType DeviceType() const { return renderDevice->Type(); };
+
 	HRESULT CreateDeviceAndContext();
 	HRESULT Check4xMSAASupport();
 	HRESULT DescribeSwapChain(bool switchMSAA, bool fullScreen, UINT width, UINT height, HWND nCurWnd);
@@ -60,7 +103,12 @@ public:
 
 	inline UINT    GetClientHeight() const { return wHeight; };
 	inline UINT    GetClientWidth()  const { return wWidth; };
-	inline CurState GetCurrentState() const { return mgrState; };
+	//Any thread. Acquire, so a state seen here comes with everything set up before it was reached (WM_SIZE
+	//checks it on the window thread while the device step runs on a worker).
+	inline CurState GetCurrentState() const { return mgrState.load(std::memory_order_acquire); };
+
+	//When each init call ran (last time it was called), for the startup report
+	inline const MgrStageTiming& StageTiming(MgrInitStage stage) const { return stageTimings[stage]; };
 
 	inline void	   SetClientDimensions(UINT height, UINT width) { wHeight = height; wWidth = width; };
 
@@ -68,72 +116,100 @@ public:
 	//The minimum which needs to be done when a resize occurs
 	bool ResizeHandler();
 
+	//Lock should be obtained before calling these, and released after.
+	HRESULT Present(UINT syncInterval = 0);
+	inline IRenderContext& Context() { return renderDevice->Context(); };
+
+	//Redundant bind filtering, issued vs filtered counts per frame (frames end at Present)
+	inline RenderStateCache& StateCache() { return renderDevice->StateCache(); };
+
+	//Memory held vs used by the depth buffer (and other pooled targets)
+	inline RenderTargetPool& TargetPool() { return renderDevice->TargetPool(); };
+
 
 	//These are used if a data member needs to be directly accessed by another class, the scopelocks are used in member functions
+	//Not recursive, don't call member functions which take the lock while holding it.
+	//
+	//If a thread has claimed the context (ClaimContext), LockMgr/UnlockMgr on that thread are free: it already holds
+	//the lock for as long as the claim lasts. Any other thread gets false right away instead of waiting on it.
 	inline bool LockMgr() {
-		if (mgrState >= STATE_MGR_FREE) { if (WaitForSingleObject(mutexHandle, 2000)) { return false; } else { isLocked = true; return true; } }
-		else { return false; }
+		if (GetCurrentState() < STATE_MGR_FREE) { return false; }
+		if (mgrLock.IsOwner()) { return true; }
+		if (mgrLock.IsClaimed()) { return false; }
+		if (!mgrLock.TryLockFor(2000)) { return false; } else { isLocked = true; return true; }
 	}
 
 	inline bool UnlockMgr() {
-		if (isLocked && mutexHandle > 0)
+		if (mgrLock.IsOwner())
+			return true;
+
+		if (isLocked)
 		{
-			ReleaseMutex(mutexHandle);
 			isLocked = false;
+			mgrLock.Unlock();
 			return true;
 		}
 		else
 			return false;
 	}
 
+	//Give the calling thread (the render thread) ownership of the device context until ReleaseContext.
+	//Member functions called from the owner don't lock either, everyone else waits for the release.
+	inline bool ClaimContext() { return mgrLock.Claim(2000); }
+	inline void ReleaseContext() { mgrLock.ReleaseClaim(); }
+	inline bool OwnsContext() const { return mgrLock.IsOwner(); }
+
 	//Lock should be obtained before calling any of these, and released after.
-	inline ID3D11Device *CurrentDevice() const { return curDevice; };
-	inline ID3D11DeviceContext *CurrentDeviceContext() const { return curDeviceContext; };
-	inline IDXGISwapChain *CurrentSwapChain() const { return curSwapChain; };
-	inline ID3D11RenderTargetView *CurrentRenderTargetView() const { return bbRenderTargetView; };
-	inline DXGI_SWAP_CHAIN_DESC& CurrentSwapChainDesc() { return curSwapChainDesc; };
-	inline D3D11_TEXTURE2D_DESC& CurrentDepthStencilDesc() { return depthStencilDesc; };
-	inline ID3D11Texture2D* CurrentDepthStencilBuffer() { return mDepthStencilBuffer; };
-	inline ID3D11DepthStencilView* CurrentDepthStencilView() { return mDepthStencilView; };
-	inline D3D11_VIEWPORT& GetCurrentViewPort() { return curViewport; };
+	inline RenderSwapChainDesc& CurrentSwapChainDesc() { return curSwapChainDesc; };
+	inline RenderDepthStencilDesc& CurrentDepthStencilDesc() { return depthStencilDesc; };
+	inline RenderViewport& GetCurrentViewPort() { return curViewport; };
+	inline const RenderViewport& GetCurrentViewPort() const { return curViewport; };
+
+#ifdef _WIN32
+	//NULL unless the device is a D3D11RenderDevice. Binding on the context directly bypasses StateCache(), invalidate it after.
+	inline D3D11RenderDevice *CurrentD3D11Device() const { return d3dDevice; };
+	inline ID3D11Device *CurrentDevice() const { return d3dDevice ? d3dDevice->Device() : NULL; };
+	inline ID3D11DeviceContext *CurrentDeviceContext() const { return d3dDevice ? d3dDevice->DeviceContext() : NULL; };
+	inline IDXGISwapChain *CurrentSwapChain() const { return d3dDevice ? d3dDevice->SwapChain() : NULL; };
+	inline ID3D11RenderTargetView *CurrentRenderTargetView() const { return d3dDevice ? d3dDevice->RenderTargetView() : NULL; };
+	inline ID3D11Texture2D* CurrentDepthStencilBuffer() { return d3dDevice ? d3dDevice->DepthStencilBuffer() : NULL; };
+	inline ID3D11DepthStencilView* CurrentDepthStencilView() { return d3dDevice ? d3dDevice->DepthStencilView() : NULL; };
+#endif
 
 
 private:
 
-	//Called in destructor, lastValidState tracks where we are as far as COM interface reference counts we need to decrement
+	//Called in destructor, lastValidState tracks whether there is anything for the device to release
 	void Clean();
 
+	//Release, pairs with GetCurrentState
+	inline void SetState(CurState state) { mgrState.store(state, std::memory_order_release); };
 
-	//Current device
-	ID3D11Device *curDevice;
+	//Same for init and resize
+	void FillDepthStencilDesc();
+	void FillViewport(float x, float y);
 
-	//Current device context
-	ID3D11DeviceContext *curDeviceContext;
 
-	//Current swap chain descriptor
-	DXGI_SWAP_CHAIN_DESC curSwapChainDesc;
+	//Does the actual work
+	std::unique_ptr<IRenderDevice> renderDevice;
 
-	//Pointer to swap chain interface
-	IDXGISwapChain *curSwapChain;
+#ifdef _WIN32
+	//renderDevice if it is a D3D11RenderDevice, for the D3D accessors
+	D3D11RenderDevice *d3dDevice;
+#endif
 
-	//Handle to render target view for swap chain back buffer
-	ID3D11RenderTargetView *bbRenderTargetView;
+	//Current swap chain descriptor
+	RenderSwapChainDesc curSwapChainDesc;
 
 	//depth stencil texture descriptor
-	D3D11_TEXTURE2D_DESC depthStencilDesc;
-
-	//depth/stencil texture
-	ID3D11Texture2D *mDepthStencilBuffer;
-
-	//depth/stencil view to bind to output pipeline
-	ID3D11DepthStencilView *mDepthStencilView;
+	RenderDepthStencilDesc depthStencilDesc;
 
 	//Keep a copy of the viewport, by default we will set it to fill the entire backbuffer.
 	//We will just use one viewport for now.
-	D3D11_VIEWPORT curViewport;
+	RenderViewport curViewport;
 
-	//State (error, free, init, disposing)
-	CurState mgrState;
+	//State (error, free, init, disposing). Only the init/dispose calls write it, through SetState.
+	std::atomic<CurState> mgrState;
 
 	//Last valid state (same as mgrState if no error)
 	CurState lastValidState;
@@ -150,51 +226,13 @@ private:
 	//Output window handle (mostly for swap chain descriptor)
 	HWND wCurWnd;
 
-	//Mutex associated with this instance
-	HANDLE mutexHandle;
+	//Lock associated with this instance, claimable by the render thread
+	MgrMutex mgrLock;
 
 	//for when an owner class needs to directly lock and unlock,
 	//scopelock is used for member functions
 	bool isLocked;
 
-};
-
-
-typedef UINT TimerHandle;
-
-//More or less Frank D. Lunas' "Intro to game programming with Dx11" game timer class, added mutex and isValid
-
-class GameTimer
-{
-
-public:
-	GameTimer();
-	GameTimer(bool setThreadAffinity);
-
+	MgrStageTiming stageTimings[MGR_STAGE_COUNT];
 
-	float TotalTime() const;		//In seconds
-	float DeltaTime() const;	//In seconds
-
-	void Reset();	// Call before message loop
-	void Start();	// Call when unpaused
-	void Stop();	// Call when paused
-	void Tick();	// Call every frame
-
-	inline bool GetIsValid() const { return isValid; };
-
-private:
-
-	double mSecondsPerCount;
-	double mDeltaTime;
-
-	__int64 mBaseTime;
-	__int64 mPausedTime;
-	__int64 mStopTime;
-	__int64 mPrevTime;
-	__int64 mCurrTime;
-
-	bool mStopped;
-	bool isValid;
-	HANDLE timerMutex;
-
-};
\ No newline at end of file
+};
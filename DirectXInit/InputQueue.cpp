@@ -0,0 +1,157 @@
+#include "stdafx.h"
+
+#include "InputQueue.h"
+#include "GameTimer.h"
+#include "ScopeLock.h"
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+InputQueue::InputQueue()
+	: ring(INPUTQUEUE_CAPACITY), tail(0), bHavePendingMove(false), pushed(0), coalesced(0), overflowed(0), head(0), drained(0),
+	overflowHead(0), overflowCount(0)
+{
+	overflow.reserve(INPUTQUEUE_OVERFLOW_RESERVE);
+
+	pendingMove.counter = 0;
+	pendingMove.x = pendingMove.y = 0;
+	pendingMove.buttons = 0;
+	pendingMove.type = INPUT_MOUSE_MOVE;
+	pendingMove.button = INPUT_BUTTON_NONE;
+}
+
+void InputQueue::Push(InputEventType type, InputMouseButton button, uint32_t buttons, int x, int y)
+{
+	InputEvent ev;
+	GameTimer::QueryCounter(ev.counter);
+	ev.x = (int16_t)x;
+	ev.y = (int16_t)y;
+	ev.buttons = (uint16_t)buttons;
+	ev.type = (uint8_t)type;
+	ev.button = (uint8_t)button;
+
+	Push(ev);
+}
+
+void InputQueue::Push(const InputEvent &ev)
+{
+	pushed.fetch_add(1, std::memory_order_relaxed);
+
+	if (ev.type == INPUT_MOUSE_MOVE)
+	{
+		//Same buttons held, only the position moved on
+		if (bHavePendingMove && pendingMove.buttons == ev.buttons)
+		{
+			pendingMove.x = ev.x;
+			pendingMove.y = ev.y;
+			coalesced.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Flush();
+		pendingMove = ev;
+		bHavePendingMove = true;
+		return;
+	}
+
+	Flush();
+	Enqueue(ev);
+}
+
+void InputQueue::Flush()
+{
+	if (!bHavePendingMove)
+		return;
+
+	bHavePendingMove = false;
+	Enqueue(pendingMove);
+}
+
+void InputQueue::Enqueue(const InputEvent &ev)
+{
+	//Only we make overflowCount non zero, so 0 here means Drain has taken everything that was in there
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	if (overflowCount.load(std::memory_order_acquire) != 0 || t - head.load(std::memory_order_acquire) >= INPUTQUEUE_CAPACITY)
+	{
+		EnqueueOverflow(ev);
+		return;
+	}
+
+	ring[t & (INPUTQUEUE_CAPACITY - 1)] = ev;
+	tail.store(t + 1, std::memory_order_release);
+}
+
+void InputQueue::EnqueueOverflow(const InputEvent &ev)
+{
+	ScopeLock<SpinParkMutex> lock(overflowLock);
+
+	//Moves only need the latest position, as long as nothing happened in between (same rule as Push)
+	if (ev.type == INPUT_MOUSE_MOVE && overflow.size() > overflowHead && overflow.back().type == INPUT_MOUSE_MOVE &&
+		overflow.back().buttons == ev.buttons)
+	{
+		overflow.back().x = ev.x;
+		overflow.back().y = ev.y;
+		coalesced.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	overflow.push_back(ev);
+	overflowed.fetch_add(1, std::memory_order_relaxed);
+	overflowCount.store((uint32_t)overflow.size() - overflowHead, std::memory_order_release);
+}
+
+uint32_t InputQueue::Drain(InputEvent *out, uint32_t maxEvents)
+{
+	//Overflow first: if there is any, the producer stopped using the ring before it, so the tail read below
+	//has all of the ring's events that come before it
+	bool bOverflow = overflowCount.load(std::memory_order_acquire) != 0;
+
+	uint32_t h = head.load(std::memory_order_relaxed);
+	uint32_t available = tail.load(std::memory_order_acquire) - h;
+	uint32_t count = available < maxEvents ? available : maxEvents;
+
+	for (uint32_t i = 0; i < count; ++i)
+		out[i] = ring[(h + i) & (INPUTQUEUE_CAPACITY - 1)];
+
+	head.store(h + count, std::memory_order_release);
+
+	//Only once the ring is caught up, the overflow is newer
+	if (bOverflow && count == available && count < maxEvents)
+	{
+		ScopeLock<SpinParkMutex> lock(overflowLock);
+
+		uint32_t taken = (uint32_t)overflow.size() - overflowHead;
+		if (taken > maxEvents - count)
+			taken = maxEvents - count;
+
+		for (uint32_t i = 0; i < taken; ++i)
+			out[count + i] = overflow[overflowHead + i];
+
+		count += taken;
+		overflowHead += taken;
+		if (overflowHead == overflow.size())
+		{
+			overflow.clear();
+			overflowHead = 0;
+		}
+
+		overflowCount.store((uint32_t)overflow.size() - overflowHead, std::memory_order_release);
+	}
+
+	drained.fetch_add(count, std::memory_order_relaxed);
+	return count;
+}
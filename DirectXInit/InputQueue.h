@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "Locks.h"
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+
+const uint32_t INPUTQUEUE_CAPACITY = 1024;	//Power of two
+const uint32_t INPUTQUEUE_OVERFLOW_RESERVE = 64;	//Overflow room reserved up front, it grows past that if it has to
+
+enum InputEventType
+{
+	INPUT_MOUSE_DOWN = 0,
+	INPUT_MOUSE_UP,
+	INPUT_MOUSE_MOVE,
+};
+
+enum InputMouseButton
+{
+	INPUT_BUTTON_NONE = 0,
+	INPUT_BUTTON_LEFT,
+	INPUT_BUTTON_MIDDLE,
+	INPUT_BUTTON_RIGHT,
+};
+
+//16 bytes, four to a cache line
+struct InputEvent
+{
+	int64_t  counter;		//GameTimer::QueryCounter when it arrived. For a coalesced move, when the first of them arrived.
+	int16_t  x;				//Client coordinates
+	int16_t  y;
+	uint16_t buttons;		//MK_ flags (the message's wParam)
+	uint8_t  type;			//InputEventType
+	uint8_t  button;		//InputMouseButton that went down/up, NONE for moves
+};
+
+
+//Single producer / single consumer ring of input events. The window thread pushes as messages arrive,
+//the simulation drains everything once per frame, neither side ever waits on the other.
+//
+//Moves are held back on the producer side and merged while nothing else happens in between: the latest
+//position wins, the time stays the earliest (that's the input the frame will be late for). A down/up
+//pushes the held move first so order is kept, Flush pushes it when the message pump runs dry.
+//
+//Nothing is ever dropped, a lost button up would leave the button held for good. When the ring is full
+//events go to an overflow list behind a lock instead, where a move just updates a move right before it.
+//Once anything is in there everything goes there, until Drain has caught up on the ring and taken it,
+//so order is kept. That's the slow path for a consumer that's far behind, normally the lock is never touched.
+
+class InputQueue
+{
+public:
+	InputQueue();
+
+	//Producer side
+	void Push(InputEventType type, InputMouseButton button, uint32_t buttons, int x, int y);
+	void Push(const InputEvent &ev);
+	void Flush();
+
+	//Consumer side. Copies out up to maxEvents in order, returns how many.
+	uint32_t Drain(InputEvent *out, uint32_t maxEvents);
+
+	//Counted on their own side, fine to read from anywhere
+	inline uint64_t Pushed() const { return pushed.load(std::memory_order_relaxed); };
+	inline uint64_t Coalesced() const { return coalesced.load(std::memory_order_relaxed); };
+	inline uint64_t Overflowed() const { return overflowed.load(std::memory_order_relaxed); };
+	inline uint64_t Drained() const { return drained.load(std::memory_order_relaxed); };
+
+private:
+
+	InputQueue(const InputQueue&);
+	InputQueue& operator=(const InputQueue&);
+
+	void Enqueue(const InputEvent &ev);
+	void EnqueueOverflow(const InputEvent &ev);
+
+	std::vector<InputEvent> ring;
+
+	//Producer owned, consumer reads tail. Apart so the two sides don't share a line.
+	std::atomic<uint32_t> tail;
+	InputEvent pendingMove;
+	bool	   bHavePendingMove;
+	std::atomic<uint64_t> pushed;
+	std::atomic<uint64_t> coalesced;
+	std::atomic<uint64_t> overflowed;
+	char pad[64];
+
+	//Consumer owned, producer reads head
+	std::atomic<uint32_t> head;
+	std::atomic<uint64_t> drained;
+
+	//Events past a full ring, [overflowHead, size) still to drain. Both sides under overflowLock, overflowCount
+	//is the check for it being empty without the lock.
+	SpinParkMutex overflowLock;
+	std::vector<InputEvent> overflow;
+	uint32_t overflowHead;
+	std::atomic<uint32_t> overflowCount;
+};
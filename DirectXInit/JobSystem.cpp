@@ -0,0 +1,559 @@
+#include "stdafx.h"
+
+#include "JobSystem.h"
+#include "ScopeLock.h"
+#include "Profiler.h"
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Which system/slot the current thread belongs to. One system per thread at a time.
+static thread_local JobSystem *tlsJobSystem = NULL;
+static thread_local int tlsJobSlot = -1;
+
+
+//JobDeque
+
+JobDeque::JobDeque() : top(0), bottom(0)
+{
+	for (uint32_t i = 0; i < JOB_DEQUE_SIZE; ++i)
+		entries[i].store(NULL, std::memory_order_relaxed);
+}
+
+bool JobDeque::Push(Job *job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+
+	if (b - t >= (int64_t)JOB_DEQUE_SIZE)
+		return false;
+
+	entries[b & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobDeque::Pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		//Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	Job *job = entries[b & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+	if (t == b)
+	{
+		//Last one, race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = NULL;
+
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* JobDeque::Steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return NULL;
+
+	Job *job = entries[t & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+	//Lost to the owner or another thief, caller just moves on
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return NULL;
+
+	return job;
+}
+
+
+//JobSystem
+
+JobSystem::JobSystem()
+	: bQuit(false), bRunning(false), sleepSignal(0), sleepingCount(0), injectLock("JOB_INJECT"), injectHead(0), injectTail(0), injectCount(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Stop();
+}
+
+void JobSystem::Start(int workerCount)
+{
+	if (bRunning)
+		return;
+
+	if (workerCount < 0)
+	{
+		unsigned int hw = std::thread::hardware_concurrency();
+		workerCount = (hw > 1) ? (int)hw - 1 : 0;
+	}
+
+	slots.resize(workerCount + JOB_MAX_EXTERNAL_THREADS);
+	for (size_t i = 0; i < slots.size(); ++i)
+		slots[i] = new ThreadSlot();
+
+	injectJobs.resize(JOB_INJECT_QUEUE_SIZE);
+	injectHead = injectTail = 0;
+	injectCount = 0;
+
+	bQuit = false;
+	bRunning = true;
+
+	workers.reserve(workerCount);
+	for (int i = 0; i < workerCount; ++i)
+	{
+		slots[i]->bInUse = true;
+		workers.push_back(std::thread(&JobSystem::WorkerProc, this, i));
+	}
+
+	RegisterCurrentThread();
+}
+
+void JobSystem::Stop()
+{
+	if (!bRunning)
+		return;
+
+	//Whatever the registered threads still have queued gets run before we tear down
+	if (CurrentThreadSlot() >= 0)
+		UnregisterCurrentThread();
+
+	bQuit = true;
+	sleepSignal.fetch_add(1);
+	LockUnparkAll(sleepSignal);
+
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		if (workers[i].joinable())
+			workers[i].join();
+	}
+	workers.clear();
+
+	for (size_t i = 0; i < slots.size(); ++i)
+		delete slots[i];
+	slots.clear();
+
+	bRunning = false;
+}
+
+int JobSystem::CurrentThreadSlot() const
+{
+	return (tlsJobSystem == this) ? tlsJobSlot : -1;
+}
+
+bool JobSystem::RegisterCurrentThread()
+{
+	if (CurrentThreadSlot() >= 0)
+		return true;
+
+	if (!bRunning)
+		return false;
+
+	for (size_t i = workers.size(); i < slots.size(); ++i)
+	{
+		bool expected = false;
+		if (slots[i]->bInUse.compare_exchange_strong(expected, true))
+		{
+			tlsJobSystem = this;
+			tlsJobSlot = (int)i;
+			return true;
+		}
+	}
+
+	//Out of external slots, this thread falls back to the inject queue
+	return false;
+}
+
+void JobSystem::UnregisterCurrentThread()
+{
+	int slot = CurrentThreadSlot();
+	if (slot < (int)workers.size())
+		return;
+
+	//Nobody else pops this deque, so run what is left here. Thieves may take some of it too.
+	Job *job;
+	while ((job = slots[slot]->deque.Pop()) != NULL)
+		Execute(slot, job);
+
+	tlsJobSystem = NULL;
+	tlsJobSlot = -1;
+	slots[slot]->bInUse = false;
+}
+
+Job* JobSystem::AllocJob(int slotIndex, const Job &desc)
+{
+	ThreadSlot *slot = slots[slotIndex];
+	uint32_t seed = 0x2545F491u ^ (uint32_t)(slotIndex + 1);
+
+	//Normally the next entry is long done. If not, skip the ones still queued or running (one may be a job
+	//further up our own stack, so never wait on a particular entry), and with the whole ring busy help run
+	//jobs until something frees up.
+	for (;;)
+	{
+		for (uint32_t tries = 0; tries < JOB_POOL_SIZE; ++tries)
+		{
+			uint32_t index = slot->nextJob++ & (JOB_POOL_SIZE - 1);
+			std::atomic<uint32_t> &live = slot->jobLive[index];
+			if (live.load(std::memory_order_acquire) != 0)
+				continue;
+
+			Job *job = &slot->jobPool[index];
+			*job = desc;
+			job->next = NULL;
+			job->live = &live;
+			live.store(1, std::memory_order_relaxed);
+			return job;
+		}
+
+		Job *other = FindWork(slotIndex, seed);
+		if (other)
+			Execute(slotIndex, other);
+		else
+			LockCpuRelax();
+	}
+}
+
+void JobSystem::ReleaseJob(Job *job)
+{
+	//Last touch of the entry, its owner may reuse it straight after
+	if (job->live)
+		job->live->store(0, std::memory_order_release);
+}
+
+void JobSystem::Submit(JobFunction fn, void *data, uint32_t begin, uint32_t end, uint32_t grain, JobCounter *counter)
+{
+	if (end <= begin)
+		return;
+
+	if (counter)
+		AddPending(counter);
+
+	Job desc = { fn, data, begin, end, grain, counter, NULL, NULL };
+
+	int slot = CurrentThreadSlot();
+	if (slot >= 0)
+	{
+		Enqueue(slot, AllocJob(slot, desc));
+		return;
+	}
+
+	//With no workers nobody would ever pick it up from the inject queue
+	if (!bRunning || workers.empty() || !InjectPush(desc))
+	{
+		//Nowhere to put it, run it right here
+		desc.fn(desc.data, desc.begin, desc.end);
+		if (counter)
+			FinishJob(-1, &desc);
+	}
+}
+
+void JobSystem::RunAfter(JobCounter &dependency, JobFunction fn, void *data, uint32_t begin, uint32_t end, uint32_t grain, JobCounter *counter)
+{
+	int slot = CurrentThreadSlot();
+	if (slot < 0 || dependency.IsDone())
+	{
+		Wait(dependency);
+		Submit(fn, data, begin, end, grain, counter);
+		return;
+	}
+
+	if (end <= begin)
+		return;
+
+	if (counter)
+		AddPending(counter);
+
+	Job desc = { fn, data, begin, end, grain, counter, NULL, NULL };
+	Job *job = AllocJob(slot, desc);
+
+	Job *head = dependency.continuations.load(std::memory_order_acquire);
+	for (;;)
+	{
+		if (head == JOB_CONTINUATIONS_CLOSED)
+		{
+			//Finished while we were setting up
+			job->next = NULL;
+			Enqueue(slot, job);
+			return;
+		}
+
+		job->next = head;
+		if (dependency.continuations.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_acquire))
+			return;
+	}
+}
+
+void JobSystem::AddPending(JobCounter *counter)
+{
+	if (counter->pending.fetch_add(1, std::memory_order_acq_rel) != 0)
+		return;
+
+	//First job on an idle counter, reopen its continuation list. The job that took it to zero may not have
+	//closed it yet, it's past its decrement though so this is a short wait.
+	for (;;)
+	{
+		Job *closed = JOB_CONTINUATIONS_CLOSED;
+		if (counter->continuations.compare_exchange_weak(closed, NULL, std::memory_order_acq_rel, std::memory_order_relaxed))
+			return;
+		LockCpuRelax();
+	}
+}
+
+void JobSystem::Enqueue(int slotIndex, Job *job)
+{
+	if (slotIndex < 0)
+	{
+		if (workers.empty() || !InjectPush(*job))
+		{
+			Execute(slotIndex, job);
+			return;
+		}
+
+		//A copy went to the inject queue, so the pool entry is done with
+		ReleaseJob(job);
+		return;
+	}
+
+	if (!slots[slotIndex]->deque.Push(job))
+	{
+		//Deque full, plenty of work around already
+		Execute(slotIndex, job);
+		return;
+	}
+
+	WakeWorkers();
+}
+
+void JobSystem::WakeWorkers()
+{
+	//Pairs with the sleepingCount increment in WorkerProc, so either it finds our job or we see it sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleepingCount.load(std::memory_order_relaxed) != 0)
+	{
+		sleepSignal.fetch_add(1);
+		LockUnparkOne(sleepSignal);
+	}
+}
+
+void JobSystem::Execute(int slotIndex, Job *job)
+{
+	//Split off the upper half until we're down to the grain, the last half pushed is the first one popped
+	//so we keep working near where we started while thieves take the big pieces from the top
+	if (slotIndex >= 0)
+	{
+		while (job->grain != 0 && job->end - job->begin > job->grain)
+		{
+			uint32_t mid = job->begin + (job->end - job->begin) / 2;
+
+			Job *half = AllocJob(slotIndex, *job);
+			half->begin = mid;
+
+			if (job->counter)
+				job->counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+			job->end = mid;
+			Enqueue(slotIndex, half);
+		}
+	}
+
+	{
+		PROFILE_ZONE("Job");
+		job->fn(job->data, job->begin, job->end);
+	}
+	FinishJob(slotIndex, job);
+	ReleaseJob(job);
+}
+
+void JobSystem::FinishJob(int slotIndex, Job *job)
+{
+	JobCounter *counter = job->counter;
+	if (!counter)
+		return;
+
+	//acq_rel, whoever ends up last has to see the other jobs' writes before the waiter does. Only the one
+	//that actually takes it to zero closes the list, a job the owner adds meanwhile just keeps it above.
+	if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	//IsDone waits for this too, after it the owner may destroy the counter
+	Job *list = counter->continuations.exchange(JOB_CONTINUATIONS_CLOSED, std::memory_order_acq_rel);
+
+	while (list != NULL)
+	{
+		Job *next = list->next;
+		list->next = NULL;
+		Enqueue(slotIndex, list);
+		list = next;
+	}
+}
+
+bool JobSystem::InjectPush(const Job &job)
+{
+	{
+		ScopeLock<TrackedSpinMutex> lock(injectLock);
+
+		if (injectTail - injectHead >= JOB_INJECT_QUEUE_SIZE)
+			return false;
+
+		injectJobs[injectTail & (JOB_INJECT_QUEUE_SIZE - 1)] = job;
+		++injectTail;
+		injectCount.store(injectTail - injectHead, std::memory_order_relaxed);
+	}
+
+	WakeWorkers();
+	return true;
+}
+
+bool JobSystem::InjectPop(Job &out)
+{
+	if (injectCount.load(std::memory_order_relaxed) == 0)
+		return false;
+
+	ScopeLock<TrackedSpinMutex> lock(injectLock);
+
+	if (injectTail == injectHead)
+		return false;
+
+	out = injectJobs[injectHead & (JOB_INJECT_QUEUE_SIZE - 1)];
+	++injectHead;
+	injectCount.store(injectTail - injectHead, std::memory_order_relaxed);
+	return true;
+}
+
+Job* JobSystem::FindWork(int slotIndex, uint32_t &stealSeed)
+{
+	Job *job = slots[slotIndex]->deque.Pop();
+	if (job)
+		return job;
+
+	Job injected;
+	if (InjectPop(injected))
+		return AllocJob(slotIndex, injected);
+
+	//xorshift, start at a random victim so thieves don't all pile onto slot 0
+	stealSeed ^= stealSeed << 13;
+	stealSeed ^= stealSeed >> 17;
+	stealSeed ^= stealSeed << 5;
+
+	uint32_t slotCount = (uint32_t)slots.size();
+	uint32_t start = stealSeed % slotCount;
+
+	for (uint32_t i = 0; i < slotCount; ++i)
+	{
+		uint32_t victim = (start + i) % slotCount;
+		if ((int)victim == slotIndex || slots[victim]->deque.LooksEmpty())
+			continue;
+
+		job = slots[victim]->deque.Steal();
+		if (job)
+			return job;
+	}
+
+	return NULL;
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+	int slot = CurrentThreadSlot();
+	uint32_t seed = 0x9E3779B9u ^ (uint32_t)(slot + 1);
+	int idle = 0;
+
+	while (!counter.IsDone())
+	{
+		if (slot >= 0)
+		{
+			Job *job = FindWork(slot, seed);
+			if (job)
+			{
+				Execute(slot, job);
+				idle = 0;
+				continue;
+			}
+		}
+
+		//Whatever is left is running on other threads
+		if (++idle < LOCK_SPIN_COUNT)
+			LockCpuRelax();
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::WorkerProc(int slotIndex)
+{
+	tlsJobSystem = this;
+	tlsJobSlot = slotIndex;
+	PROFILE_THREAD_NAME("Job worker");
+
+	uint32_t seed = 0x9E3779B9u ^ (uint32_t)(slotIndex + 1) * 0x85EBCA6Bu;
+
+	while (!bQuit.load(std::memory_order_relaxed))
+	{
+		Job *job = FindWork(slotIndex, seed);
+		if (job)
+		{
+			Execute(slotIndex, job);
+			continue;
+		}
+
+		//Spin a little, new work usually shows up in bursts
+		for (int i = 0; i < LOCK_SPIN_COUNT && !job; ++i)
+		{
+			LockCpuRelax();
+			if ((i & 15) == 15)
+				job = FindWork(slotIndex, seed);
+		}
+
+		if (job)
+		{
+			Execute(slotIndex, job);
+			continue;
+		}
+
+		//Announce we're going to sleep, then look once more before parking
+		uint32_t seq = sleepSignal.load();
+		sleepingCount.fetch_add(1);
+
+		job = FindWork(slotIndex, seed);
+		if (!job && !bQuit.load())
+			LockParkOnAddress(sleepSignal, seq, LOCK_WAIT_INFINITE);
+
+		sleepingCount.fetch_sub(1);
+
+		if (job)
+			Execute(slotIndex, job);
+	}
+
+	tlsJobSystem = NULL;
+	tlsJobSlot = -1;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "Locks.h"
+#include "LockStats.h"
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+
+//Work stealing job scheduler.
+//
+//Every participating thread (the workers, plus threads that call RegisterCurrentThread such as the main,
+//simulation and render threads) has a Chase-Lev deque: it pushes and pops at the bottom, idle threads
+//steal from the top. Jobs carry a range and a grain size; a job bigger than its grain splits itself in
+//half and pushes the other half before running, so ParallelFor starts as one job and fans out on demand.
+//
+//Completion is tracked with JobCounters. Waiting on a counter from a registered thread runs other jobs
+//in the meantime instead of blocking, and jobs can be queued to start once a counter reaches zero (RunAfter).
+//
+//Jobs are allocated from a per thread ring of JOB_POOL_SIZE. A thread with that many of its jobs still in
+//flight runs other jobs until the entry it wants to reuse is done, so going past it costs time, not jobs.
+
+const uint32_t JOB_DEQUE_SIZE = 4096;		//Power of two
+const uint32_t JOB_POOL_SIZE = 4096;		//Power of two
+const int	   JOB_MAX_EXTERNAL_THREADS = 4;	//Non worker threads that can register
+const uint32_t JOB_INJECT_QUEUE_SIZE = 1024;	//Power of two, for submits from unregistered threads
+
+//Marks a counter's continuation list as already run
+#define JOB_CONTINUATIONS_CLOSED (reinterpret_cast<Job*>(1))
+
+typedef void (*JobFunction)(void *data, uint32_t begin, uint32_t end);
+
+class JobSystem;
+struct Job;
+
+
+//Number of unfinished jobs in a batch. Only add jobs to it from the thread that owns it or from jobs
+//on it, and don't destroy it while it isn't done. Can be reused once done.
+
+class JobCounter
+{
+public:
+	JobCounter() : pending(0), continuations(JOB_CONTINUATIONS_CLOSED) { }
+
+	//Done once the last job has also closed the continuation list, it touches the counter until then
+	inline bool IsDone() const
+	{
+		return pending.load(std::memory_order_acquire) == 0 && continuations.load(std::memory_order_acquire) == JOB_CONTINUATIONS_CLOSED;
+	}
+
+private:
+	friend class JobSystem;
+
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+
+	std::atomic<int32_t> pending;
+
+	//Jobs waiting for pending to hit zero, intrusive stack through Job::next. The job that takes pending to
+	//zero swaps in JOB_CONTINUATIONS_CLOSED and runs what it got, the next job added reopens it.
+	std::atomic<Job*> continuations;
+};
+
+
+struct Job
+{
+	JobFunction fn;
+	void	   *data;
+	uint32_t	begin;
+	uint32_t	end;
+	uint32_t	grain;		//0 = never split
+	JobCounter *counter;	//Decremented when this job (and any halves split off it) finishes, may be NULL
+	Job		   *next;		//Continuation list link
+	std::atomic<uint32_t> *live;	//Its pool entry's in use flag, NULL for jobs outside the pools
+};
+
+
+//Fixed size Chase-Lev work stealing deque (Le, Pop, Cohen, Zappa Nardelli 2013 C11 version)
+
+class JobDeque
+{
+public:
+	JobDeque();
+
+	//Owner only. False if full.
+	bool Push(Job *job);
+	Job* Pop();
+
+	//Any thread
+	Job* Steal();
+
+	inline bool LooksEmpty() const { return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> top;
+	char pad[64];
+	std::atomic<int64_t> bottom;
+	std::atomic<Job*> entries[JOB_DEQUE_SIZE];
+};
+
+
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	//workerCount < 0 means one per hardware thread, minus one for the calling thread. The calling thread is
+	//registered and takes part whenever it waits.
+	void Start(int workerCount = -1);
+	void Stop();
+
+	inline bool IsRunning() const { return bRunning; };
+	inline int  WorkerCount() const { return (int)workers.size(); };
+
+	//Threads that will submit or wait on jobs (sim/render threads). Unregistered threads can still submit,
+	//through a shared queue, but they just yield while waiting.
+	bool RegisterCurrentThread();
+	void UnregisterCurrentThread();
+
+	//Run fn(data, begin, end) over [begin, end), split down to grain sized pieces. counter may be NULL.
+	void Submit(JobFunction fn, void *data, uint32_t begin, uint32_t end, uint32_t grain, JobCounter *counter);
+
+	//Same, but only queued once dependency reaches zero (right away if it already has).
+	//From an unregistered thread this waits for dependency first.
+	void RunAfter(JobCounter &dependency, JobFunction fn, void *data, uint32_t begin, uint32_t end, uint32_t grain, JobCounter *counter);
+
+	//Runs other jobs until the counter reaches zero
+	void Wait(JobCounter &counter);
+
+	//fn(begin, end) over [0, count), blocks (while helping) until done
+	template <class TFunc>
+	void ParallelFor(uint32_t count, uint32_t grain, const TFunc &fn)
+	{
+		if (count == 0)
+			return;
+
+		if (grain == 0)
+			grain = 1;
+
+		//Not worth a job, or nobody to share with
+		if (count <= grain || !bRunning)
+		{
+			fn(0u, count);
+			return;
+		}
+
+		JobCounter counter;
+		Submit(&ParallelForThunk<TFunc>, (void*)&fn, 0, count, grain, &counter);
+		Wait(counter);
+	}
+
+	//Index of the calling thread's slot, -1 if not registered. Slots are [0, ThreadSlotCount()). Jobs run on a
+	//thread with one, except when Submit can't queue them and runs them inline on the submitting thread.
+	int CurrentThreadSlot() const;
+	inline int ThreadSlotCount() const { return (int)slots.size(); };
+
+private:
+
+	struct ThreadSlot
+	{
+		ThreadSlot() : nextJob(0), bInUse(false), jobPool(JOB_POOL_SIZE), jobLive(JOB_POOL_SIZE) { }
+
+		JobDeque deque;
+		uint32_t nextJob;
+		std::atomic<bool> bInUse;
+		std::vector<Job> jobPool;
+		std::vector<std::atomic<uint32_t> > jobLive;	//1 from AllocJob until the job is done with
+	};
+
+	template <class TFunc>
+	static void ParallelForThunk(void *data, uint32_t begin, uint32_t end)
+	{
+		(*static_cast<const TFunc*>(data))(begin, end);
+	}
+
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	void WorkerProc(int slotIndex);
+
+	Job* AllocJob(int slotIndex, const Job &desc);
+	void ReleaseJob(Job *job);
+	void AddPending(JobCounter *counter);		//One more job on it, reopens it if it was idle
+	void Enqueue(int slotIndex, Job *job);
+	Job* FindWork(int slotIndex, uint32_t &stealSeed);
+	void Execute(int slotIndex, Job *job);
+	void FinishJob(int slotIndex, Job *job);
+	void WakeWorkers();
+
+	bool InjectPush(const Job &job);
+	bool InjectPop(Job &out);
+
+	std::vector<ThreadSlot*> slots;		//Workers first, then external threads
+	std::vector<std::thread> workers;
+	std::atomic<bool> bQuit;
+	bool bRunning;
+
+	//Idle workers park on sleepSignal
+	std::atomic<uint32_t> sleepSignal;
+	std::atomic<uint32_t> sleepingCount;
+
+	//Submits from threads without a slot
+	TrackedSpinMutex injectLock;
+	std::vector<Job> injectJobs;
+	uint32_t injectHead;
+	uint32_t injectTail;
+	std::atomic<uint32_t> injectCount;
+};
@@ -0,0 +1,210 @@
+#include "stdafx.h"
+
+#include "LockStats.h"
+#include "ScopeLock.h"
+#include <algorithm>
+#include <stdio.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+std::atomic<bool> gLockStatsEnabled(DXAPP_LOCK_STATS_DEFAULT_ON != 0);
+
+//Every live LockStats, oldest first
+static SpinParkMutex registryLock;
+static LockStats *registryHead = NULL;
+static LockStats *registryTail = NULL;
+
+static double CountsToMs(int64_t counts)
+{
+	static const double msPerCount = []()
+	{
+		int64_t frequency = 0;
+		return (GameTimer::QueryFrequency(frequency) && frequency > 0) ? 1000.0 / (double)frequency : 0.0;
+	}();
+
+	return counts * msPerCount;
+}
+
+static void AtomicMax(std::atomic<int64_t> &value, int64_t candidate)
+{
+	int64_t cur = value.load(std::memory_order_relaxed);
+	while (candidate > cur && !value.compare_exchange_weak(cur, candidate, std::memory_order_relaxed))
+		;
+}
+
+
+LockStats::LockStats(const char *lockName)
+	: name(lockName), acquisitions(0), contended(0), timeouts(0), totalWait(0), maxWait(0), totalHold(0), maxHold(0),
+	prev(NULL), next(NULL)
+{
+	for (uint32_t i = 0; i < LOCKSTATS_WAIT_BUCKETS; ++i)
+		waitHistogram[i].store(0, std::memory_order_relaxed);
+
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	prev = registryTail;
+	if (registryTail)
+		registryTail->next = this;
+	else
+		registryHead = this;
+	registryTail = this;
+}
+
+LockStats::~LockStats()
+{
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	if (prev)
+		prev->next = next;
+	else
+		registryHead = next;
+
+	if (next)
+		next->prev = prev;
+	else
+		registryTail = prev;
+}
+
+void LockStats::RecordWait(int64_t waitCounts)
+{
+	totalWait.fetch_add(waitCounts, std::memory_order_relaxed);
+	AtomicMax(maxWait, waitCounts);
+
+	double us = CountsToMs(waitCounts) * 1000.0;
+	uint32_t bucket = 0;
+	while (bucket + 1 < LOCKSTATS_WAIT_BUCKETS && us >= (double)(1u << bucket))
+		++bucket;
+
+	waitHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStats::RecordAcquire(bool bContended, int64_t waitCounts)
+{
+	acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+	if (bContended)
+	{
+		contended.fetch_add(1, std::memory_order_relaxed);
+		RecordWait(waitCounts);
+	}
+}
+
+void LockStats::RecordTimeout(int64_t waitCounts)
+{
+	timeouts.fetch_add(1, std::memory_order_relaxed);
+	RecordWait(waitCounts);
+}
+
+void LockStats::RecordHold(int64_t holdCounts)
+{
+	totalHold.fetch_add(holdCounts, std::memory_order_relaxed);
+	AtomicMax(maxHold, holdCounts);
+}
+
+void LockStats::Snapshot(LockStatsSnapshot &out) const
+{
+	out.name = name;
+	out.acquisitions = acquisitions.load(std::memory_order_relaxed);
+	out.contended = contended.load(std::memory_order_relaxed);
+	out.timeouts = timeouts.load(std::memory_order_relaxed);
+	for (uint32_t i = 0; i < LOCKSTATS_WAIT_BUCKETS; ++i)
+		out.waitHistogram[i] = waitHistogram[i].load(std::memory_order_relaxed);
+	out.totalWaitMs = CountsToMs(totalWait.load(std::memory_order_relaxed));
+	out.maxWaitMs = CountsToMs(maxWait.load(std::memory_order_relaxed));
+	out.totalHoldMs = CountsToMs(totalHold.load(std::memory_order_relaxed));
+	out.maxHoldMs = CountsToMs(maxHold.load(std::memory_order_relaxed));
+}
+
+void LockStats::Reset()
+{
+	acquisitions.store(0, std::memory_order_relaxed);
+	contended.store(0, std::memory_order_relaxed);
+	timeouts.store(0, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < LOCKSTATS_WAIT_BUCKETS; ++i)
+		waitHistogram[i].store(0, std::memory_order_relaxed);
+	totalWait.store(0, std::memory_order_relaxed);
+	maxWait.store(0, std::memory_order_relaxed);
+	totalHold.store(0, std::memory_order_relaxed);
+	maxHold.store(0, std::memory_order_relaxed);
+}
+
+
+void LockStatsSnapshotAll(std::vector<LockStatsSnapshot> &out)
+{
+	out.clear();
+
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	for (const LockStats *stats = registryHead; stats; stats = stats->next)
+	{
+		out.push_back(LockStatsSnapshot());
+		stats->Snapshot(out.back());
+	}
+}
+
+void LockStatsResetAll()
+{
+	ScopeLock<SpinParkMutex> lock(registryLock);
+	for (LockStats *stats = registryHead; stats; stats = stats->next)
+		stats->Reset();
+}
+
+void LockStatsSetEnabled(bool bEnabled)
+{
+	gLockStatsEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+void LockStatsFormatReport(std::string &out)
+{
+	std::vector<LockStatsSnapshot> snapshots;
+	LockStatsSnapshotAll(snapshots);
+
+	std::stable_sort(snapshots.begin(), snapshots.end(), [](const LockStatsSnapshot &a, const LockStatsSnapshot &b)
+	{
+		return a.totalWaitMs > b.totalWaitMs;
+	});
+
+	char line[256];
+	snprintf(line, sizeof(line), "Locks: %u tracked%s\n\n  %-14s %10s %10s %8s %10s %9s %10s %9s\n", (unsigned)snapshots.size(),
+		LockStatsEnabled() ? "" : " (recording off, see LockStatsSetEnabled)", "lock", "acquires", "contended", "timeouts", "wait ms", "max wait", "hold ms", "max hold");
+	out = line;
+
+	for (size_t i = 0; i < snapshots.size(); ++i)
+	{
+		const LockStatsSnapshot &s = snapshots[i];
+		snprintf(line, sizeof(line), "  %-14s %10llu %10llu %8llu %10.3f %9.3f %10.3f %9.3f\n", s.name ? s.name : "?",
+			(unsigned long long)s.acquisitions, (unsigned long long)s.contended, (unsigned long long)s.timeouts,
+			s.totalWaitMs, s.maxWaitMs, s.totalHoldMs, s.maxHoldMs);
+		out += line;
+
+		if (s.contended + s.timeouts == 0)
+			continue;
+
+		//Only the buckets something landed in, by upper bound
+		out += "      waits:";
+		for (uint32_t b = 0; b < LOCKSTATS_WAIT_BUCKETS; ++b)
+		{
+			if (s.waitHistogram[b] == 0)
+				continue;
+
+			if (b + 1 == LOCKSTATS_WAIT_BUCKETS)
+				snprintf(line, sizeof(line), " >=%uus:%llu", 1u << (b - 1), (unsigned long long)s.waitHistogram[b]);
+			else
+				snprintf(line, sizeof(line), " <%uus:%llu", 1u << b, (unsigned long long)s.waitHistogram[b]);
+			out += line;
+		}
+		out += "\n";
+	}
+}
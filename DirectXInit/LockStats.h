@@ -0,0 +1,261 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "GameTimer.h"
+#include "Locks.h"
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+//Build with DXAPP_LOCK_STATS=0 and TrackedLock is just the lock it wraps, nothing counted or registered
+#ifndef DXAPP_LOCK_STATS
+#define DXAPP_LOCK_STATS 1
+#endif
+
+//Whether tracked locks record at all to begin with (LockStatsSetEnabled changes it at runtime). Recording
+//takes an uncontended acquire from ~15 to ~90 ns, so only debug builds start with it on.
+#ifndef DXAPP_LOCK_STATS_DEFAULT_ON
+#ifdef _DEBUG
+#define DXAPP_LOCK_STATS_DEFAULT_ON 1
+#else
+#define DXAPP_LOCK_STATS_DEFAULT_ON 0
+#endif
+#endif
+
+//Wait histogram buckets: [0] under 1 us, [i] 2^(i-1) to 2^i us, the last one everything from ~16 ms up
+const uint32_t LOCKSTATS_WAIT_BUCKETS = 16;
+
+
+struct LockStatsSnapshot
+{
+	const char *name;
+	uint64_t acquisitions;		//Exclusive and shared
+	uint64_t contended;			//Had to wait (spin or park) before getting it
+	uint64_t timeouts;			//Gave up waiting
+	uint64_t waitHistogram[LOCKSTATS_WAIT_BUCKETS];	//Contended waits, timeouts included
+	double	 totalWaitMs;
+	double	 maxWaitMs;
+	double	 totalHoldMs;		//Exclusive holds only, readers overlap
+	double	 maxHoldMs;
+};
+
+
+//Counters for one lock, registered under its name for as long as it lives. Any thread records, everything
+//is relaxed atomics so a snapshot taken while the lock is in use can be a few counts out between fields.
+
+class LockStats
+{
+public:
+	explicit LockStats(const char *name);
+	~LockStats();
+
+	inline const char* Name() const { return name; };
+
+	//Times in GameTimer counts
+	void RecordAcquire(bool bContended, int64_t waitCounts);
+	void RecordTimeout(int64_t waitCounts);
+	void RecordHold(int64_t holdCounts);
+
+	void Snapshot(LockStatsSnapshot &out) const;
+	void Reset();
+
+private:
+	LockStats(const LockStats&);
+	LockStats& operator=(const LockStats&);
+
+	void RecordWait(int64_t waitCounts);
+
+	const char *name;
+
+	std::atomic<uint64_t> acquisitions;
+	std::atomic<uint64_t> contended;
+	std::atomic<uint64_t> timeouts;
+	std::atomic<uint64_t> waitHistogram[LOCKSTATS_WAIT_BUCKETS];
+	std::atomic<int64_t>  totalWait;
+	std::atomic<int64_t>  maxWait;
+	std::atomic<int64_t>  totalHold;
+	std::atomic<int64_t>  maxHold;
+
+	//Registry list, under the registry's lock
+	LockStats *prev;
+	LockStats *next;
+
+	friend void LockStatsSnapshotAll(std::vector<LockStatsSnapshot> &out);
+	friend void LockStatsResetAll();
+};
+
+
+//The registry: every LockStats alive right now, in the order they were created
+void LockStatsSnapshotAll(std::vector<LockStatsSnapshot> &out);
+void LockStatsResetAll();
+
+//Table of every registered lock, worst total wait first
+void LockStatsFormatReport(std::string &out);
+
+//Turns recording on or off for every tracked lock. Off, a tracked lock costs one relaxed load and branch over
+//the lock it wraps. A lock held across the switch just doesn't count that hold.
+void LockStatsSetEnabled(bool bEnabled);
+
+extern std::atomic<bool> gLockStatsEnabled;
+
+inline bool LockStatsEnabled() { return gLockStatsEnabled.load(std::memory_order_relaxed); }
+
+
+//Lock policy wrapper (same interface as the one it wraps, see Locks.h) that feeds a LockStats. While
+//recording (LockStatsEnabled) the uncontended path pays two counter reads (acquire and release) on top of
+//the lock itself, so wrap the locks worth watching rather than everything.
+//
+//Contention is anything that didn't get the lock on the first try. A failed TryLock on its own isn't counted,
+//only the waits (TryLockFor, Lock, LockShared) are.
+
+template <class TLock>
+class TrackedLock
+{
+public:
+#if DXAPP_LOCK_STATS
+	explicit TrackedLock(const char *name) : stats(name), holdStart(0) { }
+
+	inline LockStats* Stats() { return &stats; }
+
+	inline bool TryLock()
+	{
+		if (!lock.TryLock())
+			return false;
+
+		if (LockStatsEnabled())
+			Acquired(false, 0);
+		return true;
+	}
+
+	inline void Lock()
+	{
+		if (TryLock())
+			return;
+
+		if (!LockStatsEnabled())
+		{
+			lock.Lock();
+			return;
+		}
+
+		int64_t start = Now();
+		lock.Lock();
+		Acquired(true, Now() - start);
+	}
+
+	inline bool TryLockFor(unsigned int timeoutMs)
+	{
+		if (TryLock())
+			return true;
+
+		if (!LockStatsEnabled())
+			return lock.TryLockFor(timeoutMs);
+
+		int64_t start = Now();
+		if (!lock.TryLockFor(timeoutMs))
+		{
+			stats.RecordTimeout(Now() - start);
+			return false;
+		}
+
+		Acquired(true, Now() - start);
+		return true;
+	}
+
+	inline void Unlock()
+	{
+		//0 when the acquire wasn't recorded
+		if (holdStart != 0)
+		{
+			stats.RecordHold(Now() - holdStart);
+			holdStart = 0;
+		}
+		lock.Unlock();
+	}
+
+	inline bool TryLockShared()
+	{
+		if (!lock.TryLockShared())
+			return false;
+
+		if (LockStatsEnabled())
+			stats.RecordAcquire(false, 0);
+		return true;
+	}
+
+	inline void LockShared()
+	{
+		if (TryLockShared())
+			return;
+
+		if (!LockStatsEnabled())
+		{
+			lock.LockShared();
+			return;
+		}
+
+		int64_t start = Now();
+		lock.LockShared();
+		stats.RecordAcquire(true, Now() - start);
+	}
+
+	inline void UnlockShared() { lock.UnlockShared(); }
+
+private:
+	static inline int64_t Now()
+	{
+		int64_t counter = 0;
+		GameTimer::QueryCounter(counter);
+		return counter;
+	}
+
+	//Only the holder touches holdStart, the lock orders it between holders
+	inline void Acquired(bool bContended, int64_t waitCounts)
+	{
+		holdStart = Now();
+		stats.RecordAcquire(bContended, waitCounts);
+	}
+
+	LockStats stats;
+	int64_t	  holdStart;
+#else
+	explicit TrackedLock(const char*) { }
+
+	inline LockStats* Stats() { return NULL; }
+
+	inline bool TryLock() { return lock.TryLock(); }
+	inline void Lock() { lock.Lock(); }
+	inline bool TryLockFor(unsigned int timeoutMs) { return lock.TryLockFor(timeoutMs); }
+	inline void Unlock() { lock.Unlock(); }
+	inline bool TryLockShared() { return lock.TryLockShared(); }
+	inline void LockShared() { lock.LockShared(); }
+	inline void UnlockShared() { lock.UnlockShared(); }
+
+private:
+#endif
+
+	TrackedLock(const TrackedLock&);
+	TrackedLock& operator=(const TrackedLock&);
+
+	TLock lock;
+};
+
+
+typedef TrackedLock<SpinParkMutex> TrackedSpinMutex;
@@ -0,0 +1,353 @@
+#include "stdafx.h"
+
+#include "Locks.h"
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+//WaitOnAddress/WakeByAddress* (Windows 8+)
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <errno.h>
+#endif
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+uint64_t LockNowMs()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Work out how long is left before the deadline, false if we are already past it
+static inline bool RemainingMs(uint64_t deadline, unsigned int timeoutMs, unsigned int &remaining)
+{
+	if (timeoutMs == LOCK_WAIT_INFINITE)
+	{
+		remaining = LOCK_WAIT_INFINITE;
+		return true;
+	}
+
+	uint64_t now = LockNowMs();
+	if (now >= deadline)
+		return false;
+
+	remaining = (unsigned int)(deadline - now);
+	return true;
+}
+
+
+bool LockParkOnAddress(std::atomic<uint32_t> &addr, uint32_t expected, unsigned int timeoutMs)
+{
+#ifdef _WIN32
+
+	if (!WaitOnAddress((volatile void*)&addr, &expected, sizeof(uint32_t), timeoutMs == LOCK_WAIT_INFINITE ? INFINITE : timeoutMs))
+		return GetLastError() != ERROR_TIMEOUT;
+	return true;
+
+#elif defined(__linux__)
+
+	struct timespec ts;
+	struct timespec *pts = NULL;
+
+	if (timeoutMs != LOCK_WAIT_INFINITE)
+	{
+		ts.tv_sec = timeoutMs / 1000;
+		ts.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+		pts = &ts;
+	}
+
+	if (syscall(SYS_futex, reinterpret_cast<uint32_t*>(&addr), FUTEX_WAIT_PRIVATE, expected, pts, NULL, 0) == -1)
+		return errno != ETIMEDOUT;
+	return true;
+
+#else
+
+	//No address wait on this platform, degrade to yielding. Callers re-check state anyway.
+	(void)expected;
+	(void)timeoutMs;
+	std::this_thread::yield();
+	return true;
+
+#endif
+}
+
+void LockUnparkOne(std::atomic<uint32_t> &addr)
+{
+#ifdef _WIN32
+	WakeByAddressSingle((void*)&addr);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&addr), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)addr;
+#endif
+}
+
+void LockUnparkAll(std::atomic<uint32_t> &addr)
+{
+#ifdef _WIN32
+	WakeByAddressAll((void*)&addr);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&addr), FUTEX_WAKE_PRIVATE, 0x7FFFFFFF, NULL, NULL, 0);
+#else
+	(void)addr;
+#endif
+}
+
+
+//SpinParkMutex
+
+bool SpinParkMutex::LockSlow(unsigned int timeoutMs)
+{
+	//Spin first, most of our critical sections are a handful of instructions
+	for (int i = 0; i < LOCK_SPIN_COUNT; ++i)
+	{
+		LockCpuRelax();
+
+		if (state.load(std::memory_order_relaxed) == 0 && TryLock())
+			return true;
+	}
+
+	uint64_t deadline = (timeoutMs == LOCK_WAIT_INFINITE) ? 0 : LockNowMs() + timeoutMs;
+
+	//Mark the lock contended, if it was free we now own it (in contended state, which just costs
+	//one extra wake on unlock).
+	uint32_t prev = state.exchange(2, std::memory_order_acquire);
+
+	while (prev != 0)
+	{
+		unsigned int remaining;
+		if (!RemainingMs(deadline, timeoutMs, remaining))
+			return false;
+
+		LockParkOnAddress(state, 2, remaining);
+		prev = state.exchange(2, std::memory_order_acquire);
+	}
+
+	return true;
+}
+
+
+//SharedSpinMutex
+
+bool SharedSpinMutex::LockSlow(unsigned int timeoutMs)
+{
+	for (int i = 0; i < LOCK_SPIN_COUNT; ++i)
+	{
+		LockCpuRelax();
+
+		if (TryLock())
+			return true;
+	}
+
+	uint64_t deadline = (timeoutMs == LOCK_WAIT_INFINITE) ? 0 : LockNowMs() + timeoutMs;
+	writersWaiting.fetch_add(1);
+
+	for (;;)
+	{
+		//Keep new readers out while we wait
+		state.fetch_or(WRITER_PENDING, std::memory_order_relaxed);
+
+		if (TryLock())
+		{
+			writersWaiting.fetch_sub(1);
+			return true;
+		}
+
+		unsigned int remaining;
+		if (!RemainingMs(deadline, timeoutMs, remaining))
+		{
+			//Last writer out takes the flag with it and lets the parked readers in. A writer arriving
+			//right after sets it again on its next pass (and the wake gets it there if it's parked).
+			if (writersWaiting.fetch_sub(1) == 1)
+			{
+				state.fetch_and(~WRITER_PENDING);
+				WakeWaiters();
+			}
+			return false;
+		}
+
+		parkedCount.fetch_add(1);
+		uint32_t seq = wakeSeq.load();
+
+		//Re-check after registering, so an unlock between TryLock and here can't be missed
+		if (state.load() & (WRITER | READER_MASK))
+			LockParkOnAddress(wakeSeq, seq, remaining);
+
+		parkedCount.fetch_sub(1);
+	}
+}
+
+void SharedSpinMutex::LockSharedSlow()
+{
+	for (int i = 0; i < LOCK_SPIN_COUNT; ++i)
+	{
+		LockCpuRelax();
+
+		if (TryLockShared())
+			return;
+	}
+
+	for (;;)
+	{
+		if (TryLockShared())
+			return;
+
+		parkedCount.fetch_add(1);
+		uint32_t seq = wakeSeq.load();
+
+		if (state.load() & (WRITER | WRITER_PENDING))
+			LockParkOnAddress(wakeSeq, seq, LOCK_WAIT_INFINITE);
+
+		parkedCount.fetch_sub(1);
+	}
+}
+
+
+//KernelMutex
+
+#ifdef _WIN32
+
+KernelMutex::KernelMutex() : mutexHandle(NULL), bValid(false)
+{
+	mutexHandle = CreateMutex(NULL, false, NULL);
+	bValid = (mutexHandle != NULL);
+}
+
+KernelMutex::~KernelMutex()
+{
+	if (bValid)
+		CloseHandle(mutexHandle);
+}
+
+bool KernelMutex::TryLock()
+{
+	return bValid && WaitForSingleObject(mutexHandle, 0) == WAIT_OBJECT_0;
+}
+
+void KernelMutex::Lock()
+{
+	if (bValid)
+		WaitForSingleObject(mutexHandle, INFINITE);
+}
+
+bool KernelMutex::TryLockFor(unsigned int timeoutMs)
+{
+	return bValid && WaitForSingleObject(mutexHandle, timeoutMs == LOCK_WAIT_INFINITE ? INFINITE : timeoutMs) == WAIT_OBJECT_0;
+}
+
+void KernelMutex::Unlock()
+{
+	if (bValid)
+		ReleaseMutex(mutexHandle);
+}
+
+#else
+
+KernelMutex::KernelMutex() : semId(-1), bValid(false)
+{
+	semId = semget(IPC_PRIVATE, 1, IPC_CREAT | 0600);
+	if (semId == -1)
+		return;
+
+	if (semctl(semId, 0, SETVAL, 1) == -1)
+	{
+		semctl(semId, 0, IPC_RMID);
+		semId = -1;
+		return;
+	}
+
+	bValid = true;
+}
+
+KernelMutex::~KernelMutex()
+{
+	if (bValid)
+		semctl(semId, 0, IPC_RMID);
+}
+
+bool KernelMutex::TryLock()
+{
+	if (!bValid)
+		return false;
+
+	struct sembuf op = { 0, -1, IPC_NOWAIT };
+	return semop(semId, &op, 1) == 0;
+}
+
+void KernelMutex::Lock()
+{
+	if (!bValid)
+		return;
+
+	struct sembuf op = { 0, -1, 0 };
+	while (semop(semId, &op, 1) == -1 && errno == EINTR)
+		;
+}
+
+bool KernelMutex::TryLockFor(unsigned int timeoutMs)
+{
+	if (!bValid)
+		return false;
+
+	if (timeoutMs == LOCK_WAIT_INFINITE)
+	{
+		Lock();
+		return true;
+	}
+
+#ifdef __linux__
+	struct sembuf op = { 0, -1, 0 };
+	struct timespec ts;
+	ts.tv_sec = timeoutMs / 1000;
+	ts.tv_nsec = (long)(timeoutMs % 1000) * 1000000L;
+	return semtimedop(semId, &op, 1, &ts) == 0;
+#else
+	uint64_t deadline = LockNowMs() + timeoutMs;
+	while (!TryLock())
+	{
+		if (LockNowMs() >= deadline)
+			return false;
+		std::this_thread::yield();
+	}
+	return true;
+#endif
+}
+
+void KernelMutex::Unlock()
+{
+	if (!bValid)
+		return;
+
+	struct sembuf op = { 0, 1, 0 };
+	semop(semId, &op, 1);
+}
+
+#endif
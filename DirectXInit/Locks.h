@@ -0,0 +1,307 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+//Lock policies that ScopeLock can be instantiated with. All of them expose the same small interface:
+//	Lock(), TryLock(), TryLockFor(ms), Unlock()
+//and the reader/writer lock adds LockShared()/TryLockShared()/UnlockShared().
+//
+//None of these are named or shared across processes, and none of them are recursive.
+//An uncontended Lock()/Unlock() pair is a single atomic op each, we only go to the kernel to park a
+//thread after spinning for a while.
+
+
+//Spin a short while with a pause instruction between attempts before asking the OS to park us.
+const int LOCK_SPIN_COUNT = 128;
+
+//Low level park/unpark on a 32 bit word (WaitOnAddress on windows, futex on linux).
+//Park returns when *addr != expected, when woken, on timeout, or spuriously; callers always re-check.
+//timeoutMs of LOCK_WAIT_INFINITE waits forever. Returns false only if the wait timed out.
+const unsigned int LOCK_WAIT_INFINITE = 0xFFFFFFFF;
+
+bool LockParkOnAddress(std::atomic<uint32_t> &addr, uint32_t expected, unsigned int timeoutMs);
+void LockUnparkOne(std::atomic<uint32_t> &addr);
+void LockUnparkAll(std::atomic<uint32_t> &addr);
+
+//Milliseconds on a monotonic clock, used for timeouts
+uint64_t LockNowMs();
+
+inline void LockCpuRelax()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+
+//Spin-then-park mutex. State is 0 (free), 1 (locked), 2 (locked, and someone may be parked on it).
+//Unlock only pays for a wake syscall when the state says there is a waiter.
+
+class SpinParkMutex
+{
+public:
+	SpinParkMutex() : state(0) { }
+
+	inline bool TryLock()
+	{
+		uint32_t expected = 0;
+		return state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	inline void Lock()
+	{
+		if (TryLock())
+			return;
+
+		LockSlow(LOCK_WAIT_INFINITE);
+	}
+
+	inline bool TryLockFor(unsigned int timeoutMs)
+	{
+		if (TryLock())
+			return true;
+
+		return LockSlow(timeoutMs);
+	}
+
+	inline void Unlock()
+	{
+		if (state.exchange(0, std::memory_order_release) == 2)
+			LockUnparkOne(state);
+	}
+
+private:
+
+	bool LockSlow(unsigned int timeoutMs);
+
+	SpinParkMutex(const SpinParkMutex&);
+	SpinParkMutex& operator=(const SpinParkMutex&);
+
+	std::atomic<uint32_t> state;
+};
+
+
+//Mutex that one thread can claim for a long stretch (the render thread owning the device context).
+//While claimed, lock calls from the owning thread pass straight through without touching the mutex, so
+//nested ScopeLocks in code the owner calls don't deadlock and don't cost anything. Other threads block on
+//it like a normal mutex until the owner releases the claim.
+//
+//TMutex is the lock underneath, a SpinParkMutex or something wrapping one (TrackedLock). A claim is one
+//acquisition of it, held until ReleaseClaim.
+
+template <class TMutex>
+class BasicClaimableMutex
+{
+public:
+	BasicClaimableMutex() : owner(std::thread::id()) { }
+
+	//For mutexes that take a constructor argument (TrackedLock's name)
+	template <class TArg>
+	explicit BasicClaimableMutex(TArg arg) : mutex(arg), owner(std::thread::id()) { }
+
+	inline bool IsOwner() const { return owner.load(std::memory_order_relaxed) == std::this_thread::get_id(); }
+	inline bool IsClaimed() const { return owner.load(std::memory_order_relaxed) != std::thread::id(); }
+
+	inline bool Claim(unsigned int timeoutMs)
+	{
+		if (IsOwner())
+			return true;
+
+		if (!mutex.TryLockFor(timeoutMs))
+			return false;
+
+		owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+		return true;
+	}
+
+	inline void ReleaseClaim()
+	{
+		if (!IsOwner())
+			return;
+
+		owner.store(std::thread::id(), std::memory_order_relaxed);
+		mutex.Unlock();
+	}
+
+	inline bool TryLock() { return IsOwner() || mutex.TryLock(); }
+	inline void Lock() { if (!IsOwner()) mutex.Lock(); }
+	inline bool TryLockFor(unsigned int timeoutMs) { return IsOwner() || mutex.TryLockFor(timeoutMs); }
+	inline void Unlock() { if (!IsOwner()) mutex.Unlock(); }
+
+private:
+	BasicClaimableMutex(const BasicClaimableMutex&);
+	BasicClaimableMutex& operator=(const BasicClaimableMutex&);
+
+	TMutex mutex;
+
+	//Only ever set to a thread's own id by that thread, so comparing against our own id is race free
+	std::atomic<std::thread::id> owner;
+};
+
+typedef BasicClaimableMutex<SpinParkMutex> ClaimableMutex;
+
+
+//Reader/writer lock, same spin-then-park idea. A waiting writer sets WRITER_PENDING so new readers
+//back off and writers don't starve under a steady stream of readers. The last waiting writer to give up
+//(TryLockFor timing out) clears it again, otherwise readers would park until some other writer came along.
+
+class SharedSpinMutex
+{
+public:
+	SharedSpinMutex() : state(0), wakeSeq(0), parkedCount(0), writersWaiting(0) { }
+
+	inline bool TryLock()
+	{
+		uint32_t cur = state.load(std::memory_order_relaxed);
+		if (cur & (WRITER | READER_MASK))
+			return false;
+
+		//Clears WRITER_PENDING as well, any other waiting writer will set it again
+		return state.compare_exchange_strong(cur, WRITER, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	inline bool TryLockShared()
+	{
+		uint32_t cur = state.load(std::memory_order_relaxed);
+		if (cur & (WRITER | WRITER_PENDING))
+			return false;
+
+		return state.compare_exchange_strong(cur, cur + 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	inline void Lock()
+	{
+		if (TryLock())
+			return;
+
+		LockSlow(LOCK_WAIT_INFINITE);
+	}
+
+	inline bool TryLockFor(unsigned int timeoutMs)
+	{
+		if (TryLock())
+			return true;
+
+		return LockSlow(timeoutMs);
+	}
+
+	inline void LockShared()
+	{
+		if (TryLockShared())
+			return;
+
+		LockSharedSlow();
+	}
+
+	inline void Unlock()
+	{
+		//seq_cst, see WakeWaiters
+		state.fetch_and(~WRITER);
+		WakeWaiters();
+	}
+
+	inline void UnlockShared()
+	{
+		if ((state.fetch_sub(1) & READER_MASK) == 1)
+			WakeWaiters();
+	}
+
+private:
+
+	static const uint32_t WRITER = 0x80000000u;
+	static const uint32_t WRITER_PENDING = 0x40000000u;
+	static const uint32_t READER_MASK = 0x3FFFFFFFu;
+
+	bool LockSlow(unsigned int timeoutMs);
+	void LockSharedSlow();
+
+	inline void WakeWaiters()
+	{
+		//Pairs with the parkedCount increment in the slow paths, both are seq_cst so either the waiter
+		//sees our state change or we see its count.
+		if (parkedCount.load() != 0)
+		{
+			wakeSeq.fetch_add(1);
+			LockUnparkAll(wakeSeq);
+		}
+	}
+
+	SharedSpinMutex(const SharedSpinMutex&);
+	SharedSpinMutex& operator=(const SharedSpinMutex&);
+
+	std::atomic<uint32_t> state;
+	std::atomic<uint32_t> wakeSeq;
+	std::atomic<uint32_t> parkedCount;
+	std::atomic<uint32_t> writersWaiting;		//In LockSlow past the spin, so wanting WRITER_PENDING set
+};
+
+
+//No-op policy, for single threaded builds or data that is provably only touched by one thread.
+
+class NullLock
+{
+public:
+	inline bool TryLock() { return true; }
+	inline void Lock() { }
+	inline bool TryLockFor(unsigned int) { return true; }
+	inline void Unlock() { }
+	inline bool TryLockShared() { return true; }
+	inline void LockShared() { }
+	inline void UnlockShared() { }
+};
+
+
+//The old behavior, every acquire/release is a kernel call. Kept around so we can measure against it,
+//and for anything that really does need a kernel object. Unnamed, so no cross process collisions.
+//Windows: CreateMutex/WaitForSingleObject (recursive). Elsewhere: a SysV semaphore (not recursive).
+
+class KernelMutex
+{
+public:
+	KernelMutex();
+	~KernelMutex();
+
+	inline bool IsValid() const { return bValid; }
+
+	bool TryLock();
+	void Lock();
+	bool TryLockFor(unsigned int timeoutMs);
+	void Unlock();
+
+private:
+	KernelMutex(const KernelMutex&);
+	KernelMutex& operator=(const KernelMutex&);
+
+#ifdef _WIN32
+	HANDLE mutexHandle;
+#else
+	int semId;
+#endif
+	bool bValid;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "VecMath.h"
+
+//Batch kernels over structure of arrays data: x, y and z each in their own array, so MATH_SOA_LANES (8)
+//elements go through every instruction at once with no shuffling. On AVX2 that's one register, elsewhere
+//two 4 lane ones. Counts that aren't a multiple of 8 finish on the scalar path.
+//
+//Inputs and outputs may be the same arrays (in place), but shouldn't otherwise overlap. No alignment needed.
+
+
+//One matrix element in every lane
+struct SoAMat4
+{
+	SimdF8 m[4][4];
+};
+
+inline void LoadSoAMat4(SoAMat4 &out, const Mat4 &matrix)
+{
+	Float4x4 f;
+	StoreFloat4x4(f, matrix);
+	for (int r = 0; r < 4; ++r)
+		for (int c = 0; c < 4; ++c)
+			out.m[r][c] = F8Splat(f.m[r][c]);
+}
+
+
+//Reference versions, one element at a time. The kernels below use them for their tails.
+
+inline void TransformPointsScalar(const Mat4 &matrix, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, uint32_t count)
+{
+	Float4x4 f;
+	StoreFloat4x4(f, matrix);
+	const float (*m)[4] = f.m;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float px = x[i], py = y[i], pz = z[i];
+		outX[i] = px * m[0][0] + py * m[1][0] + pz * m[2][0] + m[3][0];
+		outY[i] = px * m[0][1] + py * m[1][1] + pz * m[2][1] + m[3][1];
+		outZ[i] = px * m[0][2] + py * m[1][2] + pz * m[2][2] + m[3][2];
+	}
+}
+
+inline void TransformVectorsScalar(const Mat4 &matrix, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, uint32_t count)
+{
+	Float4x4 f;
+	StoreFloat4x4(f, matrix);
+	const float (*m)[4] = f.m;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float dx = x[i], dy = y[i], dz = z[i];
+		outX[i] = dx * m[0][0] + dy * m[1][0] + dz * m[2][0];
+		outY[i] = dx * m[0][1] + dy * m[1][1] + dz * m[2][1];
+		outZ[i] = dx * m[0][2] + dy * m[1][2] + dz * m[2][2];
+	}
+}
+
+inline void Normalize3Scalar(float *x, float *y, float *z, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float lengthSq = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+		float scale = lengthSq > 0.0f ? 1.0f / sqrtf(lengthSq) : 0.0f;
+		x[i] *= scale;
+		y[i] *= scale;
+		z[i] *= scale;
+	}
+}
+
+
+//Points (w = 1) through matrix, no divide by w
+inline void TransformPointsSoA(const Mat4 &matrix, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, uint32_t count)
+{
+	SoAMat4 m;
+	LoadSoAMat4(m, matrix);
+
+	uint32_t i = 0;
+	for (; i + MATH_SOA_LANES <= count; i += MATH_SOA_LANES)
+	{
+		SimdF8 px = F8Load(x + i), py = F8Load(y + i), pz = F8Load(z + i);
+
+		SimdF8 rx = F8MulAdd(pz, m.m[2][0], F8MulAdd(py, m.m[1][0], F8MulAdd(px, m.m[0][0], m.m[3][0])));
+		SimdF8 ry = F8MulAdd(pz, m.m[2][1], F8MulAdd(py, m.m[1][1], F8MulAdd(px, m.m[0][1], m.m[3][1])));
+		SimdF8 rz = F8MulAdd(pz, m.m[2][2], F8MulAdd(py, m.m[1][2], F8MulAdd(px, m.m[0][2], m.m[3][2])));
+
+		F8Store(outX + i, rx);
+		F8Store(outY + i, ry);
+		F8Store(outZ + i, rz);
+	}
+
+	if (i < count)
+		TransformPointsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+//Directions (w = 0), translation ignored
+inline void TransformVectorsSoA(const Mat4 &matrix, const float *x, const float *y, const float *z,
+	float *outX, float *outY, float *outZ, uint32_t count)
+{
+	SoAMat4 m;
+	LoadSoAMat4(m, matrix);
+
+	uint32_t i = 0;
+	for (; i + MATH_SOA_LANES <= count; i += MATH_SOA_LANES)
+	{
+		SimdF8 dx = F8Load(x + i), dy = F8Load(y + i), dz = F8Load(z + i);
+
+		SimdF8 rx = F8MulAdd(dz, m.m[2][0], F8MulAdd(dy, m.m[1][0], F8Mul(dx, m.m[0][0])));
+		SimdF8 ry = F8MulAdd(dz, m.m[2][1], F8MulAdd(dy, m.m[1][1], F8Mul(dx, m.m[0][1])));
+		SimdF8 rz = F8MulAdd(dz, m.m[2][2], F8MulAdd(dy, m.m[1][2], F8Mul(dx, m.m[0][2])));
+
+		F8Store(outX + i, rx);
+		F8Store(outY + i, ry);
+		F8Store(outZ + i, rz);
+	}
+
+	if (i < count)
+		TransformVectorsScalar(matrix, x + i, y + i, z + i, outX + i, outY + i, outZ + i, count - i);
+}
+
+//In place, zero length stays zero
+inline void Normalize3SoA(float *x, float *y, float *z, uint32_t count)
+{
+	const SimdF8 zero = F8Zero();
+
+	uint32_t i = 0;
+	for (; i + MATH_SOA_LANES <= count; i += MATH_SOA_LANES)
+	{
+		SimdF8 vx = F8Load(x + i), vy = F8Load(y + i), vz = F8Load(z + i);
+
+		SimdF8 lengthSq = F8MulAdd(vz, vz, F8MulAdd(vy, vy, F8Mul(vx, vx)));
+		SimdF8 scale = F8And(F8Div(F8Splat(1.0f), F8Sqrt(lengthSq)), F8CmpLt(zero, lengthSq));
+
+		F8Store(x + i, F8Mul(vx, scale));
+		F8Store(y + i, F8Mul(vy, scale));
+		F8Store(z + i, F8Mul(vz, scale));
+	}
+
+	if (i < count)
+		Normalize3Scalar(x + i, y + i, z + i, count - i);
+}
+
+
+//The same thing from array of structures data, one Vec4 at a time. For comparing against, and for data that
+//can't be moved into SoA.
+inline void TransformPointsAoS(const Mat4 &matrix, const Float3 *in, Float3 *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+		StoreFloat3(out[i], TransformPoint(LoadFloat3(in[i]), matrix));
+}
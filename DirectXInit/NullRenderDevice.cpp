@@ -0,0 +1,272 @@
+#include "stdafx.h"
+
+#include "NullRenderDevice.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//R8G8B8A8 and D24S8 are both 4 bytes a sample
+static inline uint64_t SurfaceBytes(UINT width, UINT height, UINT samples)
+{
+	return (uint64_t)width * height * 4 * (samples > 0 ? samples : 1);
+}
+
+
+NullRenderDevice::NullRenderDevice() :
+	bDevice(false), bSwapChain(false), bBackBufferView(false), bDepthStencil(false), bViewsBound(false),
+	bbWidth(0), bbHeight(0), bbSamples(1), bbCount(1), swapChainBytes(0), depthTarget(NULL), lastTargetHandle(0),
+	viewGeneration(0), filter(context, stateCache), targetPool(*this)
+{
+	memset(failNext, 0, sizeof(failNext));
+	memset(&depthTargetDesc, 0, sizeof(depthTargetDesc));
+	context.SetKeepCalls(false);
+	ResetStats();
+}
+
+NullRenderDevice::~NullRenderDevice()
+{
+	Release();
+}
+
+void NullRenderDevice::ResetStats()
+{
+	//Whatever is still alive stays counted as live
+	uint64_t live = swapChainBytes + targetPool.Stats().bytesHeld;
+
+	memset(&stats, 0, sizeof(stats));
+	stats.bytesLive = live;
+	stats.bytesPeak = live;
+
+	context.Reset();
+	stateCache.ResetStats();
+	targetPool.ResetStats();
+}
+
+bool NullRenderDevice::Call(NullDeviceCall call, bool ok)
+{
+	++stats.calls[call];
+
+	if (failNext[call])
+	{
+		failNext[call] = false;
+		ok = false;
+	}
+
+	if (!ok)
+		++stats.failedCalls;
+
+	return ok;
+}
+
+void NullRenderDevice::Allocate(uint64_t bytes)
+{
+	++stats.allocations;
+	stats.bytesAllocated += bytes;
+	stats.bytesLive += bytes;
+
+	if (stats.bytesLive > stats.bytesPeak)
+		stats.bytesPeak = stats.bytesLive;
+}
+
+void NullRenderDevice::Free(uint64_t bytes)
+{
+	stats.bytesLive = (bytes > stats.bytesLive) ? 0 : stats.bytesLive - bytes;
+}
+
+HRESULT NullRenderDevice::CreateTarget(const RenderTargetDesc &desc, void *&resource)
+{
+	resource = NULL;
+	if (!bDevice)
+		return -1;
+
+	Allocate(RenderTargetBytes(desc));
+	resource = (void*)++lastTargetHandle;
+	return S_OK;
+}
+
+void NullRenderDevice::ReleaseTarget(const RenderTargetDesc &desc, void*)
+{
+	Free(RenderTargetBytes(desc));
+}
+
+HRESULT NullRenderDevice::CreateDevice()
+{
+	if (!Call(NULLDEV_CREATE_DEVICE, !bDevice))
+		return -1;
+
+	bDevice = true;
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::CheckMultisampleQuality(UINT sampleCount, UINT &quality)
+{
+	quality = 0;
+
+	if (!Call(NULLDEV_CHECK_MULTISAMPLE, bDevice))
+		return -1;
+
+	//Feature level 11 hardware has to support 1/2/4/8, one quality level is all we pretend to have
+	if (sampleCount == 1 || sampleCount == 2 || sampleCount == 4 || sampleCount == 8)
+		quality = 1;
+
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::CreateSwapChain(const RenderSwapChainDesc &desc)
+{
+	//No window to take the size from, so it has to be given
+	if (!Call(NULLDEV_CREATE_SWAP_CHAIN, bDevice && !bSwapChain && desc.width > 0 && desc.height > 0))
+		return -1;
+
+	bbWidth = desc.width;
+	bbHeight = desc.height;
+	bbSamples = desc.sampleCount;
+	bbCount = desc.bufferCount > 0 ? desc.bufferCount : 1;
+
+	swapChainBytes = SurfaceBytes(bbWidth, bbHeight, bbSamples) * bbCount;
+	Allocate(swapChainBytes);
+
+	bSwapChain = true;
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::CreateBackBufferView()
+{
+	//A second view without releasing the first would leak it on a real device
+	if (!Call(NULLDEV_CREATE_BACK_BUFFER_VIEW, bSwapChain && !bBackBufferView))
+		return -1;
+
+	bBackBufferView = true;
+	++viewGeneration;
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::CreateDepthStencil(const RenderDepthStencilDesc &desc)
+{
+	if (!Call(NULLDEV_CREATE_DEPTH_STENCIL, bDevice && !bDepthStencil && desc.width > 0 && desc.height > 0))
+		return -1;
+
+	depthTargetDesc.usage = RENDERTARGET_DEPTH_STENCIL;
+	depthTargetDesc.format = 0;
+	depthTargetDesc.bytesPerSample = 4;
+	depthTargetDesc.sampleCount = desc.sampleCount;
+	depthTargetDesc.sampleQuality = desc.sampleQuality;
+	depthTargetDesc.width = desc.width;
+	depthTargetDesc.height = desc.height;
+
+	if (FAILED(targetPool.Acquire(depthTargetDesc, depthTarget)))
+	{
+		++stats.failedCalls;
+		return -1;
+	}
+
+	bDepthStencil = true;
+	++viewGeneration;
+	return S_OK;
+}
+
+void NullRenderDevice::BindViews()
+{
+	if (!Call(NULLDEV_BIND_VIEWS, bBackBufferView && bDepthStencil))
+		return;
+
+	stateCache.SetId(STATECALL_RENDER_TARGETS, 0, viewGeneration);
+	bViewsBound = true;
+}
+
+void NullRenderDevice::SetViewport(const RenderViewport &viewport)
+{
+	if (Call(NULLDEV_SET_VIEWPORT, bDevice && viewport.width > 0.0f && viewport.height > 0.0f))
+		stateCache.SetBytes(STATECALL_VIEWPORT, 0, &viewport, sizeof(viewport));
+}
+
+void NullRenderDevice::ReleaseViews()
+{
+	Call(NULLDEV_RELEASE_VIEWS, true);
+
+	targetPool.Release(depthTarget);
+	depthTarget = NULL;
+	bDepthStencil = false;
+	bBackBufferView = false;
+	bViewsBound = false;
+
+	//Unbound, the same as binding "nothing"
+	stateCache.SetId(STATECALL_RENDER_TARGETS, 0, 0);
+}
+
+HRESULT NullRenderDevice::ResizeSwapChain(UINT width, UINT height)
+{
+	//DXGI refuses while anything still references the old buffers
+	if (!Call(NULLDEV_RESIZE_SWAP_CHAIN, bSwapChain && !bBackBufferView))
+		return -1;
+
+	//0 means "size of the window" to DXGI, which hasn't changed as far as we know
+	if (width > 0)
+		bbWidth = width;
+	if (height > 0)
+		bbHeight = height;
+
+	Free(swapChainBytes);
+	swapChainBytes = SurfaceBytes(bbWidth, bbHeight, bbSamples) * bbCount;
+	Allocate(swapChainBytes);
+
+	return S_OK;
+}
+
+HRESULT NullRenderDevice::Present(UINT)
+{
+	if (!Call(NULLDEV_PRESENT, bSwapChain && bViewsBound))
+		return -1;
+
+	stateCache.EndFrame();
+
+	//Same as D3D11: a depth buffer that has been oversized for long enough is swapped for a smaller one, new view and all
+	if (targetPool.EndFrame() && targetPool.ShouldShrink(depthTarget))
+	{
+		targetPool.Release(depthTarget);
+		depthTarget = NULL;
+
+		if (FAILED(targetPool.Acquire(depthTargetDesc, depthTarget)))
+		{
+			bDepthStencil = bViewsBound = false;
+			return S_OK;
+		}
+
+		++viewGeneration;
+		stateCache.SetId(STATECALL_RENDER_TARGETS, 0, viewGeneration);
+	}
+
+	return S_OK;
+}
+
+void NullRenderDevice::Release()
+{
+	if (!bDevice)
+		return;
+
+	++stats.calls[NULLDEV_RELEASE];
+
+	Free(swapChainBytes);
+	swapChainBytes = 0;
+
+	targetPool.Clear();
+	depthTarget = NULL;
+
+	bDevice = bSwapChain = bBackBufferView = bDepthStencil = bViewsBound = false;
+	stateCache.InvalidateAll();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "RenderDevice.h"
+#include <stdint.h>
+
+
+enum NullDeviceCall
+{
+	NULLDEV_CREATE_DEVICE = 0,
+	NULLDEV_CHECK_MULTISAMPLE,
+	NULLDEV_CREATE_SWAP_CHAIN,
+	NULLDEV_CREATE_BACK_BUFFER_VIEW,
+	NULLDEV_CREATE_DEPTH_STENCIL,
+	NULLDEV_BIND_VIEWS,
+	NULLDEV_SET_VIEWPORT,
+	NULLDEV_RELEASE_VIEWS,
+	NULLDEV_RESIZE_SWAP_CHAIN,
+	NULLDEV_PRESENT,
+	NULLDEV_RELEASE,
+
+	NULLDEV_CALL_COUNT
+};
+
+struct NullDeviceStats
+{
+	uint64_t calls[NULLDEV_CALL_COUNT];
+	uint64_t failedCalls;		//Out of order (what D3D/DXGI would have refused) or failed on purpose
+	uint64_t allocations;		//Swap chain and depth buffers "created" (depth buffers the target pool had to allocate)
+	uint64_t bytesAllocated;	//Total over the device's life
+	uint64_t bytesLive;			//What a real device would be holding right now
+	uint64_t bytesPeak;
+};
+
+
+//Device that does nothing but keep track. Goes through the whole init ladder, resize and present in
+//memory: every call is counted, buffers are accounted for at the size D3D would have allocated
+//(no memory is actually touched) and calls D3D/DXGI would refuse fail the same way, e.g. resizing the
+//swap chain while the back buffer view is still alive. Depth buffers come from a RenderTargetPool the same
+//as on D3D11.
+//
+//Draws go through a StateFilterRenderContext to a RecordingRenderContext (counts only by default, see
+//Recorder().SetKeepCalls), so the recorder sees what would have reached a device.
+//Not thread safe, like the real one it is used under the manager's lock.
+
+class NullRenderDevice : public IRenderDevice, private IRenderTargetAllocator
+{
+public:
+	NullRenderDevice();
+	virtual ~NullRenderDevice();
+
+	inline const NullDeviceStats& Stats() const { return stats; };
+	inline uint64_t CallCount(NullDeviceCall call) const { return stats.calls[call]; };
+	void ResetStats();
+
+	inline RecordingRenderContext& Recorder() { return context; };
+
+	//Make the next call of this kind fail, for exercising error paths
+	inline void FailNextCall(NullDeviceCall call) { failNext[call] = true; };
+
+	inline UINT BackBufferWidth() const { return bbWidth; };
+	inline UINT BackBufferHeight() const { return bbHeight; };
+
+	virtual RenderDeviceType Type() const { return RENDER_DEVICE_NULL; }
+	virtual bool NeedsWindow() const { return false; }
+
+	virtual HRESULT CreateDevice();
+	virtual HRESULT CheckMultisampleQuality(UINT sampleCount, UINT &quality);
+	virtual HRESULT CreateSwapChain(const RenderSwapChainDesc &desc);
+	virtual HRESULT CreateBackBufferView();
+	virtual HRESULT CreateDepthStencil(const RenderDepthStencilDesc &desc);
+	virtual void	BindViews();
+	virtual void	SetViewport(const RenderViewport &viewport);
+	virtual void	ReleaseViews();
+	virtual HRESULT ResizeSwapChain(UINT width, UINT height);
+	virtual HRESULT Present(UINT syncInterval);
+	virtual void	Release();
+
+	virtual IRenderContext& Context() { return filter; }
+	virtual RenderStateCache& StateCache() { return stateCache; }
+	virtual RenderTargetPool& TargetPool() { return targetPool; }
+
+private:
+
+	NullRenderDevice(const NullRenderDevice&);
+	NullRenderDevice& operator=(const NullRenderDevice&);
+
+	//Counts the call, returns false if it should fail (on purpose or because ok is false)
+	bool Call(NullDeviceCall call, bool ok);
+
+	void Allocate(uint64_t bytes);
+	void Free(uint64_t bytes);
+
+	virtual HRESULT CreateTarget(const RenderTargetDesc &desc, void *&resource);
+	virtual void	ReleaseTarget(const RenderTargetDesc &desc, void *resource);
+
+	NullDeviceStats stats;
+	bool failNext[NULLDEV_CALL_COUNT];
+
+	bool bDevice;
+	bool bSwapChain;
+	bool bBackBufferView;
+	bool bDepthStencil;
+	bool bViewsBound;
+
+	UINT bbWidth, bbHeight, bbSamples, bbCount;
+	uint64_t swapChainBytes;
+
+	//Handles are just numbers
+	void *depthTarget;
+	RenderTargetDesc depthTargetDesc;
+	uintptr_t lastTargetHandle;
+
+	//Bumped whenever a view is created, stands in for the view pointers in the state cache
+	uint64_t viewGeneration;
+
+	RecordingRenderContext context;
+	RenderStateCache stateCache;
+	StateFilterRenderContext filter;
+
+	RenderTargetPool targetPool;
+};
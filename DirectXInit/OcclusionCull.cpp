@@ -0,0 +1,461 @@
+#include "stdafx.h"
+
+#include "OcclusionCull.h"
+#include "FrustumCull.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <math.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Triangles get clipped to this many times the screen's size (in clip space) rather than to the screen, so
+//only the ones reaching way off screen need clipping and screen space coordinates stay small enough for
+//the edge functions to be exact where it matters
+static const float OCCLUSION_GUARD_BAND = 2.0f;
+
+static const uint32_t TILE_PIXELS = OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT;
+
+//Pixel centers across a SIMD group, and plain lane numbers
+static const float laneCenters[MATH_SOA_LANES] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+static const float laneIndices[MATH_SOA_LANES] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+//The 8 corners of a box, one per lane
+static const float cornerX[MATH_SOA_LANES] = { -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f };
+static const float cornerY[MATH_SOA_LANES] = { -1.0f, -1.0f, 1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f };
+static const float cornerZ[MATH_SOA_LANES] = { -1.0f, -1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+
+//Clip space planes a vertex is inside of when dot(plane, v) >= 0: near, then the guard band's sides
+static const int CLIP_PLANE_COUNT = 5;
+static const float clipPlanes[CLIP_PLANE_COUNT][4] =
+{
+	{ 0.0f, 0.0f, 1.0f, 0.0f },
+	{ 1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND },
+	{ -1.0f, 0.0f, 0.0f, OCCLUSION_GUARD_BAND },
+	{ 0.0f, 1.0f, 0.0f, OCCLUSION_GUARD_BAND },
+	{ 0.0f, -1.0f, 0.0f, OCCLUSION_GUARD_BAND },
+};
+
+static inline float PlaneDistance(const float *plane, const Float4 &v)
+{
+	return plane[0] * v.x + plane[1] * v.y + plane[2] * v.z + plane[3] * v.w;
+}
+
+//Bits for the frustum planes a vertex is outside of, a triangle with all 3 outside the same one is gone
+static inline uint32_t OutCode(const Float4 &v)
+{
+	return (v.x < -v.w ? 1u : 0u) | (v.x > v.w ? 2u : 0u) | (v.y < -v.w ? 4u : 0u) | (v.y > v.w ? 8u : 0u) |
+		(v.z < 0.0f ? 16u : 0u) | (v.z > v.w ? 32u : 0u);
+}
+
+
+OcclusionCuller::OcclusionCuller()
+	: width(0), height(0), tilesX(0), tilesY(0)
+{
+	StoreFloat4x4(viewProjection, Mat4Identity());
+}
+
+void OcclusionCuller::Resize(uint32_t clientWidth, uint32_t clientHeight)
+{
+	uint32_t w = (clientWidth + OCCLUSION_DOWNSCALE - 1) / OCCLUSION_DOWNSCALE;
+	uint32_t h = (clientHeight + OCCLUSION_DOWNSCALE - 1) / OCCLUSION_DOWNSCALE;
+
+	tilesX = (w + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	tilesY = (h + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+	if (tilesX == 0 || tilesY == 0)
+		tilesX = tilesY = 0;
+
+	//The screen gets mapped onto whole tiles, a little off the client's aspect but no half empty tiles
+	width = tilesX * OCCLUSION_TILE_WIDTH;
+	height = tilesY * OCCLUSION_TILE_HEIGHT;
+
+	depth.assign((size_t)width * height, 1.0f);
+	tileMax.assign((size_t)tilesX * tilesY, 1.0f);
+	bins.resize((size_t)tilesX * tilesY);
+	triangles.clear();
+}
+
+void OcclusionCuller::Begin(const Mat4 &viewProj)
+{
+	StoreFloat4x4(viewProjection, viewProj);
+
+	triangles.clear();
+	for (size_t i = 0; i < bins.size(); ++i)
+		bins[i].clear();
+}
+
+
+void OcclusionCuller::AddOccluder(const Float3 *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, const Mat4 &world)
+{
+	if (width == 0)
+		return;
+
+	Mat4 toClip = world * LoadFloat4x4(viewProjection);
+
+	clipVertices.resize(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; ++i)
+		StoreFloat4(clipVertices[i], TransformPoint(LoadFloat3(vertices[i], 1.0f), toClip));
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+		AddTriangle(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]]);
+}
+
+void OcclusionCuller::AddTriangle(const Float4 &v0, const Float4 &v1, const Float4 &v2)
+{
+	if (OutCode(v0) & OutCode(v1) & OutCode(v2))
+		return;
+
+	bool bInside = true;
+	for (int p = 0; p < CLIP_PLANE_COUNT && bInside; ++p)
+		bInside = PlaneDistance(clipPlanes[p], v0) >= 0.0f && PlaneDistance(clipPlanes[p], v1) >= 0.0f && PlaneDistance(clipPlanes[p], v2) >= 0.0f;
+
+	if (bInside)
+	{
+		SetupTriangle(v0, v1, v2);
+		return;
+	}
+
+	//Sutherland-Hodgman against each plane in turn, 3 + 5 vertices at most, then a fan
+	Float4 polygon[2][3 + CLIP_PLANE_COUNT];
+	int count = 3, in = 0;
+	polygon[0][0] = v0;
+	polygon[0][1] = v1;
+	polygon[0][2] = v2;
+
+	for (int p = 0; p < CLIP_PLANE_COUNT && count >= 3; ++p)
+	{
+		const Float4 *src = polygon[in];
+		Float4 *dst = polygon[in ^ 1];
+		int outCount = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			const Float4 &a = src[i];
+			const Float4 &b = src[(i + 1) % count];
+			float da = PlaneDistance(clipPlanes[p], a), db = PlaneDistance(clipPlanes[p], b);
+
+			if (da >= 0.0f)
+				dst[outCount++] = a;
+
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				float t = da / (da - db);
+				Float4 &v = dst[outCount++];
+				v.x = a.x + (b.x - a.x) * t;
+				v.y = a.y + (b.y - a.y) * t;
+				v.z = a.z + (b.z - a.z) * t;
+				v.w = a.w + (b.w - a.w) * t;
+			}
+		}
+
+		count = outCount;
+		in ^= 1;
+	}
+
+	for (int i = 1; i + 1 < count; ++i)
+		SetupTriangle(polygon[in][0], polygon[in][i], polygon[in][i + 1]);
+}
+
+void OcclusionCuller::SetupTriangle(const Float4 &v0, const Float4 &v1, const Float4 &v2)
+{
+	//To buffer pixels, y down
+	float halfWidth = 0.5f * (float)width, halfHeight = 0.5f * (float)height;
+	float x[3], y[3], z[3];
+	const Float4 *v[3] = { &v0, &v1, &v2 };
+	for (int i = 0; i < 3; ++i)
+	{
+		float invW = 1.0f / v[i]->w;
+		x[i] = (v[i]->x * invW + 1.0f) * halfWidth;
+		y[i] = (1.0f - v[i]->y * invW) * halfHeight;
+		z[i] = v[i]->z * invW;
+	}
+
+	//Turned around to positive area, so inside is >= 0 on all 3 edges either way it was wound
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1e-8f)
+		return;
+
+	if (area < 0.0f)
+	{
+		float t;
+		t = x[1]; x[1] = x[2]; x[2] = t;
+		t = y[1]; y[1] = y[2]; y[2] = t;
+		t = z[1]; z[1] = z[2]; z[2] = t;
+		area = -area;
+	}
+
+	float minX = fminf(x[0], fminf(x[1], x[2])), maxX = fmaxf(x[0], fmaxf(x[1], x[2]));
+	float minY = fminf(y[0], fminf(y[1], y[2])), maxY = fmaxf(y[0], fmaxf(y[1], y[2]));
+
+	Triangle triangle;
+	triangle.minX = minX > 0.0f ? (int)minX : 0;
+	triangle.minY = minY > 0.0f ? (int)minY : 0;
+	triangle.maxX = maxX < (float)(width - 1) ? (int)maxX : (int)width - 1;
+	triangle.maxY = maxY < (float)(height - 1) ? (int)maxY : (int)height - 1;
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	for (int e = 0; e < 3; ++e)
+	{
+		int from = e, to = (e + 1) % 3;
+		triangle.edgeA[e] = y[from] - y[to];
+		triangle.edgeB[e] = x[to] - x[from];
+		triangle.edgeC[e] = -(triangle.edgeA[e] * x[from] + triangle.edgeB[e] * y[from]);
+	}
+
+	float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+	float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+	triangle.depthA = (dz1 * dy2 - dz2 * dy1) / area;
+	triangle.depthB = (dz2 * dx1 - dz1 * dx2) / area;
+	triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+	triangle.minDepth = z[0] < z[1] ? z[0] : z[1];
+	triangle.minDepth = z[2] < triangle.minDepth ? z[2] : triangle.minDepth;
+
+	uint32_t index = (uint32_t)triangles.size();
+	triangles.push_back(triangle);
+
+	for (uint32_t ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ++ty)
+		for (uint32_t tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; ++tx)
+			bins[ty * tilesX + tx].push_back(index);
+}
+
+
+void OcclusionCuller::RasterizeTile(uint32_t tile)
+{
+	int x0 = (int)((tile % tilesX) * OCCLUSION_TILE_WIDTH);
+	int y0 = (int)((tile / tilesX) * OCCLUSION_TILE_HEIGHT);
+	float *tileDepth = &depth[(size_t)tile * TILE_PIXELS];
+
+	SimdF8 cleared = F8Splat(1.0f);
+	for (uint32_t i = 0; i < TILE_PIXELS; i += MATH_SOA_LANES)
+		F8Store(tileDepth + i, cleared);
+
+	//Farthest depth in each row so far, across the lanes
+	SimdF8 rowFarthest[OCCLUSION_TILE_HEIGHT];
+	for (uint32_t r = 0; r < OCCLUSION_TILE_HEIGHT; ++r)
+		rowFarthest[r] = cleared;
+
+	SimdF8 zero = F8Zero();
+	SimdF8 lanes = F8Load(laneCenters);
+
+	const std::vector<uint32_t> &bin = bins[tile];
+	for (size_t t = 0; t < bin.size(); ++t)
+	{
+		const Triangle &triangle = triangles[bin[t]];
+
+		int rowBegin = triangle.minY > y0 ? triangle.minY : y0;
+		int rowEnd = triangle.maxY < y0 + (int)OCCLUSION_TILE_HEIGHT - 1 ? triangle.maxY : y0 + (int)OCCLUSION_TILE_HEIGHT - 1;
+		int groupBegin = ((triangle.minX > x0 ? triangle.minX : x0) - x0) / MATH_SOA_LANES;
+		int groupEnd = ((triangle.maxX < x0 + (int)OCCLUSION_TILE_WIDTH - 1 ? triangle.maxX : x0 + (int)OCCLUSION_TILE_WIDTH - 1) - x0) / MATH_SOA_LANES;
+
+		//Behind everything already in its rows, it can't change a thing
+		SimdF8 farthest = rowFarthest[rowBegin - y0];
+		for (int y = rowBegin + 1; y <= rowEnd; ++y)
+			farthest = F8Max(farthest, rowFarthest[y - y0]);
+		if (!F8MoveMask(F8CmpLt(F8Splat(triangle.minDepth), farthest)))
+			continue;
+
+		SimdF8 a0 = F8Splat(triangle.edgeA[0]), a1 = F8Splat(triangle.edgeA[1]), a2 = F8Splat(triangle.edgeA[2]);
+		SimdF8 depthA = F8Splat(triangle.depthA);
+
+		for (int y = rowBegin; y <= rowEnd; ++y)
+		{
+			//Everything but the x term, for this row
+			float py = (float)y + 0.5f;
+			SimdF8 r0 = F8Splat(triangle.edgeB[0] * py + triangle.edgeC[0]);
+			SimdF8 r1 = F8Splat(triangle.edgeB[1] * py + triangle.edgeC[1]);
+			SimdF8 r2 = F8Splat(triangle.edgeB[2] * py + triangle.edgeC[2]);
+			SimdF8 rz = F8Splat(triangle.depthB * py + triangle.depthC);
+			float *row = tileDepth + (y - y0) * OCCLUSION_TILE_WIDTH;
+			bool bWritten = false;
+
+			for (int g = groupBegin; g <= groupEnd; ++g)
+			{
+				SimdF8 px = F8Add(F8Splat((float)(x0 + g * MATH_SOA_LANES)), lanes);
+				SimdF8 e0 = F8MulAdd(px, a0, r0), e1 = F8MulAdd(px, a1, r1), e2 = F8MulAdd(px, a2, r2);
+				SimdF8 inside = F8And(F8CmpLe(zero, e0), F8And(F8CmpLe(zero, e1), F8CmpLe(zero, e2)));
+				if (!F8MoveMask(inside))
+					continue;
+
+				float *pixels = row + g * MATH_SOA_LANES;
+				SimdF8 old = F8Load(pixels);
+				SimdF8 z = F8MulAdd(px, depthA, rz);
+				F8Store(pixels, F8Select(old, F8Min(old, z), inside));
+				bWritten = true;
+			}
+
+			if (bWritten)
+			{
+				SimdF8 rowMax = F8Load(row);
+				for (uint32_t x = MATH_SOA_LANES; x < OCCLUSION_TILE_WIDTH; x += MATH_SOA_LANES)
+					rowMax = F8Max(rowMax, F8Load(row + x));
+				rowFarthest[y - y0] = rowMax;
+			}
+		}
+	}
+
+	//Farthest depth in the tile, what a box has to be behind to be hidden in all of it
+	SimdF8 farthest = rowFarthest[0];
+	for (uint32_t r = 1; r < OCCLUSION_TILE_HEIGHT; ++r)
+		farthest = F8Max(farthest, rowFarthest[r]);
+
+	float lanesMax[MATH_SOA_LANES];
+	F8Store(lanesMax, farthest);
+	float result = lanesMax[0];
+	for (uint32_t lane = 1; lane < MATH_SOA_LANES; ++lane)
+		result = lanesMax[lane] > result ? lanesMax[lane] : result;
+	tileMax[tile] = result;
+}
+
+void OcclusionCuller::Rasterize(JobSystem *jobs)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t tileCount = tilesX * tilesY;
+	if (!jobs || tileCount < 2)
+	{
+		for (uint32_t tile = 0; tile < tileCount; ++tile)
+			RasterizeTile(tile);
+		return;
+	}
+
+	//Tiles only ever touch their own pixels and bin, nothing to share
+	jobs->ParallelFor(tileCount, 1, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t tile = begin; tile < end; ++tile)
+			RasterizeTile(tile);
+	});
+}
+
+
+bool OcclusionCuller::TestBox(const Float3 &center, const Float3 &extents) const
+{
+	if (width == 0)
+		return true;
+
+	//All 8 corners to clip space at once
+	SimdF8 cx = F8MulAdd(F8Load(cornerX), F8Splat(extents.x), F8Splat(center.x));
+	SimdF8 cy = F8MulAdd(F8Load(cornerY), F8Splat(extents.y), F8Splat(center.y));
+	SimdF8 cz = F8MulAdd(F8Load(cornerZ), F8Splat(extents.z), F8Splat(center.z));
+
+	const Float4x4 &m = viewProjection;
+	SimdF8 clip[4];
+	for (int c = 0; c < 4; ++c)
+		clip[c] = F8MulAdd(cx, F8Splat(m.m[0][c]), F8MulAdd(cy, F8Splat(m.m[1][c]), F8MulAdd(cz, F8Splat(m.m[2][c]), F8Splat(m.m[3][c]))));
+
+	//Any corner in front of the near plane and the box might be all around the camera
+	SimdF8 zero = F8Zero();
+	if (F8MoveMask(F8CmpLt(clip[2], zero)))
+		return true;
+
+	SimdF8 invW = F8Div(F8Splat(1.0f), clip[3]);
+	SimdF8 halfWidth = F8Splat(0.5f * (float)width), halfHeight = F8Splat(0.5f * (float)height);
+	SimdF8 sx = F8MulAdd(F8Mul(clip[0], invW), halfWidth, halfWidth);
+	SimdF8 sy = F8Sub(halfHeight, F8Mul(F8Mul(clip[1], invW), halfHeight));
+	SimdF8 sz = F8Mul(clip[2], invW);
+
+	float xs[MATH_SOA_LANES], ys[MATH_SOA_LANES], zs[MATH_SOA_LANES];
+	F8Store(xs, sx);
+	F8Store(ys, sy);
+	F8Store(zs, sz);
+
+	float minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0], minZ = zs[0];
+	for (int i = 1; i < MATH_SOA_LANES; ++i)
+	{
+		minX = xs[i] < minX ? xs[i] : minX;
+		maxX = xs[i] > maxX ? xs[i] : maxX;
+		minY = ys[i] < minY ? ys[i] : minY;
+		maxY = ys[i] > maxY ? ys[i] : maxY;
+		minZ = zs[i] < minZ ? zs[i] : minZ;
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height)
+		return false;
+
+	//Every pixel the rectangle touches
+	int rectX0 = minX > 0.0f ? (int)minX : 0;
+	int rectY0 = minY > 0.0f ? (int)minY : 0;
+	int rectX1 = maxX < (float)(width - 1) ? (int)maxX : (int)width - 1;
+	int rectY1 = maxY < (float)(height - 1) ? (int)maxY : (int)height - 1;
+
+	SimdF8 nearest = F8Splat(minZ);
+	SimdF8 lanes = F8Load(laneIndices);
+	SimdF8 left = F8Splat((float)rectX0), right = F8Splat((float)rectX1);
+
+	for (int ty = rectY0 / (int)OCCLUSION_TILE_HEIGHT; ty <= rectY1 / (int)OCCLUSION_TILE_HEIGHT; ++ty)
+	{
+		for (int tx = rectX0 / (int)OCCLUSION_TILE_WIDTH; tx <= rectX1 / (int)OCCLUSION_TILE_WIDTH; ++tx)
+		{
+			uint32_t tile = ty * tilesX + tx;
+
+			//All of the tile's occluders in front of the box's nearest point
+			if (minZ > tileMax[tile])
+				continue;
+
+			int x0 = tx * (int)OCCLUSION_TILE_WIDTH, y0 = ty * (int)OCCLUSION_TILE_HEIGHT;
+			int rowBegin = rectY0 > y0 ? rectY0 : y0;
+			int rowEnd = rectY1 < y0 + (int)OCCLUSION_TILE_HEIGHT - 1 ? rectY1 : y0 + (int)OCCLUSION_TILE_HEIGHT - 1;
+			int groupBegin = ((rectX0 > x0 ? rectX0 : x0) - x0) / MATH_SOA_LANES;
+			int groupEnd = ((rectX1 < x0 + (int)OCCLUSION_TILE_WIDTH - 1 ? rectX1 : x0 + (int)OCCLUSION_TILE_WIDTH - 1) - x0) / MATH_SOA_LANES;
+			const float *tileDepth = &depth[(size_t)tile * TILE_PIXELS];
+
+			for (int g = groupBegin; g <= groupEnd; ++g)
+			{
+				SimdF8 px = F8Add(F8Splat((float)(x0 + g * MATH_SOA_LANES)), lanes);
+				SimdF8 columns = F8And(F8CmpLe(left, px), F8CmpLe(px, right));
+
+				for (int y = rowBegin; y <= rowEnd; ++y)
+				{
+					SimdF8 pixels = F8Load(tileDepth + (y - y0) * OCCLUSION_TILE_WIDTH + g * MATH_SOA_LANES);
+					if (F8MoveMask(F8And(columns, F8CmpLe(nearest, pixels))))
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+uint32_t OcclusionCuller::TestList(const FrustumCuller &culler, const uint32_t *indices, uint32_t count, uint32_t *out) const
+{
+	const float *cx = culler.BoundsData(CULL_CENTER_X);
+	const float *cy = culler.BoundsData(CULL_CENTER_Y);
+	const float *cz = culler.BoundsData(CULL_CENTER_Z);
+	const float *ex = culler.BoundsData(CULL_EXTENT_X);
+	const float *ey = culler.BoundsData(CULL_EXTENT_Y);
+	const float *ez = culler.BoundsData(CULL_EXTENT_Z);
+
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t index = indices[i];
+		Float3 center = { cx[index], cy[index], cz[index] };
+		Float3 extents = { ex[index], ey[index], ez[index] };
+		if (TestBox(center, extents))
+			out[visibleCount++] = index;
+	}
+
+	return visibleCount;
+}
+
+float OcclusionCuller::Depth(uint32_t x, uint32_t y) const
+{
+	uint32_t tile = (y / OCCLUSION_TILE_HEIGHT) * tilesX + x / OCCLUSION_TILE_WIDTH;
+	return depth[(size_t)tile * TILE_PIXELS + (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH];
+}
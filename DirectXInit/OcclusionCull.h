@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "VecMath.h"
+#include <stdint.h>
+#include <vector>
+
+class FrustumCuller;
+class JobSystem;
+
+
+//The depth buffer is this many times smaller than the client area each way (then rounded up to whole tiles)
+const uint32_t OCCLUSION_DOWNSCALE = 4;
+
+//Pixels per tile. A row of a tile is 4 SIMD groups of 8.
+const uint32_t OCCLUSION_TILE_WIDTH = 32;
+const uint32_t OCCLUSION_TILE_HEIGHT = 16;
+
+
+//Occlusion culling on the CPU: big, simple occluders (walls, buildings, terrain chunks) rasterized into a
+//small depth buffer, then the bounding boxes of everything else tested against it, so what's completely
+//behind them never gets drawn.
+//
+//Per frame: Begin with the camera's view * projection, AddOccluder the occluder meshes, Rasterize, then
+//TestBox/TestList. AddOccluder transforms, clips and sets up triangles and bins them into the screen tiles
+//they touch. Rasterize fills the tiles 8 pixels at a time, each tile on its own (so on its own job), keeping
+//the nearest depth per pixel and then the farthest per tile. A tile skips triangles that are behind all it
+//has so far, so adding occluders roughly front to back saves most of the work. A test projects the box,
+//skips every tile whose farthest depth is still in front of the box's nearest point and only looks at
+//pixels in the others.
+//
+//Depth is D3D's z/w, 0 near to 1 far, at pixel centers. That makes occluders a little less than
+//conservative at their edges (a box peeking out by less than a buffer pixel can count as hidden), which is
+//the usual trade and why the occluders should be a bit smaller than what they stand for. Boxes are
+//conservative: anything crossing the near plane counts as visible.
+//
+//Resize takes the client size. Not thread safe while building, the tests are const and any number of
+//threads may run them after Rasterize.
+
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	//Client area size, the buffer gets OCCLUSION_DOWNSCALE times smaller
+	void Resize(uint32_t clientWidth, uint32_t clientHeight);
+
+	//Drops last frame's occluders, for a new frame seen through viewProjection (Rasterize clears the depth)
+	void Begin(const Mat4 &viewProjection);
+
+	//Triangles of vertices[indices[3n..3n+2]] in object space, placed with world. Either winding.
+	void AddOccluder(const Float3 *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, const Mat4 &world);
+
+	//Rasterize everything added since Begin. jobs may be NULL, otherwise the tiles are spread over it.
+	void Rasterize(JobSystem *jobs = NULL);
+
+	//World space box (center, half extents), false if it's hidden behind the occluders or off screen
+	bool TestBox(const Float3 &center, const Float3 &extents) const;
+
+	//indices (say a FrustumCuller's Visible()) whose culler bounds pass TestBox, into out. Returns how many.
+	//out may be indices.
+	uint32_t TestList(const FrustumCuller &culler, const uint32_t *indices, uint32_t count, uint32_t *out) const;
+
+	inline uint32_t Width() const { return width; };
+	inline uint32_t Height() const { return height; };
+
+	//As of the last Rasterize
+	inline uint32_t TriangleCount() const { return (uint32_t)triangles.size(); };
+
+	//Depth at a buffer pixel, for debugging views
+	float Depth(uint32_t x, uint32_t y) const;
+
+private:
+
+	//A triangle ready to rasterize: edge functions a * x + b * y + c (>= 0 inside for all 3), depth as a
+	//plane over the screen, its nearest depth and its pixel rectangle
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depthA, depthB, depthC;
+		float minDepth;
+		int	  minX, minY, maxX, maxY;
+	};
+
+	OcclusionCuller(const OcclusionCuller&);
+	OcclusionCuller& operator=(const OcclusionCuller&);
+
+	void AddTriangle(const Float4 &v0, const Float4 &v1, const Float4 &v2);
+	void SetupTriangle(const Float4 &v0, const Float4 &v1, const Float4 &v2);
+	void RasterizeTile(uint32_t tile);
+
+	uint32_t width, height;
+	uint32_t tilesX, tilesY;
+
+	Float4x4 viewProjection;
+
+	std::vector<float> depth;		//Tile by tile, rows of OCCLUSION_TILE_WIDTH in each
+	std::vector<float> tileMax;		//Farthest depth in each tile
+
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t> > bins;		//Triangles touching each tile
+
+	std::vector<Float4> clipVertices;		//AddOccluder scratch
+};
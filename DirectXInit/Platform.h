@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+//The handful of Windows types/macros the framework headers use. On Windows this is just Windows.h,
+//elsewhere (headless builds on linux) they are defined here so the app layer builds without the SDK.
+//Plus the odd CRT call that is spelled differently off Windows (AlignedAlloc).
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <malloc.h>
+#include <tchar.h>
+
+#else
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int32_t		HRESULT;
+typedef unsigned int UINT;
+typedef int			BOOL;
+typedef void*		HWND;
+typedef void*		HINSTANCE;
+typedef uintptr_t	WPARAM;
+typedef intptr_t	LPARAM;
+typedef intptr_t	LRESULT;
+typedef char		TCHAR;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define _T(x) x
+
+#define S_OK ((HRESULT)0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+
+#define ZeroMemory(p, n) memset((p), 0, (n))
+
+#endif
+
+
+//Heap block aligned to align (a power of two, raised to 16), NULL if out of memory. Free with AlignedFree.
+inline void* AlignedAlloc(size_t size, size_t align)
+{
+	if (align < 16)
+		align = 16;
+
+#ifdef _WIN32
+	return _aligned_malloc(size, align);
+#else
+	void *mem = NULL;
+	if (posix_memalign(&mem, align, size) != 0)
+		return NULL;
+	return mem;
+#endif
+}
+
+inline void AlignedFree(void *mem)
+{
+#ifdef _WIN32
+	_aligned_free(mem);
+#else
+	free(mem);
+#endif
+}
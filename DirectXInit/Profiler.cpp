@@ -0,0 +1,352 @@
+#include "stdafx.h"
+
+#include "Profiler.h"
+#include "GameTimer.h"
+#include "Locks.h"
+#include <stdio.h>
+#include <vector>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Plain Lock/Unlock rather than ScopeLock, whose wait is a profiled zone and would record into the rings
+//while we set them up
+class ProfilerLock
+{
+public:
+	explicit ProfilerLock(SpinParkMutex &m) : lockRef(m) { lockRef.Lock(); }
+	~ProfilerLock() { lockRef.Unlock(); }
+
+private:
+	ProfilerLock(const ProfilerLock&);
+	ProfilerLock& operator=(const ProfilerLock&);
+
+	SpinParkMutex &lockRef;
+};
+
+
+//Events a dump leaves out at the old end of a wrapped ring. Zones that were open when the capture ended
+//still write their end events, and those can land on the oldest slots while we read them.
+const uint32_t PROFILER_WRAP_MARGIN = 256;
+
+struct ProfilerEvent
+{
+	uint64_t	timestamp;
+	const char *name;		//NULL ends the innermost zone
+};
+
+struct ProfilerRing
+{
+	explicit ProfilerRing(uint32_t id) : events(PROFILER_RING_EVENTS), write(0), captureStart(0), threadId(id), threadName(NULL) { }
+
+	std::vector<ProfilerEvent> events;
+	std::atomic<uint64_t> write;	//Events ever written, only the owning thread stores
+
+	//Under registryLock
+	uint64_t	captureStart;		//write when the capture began
+	uint32_t	threadId;
+	const char *threadName;
+};
+
+std::atomic<bool> gProfilerCapturing(false);
+
+//Rings live as long as the process, a thread may still be recording into one when statics go away
+static SpinParkMutex registryLock;
+static std::vector<ProfilerRing*> *rings = NULL;
+
+static thread_local ProfilerRing *tlsRing = NULL;
+static thread_local const char *tlsThreadName = NULL;
+
+//Frame boundaries show up as instant events, recognised by the pointer
+static const char frameMarkName[] = "frame";
+
+//Capture bookkeeping, under captureLock. The frame counting is the boundary thread's alone.
+static SpinParkMutex captureLock;
+static uint64_t captureTscStart = 0;
+static uint64_t captureTscEnd = 0;
+static int64_t	captureCounterStart = 0;
+static int64_t	captureCounterEnd = 0;
+static uint64_t captureFirstFrame = 0;
+
+static std::atomic<uint32_t> framesRequested(0);
+static uint32_t framesLeft = 0;
+static uint64_t boundaryFrame = 0;
+
+
+uint64_t ProfilerFallbackTimestamp()
+{
+	int64_t counter = 0;
+	GameTimer::QueryCounter(counter);
+	return (uint64_t)counter;
+}
+
+static ProfilerRing* CreateRing()
+{
+	ProfilerLock lock(registryLock);
+
+	if (!rings)
+		rings = new std::vector<ProfilerRing*>();
+
+	ProfilerRing *ring = new ProfilerRing((uint32_t)rings->size() + 1);
+	ring->threadName = tlsThreadName;
+	rings->push_back(ring);
+
+	tlsRing = ring;
+	return ring;
+}
+
+void ProfilerRecord(const char *name)
+{
+	ProfilerRing *ring = tlsRing;
+	if (!ring)
+		ring = CreateRing();
+
+	uint64_t w = ring->write.load(std::memory_order_relaxed);
+	ProfilerEvent &ev = ring->events[w & (PROFILER_RING_EVENTS - 1)];
+	ev.timestamp = ProfilerTimestamp();
+	ev.name = name;
+	ring->write.store(w + 1, std::memory_order_release);
+}
+
+void ProfilerSetThreadName(const char *name)
+{
+	tlsThreadName = name;
+
+	if (tlsRing)
+	{
+		ProfilerLock lock(registryLock);
+		tlsRing->threadName = name;
+	}
+}
+
+void ProfilerBeginCapture()
+{
+	ProfilerLock lock(captureLock);
+
+	{
+		ProfilerLock registry(registryLock);
+		if (rings)
+		{
+			for (size_t i = 0; i < rings->size(); ++i)
+				(*rings)[i]->captureStart = (*rings)[i]->write.load(std::memory_order_acquire);
+		}
+	}
+
+	GameTimer::QueryCounter(captureCounterStart);
+	captureTscStart = ProfilerTimestamp();
+	captureCounterEnd = 0;
+	captureTscEnd = 0;
+
+	gProfilerCapturing.store(true, std::memory_order_release);
+}
+
+void ProfilerEndCapture()
+{
+	ProfilerLock lock(captureLock);
+
+	if (!gProfilerCapturing.load(std::memory_order_relaxed))
+		return;
+
+	gProfilerCapturing.store(false, std::memory_order_release);
+
+	captureTscEnd = ProfilerTimestamp();
+	GameTimer::QueryCounter(captureCounterEnd);
+}
+
+void ProfilerCaptureFrames(uint32_t frameCount)
+{
+	framesRequested.store(frameCount, std::memory_order_release);
+}
+
+bool ProfilerFrameBoundary()
+{
+	++boundaryFrame;
+
+	if (framesLeft > 0)
+	{
+		//Capture was stopped by hand
+		if (!ProfilerIsCapturing())
+		{
+			framesLeft = 0;
+		}
+		else if (--framesLeft == 0)
+		{
+			ProfilerEndCapture();
+			return true;
+		}
+		else
+		{
+			ProfilerRecord(frameMarkName);
+		}
+	}
+
+	uint32_t requested = framesRequested.exchange(0, std::memory_order_acq_rel);
+	if (requested > 0)
+	{
+		ProfilerBeginCapture();
+		framesLeft = requested;
+		captureFirstFrame = boundaryFrame;
+		ProfilerRecord(frameMarkName);
+	}
+
+	return false;
+}
+
+
+void AppendJsonString(std::string &out, const char *text)
+{
+	out += '"';
+	for (const char *c = text ? text : "?"; *c; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			out += '\\';
+			out += *c;
+		}
+		else if ((unsigned char)*c < 0x20)
+		{
+			out += ' ';
+		}
+		else
+		{
+			out += *c;
+		}
+	}
+	out += '"';
+}
+
+void ProfilerFormatChromeTrace(std::string &out)
+{
+	ProfilerLock lock(captureLock);
+	ProfilerLock registry(registryLock);
+
+	out = "{\"traceEvents\":[";
+	bool bFirst = true;
+	char buffer[256];
+
+	//Timestamp ticks -> microseconds since the capture began, from the QueryCounter time the capture took.
+	//A capture still running is cut off at now.
+	uint64_t tscEnd = captureTscEnd;
+	int64_t counterEnd = captureCounterEnd;
+	if (counterEnd == 0)
+	{
+		tscEnd = ProfilerTimestamp();
+		GameTimer::QueryCounter(counterEnd);
+	}
+
+	int64_t frequency = 0;
+	GameTimer::QueryFrequency(frequency);
+
+	double captureUs = frequency > 0 ? (counterEnd - captureCounterStart) * 1e6 / (double)frequency : 0.0;
+	double usPerTick = (tscEnd > captureTscStart) ? captureUs / (double)(tscEnd - captureTscStart) : 0.0;
+
+	for (size_t r = 0; rings && r < rings->size(); ++r)
+	{
+		const ProfilerRing &ring = *(*rings)[r];
+
+		snprintf(buffer, sizeof(buffer), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			bFirst ? "" : ",", ring.threadId);
+		out += buffer;
+		if (ring.threadName)
+			AppendJsonString(out, ring.threadName);
+		else
+		{
+			snprintf(buffer, sizeof(buffer), "\"thread %u\"", ring.threadId);
+			out += buffer;
+		}
+		out += "}}";
+		bFirst = false;
+
+		uint64_t end = ring.write.load(std::memory_order_acquire);
+		uint64_t begin = ring.captureStart;
+		if (end - begin > PROFILER_RING_EVENTS - PROFILER_WRAP_MARGIN)
+			begin = end - (PROFILER_RING_EVENTS - PROFILER_WRAP_MARGIN);
+
+		//Pair begins and ends into complete events. Ends whose begin got overwritten are dropped, zones
+		//still open are closed at the end of the capture.
+		std::vector<const ProfilerEvent*> open;
+		uint64_t frame = captureFirstFrame;
+
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			const ProfilerEvent &ev = ring.events[i & (PROFILER_RING_EVENTS - 1)];
+
+			//Straggling end events after the capture ended
+			if (ev.timestamp > tscEnd)
+				break;
+
+			if (ev.name == frameMarkName)
+			{
+				snprintf(buffer, sizeof(buffer), ",{\"ph\":\"i\",\"s\":\"g\",\"name\":\"frame %llu\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+					(unsigned long long)frame++, ring.threadId, ev.timestamp >= captureTscStart ? (ev.timestamp - captureTscStart) * usPerTick : 0.0);
+				out += buffer;
+			}
+			else if (ev.name)
+			{
+				open.push_back(&ev);
+			}
+			else if (!open.empty())
+			{
+				const ProfilerEvent &zone = *open.back();
+				open.pop_back();
+
+				out += ",{\"ph\":\"X\",\"name\":";
+				AppendJsonString(out, zone.name);
+				snprintf(buffer, sizeof(buffer), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ring.threadId,
+					(zone.timestamp - captureTscStart) * usPerTick, (ev.timestamp - zone.timestamp) * usPerTick);
+				out += buffer;
+			}
+		}
+
+		while (!open.empty())
+		{
+			const ProfilerEvent &zone = *open.back();
+			open.pop_back();
+
+			out += ",{\"ph\":\"X\",\"name\":";
+			AppendJsonString(out, zone.name);
+			snprintf(buffer, sizeof(buffer), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ring.threadId,
+				(zone.timestamp - captureTscStart) * usPerTick, (tscEnd - zone.timestamp) * usPerTick);
+			out += buffer;
+		}
+	}
+
+	out += "],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool ProfilerWriteChromeTrace(const char *path)
+{
+	if (!path)
+		return false;
+
+	std::string trace;
+	ProfilerFormatChromeTrace(trace);
+
+	FILE *file = NULL;
+#ifdef _WIN32
+	if (fopen_s(&file, path, "wb") != 0)
+		file = NULL;
+#else
+	file = fopen(path, "wb");
+#endif
+
+	if (!file)
+		return false;
+
+	bool bOk = fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+	return (fclose(file) == 0) && bOk;
+}
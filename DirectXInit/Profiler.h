@@ -0,0 +1,131 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+
+//Build with DXAPP_PROFILE=0 and every PROFILE_ macro below turns into nothing. With it on (default) a zone
+//costs a relaxed load and a branch until a capture is running, then two timestamped ring writes.
+#ifndef DXAPP_PROFILE
+#define DXAPP_PROFILE 1
+#endif
+
+//Events per thread ring, power of two. 16 bytes each, allocated the first time a thread records.
+const uint32_t PROFILER_RING_EVENTS = 65536;
+
+
+//Scoped CPU zones written into per thread rings, dumped as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+//Each thread that records owns one ring and is its only writer, so recording takes no locks; the ring just
+//wraps and the oldest events go if a capture runs longer than it holds. Timestamps are the TSC where there
+//is one (QueryCounter elsewhere), converted using the QueryCounter time at the start and end of the capture.
+//
+//Capture either by hand (ProfilerBeginCapture/EndCapture) or for a number of frames (ProfilerCaptureFrames,
+//counted by whoever calls ProfilerFrameBoundary, DxAppBase does it for every frame drawn). Format/write the
+//trace after the capture ended. Zone names must be string literals (or otherwise outlive the capture).
+
+//QueryCounter, for targets without a TSC
+uint64_t ProfilerFallbackTimestamp();
+
+inline uint64_t ProfilerTimestamp()
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	return __rdtsc();
+#elif defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return ProfilerFallbackTimestamp();
+#endif
+}
+
+extern std::atomic<bool> gProfilerCapturing;
+
+inline bool ProfilerIsCapturing() { return gProfilerCapturing.load(std::memory_order_relaxed); }
+
+//Recording, from any thread. name NULL ends the innermost zone.
+void ProfilerRecord(const char *name);
+void ProfilerSetThreadName(const char *name);
+
+void ProfilerBeginCapture();
+void ProfilerEndCapture();
+
+//Capture the next frameCount frames, starting at the next frame boundary
+void ProfilerCaptureFrames(uint32_t frameCount);
+
+//Call once per frame from one thread. Starts/ends a ProfilerCaptureFrames capture and marks the frame in the
+//trace. Returns true on the boundary that ended the capture.
+bool ProfilerFrameBoundary();
+
+//Whatever the last capture recorded, as {"traceEvents":[...]}
+void ProfilerFormatChromeTrace(std::string &out);
+bool ProfilerWriteChromeTrace(const char *path);
+
+//text as a quoted JSON string, control characters become spaces and NULL "?". StartupReport uses it too.
+void AppendJsonString(std::string &out, const char *text);
+
+
+//RAII zone, only records if a capture was running when it opened
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char *name) : bActive(ProfilerIsCapturing())
+	{
+		if (bActive)
+			ProfilerRecord(name);
+	}
+
+	~ProfileZone()
+	{
+		if (bActive)
+			ProfilerRecord(NULL);
+	}
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	bool bActive;
+};
+
+
+#if DXAPP_PROFILE
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD_NAME(name) ProfilerSetThreadName(name)
+#define PROFILE_FRAME_BOUNDARY() ProfilerFrameBoundary()
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_FRAME_BOUNDARY() false
+
+#endif
@@ -0,0 +1,253 @@
+#include "stdafx.h"
+
+#include "RenderCommands.h"
+#include <algorithm>
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Constants are kept 16 byte aligned in the list, matching what constant buffers want anyway
+static inline uint32_t AlignConstants(uint32_t size) { return (size + 15) & ~15u; }
+
+
+RenderCommandList::RenderCommandList(uint32_t reserveCommands, uint32_t reserveConstantBytes)
+	: bSorted(true)
+{
+	commands.reserve(reserveCommands);
+	sorted.reserve(reserveCommands);
+	temp.reserve(reserveCommands);
+	constantData.reserve(reserveConstantBytes);
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+void RenderCommandList::Reset()
+{
+	//clear() keeps capacity, so this is free after the first frames
+	commands.clear();
+	constantData.clear();
+	sorted.clear();
+	bSorted = true;
+}
+
+RenderCommand& RenderCommandList::Add(uint64_t key, RenderCommandType type)
+{
+	SortEntry entry = { key, (uint32_t)commands.size(), 0 };
+	sorted.push_back(entry);
+	commands.push_back(RenderCommand());
+	bSorted = false;
+
+	RenderCommand &cmd = commands.back();
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.type = (uint8_t)type;
+	return cmd;
+}
+
+uint32_t RenderCommandList::CopyConstants(const void *data, uint32_t size)
+{
+	uint32_t offset = (uint32_t)constantData.size();
+	constantData.resize(offset + AlignConstants(size));
+	memcpy(&constantData[offset], data, size);
+	return offset;
+}
+
+void RenderCommandList::ClearColor(uint64_t key, const float rgba[4])
+{
+	RenderCommand &cmd = Add(key, RENDER_CMD_CLEAR_COLOR);
+	cmd.constantSize = 4 * sizeof(float);
+	cmd.constantOffset = CopyConstants(rgba, cmd.constantSize);
+}
+
+void RenderCommandList::ClearDepthStencil(uint64_t key, float depth, uint8_t stencil)
+{
+	RenderCommand &cmd = Add(key, RENDER_CMD_CLEAR_DEPTH_STENCIL);
+	cmd.stencil = stencil;
+	cmd.constantSize = sizeof(float);
+	cmd.constantOffset = CopyConstants(&depth, cmd.constantSize);
+}
+
+void RenderCommandList::Draw(uint64_t key, uint32_t state, uint32_t material, uint32_t geometry, uint32_t vertexCount, uint32_t startVertex,
+	const void *constants, uint32_t constantSize, uint32_t constantSlot)
+{
+	RenderCommand &cmd = Add(key, RENDER_CMD_DRAW);
+	cmd.state = state;
+	cmd.material = material;
+	cmd.geometry = geometry;
+	cmd.count = vertexCount;
+	cmd.start = startVertex;
+
+	if (constants && constantSize > 0)
+	{
+		cmd.constantSlot = (uint8_t)constantSlot;
+		cmd.constantSize = constantSize;
+		cmd.constantOffset = CopyConstants(constants, constantSize);
+	}
+}
+
+void RenderCommandList::DrawIndexed(uint64_t key, uint32_t state, uint32_t material, uint32_t geometry, uint32_t indexCount, uint32_t startIndex,
+	int32_t baseVertex, const void *constants, uint32_t constantSize, uint32_t constantSlot)
+{
+	RenderCommand &cmd = Add(key, RENDER_CMD_DRAW_INDEXED);
+	cmd.state = state;
+	cmd.material = material;
+	cmd.geometry = geometry;
+	cmd.count = indexCount;
+	cmd.start = startIndex;
+	cmd.baseVertex = baseVertex;
+
+	if (constants && constantSize > 0)
+	{
+		cmd.constantSlot = (uint8_t)constantSlot;
+		cmd.constantSize = constantSize;
+		cmd.constantOffset = CopyConstants(constants, constantSize);
+	}
+}
+
+void RenderCommandList::Sort()
+{
+	//Already in key order from a previous Sort (resubmitting the same frame)
+	if (bSorted)
+		return;
+
+	uint32_t n = (uint32_t)sorted.size();
+
+	bSorted = true;
+	stats.sortPasses = 0;
+
+	if (n < 2)
+		return;
+
+	temp.resize(n);
+
+	//All eight byte histograms in one read over the keys
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		uint64_t key = sorted[i].key;
+		for (int b = 0; b < 8; ++b)
+			++histograms[b][(key >> (b * 8)) & 0xFF];
+	}
+
+	SortEntry *src = &sorted[0];
+	SortEntry *dst = &temp[0];
+
+	for (int b = 0; b < 8; ++b)
+	{
+		uint32_t *hist = histograms[b];
+		int shift = b * 8;
+
+		//Every key has the same byte here (unused key bits, a single pass...), this pass would be a copy
+		if (hist[(src[0].key >> shift) & 0xFF] == n)
+			continue;
+
+		uint32_t offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			uint32_t c = hist[i];
+			hist[i] = offset;
+			offset += c;
+		}
+
+		for (uint32_t i = 0; i < n; ++i)
+			dst[hist[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+		std::swap(src, dst);
+		++stats.sortPasses;
+	}
+
+	//Odd number of passes leaves the result in temp
+	if (src != &sorted[0])
+		sorted.swap(temp);
+}
+
+void RenderCommandList::Submit(IRenderContext &context)
+{
+	if (!bSorted)
+		Sort();
+
+	uint32_t sortPasses = stats.sortPasses;
+	memset(&stats, 0, sizeof(stats));
+	stats.sortPasses = sortPasses;
+	stats.commands = (uint32_t)commands.size();
+
+	//Nothing bound yet as far as we know, so the first draw binds everything
+	bool bFirstDraw = true;
+	uint32_t curState = 0;
+	uint32_t curMaterial = 0;
+	uint32_t curGeometry = 0;
+
+	for (uint32_t i = 0; i < stats.commands; ++i)
+	{
+		const RenderCommand &cmd = commands[sorted[i].index];
+		const uint8_t *constants = cmd.constantSize ? &constantData[cmd.constantOffset] : NULL;
+
+		switch (cmd.type)
+		{
+		case RENDER_CMD_CLEAR_COLOR:
+			context.ClearColor(reinterpret_cast<const float*>(constants));
+			++stats.clears;
+			continue;
+
+		case RENDER_CMD_CLEAR_DEPTH_STENCIL:
+			context.ClearDepthStencil(*reinterpret_cast<const float*>(constants), cmd.stencil);
+			++stats.clears;
+			continue;
+
+		default:
+			break;
+		}
+
+		if (bFirstDraw || cmd.state != curState)
+		{
+			context.SetPipelineState(cmd.state);
+			curState = cmd.state;
+			++stats.stateChanges;
+		}
+
+		if (bFirstDraw || cmd.material != curMaterial)
+		{
+			context.SetMaterial(cmd.material);
+			curMaterial = cmd.material;
+			++stats.materialChanges;
+		}
+
+		if (bFirstDraw || cmd.geometry != curGeometry)
+		{
+			context.SetGeometry(cmd.geometry);
+			curGeometry = cmd.geometry;
+			++stats.geometryChanges;
+		}
+
+		bFirstDraw = false;
+
+		if (constants)
+		{
+			context.SetConstants(cmd.constantSlot, constants, cmd.constantSize);
+			++stats.constantUploads;
+		}
+
+		if (cmd.type == RENDER_CMD_DRAW_INDEXED)
+			context.DrawIndexed(cmd.count, cmd.start, cmd.baseVertex);
+		else
+			context.Draw(cmd.count, cmd.start);
+
+		++stats.draws;
+	}
+}
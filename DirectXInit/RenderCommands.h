@@ -0,0 +1,175 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "RenderContext.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+//Sort keys. The top 4 bits are always the pass, so passes replay in order. The rest depends on what the
+//pass wants to be sorted by:
+//
+//	opaque:			pass(4) | state(12) | material(16) | depth(24) | user(8)	- fewest state changes, then front to back
+//	transparent:	pass(4) | ~depth(24) | state(12) | material(16) | user(8)	- back to front, then by state
+//
+//depth is view depth mapped to [0,1]. The low 8 bits are free for the app to break ties however it likes,
+//commands with equal keys keep the order they were recorded in.
+
+const int RENDERKEY_PASS_BITS = 4;
+const int RENDERKEY_STATE_BITS = 12;
+const int RENDERKEY_MATERIAL_BITS = 16;
+const int RENDERKEY_DEPTH_BITS = 24;
+
+const uint32_t RENDERKEY_MAX_PASS = (1u << RENDERKEY_PASS_BITS) - 1;
+const uint32_t RENDERKEY_MAX_STATE = (1u << RENDERKEY_STATE_BITS) - 1;
+const uint32_t RENDERKEY_MAX_MATERIAL = (1u << RENDERKEY_MATERIAL_BITS) - 1;
+const uint32_t RENDERKEY_MAX_DEPTH = (1u << RENDERKEY_DEPTH_BITS) - 1;
+
+inline uint32_t RenderKeyDepth(float depth01)
+{
+	if (!(depth01 > 0.0f))
+		return 0;
+	if (depth01 >= 1.0f)
+		return RENDERKEY_MAX_DEPTH;
+	return (uint32_t)(depth01 * (float)RENDERKEY_MAX_DEPTH);
+}
+
+inline uint64_t MakeOpaqueKey(uint32_t pass, uint32_t state, uint32_t material, float depth01, uint32_t user = 0)
+{
+	return ((uint64_t)(pass & RENDERKEY_MAX_PASS) << 60) |
+		((uint64_t)(state & RENDERKEY_MAX_STATE) << 48) |
+		((uint64_t)(material & RENDERKEY_MAX_MATERIAL) << 32) |
+		((uint64_t)RenderKeyDepth(depth01) << 8) |
+		(uint64_t)(user & 0xFF);
+}
+
+inline uint64_t MakeTransparentKey(uint32_t pass, float depth01, uint32_t state, uint32_t material, uint32_t user = 0)
+{
+	return ((uint64_t)(pass & RENDERKEY_MAX_PASS) << 60) |
+		((uint64_t)(RENDERKEY_MAX_DEPTH - RenderKeyDepth(depth01)) << 36) |
+		((uint64_t)(state & RENDERKEY_MAX_STATE) << 24) |
+		((uint64_t)(material & RENDERKEY_MAX_MATERIAL) << 8) |
+		(uint64_t)(user & 0xFF);
+}
+
+//Sorts ahead of every draw in the pass (draws with an all zero key tie with it and stay in record order)
+inline uint64_t MakePassStartKey(uint32_t pass)
+{
+	return (uint64_t)(pass & RENDERKEY_MAX_PASS) << 60;
+}
+
+
+enum RenderCommandType
+{
+	RENDER_CMD_CLEAR_COLOR = 0,
+	RENDER_CMD_CLEAR_DEPTH_STENCIL,
+	RENDER_CMD_DRAW,
+	RENDER_CMD_DRAW_INDEXED,
+};
+
+struct RenderCommand
+{
+	uint8_t  type;				//RenderCommandType
+	uint8_t  constantSlot;
+	uint8_t  stencil;
+	uint8_t  pad;
+	uint32_t state;
+	uint32_t material;
+	uint32_t geometry;
+	uint32_t count;				//Vertices or indices
+	uint32_t start;
+	int32_t  baseVertex;
+	uint32_t constantOffset;	//Into the list's constant data. Clears keep their color/depth there.
+	uint32_t constantSize;
+};
+
+struct RenderCommandStats
+{
+	uint32_t commands;
+	uint32_t draws;
+	uint32_t clears;
+	uint32_t stateChanges;
+	uint32_t materialChanges;
+	uint32_t geometryChanges;
+	uint32_t constantUploads;
+	uint32_t sortPasses;		//Radix passes that actually ran, bytes every key agreed on get skipped
+};
+
+
+//Per frame command list. Record in whatever order is convenient (Reset at the top of the frame), Submit
+//sorts by key and replays into a context, binding state only when it differs from the previous draw.
+//Storage is kept between frames, so after the first few frames recording doesn't allocate.
+//One recording thread at a time.
+
+class RenderCommandList
+{
+public:
+	RenderCommandList(uint32_t reserveCommands = 4096, uint32_t reserveConstantBytes = 64 * 1024);
+
+	void Reset();
+
+	void ClearColor(uint64_t key, const float rgba[4]);
+	void ClearDepthStencil(uint64_t key, float depth, uint8_t stencil);
+
+	//constants (optional) are copied into the list and set on constantSlot right before the draw
+	void Draw(uint64_t key, uint32_t state, uint32_t material, uint32_t geometry, uint32_t vertexCount, uint32_t startVertex,
+		const void *constants = NULL, uint32_t constantSize = 0, uint32_t constantSlot = 0);
+	void DrawIndexed(uint64_t key, uint32_t state, uint32_t material, uint32_t geometry, uint32_t indexCount, uint32_t startIndex,
+		int32_t baseVertex, const void *constants = NULL, uint32_t constantSize = 0, uint32_t constantSlot = 0);
+
+	//Stable LSD radix sort on the keys. Submit calls it if nothing else did.
+	void Sort();
+
+	//Replay in key order. Leaves the commands in place, so the same frame can be submitted again.
+	void Submit(IRenderContext &context);
+
+	inline uint32_t CommandCount() const { return (uint32_t)commands.size(); };
+	inline const RenderCommandStats& LastStats() const { return stats; };
+
+	//Sorted position i -> recorded command, valid after Sort
+	inline const RenderCommand& SortedCommand(uint32_t i) const { return commands[sorted[i].index]; };
+	inline uint64_t SortedKey(uint32_t i) const { return sorted[i].key; };
+	inline uint32_t SortedCommandIndex(uint32_t i) const { return sorted[i].index; };
+
+private:
+
+	//Key and command index move together, one cache line holds four
+	struct SortEntry
+	{
+		uint64_t key;
+		uint32_t index;
+		uint32_t pad;
+	};
+
+	RenderCommandList(const RenderCommandList&);
+	RenderCommandList& operator=(const RenderCommandList&);
+
+	RenderCommand& Add(uint64_t key, RenderCommandType type);
+	uint32_t CopyConstants(const void *data, uint32_t size);
+
+	std::vector<RenderCommand> commands;
+	std::vector<uint8_t> constantData;
+
+	//Filled as commands are recorded, sorted in place (ping-ponging with temp)
+	std::vector<SortEntry> sorted;
+	std::vector<SortEntry> temp;
+
+	bool bSorted;
+	RenderCommandStats stats;
+};
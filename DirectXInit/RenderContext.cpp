@@ -0,0 +1,99 @@
+#include "stdafx.h"
+
+#include "RenderContext.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+RecordingRenderContext::RecordingRenderContext() : bKeepCalls(true)
+{
+	Reset();
+}
+
+void RecordingRenderContext::Reset()
+{
+	calls.clear();
+	memset(counts, 0, sizeof(counts));
+	constantBytes = 0;
+}
+
+uint64_t RecordingRenderContext::TotalCalls() const
+{
+	uint64_t total = 0;
+	for (int i = 0; i < RENDER_CALL_TYPE_COUNT; ++i)
+		total += counts[i];
+	return total;
+}
+
+void RecordingRenderContext::Record(RenderCallType type, uint32_t a, uint32_t b, uint32_t c)
+{
+	++counts[type];
+
+	if (!bKeepCalls)
+		return;
+
+	RecordedRenderCall call;
+	call.type = type;
+	call.args[0] = a;
+	call.args[1] = b;
+	call.args[2] = c;
+	calls.push_back(call);
+}
+
+void RecordingRenderContext::ClearColor(const float[4])
+{
+	Record(RENDER_CALL_CLEAR_COLOR);
+}
+
+void RecordingRenderContext::ClearDepthStencil(float depth, uint8_t stencil)
+{
+	uint32_t depthBits;
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	Record(RENDER_CALL_CLEAR_DEPTH_STENCIL, depthBits, stencil);
+}
+
+void RecordingRenderContext::SetPipelineState(uint32_t stateId)
+{
+	Record(RENDER_CALL_SET_PIPELINE_STATE, stateId);
+}
+
+void RecordingRenderContext::SetMaterial(uint32_t materialId)
+{
+	Record(RENDER_CALL_SET_MATERIAL, materialId);
+}
+
+void RecordingRenderContext::SetGeometry(uint32_t geometryId)
+{
+	Record(RENDER_CALL_SET_GEOMETRY, geometryId);
+}
+
+void RecordingRenderContext::SetConstants(uint32_t slot, const void*, uint32_t size)
+{
+	constantBytes += size;
+	Record(RENDER_CALL_SET_CONSTANTS, slot, size);
+}
+
+void RecordingRenderContext::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+	Record(RENDER_CALL_DRAW, vertexCount, startVertex);
+}
+
+void RecordingRenderContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Record(RENDER_CALL_DRAW_INDEXED, indexCount, startIndex, (uint32_t)baseVertex);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <vector>
+
+
+//What a RenderCommandList replays into. Deliberately small and free of any D3D types so the command
+//layer builds and can be exercised anywhere; the backend maps the ids onto its own objects.
+//
+//Ids are handed out by the backend when the app registers states/materials/geometry with it, 0 always
+//means "default" (no blend state, no shaders, ...).
+
+const uint32_t RENDER_MAX_CONSTANT_SLOTS = 4;
+
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() { }
+
+	virtual void ClearColor(const float rgba[4]) = 0;
+	virtual void ClearDepthStencil(float depth, uint8_t stencil) = 0;
+
+	//Blend/depth-stencil/rasterizer bundle
+	virtual void SetPipelineState(uint32_t stateId) = 0;
+	//Shaders, input layout and their resources
+	virtual void SetMaterial(uint32_t materialId) = 0;
+	//Vertex/index buffers and topology
+	virtual void SetGeometry(uint32_t geometryId) = 0;
+
+	//Per draw constants, copied by the backend before this returns
+	virtual void SetConstants(uint32_t slot, const void *data, uint32_t size) = 0;
+
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex) = 0;
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex) = 0;
+};
+
+
+enum RenderCallType
+{
+	RENDER_CALL_CLEAR_COLOR = 0,
+	RENDER_CALL_CLEAR_DEPTH_STENCIL,
+	RENDER_CALL_SET_PIPELINE_STATE,
+	RENDER_CALL_SET_MATERIAL,
+	RENDER_CALL_SET_GEOMETRY,
+	RENDER_CALL_SET_CONSTANTS,
+	RENDER_CALL_DRAW,
+	RENDER_CALL_DRAW_INDEXED,
+
+	RENDER_CALL_TYPE_COUNT
+};
+
+struct RecordedRenderCall
+{
+	RenderCallType type;
+	uint32_t	   args[3];		//Ids, counts, or slot/size for constants, in parameter order (floats as their bits)
+};
+
+
+//Records what it is asked to do instead of doing it. For running the command layer without a device
+//(linux, benchmarks) and for checking what actually reached the backend.
+
+class RecordingRenderContext : public IRenderContext
+{
+public:
+	RecordingRenderContext();
+
+	//Keep individual calls, not just the counts
+	inline void SetKeepCalls(bool keep) { bKeepCalls = keep; };
+
+	void Reset();
+
+	inline const std::vector<RecordedRenderCall>& Calls() const { return calls; };
+	inline uint64_t CountOf(RenderCallType type) const { return counts[type]; };
+	inline uint64_t ConstantBytes() const { return constantBytes; };
+	uint64_t TotalCalls() const;
+
+	virtual void ClearColor(const float rgba[4]);
+	virtual void ClearDepthStencil(float depth, uint8_t stencil);
+	virtual void SetPipelineState(uint32_t stateId);
+	virtual void SetMaterial(uint32_t materialId);
+	virtual void SetGeometry(uint32_t geometryId);
+	virtual void SetConstants(uint32_t slot, const void *data, uint32_t size);
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex);
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+
+private:
+
+	void Record(RenderCallType type, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+
+	bool bKeepCalls;
+	std::vector<RecordedRenderCall> calls;
+	uint64_t counts[RENDER_CALL_TYPE_COUNT];
+	uint64_t constantBytes;
+};
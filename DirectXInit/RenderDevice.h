@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "Platform.h"
+#include "RenderContext.h"
+#include "RenderStateCache.h"
+#include "RenderTargetPool.h"
+
+
+//What DirectXManager drives. One call per step of its init ladder (see CurState) plus resize and present,
+//so the manager keeps all the ordering/state/locking and a backend only has to do the work.
+//
+//D3D11RenderDevice is the real thing, NullRenderDevice does everything in memory so init, resize and the
+//frame loop run without a GPU or a window (headless benchmarks, linux).
+//
+//Formats are fixed for now: R8G8B8A8_UNORM back buffers, D24_UNORM_S8_UINT depth/stencil.
+
+enum RenderDeviceType
+{
+	RENDER_DEVICE_D3D11 = 0,
+	RENDER_DEVICE_NULL,
+};
+
+struct RenderSwapChainDesc
+{
+	UINT width;
+	UINT height;
+	UINT refreshNumerator;
+	UINT refreshDenominator;
+	UINT sampleCount;
+	UINT sampleQuality;
+	UINT bufferCount;
+	bool windowed;
+	HWND outputWindow;
+};
+
+struct RenderDepthStencilDesc
+{
+	UINT width;
+	UINT height;
+	UINT sampleCount;
+	UINT sampleQuality;
+};
+
+struct RenderViewport
+{
+	float topLeftX;
+	float topLeftY;
+	float width;
+	float height;
+	float minDepth;
+	float maxDepth;
+};
+
+
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() { }
+
+	virtual RenderDeviceType Type() const = 0;
+
+	//False if the device can run without an output window
+	virtual bool NeedsWindow() const = 0;
+
+	virtual HRESULT CreateDevice() = 0;
+	virtual HRESULT CheckMultisampleQuality(UINT sampleCount, UINT &quality) = 0;
+	virtual HRESULT CreateSwapChain(const RenderSwapChainDesc &desc) = 0;
+	virtual HRESULT CreateBackBufferView() = 0;
+
+	//From the device's target pool, so the buffer can be bigger than asked for (the viewport is what counts)
+	virtual HRESULT CreateDepthStencil(const RenderDepthStencilDesc &desc) = 0;
+	virtual void	BindViews() = 0;
+	virtual void	SetViewport(const RenderViewport &viewport) = 0;
+
+	//Drop the back buffer view and the depth/stencil view, the swap chain can't resize while anything still
+	//references its buffers. The depth/stencil buffer goes back to the target pool.
+	virtual void	ReleaseViews() = 0;
+	virtual HRESULT ResizeSwapChain(UINT width, UINT height) = 0;
+
+	virtual HRESULT Present(UINT syncInterval) = 0;
+
+	//Release everything created so far, wherever the ladder stopped. Safe to call more than once.
+	virtual void	Release() = 0;
+
+	//What RenderCommandList::Submit replays into
+	virtual IRenderContext& Context() = 0;
+
+	//Shadow of what is bound, redundant binds are dropped against it. Present ends its frame.
+	virtual RenderStateCache& StateCache() = 0;
+
+	//Depth buffers (and any other targets) by size bucket. Present ends its frame and shrinks what has been
+	//oversized for longer than its hysteresis.
+	virtual RenderTargetPool& TargetPool() = 0;
+};
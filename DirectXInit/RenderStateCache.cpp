@@ -0,0 +1,187 @@
+#include "stdafx.h"
+
+#include "RenderStateCache.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+uint64_t StateFilterIssued(const StateFilterStats &stats)
+{
+	uint64_t sum = 0;
+	for (int i = 0; i < STATECALL_COUNT; ++i)
+		sum += stats.issued[i];
+	return sum;
+}
+
+uint64_t StateFilterFiltered(const StateFilterStats &stats)
+{
+	uint64_t sum = 0;
+	for (int i = 0; i < STATECALL_COUNT; ++i)
+		sum += stats.filtered[i];
+	return sum;
+}
+
+const char* StateCallName(StateCall call)
+{
+	static const char *names[STATECALL_COUNT] =
+	{
+		"render targets", "viewport", "blend state", "depth/stencil state", "rasterizer state", "input layout",
+		"vertex shader", "pixel shader", "shader resources", "samplers", "vertex buffers", "index buffer",
+		"topology", "constant buffers", "constant data", "pipeline state", "material", "geometry",
+	};
+
+	return (call >= 0 && call < STATECALL_COUNT) ? names[call] : "?";
+}
+
+
+RenderStateCache::RenderStateCache() : bEnabled(true), frameCount(0)
+{
+	InvalidateAll();
+	ResetStats();
+}
+
+bool RenderStateCache::Set(StateCall call, uint32_t slot, const void *value)
+{
+	return SetId(call, slot, (uint64_t)(uintptr_t)value);
+}
+
+bool RenderStateCache::SetId(StateCall call, uint32_t slot, uint64_t value)
+{
+	if (!bEnabled || slot >= STATECACHE_SLOTS)
+		return Count(call, true);
+
+	uint32_t bit = 1u << slot;
+	if ((validMask[call] & bit) && values[call][slot] == value)
+		return Count(call, false);
+
+	values[call][slot] = value;
+	validMask[call] |= bit;
+	return Count(call, true);
+}
+
+bool RenderStateCache::SetBytes(StateCall call, uint32_t slot, const void *data, uint32_t size)
+{
+	if (!bEnabled || slot >= STATECACHE_SLOTS || size > STATECACHE_MAX_BYTES)
+	{
+		Invalidate(call, slot);
+		return Count(call, true);
+	}
+
+	uint32_t bit = 1u << slot;
+	std::vector<uint8_t> &bound = bytes[call][slot];
+
+	if ((validMask[call] & bit) && bound.size() == size && (size == 0 || memcmp(&bound[0], data, size) == 0))
+		return Count(call, false);
+
+	bound.resize(size);
+	if (size > 0)
+		memcpy(&bound[0], data, size);
+
+	validMask[call] |= bit;
+	return Count(call, true);
+}
+
+void RenderStateCache::Invalidate(StateCall call)
+{
+	validMask[call] = 0;
+}
+
+void RenderStateCache::Invalidate(StateCall call, uint32_t slot)
+{
+	if (slot < STATECACHE_SLOTS)
+		validMask[call] &= ~(1u << slot);
+}
+
+void RenderStateCache::InvalidateAll()
+{
+	memset(validMask, 0, sizeof(validMask));
+}
+
+void RenderStateCache::SetEnabled(bool enable)
+{
+	//Nothing was recorded while disabled
+	if (enable && !bEnabled)
+		InvalidateAll();
+
+	bEnabled = enable;
+}
+
+void RenderStateCache::EndFrame()
+{
+	lastFrame = frame;
+	memset(&frame, 0, sizeof(frame));
+	++frameCount;
+}
+
+void RenderStateCache::ResetStats()
+{
+	memset(&frame, 0, sizeof(frame));
+	memset(&lastFrame, 0, sizeof(lastFrame));
+	memset(&total, 0, sizeof(total));
+	frameCount = 0;
+}
+
+
+StateFilterRenderContext::StateFilterRenderContext(IRenderContext &targetContext, RenderStateCache &cache) :
+	target(targetContext), stateCache(cache)
+{
+}
+
+void StateFilterRenderContext::ClearColor(const float rgba[4])
+{
+	target.ClearColor(rgba);
+}
+
+void StateFilterRenderContext::ClearDepthStencil(float depth, uint8_t stencil)
+{
+	target.ClearDepthStencil(depth, stencil);
+}
+
+void StateFilterRenderContext::SetPipelineState(uint32_t stateId)
+{
+	if (stateCache.SetId(STATECALL_PIPELINE_STATE, 0, stateId))
+		target.SetPipelineState(stateId);
+}
+
+void StateFilterRenderContext::SetMaterial(uint32_t materialId)
+{
+	if (stateCache.SetId(STATECALL_MATERIAL, 0, materialId))
+		target.SetMaterial(materialId);
+}
+
+void StateFilterRenderContext::SetGeometry(uint32_t geometryId)
+{
+	if (stateCache.SetId(STATECALL_GEOMETRY, 0, geometryId))
+		target.SetGeometry(geometryId);
+}
+
+void StateFilterRenderContext::SetConstants(uint32_t slot, const void *data, uint32_t size)
+{
+	if (stateCache.SetBytes(STATECALL_CONSTANT_DATA, slot, data, size))
+		target.SetConstants(slot, data, size);
+}
+
+void StateFilterRenderContext::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+	target.Draw(vertexCount, startVertex);
+}
+
+void StateFilterRenderContext::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	target.DrawIndexed(indexCount, startIndex, baseVertex);
+}
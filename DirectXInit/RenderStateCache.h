@@ -0,0 +1,165 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "RenderContext.h"
+#include <stdint.h>
+#include <vector>
+
+
+//What can be bound. The first group is what a backend binds on the device context, the second the ids an
+//IRenderContext gets (StateFilterRenderContext works at that level, for backends that don't filter themselves).
+
+enum StateCall
+{
+	STATECALL_RENDER_TARGETS = 0,
+	STATECALL_VIEWPORT,
+	STATECALL_BLEND_STATE,
+	STATECALL_DEPTH_STENCIL_STATE,
+	STATECALL_RASTERIZER_STATE,
+	STATECALL_INPUT_LAYOUT,
+	STATECALL_VERTEX_SHADER,
+	STATECALL_PIXEL_SHADER,
+	STATECALL_SHADER_RESOURCES,
+	STATECALL_SAMPLERS,
+	STATECALL_VERTEX_BUFFERS,
+	STATECALL_INDEX_BUFFER,
+	STATECALL_TOPOLOGY,
+	STATECALL_CONSTANT_BUFFERS,
+	STATECALL_CONSTANT_DATA,		//Buffer uploads, filtered when the bytes didn't change
+
+	STATECALL_PIPELINE_STATE,
+	STATECALL_MATERIAL,
+	STATECALL_GEOMETRY,
+
+	STATECALL_COUNT
+};
+
+//Slots tracked per call, anything bound past these is always passed through
+const uint32_t STATECACHE_SLOTS = 8;
+
+//Byte compared state bigger than this (big constant uploads) is always passed through
+const uint32_t STATECACHE_MAX_BYTES = 4096;
+
+
+struct StateFilterStats
+{
+	uint64_t issued[STATECALL_COUNT];		//Reached the device
+	uint64_t filtered[STATECALL_COUNT];		//Dropped, already bound
+};
+
+uint64_t StateFilterIssued(const StateFilterStats &stats);
+uint64_t StateFilterFiltered(const StateFilterStats &stats);
+const char* StateCallName(StateCall call);
+
+
+//Shadow copy of what is bound on a device context. Backends ask it before every bind and skip the call
+//when it returns false, it counts both (per frame and in total). Frames end at EndFrame, which the
+//devices call from Present.
+//
+//Anything bound behind its back (straight on the ID3D11DeviceContext, ClearState, ...) has to be followed by
+//Invalidate for that call, or everything. Same threading as the context it shadows.
+
+class RenderStateCache
+{
+public:
+	RenderStateCache();
+
+	//Pointer/id identity. True if it differs from what the slot holds (recorded as bound), false to drop the call.
+	bool Set(StateCall call, uint32_t slot, const void *value);
+	bool SetId(StateCall call, uint32_t slot, uint64_t value);
+
+	//Same, comparing contents (viewports, constants, several values that go in one call)
+	bool SetBytes(StateCall call, uint32_t slot, const void *data, uint32_t size);
+
+	void Invalidate(StateCall call);
+	void Invalidate(StateCall call, uint32_t slot);
+	void InvalidateAll();
+
+	//Disabled: every call passes (and counts as issued), for measuring what filtering saves
+	void SetEnabled(bool enable);
+	inline bool IsEnabled() const { return bEnabled; };
+
+	void EndFrame();
+	void ResetStats();
+
+	inline const StateFilterStats& CurrentFrame() const { return frame; };
+	inline const StateFilterStats& LastFrame() const { return lastFrame; };
+	inline const StateFilterStats& Total() const { return total; };
+	inline uint64_t Frames() const { return frameCount; };
+
+private:
+
+	RenderStateCache(const RenderStateCache&);
+	RenderStateCache& operator=(const RenderStateCache&);
+
+	inline bool Count(StateCall call, bool issue)
+	{
+		if (issue)
+		{
+			++frame.issued[call];
+			++total.issued[call];
+		}
+		else
+		{
+			++frame.filtered[call];
+			++total.filtered[call];
+		}
+		return issue;
+	}
+
+	bool bEnabled;
+
+	uint64_t values[STATECALL_COUNT][STATECACHE_SLOTS];
+	uint32_t validMask[STATECALL_COUNT];
+
+	//Only grows, so after the first few frames comparing contents doesn't allocate
+	std::vector<uint8_t> bytes[STATECALL_COUNT][STATECACHE_SLOTS];
+
+	StateFilterStats frame;
+	StateFilterStats lastFrame;
+	StateFilterStats total;
+	uint64_t frameCount;
+};
+
+
+//Drops pipeline state/material/geometry binds and constant uploads that repeat what is already bound, and
+//forwards everything else to target. For backends that bind by id and don't filter on their own (the
+//null device's recorder); D3D11RenderContext filters every D3D call itself.
+
+class StateFilterRenderContext : public IRenderContext
+{
+public:
+	StateFilterRenderContext(IRenderContext &targetContext, RenderStateCache &cache);
+
+	virtual void ClearColor(const float rgba[4]);
+	virtual void ClearDepthStencil(float depth, uint8_t stencil);
+	virtual void SetPipelineState(uint32_t stateId);
+	virtual void SetMaterial(uint32_t materialId);
+	virtual void SetGeometry(uint32_t geometryId);
+	virtual void SetConstants(uint32_t slot, const void *data, uint32_t size);
+	virtual void Draw(uint32_t vertexCount, uint32_t startVertex);
+	virtual void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+
+private:
+
+	StateFilterRenderContext(const StateFilterRenderContext&);
+	StateFilterRenderContext& operator=(const StateFilterRenderContext&);
+
+	IRenderContext &target;
+	RenderStateCache &stateCache;
+};
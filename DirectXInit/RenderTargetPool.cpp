@@ -0,0 +1,240 @@
+#include "stdafx.h"
+
+#include "RenderTargetPool.h"
+#include <string.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+RenderTargetPool::RenderTargetPool(IRenderTargetAllocator &targetAllocator, uint32_t hysteresis) :
+	allocator(targetAllocator), hysteresisFrames(hysteresis), frame(0)
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+	Clear();
+}
+
+UINT RenderTargetPool::BucketSize(UINT size)
+{
+	if (size == 0)
+		return RENDERPOOL_BUCKET_PIXELS;
+
+	return ((size + RENDERPOOL_BUCKET_PIXELS - 1) / RENDERPOOL_BUCKET_PIXELS) * RENDERPOOL_BUCKET_PIXELS;
+}
+
+//Bigger than the bucket of what it is used for
+bool RenderTargetPool::IsOversized(const Target &target) const
+{
+	return target.desc.width > BucketSize(target.usedWidth) || target.desc.height > BucketSize(target.usedHeight);
+}
+
+bool RenderTargetPool::IsShrinkDue(const Target &target) const
+{
+	return IsOversized(target) && frame - target.sizedFrame >= hysteresisFrames;
+}
+
+HRESULT RenderTargetPool::Acquire(const RenderTargetDesc &desc, void *&resource)
+{
+	resource = NULL;
+	++stats.acquires;
+
+	//Smallest free one that fits
+	size_t best = targets.size();
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		const Target &target = targets[i];
+		if (target.bInUse || target.desc.usage != desc.usage || target.desc.format != desc.format ||
+			target.desc.sampleCount != desc.sampleCount || target.desc.sampleQuality != desc.sampleQuality)
+			continue;
+
+		if (target.desc.width < desc.width || target.desc.height < desc.height)
+			continue;
+
+		if (best == targets.size() || RenderTargetBytes(target.desc) < RenderTargetBytes(targets[best].desc))
+			best = i;
+	}
+
+	if (best < targets.size())
+	{
+		Target &target = targets[best];
+		target.usedWidth = desc.width;
+		target.usedHeight = desc.height;
+
+		//Shrunk, and not for the first time in a while: not worth keeping around any longer
+		if (IsShrinkDue(target))
+		{
+			++stats.shrinks;
+			Free(best);
+		}
+		else
+		{
+			if (!IsOversized(target))
+				target.sizedFrame = frame;
+
+			target.bInUse = true;
+			resource = target.resource;
+
+			++stats.reuses;
+			UpdateBytes();
+			return S_OK;
+		}
+	}
+
+	Target target;
+	target.desc = desc;
+	target.desc.width = BucketSize(desc.width);
+	target.desc.height = BucketSize(desc.height);
+
+	if (FAILED(allocator.CreateTarget(target.desc, target.resource)))
+	{
+		UpdateBytes();
+		return -1;
+	}
+
+	target.bInUse = true;
+	target.usedWidth = desc.width;
+	target.usedHeight = desc.height;
+	target.sizedFrame = frame;
+	target.releasedFrame = frame;
+
+	targets.push_back(target);
+	++stats.allocations;
+
+	resource = target.resource;
+	UpdateBytes();
+	return S_OK;
+}
+
+void RenderTargetPool::Release(void *resource)
+{
+	if (!resource)
+		return;
+
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		Target &target = targets[i];
+		if (target.resource != resource)
+			continue;
+
+		if (IsShrinkDue(target))
+		{
+			++stats.shrinks;
+			Free(i);
+		}
+		else
+		{
+			target.bInUse = false;
+			target.releasedFrame = frame;
+		}
+
+		UpdateBytes();
+		return;
+	}
+}
+
+bool RenderTargetPool::EndFrame()
+{
+	++frame;
+
+	bool bShrinkDue = false;
+
+	for (size_t i = targets.size(); i > 0; --i)
+	{
+		Target &target = targets[i - 1];
+
+		if (target.bInUse)
+		{
+			if (!IsOversized(target))
+				target.sizedFrame = frame;
+			else if (IsShrinkDue(target))
+				bShrinkDue = true;
+		}
+		else if (frame - target.releasedFrame >= hysteresisFrames)
+		{
+			Free(i - 1);
+			UpdateBytes();
+		}
+	}
+
+	return bShrinkDue;
+}
+
+bool RenderTargetPool::ShouldShrink(const void *resource) const
+{
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		if (targets[i].resource == resource)
+			return targets[i].bInUse && IsShrinkDue(targets[i]);
+	}
+
+	return false;
+}
+
+void RenderTargetPool::Clear()
+{
+	while (!targets.empty())
+		Free(targets.size() - 1);
+
+	UpdateBytes();
+}
+
+void RenderTargetPool::ResetStats()
+{
+	memset(&stats, 0, sizeof(stats));
+	UpdateBytes();
+}
+
+void RenderTargetPool::Free(size_t index)
+{
+	allocator.ReleaseTarget(targets[index].desc, targets[index].resource);
+
+	targets[index] = targets.back();
+	targets.pop_back();
+
+	++stats.frees;
+}
+
+//A handful of targets, recounting is cheaper than getting incremental counts right
+void RenderTargetPool::UpdateBytes()
+{
+	stats.bytesHeld = 0;
+	stats.bytesInUse = 0;
+	stats.bytesUsed = 0;
+	stats.targets = (uint32_t)targets.size();
+	stats.targetsInUse = 0;
+
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		const Target &target = targets[i];
+		uint64_t bytes = RenderTargetBytes(target.desc);
+		stats.bytesHeld += bytes;
+
+		if (target.bInUse)
+		{
+			RenderTargetDesc used = target.desc;
+			used.width = target.usedWidth;
+			used.height = target.usedHeight;
+
+			stats.bytesInUse += bytes;
+			stats.bytesUsed += RenderTargetBytes(used);
+			++stats.targetsInUse;
+		}
+	}
+}
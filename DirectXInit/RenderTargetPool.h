@@ -0,0 +1,139 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "Platform.h"
+#include <stdint.h>
+#include <vector>
+
+
+//Sizes are rounded up to this many pixels, a resize that stays inside the same bucket keeps its buffers
+const UINT RENDERPOOL_BUCKET_PIXELS = 128;
+
+//Frames a target may stay bigger than it needs to be (after shrinking) or sit unused in the pool before it
+//is freed. Presents, so a few seconds at 60Hz.
+const uint32_t RENDERPOOL_DEFAULT_HYSTERESIS_FRAMES = 180;
+
+enum RenderTargetUsage
+{
+	RENDERTARGET_COLOR = 0,
+	RENDERTARGET_DEPTH_STENCIL,
+};
+
+//format is whatever the backend uses (DXGI_FORMAT on D3D11), the pool only compares it
+struct RenderTargetDesc
+{
+	RenderTargetUsage usage;
+	UINT format;
+	UINT bytesPerSample;
+	UINT sampleCount;
+	UINT sampleQuality;
+	UINT width;
+	UINT height;
+};
+
+inline uint64_t RenderTargetBytes(const RenderTargetDesc &desc)
+{
+	return (uint64_t)desc.width * desc.height * desc.bytesPerSample * (desc.sampleCount > 0 ? desc.sampleCount : 1);
+}
+
+struct RenderTargetPoolStats
+{
+	uint64_t acquires;
+	uint64_t reuses;			//Acquires the pool had something for, no allocation
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t shrinks;			//Oversized targets reallocated smaller once the hysteresis ran out
+	uint64_t bytesHeld;			//Everything allocated, in use or waiting in the pool
+	uint64_t bytesInUse;		//Allocated size of what is handed out
+	uint64_t bytesUsed;			//What is handed out actually needs, the rest is bucket rounding and hysteresis
+	uint32_t targets;
+	uint32_t targetsInUse;
+};
+
+
+//What the pool allocates with, the device implements it
+class IRenderTargetAllocator
+{
+public:
+	virtual ~IRenderTargetAllocator() { }
+
+	virtual HRESULT CreateTarget(const RenderTargetDesc &desc, void *&resource) = 0;
+	virtual void	ReleaseTarget(const RenderTargetDesc &desc, void *resource) = 0;
+};
+
+
+//Render targets and depth buffers by usage, format, sample count and size bucket. Acquire hands back
+//anything at least as big as asked for, so resizing inside a bucket (or shrinking) keeps the allocation and
+//only the viewport changes. A target that stays bigger than its bucket for longer than the hysteresis is
+//due for shrinking (ShouldShrink, Release then frees it), and pooled targets nobody acquired for that long
+//are freed at EndFrame.
+//
+//Only hands out the resources, views on them are up to the device. Same threading as the device.
+
+class RenderTargetPool
+{
+public:
+	RenderTargetPool(IRenderTargetAllocator &targetAllocator, uint32_t hysteresisFrames = RENDERPOOL_DEFAULT_HYSTERESIS_FRAMES);
+	~RenderTargetPool();
+
+	inline void SetHysteresisFrames(uint32_t frames) { hysteresisFrames = frames; };
+	inline uint32_t HysteresisFrames() const { return hysteresisFrames; };
+
+	//desc.width/height are what is needed, the resource may be bigger
+	HRESULT Acquire(const RenderTargetDesc &desc, void *&resource);
+	void	Release(void *resource);
+
+	//Devices call this from Present. True if a target in use is due for shrinking.
+	bool	EndFrame();
+	bool	ShouldShrink(const void *resource) const;
+
+	//Free everything, whether in use or not (device release)
+	void	Clear();
+
+	inline const RenderTargetPoolStats& Stats() const { return stats; };
+	void	ResetStats();
+
+private:
+
+	struct Target
+	{
+		RenderTargetDesc desc;		//Bucketed size, what was allocated
+		void	*resource;
+		bool	 bInUse;
+		UINT	 usedWidth;
+		UINT	 usedHeight;
+		uint64_t sizedFrame;		//Last frame it was used at its own bucket size
+		uint64_t releasedFrame;
+	};
+
+	RenderTargetPool(const RenderTargetPool&);
+	RenderTargetPool& operator=(const RenderTargetPool&);
+
+	static UINT BucketSize(UINT size);
+	bool IsOversized(const Target &target) const;
+	bool IsShrinkDue(const Target &target) const;
+	void Free(size_t index);
+	void UpdateBytes();
+
+	IRenderTargetAllocator &allocator;
+	uint32_t hysteresisFrames;
+	uint64_t frame;
+
+	std::vector<Target> targets;
+	RenderTargetPoolStats stats;
+};
@@ -0,0 +1,1106 @@
+#include "stdafx.h"
+
+#include "SceneBvh.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Centroid bins per axis for the SAH split
+static const int BVH_BINS = 16;
+
+//Enough for a tree BVH_MAX_DEPTH deep, 3 siblings left behind per level
+static const uint32_t BVH_STACK_SIZE = BVH_MAX_DEPTH * (BVH_WIDTH - 1) + BVH_WIDTH;
+
+
+static inline void EmptyBounds(Float3 &min, Float3 &max)
+{
+	min.x = min.y = min.z = FLT_MAX;
+	max.x = max.y = max.z = -FLT_MAX;
+}
+
+//Plain compares rather than fminf/fmaxf, which don't always inline and are most of a build otherwise
+static inline void GrowBounds(Float3 &min, Float3 &max, const Float3 &addMin, const Float3 &addMax)
+{
+	min.x = addMin.x < min.x ? addMin.x : min.x;
+	min.y = addMin.y < min.y ? addMin.y : min.y;
+	min.z = addMin.z < min.z ? addMin.z : min.z;
+	max.x = addMax.x > max.x ? addMax.x : max.x;
+	max.y = addMax.y > max.y ? addMax.y : max.y;
+	max.z = addMax.z > max.z ? addMax.z : max.z;
+}
+
+static inline float SurfaceArea(const Float3 &min, const Float3 &max)
+{
+	float dx = max.x - min.x, dy = max.y - min.y, dz = max.z - min.z;
+	if (dx < 0.0f || dy < 0.0f || dz < 0.0f)
+		return 0.0f;
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static inline float Axis(const Float3 &v, int axis)
+{
+	return (&v.x)[axis];
+}
+
+static inline bool BoxesOverlap(const Float3 &aMin, const Float3 &aMax, const Float3 &bMin, const Float3 &bMax)
+{
+	return aMin.x <= bMax.x && aMax.x >= bMin.x && aMin.y <= bMax.y && aMax.y >= bMin.y && aMin.z <= bMax.z && aMax.z >= bMin.z;
+}
+
+static inline float BoxDistanceSq(const Float3 &min, const Float3 &max, const Float3 &p)
+{
+	float dx = fmaxf(fmaxf(min.x - p.x, p.x - max.x), 0.0f);
+	float dy = fmaxf(fmaxf(min.y - p.y, p.y - max.y), 0.0f);
+	float dz = fmaxf(fmaxf(min.z - p.z, p.z - max.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+//Zero direction components would make 0 * inf = NaN in the slab test, nudge them off zero instead
+static inline float SafeInverse(float d)
+{
+	if (fabsf(d) < 1e-30f)
+		d = d < 0.0f ? -1e-30f : 1e-30f;
+	return 1.0f / d;
+}
+
+
+SceneBvh::SceneBvh()
+	: liveCount(0), root(BVH_NONE), maxDepth(0), lastRefitNodes(0), lastRebuildObjects(0)
+{
+}
+
+void SceneBvh::Reserve(uint32_t count)
+{
+	objects.reserve(count);
+	nodes.reserve(count / 2 + 1);
+	leafObjects.reserve(count * 2);
+	buildItems.reserve(count);
+}
+
+void SceneBvh::Clear()
+{
+	objects.clear();
+	freeObjects.clear();
+	liveCount = 0;
+
+	nodes.clear();
+	freeNodes.clear();
+	root = BVH_NONE;
+	maxDepth = 0;
+
+	leafObjects.clear();
+	freeLeafBlocks.clear();
+
+	pendingList.clear();
+	movedList.clear();
+	dirtyList.clear();
+	rebuildList.clear();
+}
+
+
+BvhObjectId SceneBvh::Add(const Float3 &min, const Float3 &max)
+{
+	BvhObjectId id;
+	if (!freeObjects.empty())
+	{
+		id = freeObjects.back();
+		freeObjects.pop_back();
+	}
+	else
+	{
+		id = (BvhObjectId)objects.size();
+		objects.push_back(Object());
+	}
+
+	Object &object = objects[id];
+	object.min = min;
+	object.max = max;
+	object.node = BVH_NONE;
+	object.slot = 0;
+	object.leafPos = 0;
+	object.bLive = 1;
+	object.bPending = 1;
+	object.bMoved = 0;
+
+	pendingList.push_back(id);
+	++liveCount;
+	return id;
+}
+
+void SceneBvh::Remove(BvhObjectId id)
+{
+	if (id >= objects.size() || !objects[id].bLive)
+		return;
+
+	if (objects[id].node != BVH_NONE)
+		RemoveFromLeaf(id);
+
+	//Might still be in pendingList/movedList, they check bLive
+	objects[id].bLive = 0;
+	objects[id].bPending = 0;
+	objects[id].bMoved = 0;
+	freeObjects.push_back(id);
+	--liveCount;
+}
+
+void SceneBvh::SetBounds(BvhObjectId id, const Float3 &min, const Float3 &max)
+{
+	Object &object = objects[id];
+	object.min = min;
+	object.max = max;
+
+	if (object.node != BVH_NONE && !object.bMoved)
+	{
+		object.bMoved = 1;
+		movedList.push_back(id);
+	}
+}
+
+void SceneBvh::GetBounds(BvhObjectId id, Float3 &min, Float3 &max) const
+{
+	min = objects[id].min;
+	max = objects[id].max;
+}
+
+void SceneBvh::RemoveFromLeaf(BvhObjectId id)
+{
+	Object &object = objects[id];
+	uint32_t nodeIndex = object.node;
+	Node &node = nodes[nodeIndex];
+	uint32_t block = node.child[object.slot] & ~BVH_LEAF_BIT;
+	uint32_t *leaf = &leafObjects[block * BVH_LEAF_OBJECTS];
+
+	uint32_t last = node.leafCount[object.slot] - 1u;
+	if (object.leafPos != last)
+	{
+		leaf[object.leafPos] = leaf[last];
+		objects[leaf[last]].leafPos = object.leafPos;
+	}
+
+	if (--node.leafCount[object.slot] == 0)
+	{
+		freeLeafBlocks.push_back(block);
+		SetEmpty(node, object.slot);
+	}
+
+	object.node = BVH_NONE;
+	MarkDirty(nodeIndex);
+}
+
+
+uint32_t SceneBvh::AllocNode(uint32_t parent, uint32_t parentSlot, uint32_t depth)
+{
+	uint32_t index;
+	if (!freeNodes.empty())
+	{
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node &node = nodes[index];
+	for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		SetEmpty(node, slot);
+	node.parent = parent;
+	node.parentSlot = (uint8_t)parentSlot;
+	node.bDirty = 0;
+	node.bRebuild = 0;
+	node.bFree = 0;
+	node.depth = depth;
+	node.buildArea = 0.0f;
+
+	if (depth > maxDepth)
+		maxDepth = depth;
+	return index;
+}
+
+void SceneBvh::FreeSubtree(uint32_t index)
+{
+	for (int slot = 0; slot < BVH_WIDTH; ++slot)
+	{
+		uint32_t child = nodes[index].child[slot];
+		if (child == BVH_EMPTY_CHILD)
+			continue;
+
+		if (child & BVH_LEAF_BIT)
+			freeLeafBlocks.push_back(child & ~BVH_LEAF_BIT);
+		else
+			FreeSubtree(child);
+	}
+
+	Node &node = nodes[index];
+	node.bFree = 1;
+	node.bDirty = 0;
+	node.bRebuild = 0;
+	freeNodes.push_back(index);
+}
+
+uint32_t SceneBvh::AllocLeafBlock()
+{
+	if (!freeLeafBlocks.empty())
+	{
+		uint32_t block = freeLeafBlocks.back();
+		freeLeafBlocks.pop_back();
+		return block;
+	}
+
+	uint32_t block = (uint32_t)(leafObjects.size() / BVH_LEAF_OBJECTS);
+	leafObjects.resize(leafObjects.size() + BVH_LEAF_OBJECTS);
+	return block;
+}
+
+
+void SceneBvh::SetEmpty(Node &node, int slot)
+{
+	Float3 min, max;
+	EmptyBounds(min, max);
+	SetSlotBounds(node, slot, min, max);
+	node.child[slot] = BVH_EMPTY_CHILD;
+	node.leafCount[slot] = 0;
+}
+
+void SceneBvh::SetSlotBounds(Node &node, int slot, const Float3 &min, const Float3 &max)
+{
+	node.minX[slot] = min.x;
+	node.minY[slot] = min.y;
+	node.minZ[slot] = min.z;
+	node.maxX[slot] = max.x;
+	node.maxY[slot] = max.y;
+	node.maxZ[slot] = max.z;
+}
+
+void SceneBvh::SlotBounds(const Node &node, int slot, Float3 &min, Float3 &max) const
+{
+	min.x = node.minX[slot];
+	min.y = node.minY[slot];
+	min.z = node.minZ[slot];
+	max.x = node.maxX[slot];
+	max.y = node.maxY[slot];
+	max.z = node.maxZ[slot];
+}
+
+void SceneBvh::ComputeChildBounds(uint32_t ref, uint32_t count, Float3 &min, Float3 &max) const
+{
+	EmptyBounds(min, max);
+	if (ref == BVH_EMPTY_CHILD)
+		return;
+
+	if (ref & BVH_LEAF_BIT)
+	{
+		const uint32_t *leaf = &leafObjects[(ref & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+		for (uint32_t i = 0; i < count; ++i)
+			GrowBounds(min, max, objects[leaf[i]].min, objects[leaf[i]].max);
+		return;
+	}
+
+	const Node &node = nodes[ref];
+	for (int slot = 0; slot < BVH_WIDTH; ++slot)
+	{
+		Float3 slotMin, slotMax;
+		SlotBounds(node, slot, slotMin, slotMax);
+		GrowBounds(min, max, slotMin, slotMax);
+	}
+}
+
+float SceneBvh::NodeArea(const Node &node) const
+{
+	Float3 min, max;
+	EmptyBounds(min, max);
+	for (int slot = 0; slot < BVH_WIDTH; ++slot)
+	{
+		Float3 slotMin, slotMax;
+		SlotBounds(node, slot, slotMin, slotMax);
+		GrowBounds(min, max, slotMin, slotMax);
+	}
+	return SurfaceArea(min, max);
+}
+
+
+void SceneBvh::Build()
+{
+	PROFILE_FUNCTION();
+
+	nodes.clear();
+	freeNodes.clear();
+	leafObjects.clear();
+	freeLeafBlocks.clear();
+	pendingList.clear();
+	movedList.clear();
+	dirtyList.clear();
+	rebuildList.clear();
+	root = BVH_NONE;
+	maxDepth = 0;
+
+	buildItems.clear();
+	for (uint32_t id = 0; id < (uint32_t)objects.size(); ++id)
+	{
+		Object &object = objects[id];
+		object.node = BVH_NONE;
+		object.bPending = 0;
+		object.bMoved = 0;
+		if (object.bLive)
+			AddBuildItem(id);
+	}
+
+	lastRebuildObjects = (uint32_t)buildItems.size();
+	if (buildItems.empty())
+		return;
+
+	root = AllocNode(BVH_NONE, 0, 0);
+	BuildNode(root, 0, (uint32_t)buildItems.size());
+	nodes[root].buildArea = NodeArea(nodes[root]);
+}
+
+void SceneBvh::AddBuildItem(uint32_t id)
+{
+	BuildItem item;
+	item.min = objects[id].min;
+	item.max = objects[id].max;
+	item.id = id;
+	buildItems.push_back(item);
+}
+
+void SceneBvh::BuildNode(uint32_t node, uint32_t begin, uint32_t end)
+{
+	//Keep splitting the biggest range that is too big for a leaf until there are 4. Past half the depth
+	//limit splits go down the middle, so even bad data can't make the tree too deep.
+	bool bMedian = nodes[node].depth > BVH_MAX_DEPTH / 2;
+
+	BuildRange ranges[BVH_WIDTH];
+	int rangeCount = 1;
+	ranges[0].begin = begin;
+	ranges[0].end = end;
+	ranges[0].area = FLT_MAX;
+
+	while (rangeCount < BVH_WIDTH)
+	{
+		int split = -1;
+		for (int r = 0; r < rangeCount; ++r)
+			if (ranges[r].end - ranges[r].begin > BVH_LEAF_OBJECTS && (split < 0 || ranges[r].area > ranges[split].area))
+				split = r;
+
+		if (split < 0)
+			break;
+
+		float leftArea, rightArea;
+		uint32_t mid = SplitRange(ranges[split].begin, ranges[split].end, bMedian, leftArea, rightArea);
+
+		BuildRange right = { mid, ranges[split].end, rightArea };
+		ranges[split].end = mid;
+		ranges[split].area = leftArea;
+		ranges[rangeCount++] = right;
+	}
+
+	for (int r = 0; r < rangeCount; ++r)
+		BuildSlot(node, r, ranges[r].begin, ranges[r].end);
+}
+
+void SceneBvh::BuildSlot(uint32_t node, int slot, uint32_t begin, uint32_t end)
+{
+	uint32_t count = end - begin;
+	Float3 min, max;
+
+	if (count <= BVH_LEAF_OBJECTS)
+	{
+		uint32_t block = AllocLeafBlock();
+		EmptyBounds(min, max);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const BuildItem &item = buildItems[begin + i];
+			leafObjects[block * BVH_LEAF_OBJECTS + i] = item.id;
+
+			Object &object = objects[item.id];
+			object.node = node;
+			object.slot = (uint8_t)slot;
+			object.leafPos = (uint8_t)i;
+			GrowBounds(min, max, item.min, item.max);
+		}
+
+		nodes[node].child[slot] = BVH_LEAF_BIT | block;
+		nodes[node].leafCount[slot] = (uint8_t)count;
+		SetSlotBounds(nodes[node], slot, min, max);
+		return;
+	}
+
+	uint32_t child = AllocNode(node, slot, nodes[node].depth + 1);
+	nodes[node].child[slot] = child;
+	nodes[node].leafCount[slot] = 0;
+
+	BuildNode(child, begin, end);
+	nodes[child].buildArea = NodeArea(nodes[child]);
+
+	ComputeChildBounds(child, 0, min, max);
+	SetSlotBounds(nodes[node], slot, min, max);
+}
+
+//Centers are left doubled (min + max), that doesn't change where anything splits
+static inline float Center(const Float3 &min, const Float3 &max, int axis)
+{
+	return Axis(min, axis) + Axis(max, axis);
+}
+
+uint32_t SceneBvh::SplitRange(uint32_t begin, uint32_t end, bool bMedian, float &leftArea, float &rightArea)
+{
+	BuildItem *items = &buildItems[0];
+
+	Float3 centerMin, centerMax;
+	EmptyBounds(centerMin, centerMax);
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		Float3 center = { items[i].min.x + items[i].max.x, items[i].min.y + items[i].max.y, items[i].min.z + items[i].max.z };
+		GrowBounds(centerMin, centerMax, center, center);
+	}
+
+	int bestAxis = -1, bestBin = 0;
+	float bestCost = FLT_MAX;
+
+	for (int axis = 0; axis < 3 && !bMedian; ++axis)
+	{
+		float lo = Axis(centerMin, axis), extent = Axis(centerMax, axis) - lo;
+		if (extent <= 0.0f)
+			continue;
+
+		uint32_t binCount[BVH_BINS] = { 0 };
+		Float3 binMin[BVH_BINS], binMax[BVH_BINS];
+		for (int b = 0; b < BVH_BINS; ++b)
+			EmptyBounds(binMin[b], binMax[b]);
+
+		float scale = (float)BVH_BINS * 0.9999f / extent;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			int b = (int)((Center(items[i].min, items[i].max, axis) - lo) * scale);
+			++binCount[b];
+			GrowBounds(binMin[b], binMax[b], items[i].min, items[i].max);
+		}
+
+		//Cost of splitting after each bin: count * area on both sides
+		float rightCost[BVH_BINS], rightBinArea[BVH_BINS];
+		Float3 min, max;
+		EmptyBounds(min, max);
+		uint32_t count = 0;
+		for (int b = BVH_BINS - 1; b > 0; --b)
+		{
+			GrowBounds(min, max, binMin[b], binMax[b]);
+			count += binCount[b];
+			rightBinArea[b] = SurfaceArea(min, max);
+			rightCost[b] = (float)count * rightBinArea[b];
+		}
+
+		EmptyBounds(min, max);
+		count = 0;
+		for (int b = 0; b < BVH_BINS - 1; ++b)
+		{
+			GrowBounds(min, max, binMin[b], binMax[b]);
+			count += binCount[b];
+			float area = SurfaceArea(min, max);
+			float cost = (float)count * area + rightCost[b + 1];
+			if (count > 0 && count < end - begin && cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+				leftArea = area;
+				rightArea = rightBinArea[b + 1];
+			}
+		}
+	}
+
+	if (bestAxis >= 0)
+	{
+		float lo = Axis(centerMin, bestAxis);
+		float scale = (float)BVH_BINS * 0.9999f / (Axis(centerMax, bestAxis) - lo);
+		BuildItem *mid = std::partition(items + begin, items + end,
+			[bestAxis, bestBin, lo, scale](const BuildItem &item) { return (int)((Center(item.min, item.max, bestAxis) - lo) * scale) <= bestBin; });
+
+		return (uint32_t)(mid - items);
+	}
+
+	//All the centers in one spot (or out of depth): any split is as good as any other, halve it along the
+	//longest axis
+	int axis = 0;
+	for (int a = 1; a < 3; ++a)
+		if (Axis(centerMax, a) - Axis(centerMin, a) > Axis(centerMax, axis) - Axis(centerMin, axis))
+			axis = a;
+
+	uint32_t mid = begin + (end - begin) / 2;
+	std::nth_element(items + begin, items + mid, items + end,
+		[axis](const BuildItem &a, const BuildItem &b) { return Center(a.min, a.max, axis) < Center(b.min, b.max, axis); });
+
+	Float3 min, max;
+	EmptyBounds(min, max);
+	for (uint32_t i = begin; i < mid; ++i)
+		GrowBounds(min, max, items[i].min, items[i].max);
+	leftArea = SurfaceArea(min, max);
+
+	EmptyBounds(min, max);
+	for (uint32_t i = mid; i < end; ++i)
+		GrowBounds(min, max, items[i].min, items[i].max);
+	rightArea = SurfaceArea(min, max);
+
+	return mid;
+}
+
+
+void SceneBvh::Insert(BvhObjectId id)
+{
+	Object &object = objects[id];
+
+	if (root == BVH_NONE)
+	{
+		root = AllocNode(BVH_NONE, 0, 0);
+		nodes[root].buildArea = SurfaceArea(object.min, object.max);
+	}
+
+	uint32_t index = root;
+	for (;;)
+	{
+		Node &node = nodes[index];
+
+		//A free slot takes it as a new leaf, otherwise down the child it grows least
+		int slot = -1;
+		float bestGrowth = FLT_MAX, bestArea = FLT_MAX;
+		for (int s = 0; s < BVH_WIDTH; ++s)
+		{
+			if (node.child[s] == BVH_EMPTY_CHILD)
+			{
+				slot = s;
+				break;
+			}
+
+			Float3 min, max;
+			SlotBounds(node, s, min, max);
+			float area = SurfaceArea(min, max);
+			GrowBounds(min, max, object.min, object.max);
+			float growth = SurfaceArea(min, max) - area;
+			if (growth < bestGrowth || (growth == bestGrowth && area < bestArea))
+			{
+				slot = s;
+				bestGrowth = growth;
+				bestArea = area;
+			}
+		}
+
+		Float3 min, max;
+		SlotBounds(node, slot, min, max);
+		GrowBounds(min, max, object.min, object.max);
+		SetSlotBounds(node, slot, min, max);
+
+		uint32_t child = node.child[slot];
+		if (child != BVH_EMPTY_CHILD && !(child & BVH_LEAF_BIT))
+		{
+			index = child;
+			continue;
+		}
+
+		if (child == BVH_EMPTY_CHILD || node.leafCount[slot] < BVH_LEAF_OBJECTS)
+		{
+			if (child == BVH_EMPTY_CHILD)
+			{
+				child = BVH_LEAF_BIT | AllocLeafBlock();
+				nodes[index].child[slot] = child;
+				nodes[index].leafCount[slot] = 0;
+			}
+
+			uint32_t pos = nodes[index].leafCount[slot]++;
+			leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS + pos] = id;
+			object.node = index;
+			object.slot = (uint8_t)slot;
+			object.leafPos = (uint8_t)pos;
+			MarkDirty(index);
+			return;
+		}
+
+		//Full leaf: a new node in its place, holding the old leaf and a new one for this object
+		uint32_t split = AllocNode(index, slot, nodes[index].depth + 1);
+		Node &parent = nodes[index];
+		Node &splitNode = nodes[split];
+
+		splitNode.child[0] = child;
+		splitNode.leafCount[0] = parent.leafCount[slot];
+		Float3 leafMin, leafMax;
+		ComputeChildBounds(child, splitNode.leafCount[0], leafMin, leafMax);
+		SetSlotBounds(splitNode, 0, leafMin, leafMax);
+
+		const uint32_t *leaf = &leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+		for (uint32_t i = 0; i < splitNode.leafCount[0]; ++i)
+		{
+			objects[leaf[i]].node = split;
+			objects[leaf[i]].slot = 0;
+		}
+
+		uint32_t block = AllocLeafBlock();
+		leafObjects[block * BVH_LEAF_OBJECTS] = id;
+		splitNode.child[1] = BVH_LEAF_BIT | block;
+		splitNode.leafCount[1] = 1;
+		SetSlotBounds(splitNode, 1, object.min, object.max);
+		object.node = split;
+		object.slot = 1;
+		object.leafPos = 0;
+
+		parent.child[slot] = split;
+		parent.leafCount[slot] = 0;
+
+		splitNode.buildArea = NodeArea(splitNode);
+		MarkDirty(split);
+		return;
+	}
+}
+
+void SceneBvh::MarkDirty(uint32_t index)
+{
+	while (index != BVH_NONE && !nodes[index].bDirty)
+	{
+		nodes[index].bDirty = 1;
+		dirtyList.push_back(index);
+		index = nodes[index].parent;
+	}
+}
+
+void SceneBvh::Refit()
+{
+	//Deepest first, so every node's children are done before it. Only a few dozen depths, so a counting
+	//sort into refitOrder (anything past BVH_MAX_DEPTH gets lumped together, Update builds over those anyway).
+	uint32_t depthStart[BVH_MAX_DEPTH + 2] = { 0 };
+	for (size_t i = 0; i < dirtyList.size(); ++i)
+		++depthStart[BVH_MAX_DEPTH + 1 - std::min(nodes[dirtyList[i]].depth, BVH_MAX_DEPTH + 1)];
+
+	uint32_t offset = 0;
+	for (uint32_t d = 0; d < BVH_MAX_DEPTH + 2; ++d)
+	{
+		uint32_t count = depthStart[d];
+		depthStart[d] = offset;
+		offset += count;
+	}
+
+	refitOrder.resize(dirtyList.size());
+	for (size_t i = 0; i < dirtyList.size(); ++i)
+		refitOrder[depthStart[BVH_MAX_DEPTH + 1 - std::min(nodes[dirtyList[i]].depth, BVH_MAX_DEPTH + 1)]++] = dirtyList[i];
+
+	for (size_t i = 0; i < refitOrder.size(); ++i)
+	{
+		Node &node = nodes[refitOrder[i]];
+		if (node.bFree)
+			continue;
+
+		for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		{
+			if (node.child[slot] == BVH_EMPTY_CHILD)
+				continue;
+
+			Float3 min, max;
+			ComputeChildBounds(node.child[slot], node.leafCount[slot], min, max);
+			SetSlotBounds(node, slot, min, max);
+		}
+
+		node.bDirty = 0;
+		if (!node.bRebuild && NodeArea(node) > node.buildArea * BVH_REBUILD_GROWTH)
+		{
+			node.bRebuild = 1;
+			rebuildList.push_back(refitOrder[i]);
+		}
+	}
+
+	lastRefitNodes = (uint32_t)dirtyList.size();
+	dirtyList.clear();
+}
+
+void SceneBvh::CollectObjects(uint32_t ref, uint32_t count, std::vector<uint32_t> &out) const
+{
+	if (ref == BVH_EMPTY_CHILD)
+		return;
+
+	if (ref & BVH_LEAF_BIT)
+	{
+		const uint32_t *leaf = &leafObjects[(ref & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+		out.insert(out.end(), leaf, leaf + count);
+		return;
+	}
+
+	const Node &node = nodes[ref];
+	for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		CollectObjects(node.child[slot], node.leafCount[slot], out);
+}
+
+void SceneBvh::RebuildSubtree(uint32_t index)
+{
+	uint32_t parent = nodes[index].parent;
+	uint32_t slot = nodes[index].parentSlot;
+
+	FreeSubtree(index);
+
+	buildItems.clear();
+	for (size_t i = 0; i < collectIds.size(); ++i)
+		AddBuildItem(collectIds[i]);
+
+	BuildSlot(parent, slot, 0, (uint32_t)buildItems.size());
+	lastRebuildObjects += (uint32_t)buildItems.size();
+}
+
+void SceneBvh::Update()
+{
+	PROFILE_FUNCTION();
+
+	lastRefitNodes = 0;
+	lastRebuildObjects = 0;
+
+	//Lots of new objects (or nothing built yet) are better off with a fresh tree than inserted one by one
+	uint32_t pendingCount = 0;
+	for (size_t i = 0; i < pendingList.size(); ++i)
+		pendingCount += objects[pendingList[i]].bPending;
+
+	if (pendingCount > 0 && (root == BVH_NONE || pendingCount > liveCount / 4))
+	{
+		Build();
+		return;
+	}
+
+	for (size_t i = 0; i < pendingList.size(); ++i)
+	{
+		Object &object = objects[pendingList[i]];
+		if (!object.bPending)
+			continue;
+
+		object.bPending = 0;
+		Insert(pendingList[i]);
+	}
+	pendingList.clear();
+
+	for (size_t i = 0; i < movedList.size(); ++i)
+	{
+		Object &object = objects[movedList[i]];
+		if (!object.bMoved)
+			continue;
+
+		object.bMoved = 0;
+		if (object.node != BVH_NONE)
+			MarkDirty(object.node);
+	}
+	movedList.clear();
+
+	Refit();
+
+	//Subtrees that got too loose, top ones first (a rebuild takes everything under it along)
+	if (!rebuildList.empty())
+	{
+		const std::vector<Node> &nodeList = nodes;
+		std::sort(rebuildList.begin(), rebuildList.end(), [&nodeList](uint32_t a, uint32_t b) { return nodeList[a].depth < nodeList[b].depth; });
+
+		std::vector<uint32_t> later;
+		for (size_t i = 0; i < rebuildList.size(); ++i)
+		{
+			uint32_t index = rebuildList[i];
+			if (nodes[index].bFree || !nodes[index].bRebuild)
+				continue;
+
+			if (index == root)
+			{
+				Build();
+				return;
+			}
+
+			collectIds.clear();
+			CollectObjects(index, 0, collectIds);
+			if (lastRebuildObjects > 0 && lastRebuildObjects + collectIds.size() > BVH_REBUILD_BUDGET)
+			{
+				later.push_back(index);
+				continue;
+			}
+
+			RebuildSubtree(index);
+		}
+
+		rebuildList.swap(later);
+	}
+
+	if (maxDepth > BVH_MAX_DEPTH)
+		Build();
+}
+
+
+uint32_t SceneBvh::QueryFrustum(const Frustum &frustum, std::vector<BvhObjectId> &out) const
+{
+	if (root == BVH_NONE)
+		return 0;
+
+	size_t start = out.size();
+
+	//Per plane the box corner furthest along the normal (decides outside) and the one furthest against it
+	//(decides all inside)
+	SimdF4 nx[FRUSTUM_PLANE_COUNT], ny[FRUSTUM_PLANE_COUNT], nz[FRUSTUM_PLANE_COUNT], nd[FRUSTUM_PLANE_COUNT];
+	bool bPosX[FRUSTUM_PLANE_COUNT], bPosY[FRUSTUM_PLANE_COUNT], bPosZ[FRUSTUM_PLANE_COUNT];
+	for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+	{
+		const Float4 &plane = frustum.planes[p];
+		nx[p] = F4Splat(plane.x);
+		ny[p] = F4Splat(plane.y);
+		nz[p] = F4Splat(plane.z);
+		nd[p] = F4Splat(plane.w);
+		bPosX[p] = plane.x >= 0.0f;
+		bPosY[p] = plane.y >= 0.0f;
+		bPosZ[p] = plane.z >= 0.0f;
+	}
+
+	SimdF4 zero = F4Zero();
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = root;
+
+	while (stackSize > 0)
+	{
+		const Node &node = nodes[stack[--stackSize]];
+
+		SimdF4 outside = zero, crossing = zero;
+		for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p)
+		{
+			SimdF4 farX = F4Load(bPosX[p] ? node.maxX : node.minX), nearX = F4Load(bPosX[p] ? node.minX : node.maxX);
+			SimdF4 farY = F4Load(bPosY[p] ? node.maxY : node.minY), nearY = F4Load(bPosY[p] ? node.minY : node.maxY);
+			SimdF4 farZ = F4Load(bPosZ[p] ? node.maxZ : node.minZ), nearZ = F4Load(bPosZ[p] ? node.minZ : node.maxZ);
+
+			SimdF4 farDistance = F4MulAdd(farX, nx[p], F4MulAdd(farY, ny[p], F4MulAdd(farZ, nz[p], nd[p])));
+			SimdF4 nearDistance = F4MulAdd(nearX, nx[p], F4MulAdd(nearY, ny[p], F4MulAdd(nearZ, nz[p], nd[p])));
+			outside = F4Or(outside, F4CmpLt(farDistance, zero));
+			crossing = F4Or(crossing, F4CmpLt(nearDistance, zero));
+		}
+
+		int visibleMask = ~F4MoveMask(outside) & 0xF;
+		int crossingMask = F4MoveMask(crossing);
+
+		for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		{
+			uint32_t child = node.child[slot];
+			if (!(visibleMask & (1 << slot)) || child == BVH_EMPTY_CHILD)
+				continue;
+
+			if (!(crossingMask & (1 << slot)))
+			{
+				CollectObjects(child, node.leafCount[slot], out);
+			}
+			else if (child & BVH_LEAF_BIT)
+			{
+				const uint32_t *leaf = &leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+				for (uint32_t i = 0; i < node.leafCount[slot]; ++i)
+				{
+					const Object &object = objects[leaf[i]];
+					Float3 center = { (object.min.x + object.max.x) * 0.5f, (object.min.y + object.max.y) * 0.5f, (object.min.z + object.max.z) * 0.5f };
+					Float3 extents = { (object.max.x - object.min.x) * 0.5f, (object.max.y - object.min.y) * 0.5f, (object.max.z - object.min.z) * 0.5f };
+					if (FrustumTestBox(frustum, center, extents))
+						out.push_back(leaf[i]);
+				}
+			}
+			else
+			{
+				stack[stackSize++] = child;
+			}
+		}
+	}
+
+	return (uint32_t)(out.size() - start);
+}
+
+uint32_t SceneBvh::QueryBox(const Float3 &min, const Float3 &max, std::vector<BvhObjectId> &out) const
+{
+	if (root == BVH_NONE)
+		return 0;
+
+	size_t start = out.size();
+
+	SimdF4 qMinX = F4Splat(min.x), qMinY = F4Splat(min.y), qMinZ = F4Splat(min.z);
+	SimdF4 qMaxX = F4Splat(max.x), qMaxY = F4Splat(max.y), qMaxZ = F4Splat(max.z);
+
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = root;
+
+	while (stackSize > 0)
+	{
+		const Node &node = nodes[stack[--stackSize]];
+
+		SimdF4 apart = F4Or(F4Or(F4CmpLt(qMaxX, F4Load(node.minX)), F4CmpLt(F4Load(node.maxX), qMinX)),
+			F4Or(F4Or(F4CmpLt(qMaxY, F4Load(node.minY)), F4CmpLt(F4Load(node.maxY), qMinY)),
+			F4Or(F4CmpLt(qMaxZ, F4Load(node.minZ)), F4CmpLt(F4Load(node.maxZ), qMinZ))));
+		int hitMask = ~F4MoveMask(apart) & 0xF;
+
+		for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		{
+			uint32_t child = node.child[slot];
+			if (!(hitMask & (1 << slot)) || child == BVH_EMPTY_CHILD)
+				continue;
+
+			if (child & BVH_LEAF_BIT)
+			{
+				const uint32_t *leaf = &leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+				for (uint32_t i = 0; i < node.leafCount[slot]; ++i)
+					if (BoxesOverlap(objects[leaf[i]].min, objects[leaf[i]].max, min, max))
+						out.push_back(leaf[i]);
+			}
+			else
+			{
+				stack[stackSize++] = child;
+			}
+		}
+	}
+
+	return (uint32_t)(out.size() - start);
+}
+
+uint32_t SceneBvh::QuerySphere(const Float3 &center, float radius, std::vector<BvhObjectId> &out) const
+{
+	if (root == BVH_NONE)
+		return 0;
+
+	size_t start = out.size();
+
+	SimdF4 cx = F4Splat(center.x), cy = F4Splat(center.y), cz = F4Splat(center.z);
+	SimdF4 radiusSq = F4Splat(radius * radius);
+	SimdF4 zero = F4Zero();
+	float scalarRadiusSq = radius * radius;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = root;
+
+	while (stackSize > 0)
+	{
+		const Node &node = nodes[stack[--stackSize]];
+
+		//Distance from the center to each box, 0 inside
+		SimdF4 dx = F4Max(F4Max(F4Sub(F4Load(node.minX), cx), F4Sub(cx, F4Load(node.maxX))), zero);
+		SimdF4 dy = F4Max(F4Max(F4Sub(F4Load(node.minY), cy), F4Sub(cy, F4Load(node.maxY))), zero);
+		SimdF4 dz = F4Max(F4Max(F4Sub(F4Load(node.minZ), cz), F4Sub(cz, F4Load(node.maxZ))), zero);
+		SimdF4 distanceSq = F4MulAdd(dx, dx, F4MulAdd(dy, dy, F4Mul(dz, dz)));
+		int hitMask = F4MoveMask(F4CmpLe(distanceSq, radiusSq));
+
+		for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		{
+			uint32_t child = node.child[slot];
+			if (!(hitMask & (1 << slot)) || child == BVH_EMPTY_CHILD)
+				continue;
+
+			if (child & BVH_LEAF_BIT)
+			{
+				const uint32_t *leaf = &leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+				for (uint32_t i = 0; i < node.leafCount[slot]; ++i)
+					if (BoxDistanceSq(objects[leaf[i]].min, objects[leaf[i]].max, center) <= scalarRadiusSq)
+						out.push_back(leaf[i]);
+			}
+			else
+			{
+				stack[stackSize++] = child;
+			}
+		}
+	}
+
+	return (uint32_t)(out.size() - start);
+}
+
+bool SceneBvh::Raycast(const Float3 &origin, const Float3 &direction, float maxDistance, BvhRayHit &hit) const
+{
+	hit.object = BVH_NONE;
+	hit.distance = maxDistance;
+	if (root == BVH_NONE)
+		return false;
+
+	float invX = SafeInverse(direction.x), invY = SafeInverse(direction.y), invZ = SafeInverse(direction.z);
+	SimdF4 ox = F4Splat(origin.x), oy = F4Splat(origin.y), oz = F4Splat(origin.z);
+	SimdF4 ix = F4Splat(invX), iy = F4Splat(invY), iz = F4Splat(invZ);
+	SimdF4 zero = F4Zero();
+
+	//Nodes with the distance the ray enters them, nearest on top
+	struct Entry
+	{
+		uint32_t node;
+		float	 distance;
+	};
+	Entry stack[BVH_STACK_SIZE];
+	uint32_t stackSize = 0;
+	stack[stackSize].node = root;
+	stack[stackSize++].distance = 0.0f;
+
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		if (entry.distance > hit.distance)
+			continue;
+
+		const Node &node = nodes[entry.node];
+
+		//Slabs: where the ray is between each pair of planes, overlapped
+		SimdF4 tx1 = F4Mul(F4Sub(F4Load(node.minX), ox), ix), tx2 = F4Mul(F4Sub(F4Load(node.maxX), ox), ix);
+		SimdF4 ty1 = F4Mul(F4Sub(F4Load(node.minY), oy), iy), ty2 = F4Mul(F4Sub(F4Load(node.maxY), oy), iy);
+		SimdF4 tz1 = F4Mul(F4Sub(F4Load(node.minZ), oz), iz), tz2 = F4Mul(F4Sub(F4Load(node.maxZ), oz), iz);
+		SimdF4 tNear = F4Max(F4Max(F4Min(tx1, tx2), F4Min(ty1, ty2)), F4Max(F4Min(tz1, tz2), zero));
+		SimdF4 tFar = F4Min(F4Min(F4Max(tx1, tx2), F4Max(ty1, ty2)), F4Min(F4Max(tz1, tz2), F4Splat(hit.distance)));
+		int hitMask = F4MoveMask(F4CmpLe(tNear, tFar));
+		if (!hitMask)
+			continue;
+
+		float nearDistance[BVH_WIDTH];
+		F4Store(nearDistance, tNear);
+
+		//Children to visit, furthest pushed first
+		Entry children[BVH_WIDTH];
+		int childCount = 0;
+		for (int slot = 0; slot < BVH_WIDTH; ++slot)
+		{
+			uint32_t child = node.child[slot];
+			if (!(hitMask & (1 << slot)) || child == BVH_EMPTY_CHILD)
+				continue;
+
+			if (child & BVH_LEAF_BIT)
+			{
+				const uint32_t *leaf = &leafObjects[(child & ~BVH_LEAF_BIT) * BVH_LEAF_OBJECTS];
+				for (uint32_t i = 0; i < node.leafCount[slot]; ++i)
+				{
+					const Object &object = objects[leaf[i]];
+					float x1 = (object.min.x - origin.x) * invX, x2 = (object.max.x - origin.x) * invX;
+					float y1 = (object.min.y - origin.y) * invY, y2 = (object.max.y - origin.y) * invY;
+					float z1 = (object.min.z - origin.z) * invZ, z2 = (object.max.z - origin.z) * invZ;
+					float enter = fmaxf(fmaxf(fminf(x1, x2), fminf(y1, y2)), fmaxf(fminf(z1, z2), 0.0f));
+					float leave = fminf(fminf(fmaxf(x1, x2), fmaxf(y1, y2)), fminf(fmaxf(z1, z2), hit.distance));
+					if (enter <= leave && (enter < hit.distance || hit.object == BVH_NONE))
+					{
+						hit.object = leaf[i];
+						hit.distance = enter;
+					}
+				}
+				continue;
+			}
+
+			Entry e = { child, nearDistance[slot] };
+			int at = childCount++;
+			while (at > 0 && children[at - 1].distance < e.distance)
+			{
+				children[at] = children[at - 1];
+				--at;
+			}
+			children[at] = e;
+		}
+
+		for (int c = 0; c < childCount; ++c)
+			stack[stackSize++] = children[c];
+	}
+
+	return hit.object != BVH_NONE;
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "FrustumCull.h"
+#include <stdint.h>
+#include <vector>
+
+
+typedef uint32_t BvhObjectId;
+const BvhObjectId BVH_NONE = 0xFFFFFFFF;
+
+const int	   BVH_WIDTH = 4;				//Children per node
+const uint32_t BVH_LEAF_OBJECTS = 4;		//Objects per leaf, at most
+
+//Update rebuilds a subtree once its bounds have grown to this many times their area when it was built...
+const float	   BVH_REBUILD_GROWTH = 2.0f;
+
+//...up to about this many objects worth of subtrees per Update (always at least one)
+const uint32_t BVH_REBUILD_BUDGET = 4096;
+
+//Deeper than this and Update rebuilds the whole thing, also what the query stacks are sized for
+const uint32_t BVH_MAX_DEPTH = 48;
+
+
+struct BvhRayHit
+{
+	BvhObjectId object;
+	float		distance;		//Along the ray, in direction lengths
+};
+
+
+//Bounding volume hierarchy over axis aligned boxes, for finding what's in view, under the mouse or near
+//something without looking at every object.
+//
+//Nodes have 4 children, their boxes stored as structure of arrays so a query tests all 4 with one SIMD
+//instruction per plane/slab. A child is another node, a leaf of up to BVH_LEAF_OBJECTS objects, or empty.
+//Build is a binned surface area heuristic build: it splits where the expected cost of a query is lowest.
+//
+//Objects that move (SetBounds) just get their leaf's box and the boxes above it refitted by the next
+//Update, which keeps the tree correct but lets it get worse as things wander off from where they were at
+//build time. Update keeps an eye on that and rebuilds the subtrees whose boxes have grown the most, a few
+//thousand objects worth at a time. New objects are inserted by Update where they grow the tree the least,
+//or all at once with a full Build when there are a lot of them.
+//
+//Adds and moves only show up in queries after the next Update, Remove right away. Queries are const and
+//any number of threads may run them at once, as long as nothing is changing the tree.
+
+class SceneBvh
+{
+public:
+	SceneBvh();
+
+	void Reserve(uint32_t count);
+	void Clear();
+
+	BvhObjectId Add(const Float3 &min, const Float3 &max);
+	void Remove(BvhObjectId id);
+	void SetBounds(BvhObjectId id, const Float3 &min, const Float3 &max);
+	void GetBounds(BvhObjectId id, Float3 &min, Float3 &max) const;
+
+	//Everything from scratch
+	void Build();
+
+	//Insert what was added, refit what moved, rebuild what got bad
+	void Update();
+
+	//Appended to out, no particular order. Returns how many.
+	uint32_t QueryFrustum(const Frustum &frustum, std::vector<BvhObjectId> &out) const;
+	uint32_t QueryBox(const Float3 &min, const Float3 &max, std::vector<BvhObjectId> &out) const;
+	uint32_t QuerySphere(const Float3 &center, float radius, std::vector<BvhObjectId> &out) const;
+
+	//Nearest object box the ray hits within maxDistance (in direction lengths), from the inside counts at 0
+	bool Raycast(const Float3 &origin, const Float3 &direction, float maxDistance, BvhRayHit &hit) const;
+
+	inline uint32_t Count() const { return liveCount; };
+	inline uint32_t NodeCount() const { return (uint32_t)nodes.size() - (uint32_t)freeNodes.size(); };
+	inline uint32_t Depth() const { return maxDepth; };
+
+	//Last Update's work
+	inline uint32_t LastRefitNodes() const { return lastRefitNodes; };
+	inline uint32_t LastRebuildObjects() const { return lastRebuildObjects; };
+
+private:
+
+	//Child slots: a node index, BVH_LEAF_BIT | a leaf block index, or BVH_EMPTY_CHILD
+	static const uint32_t BVH_LEAF_BIT = 0x80000000;
+	static const uint32_t BVH_EMPTY_CHILD = 0xFFFFFFFF;
+
+	//Empty slots have min > max, so nothing ever hits them
+	struct Node
+	{
+		float	 minX[BVH_WIDTH], minY[BVH_WIDTH], minZ[BVH_WIDTH];
+		float	 maxX[BVH_WIDTH], maxY[BVH_WIDTH], maxZ[BVH_WIDTH];
+		uint32_t child[BVH_WIDTH];
+		uint8_t	 leafCount[BVH_WIDTH];
+		uint32_t parent;
+		uint8_t	 parentSlot;
+		uint8_t	 bDirty;
+		uint8_t	 bRebuild;		//In rebuildList
+		uint8_t	 bFree;
+		uint32_t depth;
+		float	 buildArea;		//Surface area of all 4 children at build time
+	};
+
+	struct Object
+	{
+		Float3	 min;
+		Float3	 max;
+		uint32_t node;			//Holding its leaf, BVH_NONE if not in the tree (yet)
+		uint8_t	 slot;
+		uint8_t	 leafPos;		//In the leaf block
+		uint8_t	 bLive;
+		uint8_t	 bPending;		//In pendingList
+		uint8_t	 bMoved;		//In movedList
+	};
+
+	//What a build sorts: an object's box and id, packed so splitting walks memory in order
+	struct BuildItem
+	{
+		Float3	 min;
+		Float3	 max;
+		uint32_t id;
+	};
+
+	//Where a build puts things, [begin, end) of buildItems
+	struct BuildRange
+	{
+		uint32_t begin;
+		uint32_t end;
+		float	 area;
+	};
+
+	SceneBvh(const SceneBvh&);
+	SceneBvh& operator=(const SceneBvh&);
+
+	uint32_t AllocNode(uint32_t parent, uint32_t parentSlot, uint32_t depth);
+	void FreeSubtree(uint32_t node);
+	uint32_t AllocLeafBlock();
+
+	void SetEmpty(Node &node, int slot);
+	void SetSlotBounds(Node &node, int slot, const Float3 &min, const Float3 &max);
+	void SlotBounds(const Node &node, int slot, Float3 &min, Float3 &max) const;
+	void ComputeChildBounds(uint32_t ref, uint32_t count, Float3 &min, Float3 &max) const;
+	float NodeArea(const Node &node) const;
+
+	//Objects [begin, end) of buildItems into slot of node, as a leaf or a new subtree
+	void BuildSlot(uint32_t node, int slot, uint32_t begin, uint32_t end);
+	void BuildNode(uint32_t node, uint32_t begin, uint32_t end);
+	uint32_t SplitRange(uint32_t begin, uint32_t end, bool bMedian, float &leftArea, float &rightArea);
+	void AddBuildItem(uint32_t id);
+
+	void Insert(BvhObjectId id);
+	void RemoveFromLeaf(BvhObjectId id);
+	void MarkDirty(uint32_t node);
+	void Refit();
+	void RebuildSubtree(uint32_t node);		//Of the objects in collectIds, which must be all of its
+	void CollectObjects(uint32_t ref, uint32_t count, std::vector<uint32_t> &out) const;
+
+	std::vector<Object> objects;
+	std::vector<uint32_t> freeObjects;
+	uint32_t liveCount;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> freeNodes;
+	uint32_t root;
+	uint32_t maxDepth;
+
+	std::vector<uint32_t> leafObjects;		//BVH_LEAF_OBJECTS per block
+	std::vector<uint32_t> freeLeafBlocks;
+
+	std::vector<uint32_t> pendingList;		//Added since the last Update
+	std::vector<uint32_t> movedList;		//Set since the last Update
+	std::vector<uint32_t> dirtyList;		//Nodes to refit
+	std::vector<uint32_t> refitOrder;		//dirtyList, deepest first
+	std::vector<uint32_t> rebuildList;		//Nodes whose boxes grew too much
+
+	uint32_t lastRefitNodes;
+	uint32_t lastRebuildObjects;
+
+	//Build scratch
+	std::vector<uint32_t> collectIds;
+	std::vector<BuildItem> buildItems;
+};
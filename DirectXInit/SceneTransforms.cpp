@@ -0,0 +1,624 @@
+#include "stdafx.h"
+
+#include "SceneTransforms.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//Update walks the dirty flags instead of sorting the list once more than 1 in this many nodes are set
+static const uint64_t TRANSFORM_SCAN_RATIO = 32;
+
+//And recomputes everything once more than 1 in this many are. In a tree a few wide the subtrees under that
+//many marks are most of it, and following runs that nearly cover every level costs more than it saves.
+static const uint64_t TRANSFORM_FULL_RATIO = 16;
+
+static const float identityWorld[TRANSFORM_WORLD_COUNT] =
+{
+	1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 1.0f,
+	0.0f, 0.0f, 0.0f,
+};
+
+
+SceneTransforms::SceneTransforms()
+	: capacity(0), positions(NULL), rotations(NULL), scales(NULL), dirtyCount(0), bNeedsRebuild(false), lastUpdateCount(0)
+{
+	for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e)
+		world[e] = NULL;
+}
+
+void SceneTransforms::AppendRun(std::vector<Run> &runs, uint32_t begin, uint32_t end)
+{
+	if (!runs.empty() && begin <= runs.back().end)
+	{
+		if (end > runs.back().end)
+			runs.back().end = end;
+		return;
+	}
+
+	Run run = { begin, end };
+	runs.push_back(run);
+}
+
+void SceneTransforms::Reserve(uint32_t count)
+{
+	if (count > capacity)
+		Grow(count);
+
+	parent.reserve(count);
+	childBegin.reserve(count + 1);
+	dirty.reserve(count);
+	dirtyList.reserve(count);
+	idToIndex.reserve(count);
+	indexToId.reserve(count);
+}
+
+void SceneTransforms::Clear()
+{
+	parent.clear();
+	childBegin.clear();
+	levelStart.clear();
+	dirty.clear();
+	dirtyList.clear();
+	dirtyCount = 0;
+	idToIndex.clear();
+	indexToId.clear();
+	bNeedsRebuild = false;
+	lastUpdateCount = 0;
+}
+
+TransformId SceneTransforms::Add(TransformId parentId)
+{
+	static const Float3 zero = { 0.0f, 0.0f, 0.0f };
+	static const Float4 identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+	static const Float3 one = { 1.0f, 1.0f, 1.0f };
+
+	return Add(parentId, zero, identity, one);
+}
+
+TransformId SceneTransforms::Add(TransformId parentId, const Float3 &position, const Float4 &rotation, const Float3 &scale)
+{
+	//Appended for now, which still has it after its parent. Rebuild puts it in its level.
+	uint32_t index = Count();
+	TransformId id = (TransformId)idToIndex.size();
+
+	if (index == capacity)
+		Grow(index + 1);
+
+	//The locals come from SetLocal below
+	for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e)
+		world[e][index] = identityWorld[e];
+
+	parent.push_back(parentId == TRANSFORM_NONE ? TRANSFORM_NONE : idToIndex[parentId]);
+	dirty.push_back(0);
+	dirtyList.push_back(0);
+	idToIndex.push_back(index);
+	indexToId.push_back(id);
+
+	SetLocal(id, position, rotation, scale);
+	bNeedsRebuild = true;
+	return id;
+}
+
+void SceneTransforms::GetLocal(TransformId id, Float3 &position, Float4 &rotation, Float3 &scale) const
+{
+	uint32_t index = idToIndex[id];
+	position = positions[index];
+	rotation = rotations[index];
+	scale = scales[index];
+}
+
+TransformId SceneTransforms::Parent(TransformId id) const
+{
+	uint32_t parentIndex = parent[idToIndex[id]];
+	return parentIndex == TRANSFORM_NONE ? TRANSFORM_NONE : indexToId[parentIndex];
+}
+
+Mat4 SceneTransforms::World(TransformId id) const
+{
+	uint32_t index = idToIndex[id];
+	const float *const *w = world;
+	return MakeMat4(
+		Vec4Set(w[TRANSFORM_WORLD_00][index], w[TRANSFORM_WORLD_01][index], w[TRANSFORM_WORLD_02][index], 0.0f),
+		Vec4Set(w[TRANSFORM_WORLD_10][index], w[TRANSFORM_WORLD_11][index], w[TRANSFORM_WORLD_12][index], 0.0f),
+		Vec4Set(w[TRANSFORM_WORLD_20][index], w[TRANSFORM_WORLD_21][index], w[TRANSFORM_WORLD_22][index], 0.0f),
+		Vec4Set(w[TRANSFORM_WORLD_30][index], w[TRANSFORM_WORLD_31][index], w[TRANSFORM_WORLD_32][index], 1.0f));
+}
+
+void SceneTransforms::Grow(uint32_t minCapacity)
+{
+	uint32_t newCapacity = capacity > 0 ? capacity : 64;
+	while (newCapacity < minCapacity)
+		newCapacity *= 2;
+
+	//One block: the three local arrays, then the world columns. Each starts a cache line further into a page
+	//than the last, as separate allocations this big they'd all start at the same offset in a page, so element
+	//i of every column does too, and the kernels' stores to one column keep stalling the loads from the others
+	//(4K aliasing), which cost more than a third of Update at 100k nodes. The padding also lets the kernel
+	//read a whole 4 floats at the last Float3.
+	const uint32_t localFloats = 3 + 4 + 3;
+	uint32_t stride = ((newCapacity + 15) & ~15u) + 16;
+	std::vector<float> newColumns((size_t)stride * (localFloats + TRANSFORM_WORLD_COUNT));
+
+	uint32_t count = Count();
+	float *column = newColumns.empty() ? NULL : &newColumns[0];
+
+	Float3 *newPositions = reinterpret_cast<Float3*>(column);
+	Float4 *newRotations = reinterpret_cast<Float4*>(column + stride * 3);
+	Float3 *newScales = reinterpret_cast<Float3*>(column + stride * 7);
+	if (count > 0)
+	{
+		memcpy(newPositions, positions, count * sizeof(Float3));
+		memcpy(newRotations, rotations, count * sizeof(Float4));
+		memcpy(newScales, scales, count * sizeof(Float3));
+	}
+	positions = newPositions;
+	rotations = newRotations;
+	scales = newScales;
+
+	column += stride * localFloats;
+	for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e, column += stride)
+	{
+		if (count > 0)
+			memcpy(column, world[e], count * sizeof(float));
+		world[e] = column;
+	}
+
+	columns.swap(newColumns);
+	capacity = newCapacity;
+}
+
+//values[n] = old values[order[n]]
+template<typename T>
+static void Permute(T *values, const std::vector<uint32_t> &order)
+{
+	std::vector<T> temp(order.size());
+	for (size_t n = 0; n < order.size(); ++n)
+		temp[n] = values[order[n]];
+	std::copy(temp.begin(), temp.end(), values);
+}
+
+void SceneTransforms::Rebuild()
+{
+	PROFILE_FUNCTION();
+
+	uint32_t count = Count();
+
+	//Children of every node in index order, which the adds kept parent first
+	std::vector<uint32_t> childOffset(count + 1, 0);
+	for (uint32_t i = 0; i < count; ++i)
+		if (parent[i] != TRANSFORM_NONE)
+			++childOffset[parent[i] + 1];
+	for (uint32_t i = 0; i < count; ++i)
+		childOffset[i + 1] += childOffset[i];
+
+	std::vector<uint32_t> children(count);
+	std::vector<uint32_t> fill(childOffset.begin(), childOffset.end() - 1);
+	for (uint32_t i = 0; i < count; ++i)
+		if (parent[i] != TRANSFORM_NONE)
+			children[fill[parent[i]]++] = i;
+
+	//Breadth first from the roots: order[newIndex] = oldIndex
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (uint32_t i = 0; i < count; ++i)
+		if (parent[i] == TRANSFORM_NONE)
+			order.push_back(i);
+
+	levelStart.clear();
+	levelStart.push_back(0);
+	childBegin.resize(count + 1);
+
+	uint32_t levelBegin = 0;
+	while (levelBegin < order.size())
+	{
+		uint32_t levelEnd = (uint32_t)order.size();
+		levelStart.push_back(levelEnd);
+
+		for (uint32_t n = levelBegin; n < levelEnd; ++n)
+		{
+			uint32_t old = order[n];
+			childBegin[n] = (uint32_t)order.size();
+			order.insert(order.end(), children.begin() + childOffset[old], children.begin() + childOffset[old + 1]);
+		}
+
+		levelBegin = levelEnd;
+	}
+	childBegin[count] = count;
+
+	std::vector<uint32_t> &newIndex = fill;
+	for (uint32_t n = 0; n < count; ++n)
+		newIndex[order[n]] = n;
+
+	Permute(positions, order);
+	Permute(rotations, order);
+	Permute(scales, order);
+
+	std::vector<uint32_t> &newParent = children;
+	std::vector<TransformId> newIds(count);
+	for (uint32_t n = 0; n < count; ++n)
+	{
+		uint32_t old = order[n];
+		newParent[n] = parent[old] == TRANSFORM_NONE ? TRANSFORM_NONE : newIndex[parent[old]];
+		newIds[n] = indexToId[old];
+		idToIndex[newIds[n]] = n;
+	}
+	parent.swap(newParent);
+	indexToId.swap(newIds);
+
+	//Indices changed under the dirty list, it doesn't matter since everything is recomputed now
+	for (size_t d = 0; d < dirtyCount; ++d)
+		dirty[dirtyList[d]] = 0;
+	dirtyCount = 0;
+
+	bNeedsRebuild = false;
+}
+
+void SceneTransforms::Update(JobSystem *jobs)
+{
+	PROFILE_FUNCTION();
+
+	lastUpdateCount = 0;
+	nextRuns.clear();
+
+	if (bNeedsRebuild)
+	{
+		Rebuild();
+		UpdateAll(jobs);
+		return;
+	}
+
+	if (dirtyCount == 0)
+		return;
+
+	if ((uint64_t)dirtyCount * TRANSFORM_FULL_RATIO > Count())
+	{
+		UpdateAll(jobs);
+		std::fill(dirty.begin(), dirty.end(), 0);
+		dirtyCount = 0;
+		return;
+	}
+
+	//A few marks are quicker sorted, lots of them quicker found again by walking the flags level by level
+	bool bScanFlags = (uint64_t)dirtyCount * TRANSFORM_SCAN_RATIO > Count();
+	if (!bScanFlags)
+		std::sort(dirtyList.begin(), dirtyList.begin() + dirtyCount);
+
+	size_t nextDirty = 0;
+	size_t marksLeft = dirtyCount;
+
+	for (uint32_t level = 0; level < LevelCount(); ++level)
+	{
+		uint32_t levelBegin = levelStart[level], levelEnd = levelStart[level + 1];
+
+		markedRuns.clear();
+		if (bScanFlags)
+		{
+			for (uint32_t i = levelBegin; i < levelEnd && marksLeft > 0; ++i)
+			{
+				if (dirty[i])
+				{
+					AppendRun(markedRuns, i, i + 1);
+					--marksLeft;
+				}
+			}
+		}
+		else
+		{
+			for (; nextDirty < dirtyCount && dirtyList[nextDirty] < levelEnd; ++nextDirty, --marksLeft)
+				AppendRun(markedRuns, dirtyList[nextDirty], dirtyList[nextDirty] + 1);
+		}
+
+		//Both are sorted, merge what was set in this level in with what the level above passed down
+		levelRuns.clear();
+		size_t m = 0, r = 0;
+		while (m < markedRuns.size() || r < nextRuns.size())
+		{
+			if (r == nextRuns.size() || (m < markedRuns.size() && markedRuns[m].begin < nextRuns[r].begin))
+			{
+				AppendRun(levelRuns, markedRuns[m].begin, markedRuns[m].end);
+				++m;
+			}
+			else
+			{
+				AppendRun(levelRuns, nextRuns[r].begin, nextRuns[r].end);
+				++r;
+			}
+		}
+
+		if (levelRuns.empty())
+		{
+			if (marksLeft == 0)
+				break;
+			continue;
+		}
+
+		//Close gaps narrower than the kernel so it can stay 8 wide (the nodes in between just get the same
+		//answer again), and cut long runs up for the jobs
+		computeRuns.clear();
+		uint32_t total = 0;
+		for (size_t i = 0; i < levelRuns.size(); ++i)
+		{
+			uint32_t begin = levelRuns[i].begin;
+			if (!computeRuns.empty() && begin - computeRuns.back().end < (uint32_t)MATH_SOA_LANES && computeRuns.back().end - computeRuns.back().begin < TRANSFORM_JOB_NODES)
+			{
+				total += begin - computeRuns.back().end;
+				begin = computeRuns.back().begin;
+				computeRuns.pop_back();
+			}
+
+			uint32_t end = levelRuns[i].end;
+			total += end - levelRuns[i].begin;
+			while (end - begin > TRANSFORM_JOB_NODES)
+			{
+				Run piece = { begin, begin + TRANSFORM_JOB_NODES };
+				computeRuns.push_back(piece);
+				begin += TRANSFORM_JOB_NODES;
+			}
+
+			Run rest = { begin, end };
+			computeRuns.push_back(rest);
+		}
+
+		lastUpdateCount += total;
+
+		uint32_t runCount = (uint32_t)computeRuns.size();
+		if (jobs && total > TRANSFORM_JOB_NODES)
+		{
+			uint32_t grain = (uint32_t)(((uint64_t)runCount * TRANSFORM_JOB_NODES) / total);
+			jobs->ParallelFor(runCount, grain, [this](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; ++i)
+					ComputeWorld(computeRuns[i].begin, computeRuns[i].end);
+			});
+		}
+		else
+		{
+			for (uint32_t i = 0; i < runCount; ++i)
+				ComputeWorld(computeRuns[i].begin, computeRuns[i].end);
+		}
+
+		//The children of a run are one run in the next level
+		nextRuns.clear();
+		for (size_t i = 0; i < levelRuns.size(); ++i)
+		{
+			uint32_t begin = childBegin[levelRuns[i].begin];
+			uint32_t end = childBegin[levelRuns[i].end];
+			if (begin < end)
+				AppendRun(nextRuns, begin, end);
+		}
+	}
+
+	if (bScanFlags)
+	{
+		std::fill(dirty.begin(), dirty.end(), 0);
+	}
+	else
+	{
+		for (size_t d = 0; d < dirtyCount; ++d)
+			dirty[dirtyList[d]] = 0;
+	}
+	dirtyCount = 0;
+}
+
+void SceneTransforms::UpdateAll(JobSystem *jobs)
+{
+	for (uint32_t level = 0; level < LevelCount(); ++level)
+	{
+		uint32_t levelBegin = levelStart[level], levelEnd = levelStart[level + 1];
+		uint32_t size = levelEnd - levelBegin;
+
+		if (jobs && size > TRANSFORM_JOB_NODES)
+		{
+			uint32_t pieces = (size + TRANSFORM_JOB_NODES - 1) / TRANSFORM_JOB_NODES;
+			jobs->ParallelFor(pieces, 1, [this, levelBegin, levelEnd](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t piece = begin; piece < end; ++piece)
+				{
+					uint32_t pieceBegin = levelBegin + piece * TRANSFORM_JOB_NODES;
+					uint32_t pieceEnd = levelEnd - pieceBegin > TRANSFORM_JOB_NODES ? pieceBegin + TRANSFORM_JOB_NODES : levelEnd;
+					ComputeWorld(pieceBegin, pieceEnd);
+				}
+			});
+		}
+		else
+		{
+			ComputeWorld(levelBegin, levelEnd);
+		}
+	}
+
+	lastUpdateCount = Count();
+}
+
+//How a block's parents sit in the level above. The rebuild lays children out in their parents' order, so
+//parents of consecutive nodes never go down and the first two only need the ends checked.
+enum ParentLayout
+{
+	PARENTS_ONE,			//all 8 the same node
+	PARENTS_HALVES,			//one for lanes 0-3, one for 4-7
+	PARENTS_EACH,			//one each, one after another
+	PARENTS_SCATTERED,		//anything else, gathered
+};
+
+static MATH_INLINE ParentLayout ClassifyParents(const uint32_t *parents)
+{
+	uint32_t first = parents[0], last = parents[MATH_SOA_LANES - 1];
+	if (first == last)
+		return PARENTS_ONE;
+	if (parents[MATH_SOA_LANES / 2 - 1] == first && parents[MATH_SOA_LANES / 2] == last)
+		return PARENTS_HALVES;
+	if (last - first != MATH_SOA_LANES - 1)
+		return PARENTS_SCATTERED;
+	for (int k = 1; k < MATH_SOA_LANES - 1; ++k)
+		if (parents[k] != first + k)
+			return PARENTS_SCATTERED;
+	return PARENTS_EACH;
+}
+
+static MATH_INLINE SimdF8 LoadParents(const float *w, const uint32_t *parents, ParentLayout layout)
+{
+	switch (layout)
+	{
+	case PARENTS_ONE:		return F8Splat(w[parents[0]]);
+	case PARENTS_HALVES:	return F8SplatHalves(w[parents[0]], w[parents[MATH_SOA_LANES - 1]]);
+	case PARENTS_EACH:		return F8Load(w + parents[0]);
+	default:				return F8Gather(w, parents);
+	}
+}
+
+//The first 4 floats of 8 structs stride floats apart, struct k in lane k. Reads 4 floats from the last one
+//whatever the stride.
+static MATH_INLINE void LoadLanes(const float *p, uint32_t stride, SimdF8 &a, SimdF8 &b, SimdF8 &c, SimdF8 &d)
+{
+	SimdF4 lo0 = F4Load(p), lo1 = F4Load(p + stride), lo2 = F4Load(p + stride * 2), lo3 = F4Load(p + stride * 3);
+	SimdF4 hi0 = F4Load(p + stride * 4), hi1 = F4Load(p + stride * 5), hi2 = F4Load(p + stride * 6), hi3 = F4Load(p + stride * 7);
+	F4Transpose(lo0, lo1, lo2, lo3);
+	F4Transpose(hi0, hi1, hi2, hi3);
+	a = F8Make(lo0, hi0);
+	b = F8Make(lo1, hi1);
+	c = F8Make(lo2, hi2);
+	d = F8Make(lo3, hi3);
+}
+
+//One element of local * parent: a b c is the local row, p0 p1 p2 the parent's column
+static MATH_INLINE SimdF8 ComposeElement(SimdF8 a, SimdF8 b, SimdF8 c, SimdF8 p0, SimdF8 p1, SimdF8 p2)
+{
+	return F8MulAdd(c, p2, F8MulAdd(b, p1, F8Mul(a, p0)));
+}
+
+void SceneTransforms::ComputeWorld(uint32_t begin, uint32_t end)
+{
+	//A run is all one level, so either all roots or none
+	bool bRoots = parent[begin] == TRANSFORM_NONE;
+
+	//Everything in locals, every store could alias the members and they'd be reloaded after each one
+	float *w[TRANSFORM_WORLD_COUNT];
+	for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e)
+		w[e] = world[e];
+	const float *pos = &positions[0].x, *rot = &rotations[0].x, *scl = &scales[0].x;
+	const uint32_t *parentIndex = &parent[0];
+
+	//Written out in full, as loops over arrays of SimdF8 they don't stay in registers
+	uint32_t i = begin;
+	for (; i + MATH_SOA_LANES <= end; i += MATH_SOA_LANES)
+	{
+		SimdF8 two = F8Splat(2.0f);
+
+		//Local rotation from the quaternion, same as Mat4FromQuat
+		SimdF8 x, y, z, qw;
+		LoadLanes(rot + i * 4, 4, x, y, z, qw);
+
+		SimdF8 xx = F8Mul(x, x), yy = F8Mul(y, y), zz = F8Mul(z, z);
+		SimdF8 xy = F8Mul(x, y), xz = F8Mul(x, z), yz = F8Mul(y, z);
+		SimdF8 wx = F8Mul(qw, x), wy = F8Mul(qw, y), wz = F8Mul(qw, z);
+
+		//Scaled by row
+		SimdF8 sx, sy, sz, unused;
+		LoadLanes(scl + i * 3, 3, sx, sy, sz, unused);
+		SimdF8 sx2 = F8Mul(sx, two), sy2 = F8Mul(sy, two), sz2 = F8Mul(sz, two);
+
+		SimdF8 l00 = F8Sub(sx, F8Mul(sx2, F8Add(yy, zz)));
+		SimdF8 l01 = F8Mul(sx2, F8Add(xy, wz));
+		SimdF8 l02 = F8Mul(sx2, F8Sub(xz, wy));
+		SimdF8 l10 = F8Mul(sy2, F8Sub(xy, wz));
+		SimdF8 l11 = F8Sub(sy, F8Mul(sy2, F8Add(xx, zz)));
+		SimdF8 l12 = F8Mul(sy2, F8Add(yz, wx));
+		SimdF8 l20 = F8Mul(sz2, F8Add(xz, wy));
+		SimdF8 l21 = F8Mul(sz2, F8Sub(yz, wx));
+		SimdF8 l22 = F8Sub(sz, F8Mul(sz2, F8Add(xx, yy)));
+		SimdF8 l30, l31, l32;
+		LoadLanes(pos + i * 3, 3, l30, l31, l32, unused);
+
+		if (bRoots)
+		{
+			F8Store(w[TRANSFORM_WORLD_00] + i, l00); F8Store(w[TRANSFORM_WORLD_01] + i, l01); F8Store(w[TRANSFORM_WORLD_02] + i, l02);
+			F8Store(w[TRANSFORM_WORLD_10] + i, l10); F8Store(w[TRANSFORM_WORLD_11] + i, l11); F8Store(w[TRANSFORM_WORLD_12] + i, l12);
+			F8Store(w[TRANSFORM_WORLD_20] + i, l20); F8Store(w[TRANSFORM_WORLD_21] + i, l21); F8Store(w[TRANSFORM_WORLD_22] + i, l22);
+			F8Store(w[TRANSFORM_WORLD_30] + i, l30); F8Store(w[TRANSFORM_WORLD_31] + i, l31); F8Store(w[TRANSFORM_WORLD_32] + i, l32);
+			continue;
+		}
+
+		//Siblings sit together, so most blocks share a parent or two or have one each and skip the gather
+		const uint32_t *parents = parentIndex + i;
+		ParentLayout layout = ClassifyParents(parents);
+
+		//local * parent, rows 0-2 are directions, row 3 a point
+		SimdF8 p0 = LoadParents(w[TRANSFORM_WORLD_00], parents, layout), p1 = LoadParents(w[TRANSFORM_WORLD_10], parents, layout), p2 = LoadParents(w[TRANSFORM_WORLD_20], parents, layout);
+		F8Store(w[TRANSFORM_WORLD_00] + i, ComposeElement(l00, l01, l02, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_10] + i, ComposeElement(l10, l11, l12, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_20] + i, ComposeElement(l20, l21, l22, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_30] + i, F8Add(ComposeElement(l30, l31, l32, p0, p1, p2), LoadParents(w[TRANSFORM_WORLD_30], parents, layout)));
+
+		p0 = LoadParents(w[TRANSFORM_WORLD_01], parents, layout), p1 = LoadParents(w[TRANSFORM_WORLD_11], parents, layout), p2 = LoadParents(w[TRANSFORM_WORLD_21], parents, layout);
+		F8Store(w[TRANSFORM_WORLD_01] + i, ComposeElement(l00, l01, l02, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_11] + i, ComposeElement(l10, l11, l12, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_21] + i, ComposeElement(l20, l21, l22, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_31] + i, F8Add(ComposeElement(l30, l31, l32, p0, p1, p2), LoadParents(w[TRANSFORM_WORLD_31], parents, layout)));
+
+		p0 = LoadParents(w[TRANSFORM_WORLD_02], parents, layout), p1 = LoadParents(w[TRANSFORM_WORLD_12], parents, layout), p2 = LoadParents(w[TRANSFORM_WORLD_22], parents, layout);
+		F8Store(w[TRANSFORM_WORLD_02] + i, ComposeElement(l00, l01, l02, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_12] + i, ComposeElement(l10, l11, l12, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_22] + i, ComposeElement(l20, l21, l22, p0, p1, p2));
+		F8Store(w[TRANSFORM_WORLD_32] + i, F8Add(ComposeElement(l30, l31, l32, p0, p1, p2), LoadParents(w[TRANSFORM_WORLD_32], parents, layout)));
+	}
+
+	for (; i < end; ++i)
+		ComputeWorldScalar(i);
+}
+
+void SceneTransforms::ComputeWorldScalar(uint32_t i)
+{
+	const Float3 &position = positions[i], &scale = scales[i];
+	float x = rotations[i].x, y = rotations[i].y, z = rotations[i].z, w = rotations[i].w;
+	float xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+	float sx = scale.x, sy = scale.y, sz = scale.z;
+
+	float l[TRANSFORM_WORLD_COUNT] =
+	{
+		sx - 2.0f * sx * (yy + zz), 2.0f * sx * (xy + wz), 2.0f * sx * (xz - wy),
+		2.0f * sy * (xy - wz), sy - 2.0f * sy * (xx + zz), 2.0f * sy * (yz + wx),
+		2.0f * sz * (xz + wy), 2.0f * sz * (yz - wx), sz - 2.0f * sz * (xx + yy),
+		position.x, position.y, position.z,
+	};
+
+	uint32_t p = parent[i];
+	if (p == TRANSFORM_NONE)
+	{
+		for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e)
+			world[e][i] = l[e];
+		return;
+	}
+
+	float pw[TRANSFORM_WORLD_COUNT];
+	for (int e = 0; e < TRANSFORM_WORLD_COUNT; ++e)
+		pw[e] = world[e][p];
+
+	for (int row = 0; row < 4; ++row)
+	{
+		for (int col = 0; col < 3; ++col)
+		{
+			float r = l[row * 3 + 0] * pw[TRANSFORM_WORLD_00 + col] + l[row * 3 + 1] * pw[TRANSFORM_WORLD_10 + col] + l[row * 3 + 2] * pw[TRANSFORM_WORLD_20 + col];
+			if (row == 3)
+				r += pw[TRANSFORM_WORLD_30 + col];
+			world[row * 3 + col][i] = r;
+		}
+	}
+}
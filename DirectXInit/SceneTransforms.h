@@ -0,0 +1,196 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "VecMath.h"
+#include <stdint.h>
+#include <vector>
+
+class JobSystem;
+
+
+typedef uint32_t TransformId;
+const TransformId TRANSFORM_NONE = 0xFFFFFFFF;
+
+//Updates bigger than this (nodes in one level) get split into jobs of about this many nodes
+const uint32_t TRANSFORM_JOB_NODES = 2048;
+
+//World matrix, the top 3 columns of each row (the 4th is always 0 0 0 1), structure of arrays
+enum TransformWorldElement
+{
+	TRANSFORM_WORLD_00 = 0, TRANSFORM_WORLD_01, TRANSFORM_WORLD_02,
+	TRANSFORM_WORLD_10, TRANSFORM_WORLD_11, TRANSFORM_WORLD_12,
+	TRANSFORM_WORLD_20, TRANSFORM_WORLD_21, TRANSFORM_WORLD_22,
+	TRANSFORM_WORLD_30, TRANSFORM_WORLD_31, TRANSFORM_WORLD_32,
+	TRANSFORM_WORLD_COUNT,
+};
+
+
+//Transform hierarchy: local position/rotation/scale per node, world matrices computed from them.
+//
+//Nodes are kept in level order, roots first, then their children, then theirs, with the children of one
+//node next to each other and in the same order as their parents. So a parent is always before its
+//children, everything in one level is independent of everything else in it, and the children of any run of
+//nodes are one run in the next level. Update walks the levels top down with a list of dirty runs: the ones
+//set since last time plus the children of the runs above, and recomputes just those with the SoA kernels,
+//8 at a time. Nothing outside a dirty subtree is touched. Once more than a few percent of the nodes are set
+//the subtrees under them are most of the tree anyway, and it recomputes every level front to back instead.
+//
+//Ids stay the same for a node's whole life, indices (the order above) change whenever nodes are added, which
+//gets sorted out at the next Update. Nodes are only added, Clear to start over. Rotations must be unit length.
+//
+//Not thread safe, use it from the simulation thread. World matrices are as of the last Update.
+
+class SceneTransforms
+{
+public:
+	SceneTransforms();
+
+	void Reserve(uint32_t count);
+	void Clear();
+
+	//parent must already exist, TRANSFORM_NONE for a root
+	TransformId Add(TransformId parent = TRANSFORM_NONE);
+	TransformId Add(TransformId parent, const Float3 &position, const Float4 &rotation, const Float3 &scale);
+
+	void SetLocal(TransformId id, const Float3 &position, const Float4 &rotation, const Float3 &scale);
+	void SetPosition(TransformId id, const Float3 &position);
+	void SetRotation(TransformId id, const Float4 &rotation);
+	void SetScale(TransformId id, const Float3 &scale);
+
+	void GetLocal(TransformId id, Float3 &position, Float4 &rotation, Float3 &scale) const;
+	TransformId Parent(TransformId id) const;
+
+	Mat4 World(TransformId id) const;
+
+	//Recompute the world matrix of everything set since the last Update and everything under it. jobs may be
+	//NULL, otherwise big levels are spread over it.
+	void Update(JobSystem *jobs = NULL);
+
+	inline uint32_t Count() const { return (uint32_t)indexToId.size(); };
+	inline uint32_t LevelCount() const { return levelStart.empty() ? 0 : (uint32_t)levelStart.size() - 1; };
+
+	//Nodes the last Update computed, including the clean ones next to dirty runs it took along to stay 8 wide
+	inline uint32_t LastUpdateCount() const { return lastUpdateCount; };
+
+	//Bulk access in index order, valid until the next Add. World data is only current after Update.
+	inline uint32_t IndexOf(TransformId id) const { return idToIndex[id]; };
+	inline TransformId IdAt(uint32_t index) const { return indexToId[index]; };
+	inline const Float3* LocalPositions() const { return positions; };
+	inline const Float4* LocalRotations() const { return rotations; };
+	inline const Float3* LocalScales() const { return scales; };
+	inline const float* WorldData(TransformWorldElement element) const { return world[element]; };
+
+private:
+
+	//[begin, end) in index order
+	struct Run
+	{
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	SceneTransforms(const SceneTransforms&);
+	SceneTransforms& operator=(const SceneTransforms&);
+
+	void MarkDirty(uint32_t index);
+
+	//Add to a sorted run list, merging with the last run if they touch
+	static void AppendRun(std::vector<Run> &runs, uint32_t begin, uint32_t end);
+
+	//Room for at least minCapacity nodes in every column
+	void Grow(uint32_t minCapacity);
+
+	//Back into level order after adds, everything is dirty after
+	void Rebuild();
+
+	//Every level front to back, for after a rebuild or when most of the tree is dirty
+	void UpdateAll(JobSystem *jobs);
+
+	//World matrices for [begin, end), all in one level. The kernel does 8 at a time, the rest one by one.
+	void ComputeWorld(uint32_t begin, uint32_t end);
+	void ComputeWorldScalar(uint32_t index);
+
+	//The local arrays and world columns, all in one block (see Grow). Locals are an array per TRS part rather
+	//than per float, a set is then 3 stores instead of 10 scattered ones and the kernel transposes them.
+	std::vector<float> columns;
+	uint32_t capacity;
+	Float3 *positions;
+	Float4 *rotations;
+	Float3 *scales;
+	float *world[TRANSFORM_WORLD_COUNT];
+
+	std::vector<uint32_t> parent;		//Index, TRANSFORM_NONE for roots
+	std::vector<uint32_t> childBegin;	//Children of index i are [childBegin[i], childBegin[i + 1]), Count() + 1 of them
+	std::vector<uint32_t> levelStart;	//Level l is [levelStart[l], levelStart[l + 1])
+	std::vector<uint8_t> dirty;
+	std::vector<uint32_t> dirtyList;	//Set since the last Update, unsorted, the first dirtyCount. Count() long.
+	uint32_t dirtyCount;
+
+	std::vector<uint32_t> idToIndex;
+	std::vector<TransformId> indexToId;
+
+	bool bNeedsRebuild;
+	uint32_t lastUpdateCount;
+
+	//Update scratch, kept to not allocate every frame
+	std::vector<Run> markedRuns;		//Set since the last Update, in the current level
+	std::vector<Run> levelRuns;			//Exactly what's dirty in the current level
+	std::vector<Run> nextRuns;			//Children of those
+	std::vector<Run> computeRuns;		//levelRuns padded out and cut into job sized pieces
+};
+
+
+//Inline, a frame can set most of the nodes
+inline void SceneTransforms::MarkDirty(uint32_t index)
+{
+	if (dirty[index])
+		return;
+
+	dirty[index] = 1;
+	dirtyList[dirtyCount++] = index;
+}
+
+inline void SceneTransforms::SetLocal(TransformId id, const Float3 &position, const Float4 &rotation, const Float3 &scale)
+{
+	uint32_t index = idToIndex[id];
+	positions[index] = position;
+	rotations[index] = rotation;
+	scales[index] = scale;
+	MarkDirty(index);
+}
+
+inline void SceneTransforms::SetPosition(TransformId id, const Float3 &position)
+{
+	uint32_t index = idToIndex[id];
+	positions[index] = position;
+	MarkDirty(index);
+}
+
+inline void SceneTransforms::SetRotation(TransformId id, const Float4 &rotation)
+{
+	uint32_t index = idToIndex[id];
+	rotations[index] = rotation;
+	MarkDirty(index);
+}
+
+inline void SceneTransforms::SetScale(TransformId id, const Float3 &scale)
+{
+	uint32_t index = idToIndex[id];
+	scales[index] = scale;
+	MarkDirty(index);
+}
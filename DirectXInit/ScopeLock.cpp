@@ -1,12 +1,13 @@
-#pragma once
-
 #include "stdafx.h"
 
-#include <tchar.h>
-#include <string>
-#include <Windows.h>
 #include "ScopeLock.h"
 
+#if defined(_DEBUG) && defined(_WIN32)
+#include <crtdbg.h>
+#endif
+#include <assert.h>
+#include <stdio.h>
+
 /*
 Copyright (c) 2016, Eric Pouladian
 
@@ -23,30 +24,31 @@ ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
-ScopeLock::ScopeLock(HANDLE &m) :
-	mutexHandle(m)
+static std::atomic<uint64_t> scopeLockTimeouts(0);
+
+void OnScopeLockTimeout(unsigned int timeoutMs)
 {
-	if (mutexHandle <= 0)
-#ifdef _DEBUG
-		_CrtDbgBreak();
+	uint64_t count = scopeLockTimeouts.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	char message[128];
+	snprintf(message, sizeof(message), "ScopeLock: gave up after %u ms, carrying on unlocked (%llu so far)\n",
+		timeoutMs, (unsigned long long)count);
+#ifdef _WIN32
+	OutputDebugStringA(message);
 #else
-		return;
+	fputs(message, stderr);
 #endif
-	else if (WaitForSingleObject(mutexHandle, 2000))
-	{
+
 #ifdef _DEBUG
-		_CrtDbgBreak();
+#ifdef _WIN32
+	_CrtDbgBreak();
 #else
-		return;
+	assert(!"ScopeLock timed out");
+#endif
 #endif
-	}
 }
 
-//TODO: Add some optional logging
-ScopeLock::~ScopeLock()
+uint64_t ScopeLockTimeouts()
 {
-	if (mutexHandle <= 0)
-		return;
-	else
-		ReleaseMutex(mutexHandle);
-}
\ No newline at end of file
+	return scopeLockTimeouts.load(std::memory_order_relaxed);
+}
@@ -1,8 +1,7 @@
 #pragma once
 
-#include <Windows.h>
-#include <tchar.h>
-#include <string>
+#include "Locks.h"
+#include "Profiler.h"
 
 
 /*
@@ -31,20 +30,90 @@ private:
 	Uncopyable(const Uncopyable&);
 };
 
+
+//How long a ScopeLock waits before giving up, same as the old kernel mutex wait
+const unsigned int SCOPELOCK_DEFAULT_TIMEOUT = 2000;
+
+//Called when a default ScopeLock times out: logs it (debugger output, stderr elsewhere) and breaks in debug.
+//Release builds carry on unlocked like before, so ScopeLockTimeouts() is worth checking. Tracked locks
+//(LockStats.h) also count their own timeouts, these are the default-wait ones across every lock.
+void OnScopeLockTimeout(unsigned int timeoutMs);
+uint64_t ScopeLockTimeouts();
+
+
+//RAII lock over any of the policies in Locks.h (SpinParkMutex, SharedSpinMutex, NullLock, KernelMutex).
+//The uncontended path is just TryLock, so it never leaves user space.
+
+template <class TLock>
 class ScopeLock : public Uncopyable
 {
 
 public:
-	ScopeLock(HANDLE &m);
-	~ScopeLock();
-	//No copy operator for you
-	ScopeLock& operator=(const ScopeLock&);
+	//Waits up to SCOPELOCK_DEFAULT_TIMEOUT, timing out is treated as a bug (debug break)
+	explicit ScopeLock(TLock &m) :
+		lockRef(m), bLocked(false)
+	{
+		bLocked = lockRef.TryLock();
+
+		if (!bLocked)
+		{
+			PROFILE_ZONE("ScopeLock wait");
+			bLocked = lockRef.TryLockFor(SCOPELOCK_DEFAULT_TIMEOUT);
+		}
+
+		if (!bLocked)
+			OnScopeLockTimeout(SCOPELOCK_DEFAULT_TIMEOUT);
+	}
+
+	//Caller supplied timeout, timing out is expected here so check IsLocked()
+	ScopeLock(TLock &m, unsigned int timeoutMs) :
+		lockRef(m), bLocked(false)
+	{
+		bLocked = lockRef.TryLock();
+
+		if (!bLocked && timeoutMs > 0)
+		{
+			PROFILE_ZONE("ScopeLock wait");
+			bLocked = lockRef.TryLockFor(timeoutMs);
+		}
+	}
+
+	~ScopeLock()
+	{
+		if (bLocked)
+			lockRef.Unlock();
+	}
+
+	inline bool IsLocked() const { return bLocked; }
 
 private:
-	HANDLE &mutexHandle;
+	TLock &lockRef;
+	bool bLocked;
+};
 
 
+//Shared (reader) side of a reader/writer lock
 
-	//No copy constructor for you
-	ScopeLock(const ScopeLock&);
-};
\ No newline at end of file
+template <class TLock>
+class SharedScopeLock : public Uncopyable
+{
+
+public:
+	explicit SharedScopeLock(TLock &m) :
+		lockRef(m)
+	{
+		if (!lockRef.TryLockShared())
+		{
+			PROFILE_ZONE("SharedScopeLock wait");
+			lockRef.LockShared();
+		}
+	}
+
+	~SharedScopeLock()
+	{
+		lockRef.UnlockShared();
+	}
+
+private:
+	TLock &lockRef;
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+//4 and 8 lane float registers, with the backend picked at compile time from what the compiler targets:
+//	AVX2		8 lanes native (FMA too when the compiler has it), 4 lanes on SSE
+//	SSE2		every x64 build, 8 lanes are two 4s
+//	NEON		AArch64 only (32 bit ARM lacks the vector divide/sqrt), 8 lanes are two 4s
+//	scalar		everything else, or any build with DXAPP_MATH_SCALAR defined
+//
+//Everything here is what VecMath.h and MathBatch.h are written in, nothing should need to reach past it to
+//the intrinsics. Masks (the Cmp results) are all ones/all zeros per lane, only good for And/Or/Select/MoveMask.
+
+#if defined(DXAPP_MATH_SCALAR)
+#define DXAPP_MATH_BACKEND_SCALAR 1
+#elif defined(__AVX2__)
+#define DXAPP_MATH_BACKEND_AVX2 1
+#define DXAPP_MATH_BACKEND_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DXAPP_MATH_BACKEND_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define DXAPP_MATH_BACKEND_NEON 1
+#else
+#define DXAPP_MATH_BACKEND_SCALAR 1
+#endif
+
+#if defined(DXAPP_MATH_BACKEND_AVX2)
+#include <immintrin.h>
+#elif defined(DXAPP_MATH_BACKEND_SSE2)
+#include <emmintrin.h>
+#elif defined(DXAPP_MATH_BACKEND_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(DXAPP_MATH_BACKEND_AVX2)
+const char *const MATH_BACKEND_NAME = "AVX2";
+#elif defined(DXAPP_MATH_BACKEND_SSE2)
+const char *const MATH_BACKEND_NAME = "SSE2";
+#elif defined(DXAPP_MATH_BACKEND_NEON)
+const char *const MATH_BACKEND_NAME = "NEON";
+#else
+const char *const MATH_BACKEND_NAME = "scalar";
+#endif
+
+#if defined(_MSC_VER)
+#define MATH_INLINE __forceinline
+#else
+#define MATH_INLINE inline __attribute__((always_inline))
+#endif
+
+
+//----------------------------------------------------------------------------------------------------------
+//4 lanes
+
+#if defined(DXAPP_MATH_BACKEND_SSE2)
+
+typedef __m128 SimdF4;
+
+MATH_INLINE SimdF4 F4Zero() { return _mm_setzero_ps(); }
+MATH_INLINE SimdF4 F4Splat(float f) { return _mm_set1_ps(f); }
+MATH_INLINE SimdF4 F4Set(float x, float y, float z, float w) { return _mm_set_ps(w, z, y, x); }
+MATH_INLINE SimdF4 F4Load(const float *p) { return _mm_loadu_ps(p); }
+MATH_INLINE void   F4Store(float *p, SimdF4 a) { _mm_storeu_ps(p, a); }
+
+MATH_INLINE SimdF4 F4Add(SimdF4 a, SimdF4 b) { return _mm_add_ps(a, b); }
+MATH_INLINE SimdF4 F4Sub(SimdF4 a, SimdF4 b) { return _mm_sub_ps(a, b); }
+MATH_INLINE SimdF4 F4Mul(SimdF4 a, SimdF4 b) { return _mm_mul_ps(a, b); }
+MATH_INLINE SimdF4 F4Div(SimdF4 a, SimdF4 b) { return _mm_div_ps(a, b); }
+MATH_INLINE SimdF4 F4MulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+MATH_INLINE SimdF4 F4Min(SimdF4 a, SimdF4 b) { return _mm_min_ps(a, b); }
+MATH_INLINE SimdF4 F4Max(SimdF4 a, SimdF4 b) { return _mm_max_ps(a, b); }
+MATH_INLINE SimdF4 F4Sqrt(SimdF4 a) { return _mm_sqrt_ps(a); }
+MATH_INLINE SimdF4 F4Abs(SimdF4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+MATH_INLINE SimdF4 F4Neg(SimdF4 a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+
+MATH_INLINE SimdF4 F4CmpLt(SimdF4 a, SimdF4 b) { return _mm_cmplt_ps(a, b); }
+MATH_INLINE SimdF4 F4CmpLe(SimdF4 a, SimdF4 b) { return _mm_cmple_ps(a, b); }
+MATH_INLINE SimdF4 F4And(SimdF4 a, SimdF4 b) { return _mm_and_ps(a, b); }
+MATH_INLINE SimdF4 F4Or(SimdF4 a, SimdF4 b) { return _mm_or_ps(a, b); }
+MATH_INLINE SimdF4 F4Select(SimdF4 a, SimdF4 b, SimdF4 mask) { return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b)); }
+MATH_INLINE int	   F4MoveMask(SimdF4 mask) { return _mm_movemask_ps(mask); }
+
+MATH_INLINE float  F4GetX(SimdF4 a) { return _mm_cvtss_f32(a); }
+
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle(SimdF4 a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(W, Z, Y, X)); }
+
+//x,y from a and z,w from b
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle2(SimdF4 a, SimdF4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+
+#elif defined(DXAPP_MATH_BACKEND_NEON)
+
+typedef float32x4_t SimdF4;
+
+MATH_INLINE SimdF4 F4Zero() { return vdupq_n_f32(0.0f); }
+MATH_INLINE SimdF4 F4Splat(float f) { return vdupq_n_f32(f); }
+MATH_INLINE SimdF4 F4Set(float x, float y, float z, float w) { float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+MATH_INLINE SimdF4 F4Load(const float *p) { return vld1q_f32(p); }
+MATH_INLINE void   F4Store(float *p, SimdF4 a) { vst1q_f32(p, a); }
+
+MATH_INLINE SimdF4 F4Add(SimdF4 a, SimdF4 b) { return vaddq_f32(a, b); }
+MATH_INLINE SimdF4 F4Sub(SimdF4 a, SimdF4 b) { return vsubq_f32(a, b); }
+MATH_INLINE SimdF4 F4Mul(SimdF4 a, SimdF4 b) { return vmulq_f32(a, b); }
+MATH_INLINE SimdF4 F4Div(SimdF4 a, SimdF4 b) { return vdivq_f32(a, b); }
+MATH_INLINE SimdF4 F4MulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { return vfmaq_f32(c, a, b); }
+MATH_INLINE SimdF4 F4Min(SimdF4 a, SimdF4 b) { return vminq_f32(a, b); }
+MATH_INLINE SimdF4 F4Max(SimdF4 a, SimdF4 b) { return vmaxq_f32(a, b); }
+MATH_INLINE SimdF4 F4Sqrt(SimdF4 a) { return vsqrtq_f32(a); }
+MATH_INLINE SimdF4 F4Abs(SimdF4 a) { return vabsq_f32(a); }
+MATH_INLINE SimdF4 F4Neg(SimdF4 a) { return vnegq_f32(a); }
+
+MATH_INLINE SimdF4 F4CmpLt(SimdF4 a, SimdF4 b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+MATH_INLINE SimdF4 F4CmpLe(SimdF4 a, SimdF4 b) { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+MATH_INLINE SimdF4 F4And(SimdF4 a, SimdF4 b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+MATH_INLINE SimdF4 F4Or(SimdF4 a, SimdF4 b) { return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+MATH_INLINE SimdF4 F4Select(SimdF4 a, SimdF4 b, SimdF4 mask) { return vbslq_f32(vreinterpretq_u32_f32(mask), b, a); }
+
+MATH_INLINE int F4MoveMask(SimdF4 mask)
+{
+	static const int32_t shifts[4] = { 0, 1, 2, 3 };
+	uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(mask), 31);
+	return (int)vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts)));
+}
+
+MATH_INLINE float  F4GetX(SimdF4 a) { return vgetq_lane_f32(a, 0); }
+
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle(SimdF4 a)
+{
+	float v[4], r[4];
+	vst1q_f32(v, a);
+	r[0] = v[X]; r[1] = v[Y]; r[2] = v[Z]; r[3] = v[W];
+	return vld1q_f32(r);
+}
+
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle2(SimdF4 a, SimdF4 b)
+{
+	float va[4], vb[4], r[4];
+	vst1q_f32(va, a);
+	vst1q_f32(vb, b);
+	r[0] = va[X]; r[1] = va[Y]; r[2] = vb[Z]; r[3] = vb[W];
+	return vld1q_f32(r);
+}
+
+#else
+
+struct SimdF4
+{
+	float v[4];
+};
+
+MATH_INLINE uint32_t F4Bits(float f) { uint32_t u; memcpy(&u, &f, sizeof(u)); return u; }
+MATH_INLINE float    F4FromBits(uint32_t u) { float f; memcpy(&f, &u, sizeof(f)); return f; }
+
+MATH_INLINE SimdF4 F4Set(float x, float y, float z, float w) { SimdF4 r = { { x, y, z, w } }; return r; }
+MATH_INLINE SimdF4 F4Splat(float f) { return F4Set(f, f, f, f); }
+MATH_INLINE SimdF4 F4Zero() { return F4Splat(0.0f); }
+MATH_INLINE SimdF4 F4Load(const float *p) { return F4Set(p[0], p[1], p[2], p[3]); }
+MATH_INLINE void   F4Store(float *p, SimdF4 a) { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+
+#define F4_SCALAR_OP(name, expr) \
+	MATH_INLINE SimdF4 name(SimdF4 a, SimdF4 b) { SimdF4 r; for (int i = 0; i < 4; ++i) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return r; }
+
+F4_SCALAR_OP(F4Add, x + y)
+F4_SCALAR_OP(F4Sub, x - y)
+F4_SCALAR_OP(F4Mul, x * y)
+F4_SCALAR_OP(F4Div, x / y)
+F4_SCALAR_OP(F4Min, x < y ? x : y)
+F4_SCALAR_OP(F4Max, x > y ? x : y)
+F4_SCALAR_OP(F4CmpLt, F4FromBits(x < y ? 0xFFFFFFFFu : 0u))
+F4_SCALAR_OP(F4CmpLe, F4FromBits(x <= y ? 0xFFFFFFFFu : 0u))
+F4_SCALAR_OP(F4And, F4FromBits(F4Bits(x) & F4Bits(y)))
+F4_SCALAR_OP(F4Or, F4FromBits(F4Bits(x) | F4Bits(y)))
+
+#undef F4_SCALAR_OP
+
+MATH_INLINE SimdF4 F4MulAdd(SimdF4 a, SimdF4 b, SimdF4 c) { return F4Add(F4Mul(a, b), c); }
+MATH_INLINE SimdF4 F4Sqrt(SimdF4 a) { return F4Set(sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3])); }
+MATH_INLINE SimdF4 F4Abs(SimdF4 a) { return F4Set(fabsf(a.v[0]), fabsf(a.v[1]), fabsf(a.v[2]), fabsf(a.v[3])); }
+MATH_INLINE SimdF4 F4Neg(SimdF4 a) { return F4Set(-a.v[0], -a.v[1], -a.v[2], -a.v[3]); }
+
+MATH_INLINE SimdF4 F4Select(SimdF4 a, SimdF4 b, SimdF4 mask)
+{
+	SimdF4 r;
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = (F4Bits(mask.v[i]) & 0x80000000u) ? b.v[i] : a.v[i];
+	return r;
+}
+
+MATH_INLINE int F4MoveMask(SimdF4 mask)
+{
+	int bits = 0;
+	for (int i = 0; i < 4; ++i)
+		bits |= (int)(F4Bits(mask.v[i]) >> 31) << i;
+	return bits;
+}
+
+MATH_INLINE float  F4GetX(SimdF4 a) { return a.v[0]; }
+
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle(SimdF4 a) { return F4Set(a.v[X], a.v[Y], a.v[Z], a.v[W]); }
+
+template <int X, int Y, int Z, int W>
+MATH_INLINE SimdF4 F4Shuffle2(SimdF4 a, SimdF4 b) { return F4Set(a.v[X], a.v[Y], b.v[Z], b.v[W]); }
+
+#endif
+
+
+//Backend independent, built on the above
+
+MATH_INLINE SimdF4 F4SplatX(SimdF4 a) { return F4Shuffle<0, 0, 0, 0>(a); }
+MATH_INLINE SimdF4 F4SplatY(SimdF4 a) { return F4Shuffle<1, 1, 1, 1>(a); }
+MATH_INLINE SimdF4 F4SplatZ(SimdF4 a) { return F4Shuffle<2, 2, 2, 2>(a); }
+MATH_INLINE SimdF4 F4SplatW(SimdF4 a) { return F4Shuffle<3, 3, 3, 3>(a); }
+
+//All ones in w, zeros elsewhere: F4Select(a, b, F4MaskW()) is a with b's w
+MATH_INLINE SimdF4 F4MaskW() { return F4CmpLt(F4Set(0.0f, 0.0f, 0.0f, -1.0f), F4Zero()); }
+
+MATH_INLINE float F4GetY(SimdF4 a) { return F4GetX(F4SplatY(a)); }
+MATH_INLINE float F4GetZ(SimdF4 a) { return F4GetX(F4SplatZ(a)); }
+MATH_INLINE float F4GetW(SimdF4 a) { return F4GetX(F4SplatW(a)); }
+
+//Sums splatted to every lane
+MATH_INLINE SimdF4 F4Dot3(SimdF4 a, SimdF4 b)
+{
+	SimdF4 m = F4Mul(a, b);
+	return F4Add(F4Add(F4SplatX(m), F4SplatY(m)), F4SplatZ(m));
+}
+
+MATH_INLINE SimdF4 F4Dot4(SimdF4 a, SimdF4 b)
+{
+	SimdF4 m = F4Mul(a, b);
+	SimdF4 s = F4Add(m, F4Shuffle<2, 3, 0, 1>(m));
+	return F4Add(s, F4Shuffle<1, 0, 3, 2>(s));
+}
+
+//w comes out 0
+MATH_INLINE SimdF4 F4Cross3(SimdF4 a, SimdF4 b)
+{
+	SimdF4 aYZX = F4Shuffle<1, 2, 0, 3>(a);
+	SimdF4 bYZX = F4Shuffle<1, 2, 0, 3>(b);
+	SimdF4 c = F4Sub(F4Mul(a, bYZX), F4Mul(aYZX, b));
+	return F4Shuffle<1, 2, 0, 3>(c);
+}
+
+//Rows to columns
+MATH_INLINE void F4Transpose(SimdF4 &r0, SimdF4 &r1, SimdF4 &r2, SimdF4 &r3)
+{
+	SimdF4 t0 = F4Shuffle2<0, 1, 0, 1>(r0, r1);		//x0 y0 x1 y1
+	SimdF4 t1 = F4Shuffle2<2, 3, 2, 3>(r0, r1);		//z0 w0 z1 w1
+	SimdF4 t2 = F4Shuffle2<0, 1, 0, 1>(r2, r3);		//x2 y2 x3 y3
+	SimdF4 t3 = F4Shuffle2<2, 3, 2, 3>(r2, r3);		//z2 w2 z3 w3
+
+	r0 = F4Shuffle2<0, 2, 0, 2>(t0, t2);
+	r1 = F4Shuffle2<1, 3, 1, 3>(t0, t2);
+	r2 = F4Shuffle2<0, 2, 0, 2>(t1, t3);
+	r3 = F4Shuffle2<1, 3, 1, 3>(t1, t3);
+}
+
+
+//----------------------------------------------------------------------------------------------------------
+//8 lanes, what the SoA kernels are written in. Two 4 lane halves where there is no AVX.
+
+const int MATH_SOA_LANES = 8;
+
+#if defined(DXAPP_MATH_BACKEND_AVX2)
+
+typedef __m256 SimdF8;
+
+MATH_INLINE SimdF8 F8Make(SimdF4 lo, SimdF4 hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1); }
+
+MATH_INLINE SimdF8 F8Splat(float f) { return _mm256_set1_ps(f); }
+MATH_INLINE SimdF8 F8Zero() { return _mm256_setzero_ps(); }
+MATH_INLINE SimdF8 F8Load(const float *p) { return _mm256_loadu_ps(p); }
+MATH_INLINE void   F8Store(float *p, SimdF8 a) { _mm256_storeu_ps(p, a); }
+
+//lo in lanes 0-3, hi in 4-7
+MATH_INLINE SimdF8 F8SplatHalves(float lo, float hi) { return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(lo)), _mm_set1_ps(hi), 1); }
+
+//base[indices[0..7]]
+MATH_INLINE SimdF8 F8Gather(const float *base, const uint32_t *indices) { return _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)indices), 4); }
+
+MATH_INLINE SimdF8 F8Add(SimdF8 a, SimdF8 b) { return _mm256_add_ps(a, b); }
+MATH_INLINE SimdF8 F8Sub(SimdF8 a, SimdF8 b) { return _mm256_sub_ps(a, b); }
+MATH_INLINE SimdF8 F8Mul(SimdF8 a, SimdF8 b) { return _mm256_mul_ps(a, b); }
+MATH_INLINE SimdF8 F8Div(SimdF8 a, SimdF8 b) { return _mm256_div_ps(a, b); }
+#if defined(__FMA__)
+MATH_INLINE SimdF8 F8MulAdd(SimdF8 a, SimdF8 b, SimdF8 c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+MATH_INLINE SimdF8 F8MulAdd(SimdF8 a, SimdF8 b, SimdF8 c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+MATH_INLINE SimdF8 F8Min(SimdF8 a, SimdF8 b) { return _mm256_min_ps(a, b); }
+MATH_INLINE SimdF8 F8Max(SimdF8 a, SimdF8 b) { return _mm256_max_ps(a, b); }
+MATH_INLINE SimdF8 F8Sqrt(SimdF8 a) { return _mm256_sqrt_ps(a); }
+MATH_INLINE SimdF8 F8Abs(SimdF8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+MATH_INLINE SimdF8 F8CmpLt(SimdF8 a, SimdF8 b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+MATH_INLINE SimdF8 F8CmpLe(SimdF8 a, SimdF8 b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+MATH_INLINE SimdF8 F8And(SimdF8 a, SimdF8 b) { return _mm256_and_ps(a, b); }
+MATH_INLINE SimdF8 F8Or(SimdF8 a, SimdF8 b) { return _mm256_or_ps(a, b); }
+MATH_INLINE SimdF8 F8Select(SimdF8 a, SimdF8 b, SimdF8 mask) { return _mm256_blendv_ps(a, b, mask); }
+MATH_INLINE int	   F8MoveMask(SimdF8 mask) { return _mm256_movemask_ps(mask); }
+
+#else
+
+struct SimdF8
+{
+	SimdF4 lo, hi;
+};
+
+MATH_INLINE SimdF8 F8Make(SimdF4 lo, SimdF4 hi) { SimdF8 r; r.lo = lo; r.hi = hi; return r; }
+
+MATH_INLINE SimdF8 F8Splat(float f) { SimdF4 s = F4Splat(f); return F8Make(s, s); }
+MATH_INLINE SimdF8 F8Zero() { return F8Splat(0.0f); }
+MATH_INLINE SimdF8 F8Load(const float *p) { return F8Make(F4Load(p), F4Load(p + 4)); }
+MATH_INLINE void   F8Store(float *p, SimdF8 a) { F4Store(p, a.lo); F4Store(p + 4, a.hi); }
+
+MATH_INLINE SimdF8 F8SplatHalves(float lo, float hi) { return F8Make(F4Splat(lo), F4Splat(hi)); }
+
+MATH_INLINE SimdF8 F8Gather(const float *base, const uint32_t *indices)
+{
+	return F8Make(F4Set(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]),
+		F4Set(base[indices[4]], base[indices[5]], base[indices[6]], base[indices[7]]));
+}
+
+#define F8_FROM_F4(name, op) \
+	MATH_INLINE SimdF8 name(SimdF8 a, SimdF8 b) { return F8Make(op(a.lo, b.lo), op(a.hi, b.hi)); }
+
+F8_FROM_F4(F8Add, F4Add)
+F8_FROM_F4(F8Sub, F4Sub)
+F8_FROM_F4(F8Mul, F4Mul)
+F8_FROM_F4(F8Div, F4Div)
+F8_FROM_F4(F8Min, F4Min)
+F8_FROM_F4(F8Max, F4Max)
+F8_FROM_F4(F8CmpLt, F4CmpLt)
+F8_FROM_F4(F8CmpLe, F4CmpLe)
+F8_FROM_F4(F8And, F4And)
+F8_FROM_F4(F8Or, F4Or)
+
+#undef F8_FROM_F4
+
+MATH_INLINE SimdF8 F8MulAdd(SimdF8 a, SimdF8 b, SimdF8 c) { return F8Make(F4MulAdd(a.lo, b.lo, c.lo), F4MulAdd(a.hi, b.hi, c.hi)); }
+MATH_INLINE SimdF8 F8Sqrt(SimdF8 a) { return F8Make(F4Sqrt(a.lo), F4Sqrt(a.hi)); }
+MATH_INLINE SimdF8 F8Abs(SimdF8 a) { return F8Make(F4Abs(a.lo), F4Abs(a.hi)); }
+MATH_INLINE SimdF8 F8Select(SimdF8 a, SimdF8 b, SimdF8 mask) { return F8Make(F4Select(a.lo, b.lo, mask.lo), F4Select(a.hi, b.hi, mask.hi)); }
+MATH_INLINE int	   F8MoveMask(SimdF8 mask) { return F4MoveMask(mask.lo) | (F4MoveMask(mask.hi) << 4); }
+
+#endif
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+
+#include "StartupGraph.h"
+#include "GameTimer.h"
+#include "ScopeLock.h"
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+StartupGraph::StartupGraph() : finished(0), bSucceeded(false), mainSignal(0), jobSystem(NULL), bInline(false),
+	startCounter(0), secondsPerCount(0.0), totalMs(0.0), criticalPathMs(0.0)
+{
+}
+
+int StartupGraph::AddStep(const char *name, const std::function<bool()> &work, bool bMainThread, std::initializer_list<int> dependencies)
+{
+	Step step;
+	step.name = name;
+	step.work = work;
+	step.bMainThread = bMainThread;
+	step.pending = 0;
+	step.bSkip = false;
+
+	int id = (int)steps.size();
+	steps.push_back(step);
+
+	for (auto it = dependencies.begin(); it != dependencies.end(); ++it)
+		AddDependency(id, *it);
+
+	return id;
+}
+
+void StartupGraph::AddDependency(int step, int dependsOn)
+{
+	if (step < 0 || step >= (int)steps.size() || dependsOn < 0 || dependsOn >= (int)steps.size() || step == dependsOn)
+		return;
+
+	steps[dependsOn].dependents.push_back(step);
+	steps[step].dependencies.push_back(dependsOn);
+}
+
+void StartupGraph::Reset()
+{
+	steps.clear();
+	timings.clear();
+	stepJobs.clear();
+	mainReady.clear();
+	finished = 0;
+	bSucceeded = false;
+	totalMs = 0.0;
+	criticalPathMs = 0.0;
+}
+
+double StartupGraph::NowMs() const
+{
+	int64_t counter = 0;
+	GameTimer::QueryCounter(counter);
+	return (counter - startCounter) * secondsPerCount * 1000.0;
+}
+
+bool StartupGraph::Run(JobSystem &jobs)
+{
+	jobSystem = &jobs;
+
+	//Nobody else to run anything, or we couldn't help with our own jobs while waiting: just go in order
+	bInline = !jobs.IsRunning() || jobs.WorkerCount() == 0 || jobs.CurrentThreadSlot() < 0;
+
+	GameTimer timer;
+	secondsPerCount = timer.SecondsPerCount();
+	GameTimer::QueryCounter(startCounter);
+
+	timings.resize(steps.size());
+	stepJobs.resize(steps.size());
+
+	std::vector<int> ready;
+
+	{
+		ScopeLock<SpinParkMutex> scope(lock);
+
+		mainReady.clear();
+		finished = 0;
+		bSucceeded = true;
+
+		for (size_t i = 0; i < steps.size(); ++i)
+		{
+			Step &step = steps[i];
+			step.pending = (int)step.dependencies.size();
+			step.bSkip = false;
+
+			StartupStepTiming &timing = timings[i];
+			timing.name = step.name;
+			timing.startMs = timing.endMs = timing.finishBoundMs = 0.0;
+			timing.threadSlot = -1;
+			timing.bMainThread = step.bMainThread;
+			timing.bRan = false;
+			timing.bSucceeded = false;
+
+			stepJobs[i].graph = this;
+			stepJobs[i].step = (int)i;
+
+			if (step.pending == 0)
+				ready.push_back((int)i);
+		}
+	}
+
+	//Steps in or under a dependency cycle never get ready. Count the ones that will up front (topological
+	//order from the ready ones), Run waits for just those and fails if that isn't all of them.
+	int runnable = CountRunnable(ready);
+	if (runnable < (int)steps.size())
+		bSucceeded = false;
+
+	for (size_t i = 0; i < ready.size(); ++i)
+		Launch(ready[i]);
+
+	//Run main thread steps as they come up, park in between
+	for (;;)
+	{
+		uint32_t signal = mainSignal.load(std::memory_order_acquire);
+
+		int step = STARTUP_INVALID_STEP;
+		bool bDone = false;
+		{
+			ScopeLock<SpinParkMutex> scope(lock);
+			bDone = (finished == runnable);
+
+			if (!mainReady.empty())
+			{
+				step = mainReady.back();
+				mainReady.pop_back();
+			}
+		}
+
+		if (step != STARTUP_INVALID_STEP)
+		{
+			Execute(step);
+			continue;
+		}
+
+		if (bDone)
+			break;
+
+		LockParkOnAddress(mainSignal, signal, LOCK_WAIT_INFINITE);
+	}
+
+	//Step jobs touch the counter after their last Finish
+	if (!bInline)
+		jobs.Wait(jobsDone);
+
+	totalMs = NowMs();
+	jobSystem = NULL;
+
+	FindCriticalPath();
+
+	return bSucceeded;
+}
+
+int StartupGraph::CountRunnable(const std::vector<int> &ready) const
+{
+	std::vector<int> remaining(steps.size());
+	for (size_t i = 0; i < steps.size(); ++i)
+		remaining[i] = (int)steps[i].dependencies.size();
+
+	std::vector<int> order(ready);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const std::vector<int> &dependents = steps[order[i]].dependents;
+		for (size_t d = 0; d < dependents.size(); ++d)
+			if (--remaining[dependents[d]] == 0)
+				order.push_back(dependents[d]);
+	}
+
+	return (int)order.size();
+}
+
+void StartupGraph::Launch(int step)
+{
+	if (steps[step].bMainThread || bInline)
+	{
+		{
+			ScopeLock<SpinParkMutex> scope(lock);
+			mainReady.push_back(step);
+		}
+
+		mainSignal.fetch_add(1, std::memory_order_release);
+		LockUnparkAll(mainSignal);
+		return;
+	}
+
+	jobSystem->Submit(&StartupGraph::StepJobProc, &stepJobs[step], 0, 1, 0, &jobsDone);
+}
+
+void StartupGraph::StepJobProc(void *data, uint32_t, uint32_t)
+{
+	StepJob *job = static_cast<StepJob*>(data);
+	job->graph->Execute(job->step);
+}
+
+void StartupGraph::Execute(int step)
+{
+	Step &s = steps[step];
+	StartupStepTiming &timing = timings[step];
+
+	bool bSkip;
+	{
+		ScopeLock<SpinParkMutex> scope(lock);
+		bSkip = s.bSkip;
+	}
+
+	bool bOk = false;
+	if (!bSkip)
+	{
+		timing.threadSlot = jobSystem->CurrentThreadSlot();
+		timing.startMs = NowMs();
+		bOk = s.work ? s.work() : true;
+		timing.endMs = NowMs();
+		timing.bRan = true;
+		timing.bSucceeded = bOk;
+	}
+
+	Finish(step, bOk);
+}
+
+void StartupGraph::Finish(int step, bool bOk)
+{
+	std::vector<int> ready;
+
+	{
+		ScopeLock<SpinParkMutex> scope(lock);
+
+		if (!bOk)
+			bSucceeded = false;
+
+		const std::vector<int> &dependents = steps[step].dependents;
+		for (size_t i = 0; i < dependents.size(); ++i)
+		{
+			Step &dependent = steps[dependents[i]];
+
+			//Skipped steps pass the failure on
+			if (!bOk)
+				dependent.bSkip = true;
+
+			if (--dependent.pending == 0)
+				ready.push_back(dependents[i]);
+		}
+
+		++finished;
+	}
+
+	for (size_t i = 0; i < ready.size(); ++i)
+		Launch(ready[i]);
+
+	//The main thread may be waiting for the last one
+	mainSignal.fetch_add(1, std::memory_order_release);
+	LockUnparkAll(mainSignal);
+}
+
+//Earliest each step could have finished given only its dependencies (unlimited threads, no waiting)
+void StartupGraph::FindCriticalPath()
+{
+	//Dependencies are mostly added before their dependents, but AddDependency can point either way, so go
+	//until nothing changes (a handful of steps)
+	for (size_t pass = 0; pass < steps.size(); ++pass)
+	{
+		bool bChanged = false;
+
+		for (size_t i = 0; i < steps.size(); ++i)
+		{
+			double start = 0.0;
+			for (size_t d = 0; d < steps[i].dependencies.size(); ++d)
+			{
+				if (timings[steps[i].dependencies[d]].finishBoundMs > start)
+					start = timings[steps[i].dependencies[d]].finishBoundMs;
+			}
+
+			double finish = start + (timings[i].endMs - timings[i].startMs);
+			if (finish != timings[i].finishBoundMs)
+			{
+				timings[i].finishBoundMs = finish;
+				bChanged = true;
+			}
+		}
+
+		if (!bChanged)
+			break;
+	}
+
+	criticalPathMs = 0.0;
+	for (size_t i = 0; i < timings.size(); ++i)
+	{
+		if (timings[i].finishBoundMs > criticalPathMs)
+			criticalPathMs = timings[i].finishBoundMs;
+	}
+}
+
+double StartupGraph::SerialMs() const
+{
+	double total = 0.0;
+	for (size_t i = 0; i < timings.size(); ++i)
+		total += timings[i].endMs - timings[i].startMs;
+	return total;
+}
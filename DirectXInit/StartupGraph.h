@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "JobSystem.h"
+#include "Locks.h"
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <stdint.h>
+#include <vector>
+
+
+const int STARTUP_INVALID_STEP = -1;
+
+struct StartupStepTiming
+{
+	const char *name;
+	double	startMs;			//From the start of Run
+	double	endMs;
+	double	finishBoundMs;		//Earliest it could have finished with unlimited threads (its critical path)
+	int		threadSlot;			//Job system slot it ran on, -1 if not registered
+	bool	bMainThread;
+	bool	bRan;				//False if skipped because something it depends on failed
+	bool	bSucceeded;
+};
+
+
+//Init as a dependency graph instead of one step after another. Steps are added with what they depend on
+//and Run starts each as soon as its dependencies are done: anything that may run anywhere goes to the job
+//system, main thread steps (window creation, anything DXGI will send window messages for) run on the
+//thread calling Run. Every step is timed, so the critical path to the first frame can be seen and worked on.
+//
+//A step returns false to fail. Steps depending on it are skipped, everything else still runs, and Run
+//returns false. Same for a dependency cycle, the steps in it and under it never run. Steps are added before Run, from one thread, and a graph is run once (Reset to reuse).
+
+class StartupGraph
+{
+public:
+	StartupGraph();
+
+	//Dependencies must have been added already. Returns the step id.
+	int  AddStep(const char *name, const std::function<bool()> &work, bool bMainThread = false,
+		std::initializer_list<int> dependencies = std::initializer_list<int>());
+
+	//For making an existing step wait on one added later (an app step the base steps need)
+	void AddDependency(int step, int dependsOn);
+
+	//From a thread registered with jobs (or with no workers, then everything runs on this thread)
+	bool Run(JobSystem &jobs);
+
+	void Reset();
+
+	inline int  StepCount() const { return (int)steps.size(); };
+	inline bool Succeeded() const { return bSucceeded; };
+
+	//Valid after Run
+	inline const std::vector<StartupStepTiming>& Timings() const { return timings; };
+	inline double TotalMs() const { return totalMs; };
+	inline int64_t StartCounter() const { return startCounter; };		//GameTimer::QueryCounter at the start of Run, what the ms are from
+	inline double CriticalPathMs() const { return criticalPathMs; };	//Longest chain of step times, the best Run can do
+	double SerialMs() const;			//Sum of all step times, what one thread doing everything would take
+
+private:
+
+	struct Step
+	{
+		const char *name;
+		std::function<bool()> work;
+		bool bMainThread;
+		std::vector<int> dependents;
+		std::vector<int> dependencies;
+		int  pending;					//Dependencies not finished yet, under lock
+		bool bSkip;						//A dependency failed
+	};
+
+	struct StepJob
+	{
+		StartupGraph *graph;
+		int step;
+	};
+
+	StartupGraph(const StartupGraph&);
+	StartupGraph& operator=(const StartupGraph&);
+
+	static void StepJobProc(void *data, uint32_t begin, uint32_t end);
+
+	int  CountRunnable(const std::vector<int> &ready) const;	//Steps that will get to run, given the ones with no dependencies
+	void Launch(int step);
+	void Execute(int step);
+	void Finish(int step, bool bOk);
+	void FindCriticalPath();
+	double NowMs() const;
+
+	std::vector<Step> steps;
+	std::vector<StartupStepTiming> timings;
+	std::vector<StepJob> stepJobs;
+
+	//Scheduling state, everything below under lock
+	SpinParkMutex lock;
+	std::vector<int> mainReady;
+	int  finished;
+	bool bSucceeded;
+
+	//Bumped whenever there is something for the main thread to look at, it parks on it otherwise
+	std::atomic<uint32_t> mainSignal;
+
+	JobSystem *jobSystem;
+	JobCounter jobsDone;
+	bool bInline;
+	int64_t startCounter;
+	double secondsPerCount;
+	double totalMs;
+	double criticalPathMs;
+};
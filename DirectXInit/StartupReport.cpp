@@ -0,0 +1,159 @@
+#include "stdafx.h"
+
+#include "StartupReport.h"
+#include "GameTimer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <stdio.h>
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+static bool WriteFile(const char *path, const std::string &text)
+{
+	if (!path)
+		return false;
+
+	FILE *file = NULL;
+#ifdef _WIN32
+	if (fopen_s(&file, path, "wb") != 0)
+		file = NULL;
+#else
+	file = fopen(path, "wb");
+#endif
+
+	if (!file)
+		return false;
+
+	bool bOk = fwrite(text.data(), 1, text.size(), file) == text.size();
+	return (fclose(file) == 0) && bOk;
+}
+
+static void AppendFormat(std::string &out, const char *format, double a, double b = 0.0, double c = 0.0)
+{
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), format, a, b, c);
+	out += buffer;
+}
+
+
+StartupReport::StartupReport() : originCounter(0), msPerCount(0.0), firstFrameMs(0.0), bFinished(false)
+{
+	int64_t frequency = 0;
+	if (GameTimer::QueryFrequency(frequency) && frequency > 0)
+		msPerCount = 1000.0 / (double)frequency;
+}
+
+void StartupReport::Begin()
+{
+	GameTimer::QueryCounter(originCounter);
+	stages.clear();
+	firstFrameMs = 0.0;
+	bFinished = false;
+}
+
+double StartupReport::ToMs(int64_t counter) const
+{
+	return (counter - originCounter) * msPerCount;
+}
+
+double StartupReport::NowMs() const
+{
+	int64_t counter = 0;
+	GameTimer::QueryCounter(counter);
+	return ToMs(counter);
+}
+
+void StartupReport::AddStage(const char *category, const char *name, double startMs, double endMs, int thread, bool bSucceeded)
+{
+	StartupStage stage;
+	stage.category = category ? category : "";
+	stage.name = name ? name : "";
+	stage.startMs = startMs;
+	stage.endMs = endMs;
+	stage.thread = thread;
+	stage.bSucceeded = bSucceeded;
+	stages.push_back(stage);
+}
+
+void StartupReport::Finish(double firstFrame)
+{
+	firstFrameMs = firstFrame;
+	bFinished = true;
+
+	std::stable_sort(stages.begin(), stages.end(), [](const StartupStage &a, const StartupStage &b) { return a.startMs < b.startMs; });
+}
+
+void StartupReport::FormatText(std::string &out) const
+{
+	out.clear();
+
+	if (bFinished)
+		AppendFormat(out, "Startup: first frame at %.3f ms\n\n", firstFrameMs);
+	else
+		out += "Startup: no frame presented yet\n\n";
+
+	char line[256];
+	snprintf(line, sizeof(line), "  %-8s %-34s %10s %10s %10s %7s\n", "", "stage", "start ms", "end ms", "ms", "thread");
+	out += line;
+
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		const StartupStage &stage = stages[i];
+		snprintf(line, sizeof(line), "  %-8s %-34s %10.3f %10.3f %10.3f %7d%s\n", stage.category.c_str(), stage.name.c_str(),
+			stage.startMs, stage.endMs, stage.endMs - stage.startMs, stage.thread, stage.bSucceeded ? "" : "  FAILED");
+		out += line;
+	}
+}
+
+void StartupReport::FormatJson(std::string &out) const
+{
+	out.clear();
+	out += "{\n";
+	AppendFormat(out, "  \"firstFrameMs\": %.4f,\n", bFinished ? firstFrameMs : -1.0);
+	out += "  \"stages\": [\n";
+
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		const StartupStage &stage = stages[i];
+
+		out += "    { \"category\": ";
+		AppendJsonString(out, stage.category.c_str());
+		out += ", \"name\": ";
+		AppendJsonString(out, stage.name.c_str());
+		AppendFormat(out, ", \"startMs\": %.4f, \"endMs\": %.4f, \"ms\": %.4f", stage.startMs, stage.endMs, stage.endMs - stage.startMs);
+		AppendFormat(out, ", \"thread\": %.0f", (double)stage.thread);
+		out += stage.bSucceeded ? ", \"succeeded\": true }" : ", \"succeeded\": false }";
+		out += (i + 1 < stages.size()) ? ",\n" : "\n";
+	}
+
+	out += "  ]\n}\n";
+}
+
+bool StartupReport::WriteText(const char *path) const
+{
+	std::string text;
+	FormatText(text);
+	return WriteFile(path, text);
+}
+
+bool StartupReport::WriteJson(const char *path) const
+{
+	std::string json;
+	FormatJson(json);
+	return WriteFile(path, json);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+struct StartupStage
+{
+	std::string category;		//"app", "graph", "mgr", ...
+	std::string name;
+	double	startMs;			//From Begin
+	double	endMs;
+	int		thread;				//Job system slot, -1 for unknown/unregistered
+	bool	bSucceeded;
+};
+
+
+//Where launch time went: stages stamped with GameTimer counters against the moment the app was constructed,
+//up to the first frame presented. Filled by DxAppBase (graph steps, DirectXManager init calls, InitApp and
+//the first frame), apps can add their own. Printed as a table or written as text/JSON.
+//
+//Filled from one thread at a time: init, then whoever presents the first frame.
+
+class StartupReport
+{
+public:
+	StartupReport();
+
+	//Everything is relative to this
+	void Begin();
+	inline int64_t OriginCounter() const { return originCounter; };
+
+	//ms since Begin for a GameTimer::QueryCounter value, and for now
+	double ToMs(int64_t counter) const;
+	double NowMs() const;
+
+	void AddStage(const char *category, const char *name, double startMs, double endMs, int thread = -1, bool bSucceeded = true);
+
+	//First frame is out, the report is complete
+	void Finish(double firstFrameMs);
+	inline bool IsFinished() const { return bFinished; };
+	inline double FirstFrameMs() const { return firstFrameMs; };
+
+	inline const std::vector<StartupStage>& Stages() const { return stages; };
+
+	//Stages by start time
+	void FormatText(std::string &out) const;
+	void FormatJson(std::string &out) const;
+
+	bool WriteText(const char *path) const;
+	bool WriteJson(const char *path) const;
+
+private:
+
+	int64_t originCounter;
+	double	msPerCount;
+	double	firstFrameMs;
+	bool	bFinished;
+
+	std::vector<StartupStage> stages;
+};
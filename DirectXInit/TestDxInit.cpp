@@ -2,7 +2,13 @@
 #include "DxAppBase.h"
 #include <Windows.h>
 #include <assert.h>
-#include "d3dUtil.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "VecMath.h"
 
 #ifdef _DEBUG
 #include <crtdbg.h>
@@ -22,8 +28,12 @@ public:
 
 	//Required abstract methods
 	void ProcSceneUpdate(float _dt);
-	void ProcSceneDraw();
+	void ProcSceneDraw(float _alpha);
 
+private:
+
+	//Stand-in scene state, just so the update has something to spread across the job system
+	std::vector<float> mPhases;
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
@@ -35,12 +45,54 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	TestDxInit theApp(hInstance);
 
+	//-headless [frames]: no window, null device, run that many frames and exit (for timing the update)
+	const char *headless = strstr(cmdLine, "-headless");
+	if (headless)
+	{
+		int frames = atoi(headless + 9);
+		theApp.SetHeadless(true);
+		theApp.SetFrameLimit(frames > 0 ? frames : 10000);
+	}
+
+	//-fps N: cap the frame rate
+	const char *fps = strstr(cmdLine, "-fps");
+	if (fps)
+		theApp.SetFrameRateLimit(atof(fps + 4));
+
+	//-profile N: Chrome trace of the first N frames, profile.json next to the exe
+	const char *profile = strstr(cmdLine, "-profile");
+	if (profile)
+	{
+		int frames = atoi(profile + 8);
+		theApp.CaptureProfile(frames > 0 ? frames : 60, "profile.json");
+	}
+
+	//-startupreport: print where launch time went once the first frame is out, and keep it next to the exe
+	if (strstr(cmdLine, "-startupreport"))
+		theApp.SetStartupReportOutput(true, "startup.txt", "startup.json");
+
+	//-lockstats: on the way out, print how much each tracked lock was waited on and held (recording is off by
+	//default outside debug builds)
+	bool bLockStats = strstr(cmdLine, "-lockstats") != NULL;
+	if (bLockStats)
+		LockStatsSetEnabled(true);
+
 	if (!theApp.InitApp())
 	{
 		return 0;
 	}
 
-	return theApp.Run();
+	int result = theApp.Run();
+
+	if (bLockStats)
+	{
+		std::string report;
+		LockStatsFormatReport(report);
+		OutputDebugStringA(report.c_str());
+		fputs(report.c_str(), stdout);
+	}
+
+	return result;
 
 }
 
@@ -48,7 +100,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 
 TestDxInit::TestDxInit(HINSTANCE hInstance)
-	: DxAppBase(hInstance)
+	: DxAppBase(hInstance), mPhases(16384, 0.0f)
 {
 
 }
@@ -74,30 +126,41 @@ bool TestDxInit::OnResizeHandler()
 
 void TestDxInit::ProcSceneUpdate(float _dt)
 {
+	float *phases = &mPhases[0];
 
+	//Each job gets a [begin, end) slice, this thread helps out until they're all done
+	Jobs().ParallelFor((uint32_t)mPhases.size(), 1024, [phases, _dt](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+			phases[i] = fmodf(phases[i] + _dt * (1.0f + (i & 7)), 6.2831853f);
+	});
 }
 
-void TestDxInit::ProcSceneDraw()
+void TestDxInit::ProcSceneDraw(float _alpha)
 {
-	_dxMgr.LockMgr();
+	//Timed out, or another thread has the context claimed: skip the frame rather than draw unlocked
+	if (!_dxMgr.LockMgr())
+		return;
+
 	if (_dxMgr.GetCurrentState() != STATE_MGR_VIEWPORT_CREATED)
 	{
 		_dxMgr.UnlockMgr();
 		return;
 	}
 
-	assert(_dxMgr.CurrentDeviceContext());
-	assert(_dxMgr.CurrentSwapChain());
+	_renderCommands.Reset();
 
 	//Clear back buffer blue.
-
-	_dxMgr.CurrentDeviceContext()->ClearRenderTargetView(_dxMgr.CurrentRenderTargetView(), (const float*)&Colors::Blue);
+	_renderCommands.ClearColor(MakePassStartKey(0), &Colors::Blue.x);
 
 	//clear depth buffer to 1.0f and stencil buffer to 0.
-	_dxMgr.CurrentDeviceContext()->ClearDepthStencilView(_dxMgr.CurrentDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	_renderCommands.ClearDepthStencil(MakePassStartKey(0), 1.0f, 0);
+
+	//Sorts by key and replays into the device context
+	_renderCommands.Submit(_dxMgr.Context());
 
 	//Present back buffer to screen
-	_dxMgr.CurrentSwapChain()->Present(0, 0);
+	_dxMgr.Present(0);
 	_dxMgr.UnlockMgr();
 	return;
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <atomic>
+#include <stdint.h>
+
+
+//Single producer / single consumer triple buffer, latest wins.
+//The producer always has a buffer to write into and the consumer always has one to read from, the third
+//sits in the middle and the two sides swap with it using one atomic exchange. Neither side ever waits,
+//if the producer publishes twice before the consumer looks, the older one is simply overwritten.
+
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : writeIndex(0), readIndex(1), middle(2) { }
+
+	//Direct access for setting the buffers up before either side starts
+	inline T& Buffer(int i) { return buffers[i]; }
+
+	//Producer side
+	inline T& WriteBuffer() { return buffers[writeIndex]; }
+
+	inline void Publish()
+	{
+		uint32_t prev = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+		writeIndex = prev & INDEX_MASK;
+	}
+
+	//Consumer side. Returns true if a newer buffer was published since the last call, ReadBuffer is
+	//unchanged otherwise.
+	inline bool Acquire()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+
+		uint32_t prev = middle.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = prev & INDEX_MASK;
+		return true;
+	}
+
+	inline const T& ReadBuffer() const { return buffers[readIndex]; }
+	inline T& ReadBuffer() { return buffers[readIndex]; }
+
+private:
+	static const uint32_t FRESH = 4;
+	static const uint32_t INDEX_MASK = 3;
+
+	TripleBuffer(const TripleBuffer&);
+	TripleBuffer& operator=(const TripleBuffer&);
+
+	T buffers[3];
+
+	//Owned by the producer / consumer respectively
+	uint32_t writeIndex;
+	uint32_t readIndex;
+
+	//Index of the middle buffer, plus FRESH if the producer published it and the consumer hasn't taken it
+	std::atomic<uint32_t> middle;
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+/*
+Copyright (c) 2016, Eric Pouladian
+
+Permission to use, copy, modify, and/or distribute this software for any
+purpose with or without fee is hereby granted, provided that the above
+copyright notice and this permission notice appear in all copies.
+
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include "SimdMath.h"
+
+//Vector/matrix/quaternion math, header only, in place of xnamath. Same conventions as D3D and xnamath so
+//matrices go to shaders the way they always did: row vectors (v * M), translation in the last row,
+//left handed view/projection, depth 0..1.
+//
+//Float3/Float4/Float4x4 are for storing (members, arrays, constant buffers), Vec4/Mat4/Quat are for working
+//on, they live in SIMD registers (SimdMath.h picks SSE2/AVX2/NEON/scalar). Load, do the math, store back.
+//For lots of points at once see MathBatch.h.
+
+const float MATH_PI = 3.14159265358979f;
+
+
+struct Float2
+{
+	float x, y;
+};
+
+struct Float3
+{
+	float x, y, z;
+};
+
+struct Float4
+{
+	float x, y, z, w;
+};
+
+//Row major, m[row][column]
+struct Float4x4
+{
+	float m[4][4];
+};
+
+
+//----------------------------------------------------------------------------------------------------------
+//Vec4
+
+struct Vec4
+{
+	SimdF4 v;
+};
+
+MATH_INLINE Vec4 MakeVec4(SimdF4 v) { Vec4 r; r.v = v; return r; }
+
+MATH_INLINE Vec4 Vec4Set(float x, float y, float z, float w) { return MakeVec4(F4Set(x, y, z, w)); }
+MATH_INLINE Vec4 Vec4Splat(float f) { return MakeVec4(F4Splat(f)); }
+MATH_INLINE Vec4 Vec4Zero() { return MakeVec4(F4Zero()); }
+
+MATH_INLINE Vec4 LoadFloat3(const Float3 &f, float w = 0.0f) { return Vec4Set(f.x, f.y, f.z, w); }
+MATH_INLINE Vec4 LoadFloat4(const Float4 &f) { return MakeVec4(F4Load(&f.x)); }
+
+MATH_INLINE void StoreFloat4(Float4 &out, Vec4 a) { F4Store(&out.x, a.v); }
+MATH_INLINE void StoreFloat3(Float3 &out, Vec4 a)
+{
+	float v[4];
+	F4Store(v, a.v);
+	out.x = v[0]; out.y = v[1]; out.z = v[2];
+}
+
+MATH_INLINE float Vec4GetX(Vec4 a) { return F4GetX(a.v); }
+MATH_INLINE float Vec4GetY(Vec4 a) { return F4GetY(a.v); }
+MATH_INLINE float Vec4GetZ(Vec4 a) { return F4GetZ(a.v); }
+MATH_INLINE float Vec4GetW(Vec4 a) { return F4GetW(a.v); }
+
+MATH_INLINE Vec4 operator+(Vec4 a, Vec4 b) { return MakeVec4(F4Add(a.v, b.v)); }
+MATH_INLINE Vec4 operator-(Vec4 a, Vec4 b) { return MakeVec4(F4Sub(a.v, b.v)); }
+MATH_INLINE Vec4 operator*(Vec4 a, Vec4 b) { return MakeVec4(F4Mul(a.v, b.v)); }
+MATH_INLINE Vec4 operator/(Vec4 a, Vec4 b) { return MakeVec4(F4Div(a.v, b.v)); }
+MATH_INLINE Vec4 operator*(Vec4 a, float s) { return MakeVec4(F4Mul(a.v, F4Splat(s))); }
+MATH_INLINE Vec4 operator*(float s, Vec4 a) { return MakeVec4(F4Mul(a.v, F4Splat(s))); }
+MATH_INLINE Vec4 operator-(Vec4 a) { return MakeVec4(F4Neg(a.v)); }
+
+MATH_INLINE Vec4 Vec4Min(Vec4 a, Vec4 b) { return MakeVec4(F4Min(a.v, b.v)); }
+MATH_INLINE Vec4 Vec4Max(Vec4 a, Vec4 b) { return MakeVec4(F4Max(a.v, b.v)); }
+MATH_INLINE Vec4 Vec4Lerp(Vec4 a, Vec4 b, float t) { return MakeVec4(F4MulAdd(F4Sub(b.v, a.v), F4Splat(t), a.v)); }
+
+MATH_INLINE float Dot3(Vec4 a, Vec4 b) { return F4GetX(F4Dot3(a.v, b.v)); }
+MATH_INLINE float Dot4(Vec4 a, Vec4 b) { return F4GetX(F4Dot4(a.v, b.v)); }
+MATH_INLINE Vec4  Cross3(Vec4 a, Vec4 b) { return MakeVec4(F4Cross3(a.v, b.v)); }
+
+MATH_INLINE float LengthSq3(Vec4 a) { return Dot3(a, a); }
+MATH_INLINE float Length3(Vec4 a) { return F4GetX(F4Sqrt(F4Dot3(a.v, a.v))); }
+
+//Zero length stays zero. w is scaled along with xyz, keep it 0 for directions.
+MATH_INLINE Vec4 Normalize3(Vec4 a)
+{
+	SimdF4 lengthSq = F4Dot3(a.v, a.v);
+	SimdF4 scaled = F4Div(a.v, F4Sqrt(lengthSq));
+	return MakeVec4(F4And(scaled, F4CmpLt(F4Zero(), lengthSq)));
+}
+
+
+//----------------------------------------------------------------------------------------------------------
+//Mat4
+
+struct Mat4
+{
+	Vec4 r[4];
+};
+
+MATH_INLINE Mat4 MakeMat4(Vec4 r0, Vec4 r1, Vec4 r2, Vec4 r3)
+{
+	Mat4 m;
+	m.r[0] = r0; m.r[1] = r1; m.r[2] = r2; m.r[3] = r3;
+	return m;
+}
+
+MATH_INLINE Mat4 Mat4Identity()
+{
+	return MakeMat4(Vec4Set(1.0f, 0.0f, 0.0f, 0.0f), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f), Vec4Set(0.0f, 0.0f, 1.0f, 0.0f), Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+MATH_INLINE Mat4 LoadFloat4x4(const Float4x4 &f)
+{
+	return MakeMat4(MakeVec4(F4Load(f.m[0])), MakeVec4(F4Load(f.m[1])), MakeVec4(F4Load(f.m[2])), MakeVec4(F4Load(f.m[3])));
+}
+
+MATH_INLINE void StoreFloat4x4(Float4x4 &out, const Mat4 &m)
+{
+	for (int i = 0; i < 4; ++i)
+		F4Store(out.m[i], m.r[i].v);
+}
+
+//Full 4 component v * M
+MATH_INLINE Vec4 Transform4(Vec4 v, const Mat4 &m)
+{
+	SimdF4 r = F4Mul(F4SplatX(v.v), m.r[0].v);
+	r = F4MulAdd(F4SplatY(v.v), m.r[1].v, r);
+	r = F4MulAdd(F4SplatZ(v.v), m.r[2].v, r);
+	return MakeVec4(F4MulAdd(F4SplatW(v.v), m.r[3].v, r));
+}
+
+//xyz as a point (w = 1), no divide by w
+MATH_INLINE Vec4 TransformPoint(Vec4 p, const Mat4 &m)
+{
+	SimdF4 r = F4MulAdd(F4SplatX(p.v), m.r[0].v, m.r[3].v);
+	r = F4MulAdd(F4SplatY(p.v), m.r[1].v, r);
+	return MakeVec4(F4MulAdd(F4SplatZ(p.v), m.r[2].v, r));
+}
+
+//xyz as a direction (w = 0), translation ignored
+MATH_INLINE Vec4 TransformVector(Vec4 d, const Mat4 &m)
+{
+	SimdF4 r = F4Mul(F4SplatX(d.v), m.r[0].v);
+	r = F4MulAdd(F4SplatY(d.v), m.r[1].v, r);
+	return MakeVec4(F4MulAdd(F4SplatZ(d.v), m.r[2].v, r));
+}
+
+//a then b
+MATH_INLINE Mat4 Mat4Multiply(const Mat4 &a, const Mat4 &b)
+{
+	return MakeMat4(Transform4(a.r[0], b), Transform4(a.r[1], b), Transform4(a.r[2], b), Transform4(a.r[3], b));
+}
+
+MATH_INLINE Mat4 operator*(const Mat4 &a, const Mat4 &b) { return Mat4Multiply(a, b); }
+
+MATH_INLINE Mat4 Mat4Transpose(const Mat4 &m)
+{
+	Mat4 t = m;
+	F4Transpose(t.r[0].v, t.r[1].v, t.r[2].v, t.r[3].v);
+	return t;
+}
+
+MATH_INLINE Mat4 Mat4Translation(float x, float y, float z)
+{
+	Mat4 m = Mat4Identity();
+	m.r[3] = Vec4Set(x, y, z, 1.0f);
+	return m;
+}
+
+MATH_INLINE Mat4 Mat4Scaling(float x, float y, float z)
+{
+	return MakeMat4(Vec4Set(x, 0.0f, 0.0f, 0.0f), Vec4Set(0.0f, y, 0.0f, 0.0f), Vec4Set(0.0f, 0.0f, z, 0.0f), Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+MATH_INLINE Mat4 Mat4RotationX(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	return MakeMat4(Vec4Set(1.0f, 0.0f, 0.0f, 0.0f), Vec4Set(0.0f, c, s, 0.0f), Vec4Set(0.0f, -s, c, 0.0f), Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+MATH_INLINE Mat4 Mat4RotationY(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	return MakeMat4(Vec4Set(c, 0.0f, -s, 0.0f), Vec4Set(0.0f, 1.0f, 0.0f, 0.0f), Vec4Set(s, 0.0f, c, 0.0f), Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+MATH_INLINE Mat4 Mat4RotationZ(float angle)
+{
+	float s = sinf(angle), c = cosf(angle);
+	return MakeMat4(Vec4Set(c, s, 0.0f, 0.0f), Vec4Set(-s, c, 0.0f, 0.0f), Vec4Set(0.0f, 0.0f, 1.0f, 0.0f), Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+//Inverse of a matrix whose last column is (0, 0, 0, 1): rotation/scale/shear plus translation. Much cheaper
+//than Mat4Inverse, garbage for projections.
+MATH_INLINE Mat4 Mat4InverseAffine(const Mat4 &m)
+{
+	//Rows of the 3x3 inverse are the transposed cofactor rows over the determinant
+	SimdF4 c0 = F4Cross3(m.r[1].v, m.r[2].v);
+	SimdF4 c1 = F4Cross3(m.r[2].v, m.r[0].v);
+	SimdF4 c2 = F4Cross3(m.r[0].v, m.r[1].v);
+	SimdF4 c3 = F4Zero();
+	SimdF4 invDet = F4Div(F4Splat(1.0f), F4Dot3(m.r[0].v, c0));
+
+	F4Transpose(c0, c1, c2, c3);
+
+	Mat4 inv;
+	inv.r[0] = MakeVec4(F4Mul(c0, invDet));
+	inv.r[1] = MakeVec4(F4Mul(c1, invDet));
+	inv.r[2] = MakeVec4(F4Mul(c2, invDet));
+
+	SimdF4 t = TransformVector(m.r[3], inv).v;
+	inv.r[3] = MakeVec4(F4Select(F4Neg(t), F4Splat(1.0f), F4MaskW()));
+	return inv;
+}
+
+//General inverse by cofactors. A singular matrix gives back all zeros (and *determinant 0).
+inline Mat4 Mat4Inverse(const Mat4 &matrix, float *determinant = NULL)
+{
+	Float4x4 f;
+	StoreFloat4x4(f, matrix);
+	const float *m = &f.m[0][0];
+	float inv[16];
+
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (determinant)
+		*determinant = det;
+
+	float scale = det != 0.0f ? 1.0f / det : 0.0f;
+	for (int i = 0; i < 16; ++i)
+		f.m[i >> 2][i & 3] = inv[i] * scale;
+
+	return LoadFloat4x4(f);
+}
+
+//Left handed perspective, depth 0 at zNear to 1 at zFar (D3DXMatrixPerspectiveFovLH)
+MATH_INLINE Mat4 Mat4PerspectiveFovLH(float fovY, float aspect, float zNear, float zFar)
+{
+	float h = 1.0f / tanf(fovY * 0.5f);
+	float w = h / aspect;
+	float q = zFar / (zFar - zNear);
+	return MakeMat4(Vec4Set(w, 0.0f, 0.0f, 0.0f), Vec4Set(0.0f, h, 0.0f, 0.0f), Vec4Set(0.0f, 0.0f, q, 1.0f), Vec4Set(0.0f, 0.0f, -zNear * q, 0.0f));
+}
+
+MATH_INLINE Mat4 Mat4OrthographicLH(float width, float height, float zNear, float zFar)
+{
+	float q = 1.0f / (zFar - zNear);
+	return MakeMat4(Vec4Set(2.0f / width, 0.0f, 0.0f, 0.0f), Vec4Set(0.0f, 2.0f / height, 0.0f, 0.0f), Vec4Set(0.0f, 0.0f, q, 0.0f), Vec4Set(0.0f, 0.0f, -zNear * q, 1.0f));
+}
+
+//World to view for a camera at eye looking at target (D3DXMatrixLookAtLH)
+MATH_INLINE Mat4 Mat4LookAtLH(Vec4 eye, Vec4 target, Vec4 up)
+{
+	Vec4 z = Normalize3(target - eye);
+	Vec4 x = Normalize3(Cross3(up, z));
+	Vec4 y = Cross3(z, x);
+
+	Mat4 view = MakeMat4(x, y, z, Vec4Zero());
+	view = Mat4Transpose(view);
+	view.r[3] = Vec4Set(-Dot3(x, eye), -Dot3(y, eye), -Dot3(z, eye), 1.0f);
+	return view;
+}
+
+
+//----------------------------------------------------------------------------------------------------------
+//Quat, x y z w with w the real part
+
+struct Quat
+{
+	Vec4 q;
+};
+
+MATH_INLINE Quat MakeQuat(Vec4 q) { Quat r; r.q = q; return r; }
+
+MATH_INLINE Quat QuatIdentity() { return MakeQuat(Vec4Set(0.0f, 0.0f, 0.0f, 1.0f)); }
+
+//axis must be unit length
+MATH_INLINE Quat QuatFromAxisAngle(Vec4 axis, float angle)
+{
+	float s = sinf(angle * 0.5f), c = cosf(angle * 0.5f);
+	return MakeQuat(MakeVec4(F4Select(F4Mul(axis.v, F4Splat(s)), F4Splat(c), F4MaskW())));
+}
+
+MATH_INLINE Quat QuatConjugate(Quat a) { return MakeQuat(a.q * Vec4Set(-1.0f, -1.0f, -1.0f, 1.0f)); }
+
+MATH_INLINE Quat QuatNormalize(Quat a)
+{
+	SimdF4 lengthSq = F4Dot4(a.q.v, a.q.v);
+	return MakeQuat(MakeVec4(F4Div(a.q.v, F4Sqrt(lengthSq))));
+}
+
+//Rotation a then rotation b, the same order as Mat4Multiply (so the Hamilton product b * a)
+MATH_INLINE Quat QuatMultiply(Quat a, Quat b)
+{
+	SimdF4 p = b.q.v, q = a.q.v;
+
+	SimdF4 r = F4Mul(F4SplatW(p), q);
+	r = F4MulAdd(F4SplatX(p), F4Mul(F4Shuffle<3, 2, 1, 0>(q), F4Set(1.0f, -1.0f, 1.0f, -1.0f)), r);
+	r = F4MulAdd(F4SplatY(p), F4Mul(F4Shuffle<2, 3, 0, 1>(q), F4Set(1.0f, 1.0f, -1.0f, -1.0f)), r);
+	r = F4MulAdd(F4SplatZ(p), F4Mul(F4Shuffle<1, 0, 3, 2>(q), F4Set(-1.0f, 1.0f, 1.0f, -1.0f)), r);
+	return MakeQuat(MakeVec4(r));
+}
+
+//v rotated by unit quaternion a, w of v passes through
+MATH_INLINE Vec4 QuatRotate(Quat a, Vec4 v)
+{
+	//v + w * t + u x t, t = 2 (u x v)
+	SimdF4 t = F4Cross3(a.q.v, v.v);
+	t = F4Add(t, t);
+	return MakeVec4(F4Add(F4MulAdd(F4SplatW(a.q.v), t, v.v), F4Cross3(a.q.v, t)));
+}
+
+//Shortest way round, falls back to a normalized lerp when a and b are close
+inline Quat QuatSlerp(Quat a, Quat b, float t)
+{
+	float cosTheta = Dot4(a.q, b.q);
+	Vec4 to = b.q;
+	if (cosTheta < 0.0f)
+	{
+		cosTheta = -cosTheta;
+		to = -to;
+	}
+
+	if (cosTheta > 0.9995f)
+		return QuatNormalize(MakeQuat(Vec4Lerp(a.q, to, t)));
+
+	float theta = acosf(cosTheta);
+	float invSin = 1.0f / sinf(theta);
+	return MakeQuat(a.q * (sinf((1.0f - t) * theta) * invSin) + to * (sinf(t * theta) * invSin));
+}
+
+//Same rotation as QuatRotate, as a matrix (D3DXMatrixRotationQuaternion)
+MATH_INLINE Mat4 Mat4FromQuat(Quat a)
+{
+	float q[4];
+	F4Store(q, a.q.v);
+	float x = q[0], y = q[1], z = q[2], w = q[3];
+	float xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+
+	return MakeMat4(
+		Vec4Set(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f),
+		Vec4Set(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f),
+		Vec4Set(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f),
+		Vec4Set(0.0f, 0.0f, 0.0f, 1.0f));
+}
+
+//Scale, then rotate, then translate
+MATH_INLINE Mat4 Mat4Compose(Vec4 scale, Quat rotation, Vec4 translation)
+{
+	Mat4 m = Mat4FromQuat(rotation);
+	m.r[0] = m.r[0] * Vec4Splat(Vec4GetX(scale));
+	m.r[1] = m.r[1] * Vec4Splat(Vec4GetY(scale));
+	m.r[2] = m.r[2] * Vec4Splat(Vec4GetZ(scale));
+	m.r[3] = MakeVec4(F4Select(translation.v, F4Splat(1.0f), F4MaskW()));
+	return m;
+}
+
+
+//----------------------------------------------------------------------------------------------------------
+//The d3dUtil colors the demo used
+
+namespace Colors
+{
+	const Float4 White			= { 1.0f, 1.0f, 1.0f, 1.0f };
+	const Float4 Black			= { 0.0f, 0.0f, 0.0f, 1.0f };
+	const Float4 Red			= { 1.0f, 0.0f, 0.0f, 1.0f };
+	const Float4 Green			= { 0.0f, 1.0f, 0.0f, 1.0f };
+	const Float4 Blue			= { 0.0f, 0.0f, 1.0f, 1.0f };
+	const Float4 Yellow			= { 1.0f, 1.0f, 0.0f, 1.0f };
+	const Float4 Cyan			= { 0.0f, 1.0f, 1.0f, 1.0f };
+	const Float4 Magenta		= { 1.0f, 0.0f, 1.0f, 1.0f };
+	const Float4 Silver			= { 0.75f, 0.75f, 0.75f, 1.0f };
+	const Float4 LightSteelBlue	= { 0.69f, 0.77f, 0.87f, 1.0f };
+}
@@ -5,9 +5,12 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
+#define NOMINMAX                        // std::min/max, not the min/max macros
 // Windows Header Files:
 #include <windows.h>
 
@@ -17,5 +20,13 @@
 #include <memory.h>
 #include <tchar.h>
 
+#else
+
+// Portable pieces (locks, timer, ...) also get built on linux for the benchmarks
+#include <stdlib.h>
+#include <string.h>
+
+#endif
+
 
 // TODO: reference additional headers your program requires here